@@ -4,6 +4,7 @@
 #include <string.h>
 #include <math.h>
 #include <stdlib.h>
+#include <errno.h>
 #include <arpa/inet.h>
 #include "MexprEnums.h"
 #include "MExpr.h"
@@ -92,129 +93,6 @@ free_stack(Stack_t *stack)
 /* Internal Stack Implementation FINISHED*/
 /* ====================x================x=================== */
 
-static inline bool 
-Math_is_operator (int token_code) {
-
-    /* Supported Operators In MatheMatical Expression */
-
-    switch (token_code) {
-
-        case MATH_PLUS:
-        case MATH_MINUS:
-        case MATH_MUL:
-        case MATH_DIV:
-        case MATH_MAX:
-        case MATH_MIN:
-        case MATH_POW:
-        case MATH_SIN:
-	    case MATH_COS:
-        case MATH_SQR:
-        case MATH_SQRT:
-        case MATH_BRACKET_START:
-        case MATH_BRACKET_END:
-        case MATH_OR:
-        case MATH_AND:
-        case MATH_LESS_THAN:
-	    case MATH_LESS_THAN_EQ: 
-        case MATH_GREATER_THAN:
-        case MATH_EQ:
-        case MATH_NOT_EQ:
-        return true;
-    }
-
-    return false;
-}
-
-static inline bool 
-Math_is_unary_operator (int token_code) {
-
-    /* Supported Operators In MatheMatical Expression */
-
-    switch (token_code) {
-
-        case MATH_SIN:
-	    case MATH_COS:
-        case MATH_SQR:
-        case MATH_SQRT:
-        return true;
-    }
-
-    return false;
-}
-
-static inline bool 
-Math_is_binary_operator (int token_code) {
-
-    /* Supported Operators In MatheMatical Expression */
-
-    switch (token_code) {
-
-        case MATH_MAX:
-        case MATH_MIN:
-        case MATH_PLUS:
-        case MATH_MINUS:
-        case MATH_MUL:
-        case MATH_DIV:
-        case MATH_POW:
-        case MATH_AND:
-        case MATH_OR:
-        case MATH_GREATER_THAN:
-        case MATH_LESS_THAN:
-	    case MATH_LESS_THAN_EQ:
-        case MATH_EQ:
-        case MATH_NOT_EQ:
-        return true;
-    }
-
-    return false;
-}
-
-static inline bool 
-Math_is_ineq_operator (int token_code) {
-
-    switch (token_code) {
-
-        case MATH_LESS_THAN:
-	    case MATH_LESS_THAN_EQ:
-        case MATH_GREATER_THAN:
-        case MATH_EQ:
-        case MATH_NOT_EQ:
-        return true;
-    }
-
-    return false;    
-}
-
-static inline bool 
-Math_is_logical_operator (int token_code) {
-
-    switch (token_code) {
-
-        case MATH_OR:
-        case MATH_AND:
-        return true;
-    }
-
-    return false;    
-}
-
-static inline bool 
-Math_is_operand (int token_code) {
-
-    switch (token_code) {
-
-        case MATH_IDENTIFIER:
-        case MATH_IDENTIFIER_IDENTIFIER:
-        case MATH_INTEGER_VALUE:
-        case MATH_DOUBLE_VALUE:
-        case MATH_STRING_VALUE:
-            return true;
-        default:
-            return false;
-    }
-}
-
-
 /* Higher the returned value, higher the precedence. 
     Return Minimum value for '(*/
 static int 
@@ -343,21 +221,192 @@ mexpr_convert_infix_to_postfix (lex_data_t *infix, int sizein, int *size_out) {
     return lex_data_arr_out;
 }
 
- static mexpr_var_t 
-mexpt_compute (int opr_token_code,
-                            mexpr_var_t lrc,
-                            mexpr_var_t rrc);
+#define MEXPR_FNV_OFFSET_BASIS  14695981039346656037ULL
+#define MEXPR_FNV_PRIME  1099511628211ULL
 
-mexpt_node_t*
-mexpr_create_mexpt_node (
+static inline uint64_t
+mexpr_fingerprint_update (uint64_t hash, const void *data, int len) {
+
+    int i;
+    const unsigned char *ptr = (const unsigned char *)data;
+
+    for (i = 0; i < len; i++) {
+        hash ^= ptr[i];
+        hash *= MEXPR_FNV_PRIME;
+    }
+    return hash;
+}
+
+/* ====================x================x=================== */
+/* Operand Index */
+
+#define MEXPT_OPD_INDEX_MIN_SIZE  8
+
+static inline uint32_t
+mexpt_operand_name_hash (const char *name) {
+
+    return (uint32_t) mexpr_fingerprint_update (
+                MEXPR_FNV_OFFSET_BASIS, name, strlen (name));
+}
+
+static void
+mexpt_opd_vec_push (mexpt_node_t ***vec, int *n, int *max, mexpt_node_t *node) {
+
+    if (*n == *max) {
+        *max = *max ? *max * 2 : MEXPT_OPD_INDEX_MIN_SIZE;
+        *vec = (mexpt_node_t **)realloc (*vec, *max * sizeof (mexpt_node_t *));
+    }
+    (*vec)[(*n)++] = node;
+}
+
+static void
+mexpt_opd_index_hash_insert (mexpt_opd_index_t *index, mexpt_node_t *node) {
+
+    mexpt_node_t **bucket = &index->buckets[
+                node->u.opd_node.name_hash & (index->n_buckets - 1)];
+
+    node->u.opd_node.hash_prev = NULL;
+    node->u.opd_node.hash_next = *bucket;
+    if (*bucket) (*bucket)->u.opd_node.hash_prev = node;
+    *bucket = node;
+}
+
+static void
+mexpt_opd_index_rehash (mexpt_opd_index_t *index) {
+
+    int i;
+
+    index->n_buckets = index->n_buckets ? index->n_buckets * 2 : MEXPT_OPD_INDEX_MIN_SIZE;
+    free (index->buckets);
+    index->buckets = (mexpt_node_t **)calloc (index->n_buckets, sizeof (mexpt_node_t *));
+
+    for (i = 0; i < index->n_opds; i++) {
+        mexpt_opd_index_hash_insert (index, index->opds[i]);
+    }
+}
+
+static void
+mexpt_opd_index_unresolved_remove (mexpt_node_t *node) {
+
+    mexpt_opd_index_t *index = &node->u.opd_node.tree->opd_index;
+    int pos = node->u.opd_node.unresolved_pos;
+
+    if (pos < 0) return;
+
+    index->unresolved[pos] = index->unresolved[--index->n_unresolved];
+    index->unresolved[pos]->u.opd_node.unresolved_pos = pos;
+    node->u.opd_node.unresolved_pos = -1;
+}
+
+static void
+mexpt_opd_index_add (mexpt_tree_t *tree, mexpt_node_t *node) {
+
+    mexpt_opd_index_t *index = &tree->opd_index;
+
+    assert (mexpt_node_is_operand (node));
+
+    node->u.opd_node.tree = tree;
+    node->u.opd_node.opd_pos = index->n_opds;
+    mexpt_opd_vec_push (&index->opds, &index->n_opds, &index->max_opds, node);
+
+    node->u.opd_node.unresolved_pos = -1;
+    if (!node->u.opd_node.is_resolved) {
+        node->u.opd_node.unresolved_pos = index->n_unresolved;
+        mexpt_opd_vec_push (&index->unresolved, &index->n_unresolved,
+                                           &index->max_unresolved, node);
+    }
+
+    node->u.opd_node.name_hash = mexpt_operand_name_hash (
+                (char *)node->u.opd_node.opd_value.variable_name);
+
+    if (index->n_opds > index->n_buckets) {
+        mexpt_opd_index_rehash (index);
+    }
+    else {
+        mexpt_opd_index_hash_insert (index, node);
+    }
+}
+
+static void
+mexpt_opd_index_free (mexpt_opd_index_t *index) {
+
+    free (index->opds);
+    free (index->unresolved);
+    free (index->buckets);
+    memset (index, 0, sizeof (*index));
+}
+
+void 
+mexpt_node_remove_opd_index (mexpt_node_t *node) {
+
+    int pos;
+    mexpt_opd_index_t *index;
+
+    if (!node->u.opd_node.tree) return;
+
+    index = &node->u.opd_node.tree->opd_index;
+
+    mexpt_opd_index_unresolved_remove (node);
+
+    pos = node->u.opd_node.opd_pos;
+    index->opds[pos] = index->opds[--index->n_opds];
+    index->opds[pos]->u.opd_node.opd_pos = pos;
+
+    if (node->u.opd_node.hash_prev) {
+        node->u.opd_node.hash_prev->u.opd_node.hash_next = node->u.opd_node.hash_next;
+    }
+    else {
+        index->buckets[node->u.opd_node.name_hash & (index->n_buckets - 1)] =
+            node->u.opd_node.hash_next;
+    }
+    if (node->u.opd_node.hash_next) {
+        node->u.opd_node.hash_next->u.opd_node.hash_prev = node->u.opd_node.hash_prev;
+    }
+
+    node->u.opd_node.tree = NULL;
+    node->u.opd_node.hash_next = NULL;
+    node->u.opd_node.hash_prev = NULL;
+}
+
+mexpt_node_t *
+mexpt_tree_lookup_operand (mexpt_tree_t *tree, const char *name, mexpt_node_t *prev) {
+
+    uint32_t hash;
+    mexpt_node_t *node;
+
+    if (prev) {
+        hash = prev->u.opd_node.name_hash;
+        node = prev->u.opd_node.hash_next;
+    }
+    else {
+        if (!tree->opd_index.n_buckets) return NULL;
+        hash = mexpt_operand_name_hash (name);
+        node = tree->opd_index.buckets[hash & (tree->opd_index.n_buckets - 1)];
+    }
+
+    for ( ; node; node = node->u.opd_node.hash_next) {
+
+        if (node->u.opd_node.name_hash == hash &&
+             strcmp ((char *)node->u.opd_node.opd_value.variable_name, name) == 0) {
+            return node;
+        }
+    }
+    return NULL;
+}
+
+/* Fills mexpt_node, all zero, as the node of the token */
+static mexpt_node_t *
+mexpr_init_mexpt_node (
+                mexpt_node_t *mexpt_node,
                 int token_id,
                 int len,
                 void *operand) {
 
     char *endptr;
-    mexpt_node_t *mexpt_node;
 
-    mexpt_node = (mexpt_node_t *)calloc (1, sizeof (mexpt_node_t));
+    mexpt_node->rt_dtype = MEXPR_DTYPE_UNKNOWN;
+    mexpt_node->ic_ltype = MEXPR_DTYPE_INVALID;
+    mexpt_node->ic_rtype = MEXPR_DTYPE_INVALID;
 
     /* If this node is a Math Operator node*/
     if (Math_is_operator (token_id)) {
@@ -377,15 +426,25 @@ mexpr_create_mexpt_node (
             mexpt_node->token_code = token_id;
             return mexpt_node;
         case MATH_INTEGER_VALUE:
-            mexpt_node->u.opd_node.opd_value.math_val= (double)atoi(operand);
+            errno = 0;
+            mexpt_node->u.opd_node.opd_value.int_val = strtoll(operand, &endptr, 10);
             mexpt_node->u.opd_node.is_resolved = true;
             mexpt_node->u.opd_node.is_numeric = true;
+            if (errno == ERANGE) {
+                /* Does not fit in 64 bits, explicitly a double */
+                mexpt_node->u.opd_node.opd_value.math_val = strtod(operand, &endptr);
+                mexpt_node->rt_dtype = MEXPR_DTYPE_DOUBLE;
+                mexpt_node->token_code = MATH_DOUBLE_VALUE;
+                return mexpt_node;
+            }
+            mexpt_node->rt_dtype = MEXPR_DTYPE_INT;
             mexpt_node->token_code = token_id;
             return mexpt_node;
         case MATH_DOUBLE_VALUE:
             mexpt_node->u.opd_node.opd_value.math_val = strtod(operand, &endptr);
             mexpt_node->u.opd_node.is_resolved = true;
             mexpt_node->u.opd_node.is_numeric = true;
+            mexpt_node->rt_dtype = MEXPR_DTYPE_DOUBLE;
             mexpt_node->token_code = token_id;
             return mexpt_node;
         case MATH_STRING_VALUE:
@@ -393,8 +452,12 @@ mexpr_create_mexpt_node (
             strncpy (mexpt_node->u.opd_node.opd_value.string_name, 
                          (char *)operand + 1,  // skip ' or "
                          len -2);
+            mexpt_node->u.opd_node.str_len = len - 2;
+            mexpt_node->u.opd_node.istr = mexpr_intern (
+                mexpt_node->u.opd_node.opd_value.string_name, len - 2);
             mexpt_node->u.opd_node.is_resolved = true;
             mexpt_node->u.opd_node.is_numeric = false;
+            mexpt_node->rt_dtype = MEXPR_DTYPE_STRING;
             mexpt_node->token_code = token_id;
             break;
         default:
@@ -404,6 +467,22 @@ mexpr_create_mexpt_node (
     return mexpt_node;
 }
 
+mexpt_node_t*
+mexpr_create_mexpt_node (
+                int token_id,
+                int len,
+                void *operand) {
+
+    mexpt_node_t *mexpt_node = (mexpt_node_t *)calloc (1, sizeof (mexpt_node_t));
+
+    return mexpr_init_mexpt_node (mexpt_node, token_id, len, operand);
+}
+
+static mexpt_node_pool_t *
+mexpt_node_pool_alloc (int n_nodes);
+
+/* Nodes are carved from one pool in postfix order, so the tree is flat and
+    mexpt_clone( ) copies it with one memcpy */
 mexpt_tree_t *
 mexpr_convert_postfix_to_expression_tree (
                                     lex_data_t **lex_data, int size) {
@@ -414,28 +493,24 @@ mexpr_convert_postfix_to_expression_tree (
     Stack_t *stack = get_new_stack();
 
     tree = (mexpt_tree_t *)calloc (1, sizeof (mexpt_tree_t));
+    tree->node_pools = mexpt_node_pool_alloc (size);
+    tree->is_flat = true;
 
     for (i = 0; i < size; i++) {
 
+        mexpt_node = &tree->node_pools->nodes[i];
+        mexpt_node->is_pooled = true;
+
         if (!Math_is_operator(lex_data[i]->token_code)) {
         
-            mexpt_node = mexpr_create_mexpt_node (
+            mexpr_init_mexpt_node (mexpt_node,
                                     lex_data[i]->token_code, lex_data[i]->token_len, lex_data[i]->token_val);
             push(stack, (void *)mexpt_node);
 
             if (mexpt_node->token_code == MATH_IDENTIFIER ||
                 mexpt_node->token_code == MATH_IDENTIFIER_IDENTIFIER) {
 
-                if (!tree->opd_list_head.lst_right) {
-                    tree->opd_list_head.lst_right = mexpt_node;
-                    mexpt_node->lst_left = &tree->opd_list_head;
-                }
-                else {
-                    mexpt_node->lst_right = tree->opd_list_head.lst_right;
-                    mexpt_node->lst_left = &tree->opd_list_head;
-                    tree->opd_list_head.lst_right = mexpt_node;
-                    mexpt_node->lst_right->lst_left = mexpt_node;
-                }
+                mexpt_opd_index_add (tree, mexpt_node);
             }
 
         }
@@ -444,7 +519,7 @@ mexpr_convert_postfix_to_expression_tree (
 
             mexpt_node_t *right = pop(stack);
             mexpt_node_t *left = pop(stack);
-            mexpt_node_t * opNode = mexpr_create_mexpt_node (
+            mexpt_node_t * opNode = mexpr_init_mexpt_node (mexpt_node,
                                                         lex_data[i]->token_code, 0, NULL);
             opNode->left = left;
             opNode->right = right;
@@ -456,7 +531,7 @@ mexpr_convert_postfix_to_expression_tree (
         else if (Math_is_unary_operator (lex_data[i]->token_code)){
 
             mexpt_node_t *left = pop(stack);
-            mexpt_node_t * opNode = mexpr_create_mexpt_node (
+            mexpt_node_t * opNode = mexpr_init_mexpt_node (mexpt_node,
                                                         lex_data[i]->token_code, 0, NULL);
             opNode->left = left;
             opNode->right = NULL;
@@ -495,29 +570,6 @@ mexpr_debug_print_expression_tree (mexpt_node_t *root) {
     mexpr_debug_print_expression_tree (root->right);
 }
 
-void 
-mexpt_node_remove_list (mexpt_node_t *node) {
-
-    if(!node->lst_left){
-        if(node->lst_right){
-            node->lst_right->lst_left = NULL;
-            node->lst_right = 0;
-            return;
-        }
-        return;
-    }
-    if(!node->lst_right){
-        node->lst_left->lst_right = NULL;
-        node->lst_left = NULL;
-        return;
-    }
-
-    node->lst_left->lst_right = node->lst_right;
-    node->lst_right->lst_left = node->lst_left;
-    node->lst_left = 0;
-    node->lst_right = 0;
-}
-
 void 
 mexpt_destroy(mexpt_node_t *root, bool free_data_src) {
 
@@ -529,11 +581,32 @@ mexpt_destroy(mexpt_node_t *root, bool free_data_src) {
         if (root->token_code == MATH_IDENTIFIER ||
             root->token_code == MATH_IDENTIFIER_IDENTIFIER) {
 
-            if (free_data_src) free(root->u.opd_node.data_src);
-            mexpt_node_remove_list (root);
+            /* data_src of placeholders is owned by the parameter vector */
+            if (free_data_src && !mexpt_node_is_param (root)) {
+                free(root->u.opd_node.data_src);
+            }
+            mexpt_node_remove_opd_index (root);
         }
-        free(root);
+        if (!root->is_pooled) free(root);
+    }
+}
+
+void
+mexpt_tree_destroy (mexpt_tree_t *tree, bool free_data_src) {
+
+    mexpt_node_pool_t *pool;
+
+    mexpt_destroy (tree->root, free_data_src);
+    tree->root = NULL;
+    assert (!tree->opd_index.n_opds);
+    mexpt_opd_index_free (&tree->opd_index);
+
+    while ((pool = tree->node_pools)) {
+        tree->node_pools = pool->next;
+        free (pool);
     }
+    mexpr_param_shape_unref (tree->param_shape);
+    free (tree);
 }
 
 bool 
@@ -544,48 +617,96 @@ mexpr_double_is_integer (double d) {
 }
 
 
-void 
-mexpt_tree_install_operand_properties (
-                mexpt_node_t *node,
-                void *data_src,
-                mexpr_var_t (*compute_fn_ptr)(void *)) {
+static void
+mexpt_refresh_path (mexpt_tree_t *tree, mexpt_node_t *node);
+
+/* rt_dtype is the dtype compute_fn_ptr always returns, MEXPR_DTYPE_UNKNOWN if
+    it may return any */
+static void
+mexpt_install_operand (mexpt_node_t *node,
+                                     void *data_src,
+                                     mexpr_var_t (*compute_fn_ptr)(void *),
+                                     mexpr_dtypes_t rt_dtype) {
 
     assert (node->token_code == MATH_IDENTIFIER ||
                 node->token_code == MATH_IDENTIFIER_IDENTIFIER);
 
+    if (node->u.opd_node.tree) {
+        mexpt_opd_index_unresolved_remove (node);
+        /* Appln sets is_numeric after installation, dtypes are recomputed by
+            next validation */
+        node->u.opd_node.tree->is_validated = false;
+    }
     node->u.opd_node.is_resolved = true;
     node->u.opd_node.data_src =  data_src;
     node->u.opd_node.compute_fn_ptr = compute_fn_ptr;
+    node->rt_dtype = rt_dtype;
+    mexpt_refresh_path (node->u.opd_node.tree, node);
 }
 
-mexpt_node_t *
-mexpt_get_unresolved_operand_node (mexpt_tree_t *tree) {
+void 
+mexpt_tree_install_operand_properties (
+                mexpt_node_t *node,
+                void *data_src,
+                mexpr_var_t (*compute_fn_ptr)(void *)) {
 
-    mexpt_node_t *opd_node;
+    mexpt_install_operand (node, data_src, compute_fn_ptr, MEXPR_DTYPE_UNKNOWN);
+}
 
-    mexpt_iterate_operands_begin (tree, opd_node) {
+void
+mexpt_tree_set_operand_dtype (mexpt_node_t *node, mexpr_dtypes_t dtype) {
+
+    assert (node->u.opd_node.is_resolved);
+    node->rt_dtype = (dtype < MEXPR_DTYPE_MAX) ? dtype : MEXPR_DTYPE_UNKNOWN;
+    mexpt_refresh_path (node->u.opd_node.tree, node);
+}
 
-        if (opd_node->u.opd_node.is_resolved) continue;
-        return opd_node; 
+void
+mexpt_tree_set_operand_stats (mexpt_node_t *node, const mexpt_col_stats_t *stats) {
 
-    } mexpt_iterate_operands_end (tree, opd_node);
+    assert (mexpt_node_is_operand (node));
+    node->u.opd_node.stats = stats;
+}
 
-    return NULL;
+mexpt_node_t *
+mexpt_get_unresolved_operand_node (mexpt_tree_t *tree) {
+
+    mexpt_opd_index_t *index = &tree->opd_index;
+
+    if (!index->n_unresolved) return NULL;
+    return index->unresolved[index->n_unresolved - 1];
 }
 
-uint8_t 
+/* Every destroyed operand leaves the unresolved set in O(1), so the removal is
+    one pass over the unresolved set and the destroyed subtrees. Unresolved
+    operands with no Ineq above them stay in the tree, they are moved to the
+    front of the unresolved set which is never reached by the destroys */
+int 
 mexpt_remove_unresolved_operands (mexpt_tree_t *tree, bool free_data_src) {
 
-    uint8_t count = 0;
+    int count = 0;
+    int n_kept = 0;
     mexpt_node_t *opd_node;
+    mexpt_opd_index_t *index = &tree->opd_index;
     
-    while ((opd_node = mexpt_get_unresolved_operand_node (tree))) {
+    while (index->n_unresolved > n_kept) {
+
+        opd_node = index->unresolved[index->n_unresolved - 1];
 
         while (opd_node && !Math_is_ineq_operator (opd_node->token_code)) {
             opd_node = opd_node->parent;
         }
 
-        if (!opd_node) return count;
+        if (!opd_node) {
+
+            opd_node = index->unresolved[index->n_unresolved - 1];
+            index->unresolved[index->n_unresolved - 1] = index->unresolved[n_kept];
+            index->unresolved[index->n_unresolved - 1]->u.opd_node.unresolved_pos =
+                index->n_unresolved - 1;
+            index->unresolved[n_kept] = opd_node;
+            opd_node->u.opd_node.unresolved_pos = n_kept++;
+            continue;
+        }
 
         mexpt_destroy (opd_node->left, free_data_src);
         mexpt_destroy (opd_node->right, free_data_src);
@@ -593,6 +714,7 @@ mexpt_remove_unresolved_operands (mexpt_tree_t *tree, bool free_data_src) {
         opd_node->right = NULL;
         opd_node->u.ineq_node.is_optimized = true;
         opd_node->u.ineq_node.result = true;
+        mexpt_refresh_path (tree, opd_node);
         count++;
     }
 
@@ -602,93 +724,208 @@ mexpt_remove_unresolved_operands (mexpt_tree_t *tree, bool free_data_src) {
     return count;
 }
 
-static void 
-mexpt_node_clone_data (mexpt_node_t  *src_node, mexpt_node_t  *dst_node) {
+static mexpt_node_pool_t *
+mexpt_node_pool_alloc (int n_nodes) {
 
-    memcpy (dst_node, src_node, sizeof (*dst_node));
-    dst_node->left = NULL;
-    dst_node->right = NULL;
-    dst_node->lst_left = NULL;
-    dst_node->lst_right = NULL;
-    dst_node->parent = NULL;
+    mexpt_node_pool_t *pool = (mexpt_node_pool_t *)calloc (1,
+                                    sizeof (mexpt_node_pool_t) + n_nodes * sizeof (mexpt_node_t));
+    pool->n_nodes = n_nodes;
+    pool->nodes = (mexpt_node_t *)(pool + 1);
+    return pool;
 }
 
-static void
-mexpt_clone_node_recursively (mexpt_node_t  *src_node, 
-                                                     mexpt_node_t  *dst_node, 
-                                                     int child,  
-                                                     mexpt_node_t  **new_root) {
+int
+mexpt_count_nodes (mexpt_node_t *node) {
 
-    mexpt_node_t *child_node = NULL;
+    if (!node) return 0;
+    return 1 + mexpt_count_nodes (node->left) + mexpt_count_nodes (node->right);
+}
 
-    if (!src_node) return;
-    
-    if (child == 0) {
-        dst_node = (mexpt_node_t *) calloc (1, sizeof (mexpt_node_t));
-        mexpt_node_clone_data (src_node, dst_node);
-        *new_root = dst_node;
-        child_node = dst_node;
+/* Copies the subtree rooted at src_node into consecutive slots of the pool
+    in pre-order, and indexes the operands on the way */
+static mexpt_node_t *
+mexpt_clone_node_flat (mexpt_tree_t *clone_tree,
+                                     mexpt_node_t *src_node,
+                                     mexpt_node_t *parent,
+                                     int *index) {
+
+    mexpt_node_t *dst_node = &clone_tree->node_pools->nodes[(*index)++];
+
+    memcpy (dst_node, src_node, sizeof (*dst_node));
+    dst_node->is_pooled = true;
+    dst_node->parent = parent;
+
+    if (mexpt_node_is_operand (dst_node)) {
+        mexpt_opd_index_add (clone_tree, dst_node);
+    }
+
+    if (src_node->left) {
+        dst_node->left = mexpt_clone_node_flat (clone_tree, src_node->left, dst_node, index);
     }
-    else if (child == -1) {
-        child_node = (mexpt_node_t *) calloc (1, sizeof (mexpt_node_t));
-        mexpt_node_clone_data (src_node,  child_node);
-        dst_node->left = child_node;
-        child_node->parent = dst_node;
+    if (src_node->right) {
+        dst_node->right = mexpt_clone_node_flat (clone_tree, src_node->right, dst_node, index);
     }
-    else if (child == 1) {
-        child_node = (mexpt_node_t *) calloc (1, sizeof (mexpt_node_t));
-        mexpt_node_clone_data (src_node,  child_node);
-        dst_node->right = child_node;
-        child_node->parent = dst_node;
-    }  
-    mexpt_clone_node_recursively (src_node->left, child_node, -1, new_root);
-    mexpt_clone_node_recursively (src_node->right, child_node, 1, new_root);
+    return dst_node;
 }
 
-static void 
-_mexpt_tree_create_operand_list (mexpt_tree_t *tree, mexpt_node_t *node) {
+#define MEXPT_RELOCATE(ptr, src_base, dst_base) \
+    if (ptr) ptr = (dst_base) + ((ptr) - (src_base))
 
-    if (!node) return;
+static mexpt_node_t **
+mexpt_opd_vec_clone (mexpt_node_t **vec, int n, mexpt_node_t *src_base, mexpt_node_t *dst_base) {
 
-    if (node->token_code == MATH_IDENTIFIER ||
-        node->token_code == MATH_IDENTIFIER_IDENTIFIER) {
-
-        if (!tree->opd_list_head.lst_right) {
+    int i;
+    mexpt_node_t **dst_vec;
 
-            tree->opd_list_head.lst_right = node;
-            node->lst_left = &tree->opd_list_head;
-        }
-        else {
+    if (!n) return NULL;
 
-            node->lst_right = tree->opd_list_head.lst_right;
-            node->lst_left = &tree->opd_list_head;
-            tree->opd_list_head.lst_right = node;
-            node->lst_right->lst_left = node;
-        }
+    dst_vec = (mexpt_node_t **)malloc (n * sizeof (mexpt_node_t *));
+    for (i = 0; i < n; i++) {
+        dst_vec[i] = vec[i] ? dst_base + (vec[i] - src_base) : NULL;
     }
+    return dst_vec;
+}
+
+/* Operand index of the clone of a flat tree is the one of the source with the
+    node pointers relocated : slots and name hashes, copied along with the
+    nodes, stay valid and no name is hashed again */
+static void
+mexpt_opd_index_clone (mexpt_tree_t *tree,
+                                      mexpt_tree_t *clone_tree,
+                                      mexpt_node_t *src_base,
+                                      mexpt_node_t *dst_base) {
 
-    _mexpt_tree_create_operand_list  (tree, node->left);
-    _mexpt_tree_create_operand_list  (tree, node->right);
+    int i;
+    mexpt_node_t *node;
+    mexpt_opd_index_t *src = &tree->opd_index;
+    mexpt_opd_index_t *dst = &clone_tree->opd_index;
+
+    dst->opds = mexpt_opd_vec_clone (src->opds, src->n_opds, src_base, dst_base);
+    dst->n_opds = dst->max_opds = src->n_opds;
+    dst->unresolved = mexpt_opd_vec_clone (src->unresolved, src->n_unresolved,
+                                                                  src_base, dst_base);
+    dst->n_unresolved = dst->max_unresolved = src->n_unresolved;
+    dst->buckets = mexpt_opd_vec_clone (src->buckets, src->n_buckets, src_base, dst_base);
+    dst->n_buckets = src->n_buckets;
+
+    for (i = 0; i < dst->n_opds; i++) {
+
+        node = dst->opds[i];
+        node->u.opd_node.tree = clone_tree;
+        MEXPT_RELOCATE (node->u.opd_node.hash_next, src_base, dst_base);
+        MEXPT_RELOCATE (node->u.opd_node.hash_prev, src_base, dst_base);
+    }
 }
 
-static void 
-mexpt_tree_create_operand_list (mexpt_tree_t *tree ) {
+/* Source tree is flat : clone is one memcpy of its pool, followed by
+    relocation of the node links. Nodes released by mexpt_optimize( ) are
+    copied along but stay unreachable */
+static void
+mexpt_clone_pool (mexpt_tree_t *tree, mexpt_tree_t *clone_tree) {
+
+    int i;
+    mexpt_node_t *node;
+    mexpt_node_pool_t *src_pool = tree->node_pools;
+    mexpt_node_t *src_base = src_pool->nodes;
+    mexpt_node_t *dst_base;
+
+    /* Not zeroed, every node is overwritten */
+    clone_tree->node_pools = (mexpt_node_pool_t *)malloc (
+                        sizeof (mexpt_node_pool_t) + src_pool->n_nodes * sizeof (mexpt_node_t));
+    clone_tree->node_pools->next = NULL;
+    clone_tree->node_pools->n_nodes = src_pool->n_nodes;
+    clone_tree->node_pools->nodes = (mexpt_node_t *)(clone_tree->node_pools + 1);
+    dst_base = clone_tree->node_pools->nodes;
+    memcpy (dst_base, src_base, src_pool->n_nodes * sizeof (mexpt_node_t));
+
+    for (i = 0; i < src_pool->n_nodes; i++) {
+
+        node = &dst_base[i];
+        MEXPT_RELOCATE (node->left, src_base, dst_base);
+        MEXPT_RELOCATE (node->right, src_base, dst_base);
+        MEXPT_RELOCATE (node->parent, src_base, dst_base);
+    }
 
-    _mexpt_tree_create_operand_list (tree, tree->root);
+    clone_tree->root = dst_base + (tree->root - src_base);
+    mexpt_opd_index_clone (tree, clone_tree, src_base, dst_base);
 }
 
+/* Clone has all its nodes in one contiguous pool : no per node allocation
+    and no separate pass to rebuild the operand list */
 mexpt_tree_t *
 mexpt_clone (mexpt_tree_t *tree) {
 
-    mexpt_node_t *new_root = NULL;
+    int index = 0;
     mexpt_tree_t *clone_tree = (mexpt_tree_t *) calloc (1, sizeof (mexpt_tree_t));
     if (!tree->root) return clone_tree;
-    mexpt_clone_node_recursively (tree->root, NULL, 0, &new_root);
-    clone_tree->root = new_root;
-    mexpt_tree_create_operand_list (clone_tree );
+
+    if (tree->is_flat) {
+        mexpt_clone_pool (tree, clone_tree);
+    }
+    else {
+        clone_tree->node_pools = mexpt_node_pool_alloc (mexpt_count_nodes (tree->root));
+        clone_tree->root = mexpt_clone_node_flat (clone_tree, tree->root, NULL, &index);
+        assert (index == clone_tree->node_pools->n_nodes);
+    }
+    clone_tree->is_flat = true;
+    clone_tree->is_validated = tree->is_validated;
+    clone_tree->param_shape = mexpr_param_shape_ref (tree->param_shape);
+    return clone_tree;
+}
+
+/* Left deep : ((n0 opr n1) opr n2) ... */
+static mexpt_tree_t *
+mexpt_clone_joined (mexpt_node_t **nodes, int n_nodes, int opr_token_code) {
+
+    int i;
+    int index = 0;
+    int n_pool = n_nodes - 1;
+    mexpt_node_t *opr_node;
+    mexpt_node_t *root = NULL;
+    mexpt_tree_t *clone_tree = (mexpt_tree_t *) calloc (1, sizeof (mexpt_tree_t));
+
+    if (n_nodes <= 0) return clone_tree;
+
+    for (i = 0; i < n_nodes; i++) {
+        n_pool += mexpt_count_nodes (nodes[i]);
+    }
+    clone_tree->node_pools = mexpt_node_pool_alloc (n_pool);
+
+    root = mexpt_clone_node_flat (clone_tree, nodes[0], NULL, &index);
+
+    for (i = 1; i < n_nodes; i++) {
+
+        opr_node = &clone_tree->node_pools->nodes[index++];
+        opr_node->token_code = opr_token_code;
+        opr_node->is_pooled = true;
+        opr_node->rt_dtype = MEXPR_DTYPE_UNKNOWN;
+        opr_node->ic_ltype = MEXPR_DTYPE_INVALID;
+        opr_node->ic_rtype = MEXPR_DTYPE_INVALID;
+        opr_node->left = root;
+        root->parent = opr_node;
+        opr_node->right = mexpt_clone_node_flat (clone_tree, nodes[i], opr_node, &index);
+        root = opr_node;
+    }
+    assert (index == n_pool);
+
+    clone_tree->root = root;
+    clone_tree->is_flat = true;
+    mexpr_validate_expression_tree (clone_tree);
     return clone_tree;
 }
 
+mexpt_tree_t *
+mexpt_clone_conjunction (mexpt_node_t **nodes, int n_nodes) {
+
+    return mexpt_clone_joined (nodes, n_nodes, MATH_AND);
+}
+
+mexpt_tree_t *
+mexpt_clone_disjunction (mexpt_node_t **nodes, int n_nodes) {
+
+    return mexpt_clone_joined (nodes, n_nodes, MATH_OR);
+}
+
 /* NEW IMPLEMENTATION*/
 
 #include "MexprDb.c"
@@ -702,16 +939,47 @@ mexpt_compute (int opr_token_code,
     return opr_fn_ptr (lrc, rrc);
 }
 
-mexpr_var_t
-mexpt_evaluate (mexpt_node_t *root)  {
+mexpr_dtypes_t
+mexpt_opr_result_dtype (int opr_token_code,
+                                        mexpr_dtypes_t ld,
+                                        mexpr_dtypes_t rd) {
+
+    return mexpr_opr_result_dtype (opr_token_code, ld, rd);
+}
+
+/* Guard is the pair of operand dtypes seen last time, on a miss the cache is
+    refilled from MexprDb unless the node has gone megamorphic */
+static inline mexpr_var_t
+mexpt_compute_cached (mexpt_node_t *node, mexpr_var_t lrc, mexpr_var_t rrc) {
+
+    if (lrc.dtype == node->ic_ltype && rrc.dtype == node->ic_rtype) {
+        return node->ic_opr_fn (lrc, rrc);
+    }
+
+    if (node->ic_misses >= MEXPT_IC_MAX_MISSES) {
+        return mexpt_compute (node->token_code, lrc, rrc);
+    }
+
+    node->ic_misses++;
+    node->ic_opr_fn = MexprDb[node->token_code][lrc.dtype][rrc.dtype];
+    node->ic_ltype = lrc.dtype;
+    node->ic_rtype = rrc.dtype;
+    return node->ic_opr_fn (lrc, rrc);
+}
+
+/* shared : the tree may be evaluated by other threads at the same time,
+    kernels not preselected are looked up in MexprDb without touching the inline
+    caches, so that nothing of the tree is written */
+static mexpr_var_t
+mexpt_evaluate_node (mexpt_node_t *root, bool shared)  {
 
     mexpr_var_t res;
     res.dtype = MEXPR_DTYPE_INVALID;
 
     if (!root) return res;
 
-    mexpr_var_t lrc = mexpt_evaluate (root->left);
-    mexpr_var_t rrc = mexpt_evaluate (root->right);
+    mexpr_var_t lrc = mexpt_evaluate_node (root->left, shared);
+    mexpr_var_t rrc = mexpt_evaluate_node (root->right, shared);
 
         /* If I am leaf */
     if (!root->left && !root->right) {
@@ -731,16 +999,14 @@ mexpt_evaluate (mexpt_node_t *root)  {
                 return res;
             case MATH_INTEGER_VALUE:
                 res.dtype = MEXPR_DTYPE_INT;
-                res.u.int_val = (int)  root->u.opd_node.opd_value.math_val;
+                res.u.int_val = root->u.opd_node.opd_value.int_val;
                 return res;
             case MATH_DOUBLE_VALUE:
                 res.dtype = MEXPR_DTYPE_DOUBLE;
                 res.u.d_val = root->u.opd_node.opd_value.math_val;
                 return res;
             case MATH_STRING_VALUE:
-                res.dtype = MEXPR_DTYPE_STRING;
-                res.u.str_val =  root->u.opd_node.opd_value.string_name;
-                return res;
+                return mexpr_var_interned (root->u.opd_node.istr);
             default:
             /* Due to optimization leaf may contain : Ineq Op Or Logical Op also*/
             if (Math_is_ineq_operator (root->token_code)) {
@@ -763,24 +1029,55 @@ mexpt_evaluate (mexpt_node_t *root)  {
 
         assert (Math_is_unary_operator (root->token_code));
         if (lrc.dtype == MEXPR_DTYPE_INVALID) return res;
-        return mexpt_compute (root->token_code, lrc, lrc);
+        if (root->opr_fn) return root->opr_fn (lrc, lrc);
+        if (shared) return mexpt_compute (root->token_code, lrc, lrc);
+        return mexpt_compute_cached (root, lrc, lrc);
     }
 
     /* If I am Full node */
     if (lrc.dtype== MEXPR_DTYPE_INVALID || rrc.dtype == MEXPR_DTYPE_INVALID) return res;
 
      assert (Math_is_binary_operator (root->token_code));
-     return mexpt_compute (root->token_code, lrc, rrc);
+     if (root->opr_fn) return root->opr_fn (lrc, rrc);
+     if (shared) return mexpt_compute (root->token_code, lrc, rrc);
+     return mexpt_compute_cached (root, lrc, rrc);
 }
 
+mexpr_var_t
+mexpt_evaluate_in (mexpt_node_t *root, mexpr_arena_t *arena) {
 
-static mexpr_dtypes_t
-mexpr_validate_expression_tree_internal (mexpt_node_t *node) {
+    mexpr_var_t res;
+    mexpr_arena_t *prev = mexpr_arena_enter (arena);
 
-    if (!node) return MEXPR_DTYPE_INVALID;
-    
-     mexpr_dtypes_t lrc = mexpr_validate_expression_tree_internal (node->left);
-     mexpr_dtypes_t rrc = mexpr_validate_expression_tree_internal (node->right);
+    res = mexpt_evaluate_node (root, false);
+    mexpr_arena_leave (prev);
+    return res;
+}
+
+mexpr_var_t
+mexpt_evaluate (mexpt_node_t *root) {
+
+    return mexpt_evaluate_in (root, NULL);
+}
+
+mexpr_var_t
+mexpt_evaluate_shared (mexpt_node_t *root) {
+
+    mexpr_var_t res;
+    mexpr_arena_t *prev = mexpr_arena_enter (NULL);
+
+    res = mexpt_evaluate_node (root, true);
+    mexpr_arena_leave (prev);
+    return res;
+}
+
+
+/* dtype of the node given the dtypes of its children, from the same table
+    as rt_dtype (see mexpr_opr_result_dtype( )) */
+static mexpr_dtypes_t
+mexpr_validate_node (mexpt_node_t *node,
+                                   mexpr_dtypes_t lrc,
+                                   mexpr_dtypes_t rrc) {
 
     /* Operand Nodes*/
     if (!node->left && !node->right) {
@@ -790,9 +1087,14 @@ mexpr_validate_expression_tree_internal (mexpt_node_t *node) {
             case MATH_IDENTIFIER:
             case MATH_IDENTIFIER_IDENTIFIER:
                 if (!node->u.opd_node.is_resolved) return MEXPR_DTYPE_UNKNOWN;
+                /* Declared by mexpt_tree_set_operand_dtype( ), else numeric
+                    operands are taken for double */
+                if (node->rt_dtype < MEXPR_DTYPE_MAX) return node->rt_dtype;
                 if (node->u.opd_node.is_numeric) return MEXPR_DTYPE_DOUBLE;
                 return MEXPR_DTYPE_STRING;
             case MATH_INTEGER_VALUE:
+                if (!node->u.opd_node.is_resolved) return MEXPR_DTYPE_INVALID;
+                return MEXPR_DTYPE_INT;
             case MATH_DOUBLE_VALUE:
                 if (!node->u.opd_node.is_resolved) return MEXPR_DTYPE_INVALID;
                 return MEXPR_DTYPE_DOUBLE;
@@ -813,35 +1115,214 @@ mexpr_validate_expression_tree_internal (mexpt_node_t *node) {
         }
     }
 
-    /* half nodes */
-    if (node->left && !node->right ) {
+    /* Unary operators ignore rrc */
+    return mexpr_opr_result_dtype (node->token_code, lrc, rrc);
+}
+
+/* Infers rt_dtype of the node from rt_dtype of its children, and preselects the
+    kernel when both are known. rt_dtype of operand nodes is set when installed */
+static void
+mexpt_infer_node (mexpt_node_t *node) {
+
+    mexpr_dtypes_t ld, rd, dtype;
 
-        return MexprDb_dtypes_supported[node->token_code](lrc, rrc);
+    if (!node->left && !node->right) {
+
+        switch (node->token_code) {
+
+            case MATH_IDENTIFIER:
+            case MATH_IDENTIFIER_IDENTIFIER:
+                break;
+            case MATH_INTEGER_VALUE:
+                node->rt_dtype = MEXPR_DTYPE_INT;
+                break;
+            case MATH_DOUBLE_VALUE:
+                node->rt_dtype = MEXPR_DTYPE_DOUBLE;
+                break;
+            case MATH_STRING_VALUE:
+                node->rt_dtype = MEXPR_DTYPE_STRING;
+                break;
+            default:
+                /* Optimized Ineq or Logical node */
+                node->rt_dtype = MEXPR_DTYPE_BOOL;
+        }
+        node->opr_fn = NULL;
+        return;
     }
 
-    /* Full node*/
-    return MexprDb_dtypes_supported[node->token_code](lrc, rrc);
+    node->rt_dtype = MEXPR_DTYPE_UNKNOWN;
+    node->opr_fn = NULL;
+
+    /* Children may have changed, give the inline cache a fresh start */
+    node->ic_ltype = MEXPR_DTYPE_INVALID;
+    node->ic_rtype = MEXPR_DTYPE_INVALID;
+    node->ic_opr_fn = NULL;
+    node->ic_misses = 0;
+
+    /* Unary operators are computed as (lrc, lrc) */
+    ld = node->left->rt_dtype;
+    rd = node->right ? node->right->rt_dtype : ld;
+
+    dtype = mexpr_opr_result_dtype (node->token_code, ld, rd);
+    if (dtype == MEXPR_DTYPE_INVALID) return;
+
+    /* Known even if an operand dtype is not, when all of them agree */
+    node->rt_dtype = dtype;
+    if (ld < MEXPR_DTYPE_MAX && rd < MEXPR_DTYPE_MAX) {
+        node->opr_fn = MexprDb[node->token_code][ld][rd];
+    }
 }
 
+static mexpr_dtypes_t
+mexpr_validate_expression_tree_internal (mexpt_node_t *node) {
+
+    if (!node) return MEXPR_DTYPE_INVALID;
+    
+     mexpr_dtypes_t lrc = mexpr_validate_expression_tree_internal (node->left);
+     mexpr_dtypes_t rrc = mexpr_validate_expression_tree_internal (node->right);
+
+     node->dtype = mexpr_validate_node (node, lrc, rrc);
+     mexpt_infer_node (node);
+     return node->dtype;
+}
+
+/* Operand node was installed, or Ineq node was optimized away : updates cached
+    dtype, rt_dtype and kernel of the node and of its ancestors, up to the first
+    ancestor which does not change */
+static void
+mexpt_refresh_path (mexpt_tree_t *tree, mexpt_node_t *node) {
+
+    mexpr_dtypes_t dtype, rt_dtype;
+    operator_fn_ptr_t opr_fn;
+    bool validated = tree && tree->is_validated;
+
+    if (validated) {
+        node->dtype = mexpr_validate_node (node, MEXPR_DTYPE_INVALID, MEXPR_DTYPE_INVALID);
+    }
+    mexpt_infer_node (node);
+
+    for (node = node->parent; node; node = node->parent) {
+
+        dtype = node->dtype;
+        rt_dtype = node->rt_dtype;
+        opr_fn = node->opr_fn;
+
+        if (validated) {
+            node->dtype = mexpr_validate_node (node, node->left->dtype,
+                    node->right ? node->right->dtype : MEXPR_DTYPE_INVALID);
+        }
+        mexpt_infer_node (node);
+
+        if (node->dtype == dtype && node->rt_dtype == rt_dtype &&
+             node->opr_fn == opr_fn) break;
+    }
+
+    if (validated && tree->root->dtype == MEXPR_DTYPE_INVALID) {
+        tree->is_validated = false;
+    }
+}
 
 bool
 mexpr_validate_expression_tree (mexpt_tree_t *tree) {
 
-    return   (mexpr_validate_expression_tree_internal (tree->root) != MEXPR_DTYPE_INVALID);;
+    tree->is_validated = 
+        (mexpr_validate_expression_tree_internal (tree->root) != MEXPR_DTYPE_INVALID);
+    return tree->is_validated;
 }
 
 
-bool
-mexpt_optimize (mexpt_node_t *root) {
+static inline bool
+mexpt_node_is_constant (mexpt_node_t *node) {
+
+    return (!node->left && !node->right &&
+                node->u.opd_node.is_resolved &&
+                node->u.opd_node.compute_fn_ptr == NULL);
+}
+
+/* Value of a constant leaf, as mexpt_evaluate( ) returns it */
+static mexpr_var_t
+mexpt_leaf_value (mexpt_node_t *node) {
+
+    mexpr_var_t val;
+
+    switch (node->token_code) {
+
+        case MATH_INTEGER_VALUE:
+            val.dtype = MEXPR_DTYPE_INT;
+            val.u.int_val = node->u.opd_node.opd_value.int_val;
+            break;
+        case MATH_DOUBLE_VALUE:
+            val.dtype = MEXPR_DTYPE_DOUBLE;
+            val.u.d_val = node->u.opd_node.opd_value.math_val;
+            break;
+        case MATH_STRING_VALUE:
+            val = mexpr_var_interned (node->u.opd_node.istr);
+            break;
+        default:
+            val.dtype = MEXPR_DTYPE_INVALID;
+    }
+    return val;
+}
+
+/* Turns the operator node into a constant leaf holding val, keeping its dtype.
+    Returns false, leaving the node as is, if val is not a leaf value */
+static bool
+mexpt_set_leaf_value (mexpt_node_t *node, mexpr_var_t val) {
+
+    switch (val.dtype) {
+
+        case MEXPR_DTYPE_INT:
+            node->token_code = MATH_INTEGER_VALUE;
+            node->u.opd_node.is_numeric = true;
+            node->u.opd_node.opd_value.int_val = val.u.int_val;
+            break;
+        case MEXPR_DTYPE_DOUBLE:
+            node->token_code = MATH_DOUBLE_VALUE;
+            node->u.opd_node.is_numeric = true;
+            node->u.opd_node.opd_value.math_val = val.u.d_val;
+            break;
+        case MEXPR_DTYPE_STRING:
+            /* Too long for a literal, left for the evaluation */
+            if (val.str_len >= sizeof (node->u.opd_node.opd_value.string_name)) return false;
+            node->token_code = MATH_STRING_VALUE;
+            node->u.opd_node.is_numeric = false;
+            memset (node->u.opd_node.opd_value.string_name, 0,
+                sizeof (node->u.opd_node.opd_value.string_name));
+            memcpy (node->u.opd_node.opd_value.string_name, val.u.str_val, val.str_len);
+            node->u.opd_node.str_len = val.str_len;
+            node->u.opd_node.istr = mexpr_intern (val.u.str_val, val.str_len);
+            break;
+        default:
+            return false;
+    }
+
+    node->u.opd_node.is_resolved = true;
+    return true;
+}
+
+/* mexpt_compute( ) of literals being folded, with errors of the kernel not
+    reported : a failed fold gives MEXPR_DTYPE_INVALID, and mexpt_set_leaf_value( )
+    then leaves the node for the evaluation to report */
+static mexpr_var_t
+mexpt_fold_compute (int token_code, mexpr_var_t lval, mexpr_var_t rval) {
 
-    bool rc = false;
     mexpr_var_t res;
-    mexpt_node_t *lchild, *rchild;
+    bool quiet = mexpr_db_quiet;
 
-    if (!root) return false;
+    mexpr_db_quiet = true;
+    res = mexpt_compute (token_code, lval, rval);
+    mexpr_db_quiet = quiet;
+    return res;
+}
 
-    bool lrc = mexpt_optimize  (root->left);
-    bool rrc = mexpt_optimize  (root->right);
+/* Folds the node if possible, lrc and rrc tell whether its children are
+    constant. Returns true if the node is constant afterwards */
+static bool
+mexpt_optimize_node (mexpt_node_t *root, bool lrc, bool rrc) {
+
+    bool rc = false;
+    mexpr_var_t res, lval, rval;
+    mexpt_node_t *lchild, *rchild;
 
     /* Leaf node*/
     if (!root->left && !root->right) {
@@ -866,48 +1347,33 @@ mexpt_optimize (mexpt_node_t *root) {
         /* Half node cannot have child with string value*/
         assert(lchild->u.opd_node.is_numeric);
 
-        res.dtype = MEXPR_DTYPE_DOUBLE;
-        res.u.d_val = lchild->u.opd_node.opd_value.math_val;
-        res = mexpt_compute(root->token_code, res, res);
-
-        /* Passing gouble arg, so expecting double output only*/
-        assert(res.dtype == MEXPR_DTYPE_DOUBLE);
+        res = mexpt_leaf_value (lchild);
+        res = mexpt_fold_compute (root->token_code, res, res);
 
-        /* Rejuvenate the self*/
-        root->token_code = MATH_DOUBLE_VALUE;
-        root->left = NULL;
-        root->u.opd_node.is_resolved = true;
-        root->u.opd_node.is_numeric = true;
-        root->u.opd_node.opd_value.math_val = res.u.d_val;
+        /* Rejuvenate the self, unless it failed (integer overflow) and is left
+            for the evaluation to report */
+        if (!mexpt_set_leaf_value (root, res)) return false;
         mexpt_destroy(lchild, true);
+        root->left = NULL;
         return true;
     }
 
     /* Full nodes*/
 
-    mexpr_var_t lval, rval;
-
     switch (root->token_code) {
 
+      /* Numbers and Strings */
       case MATH_LESS_THAN:
       case MATH_LESS_THAN_EQ:
       case MATH_GREATER_THAN:
+      case MATH_EQ:
+      case MATH_NOT_EQ:
 
           if (!lrc || !rrc) return false;
 
-          lchild = root->left;
-          rchild = root->right;
-
-          /* In Mexpr Tree We store numerc values as double only*/
-          assert(lchild->u.opd_node.is_numeric);
-          assert(rchild->u.opd_node.is_numeric);
-
-          lval.dtype = MEXPR_DTYPE_DOUBLE;
-          lval.u.d_val = lchild->u.opd_node.opd_value.math_val;
-          rval.dtype = MEXPR_DTYPE_DOUBLE;
-          rval.u.d_val = rchild->u.opd_node.opd_value.math_val;
-
-          res = mexpt_compute(root->token_code, lval, rval);
+          res = mexpt_fold_compute (root->token_code,
+                                      mexpt_leaf_value (root->left),
+                                      mexpt_leaf_value (root->right));
           assert(res.dtype == MEXPR_DTYPE_BOOL);
 
           root->u.ineq_node.is_optimized = true;
@@ -918,59 +1384,6 @@ mexpt_optimize (mexpt_node_t *root) {
           root->right = NULL;
           return true;
 
-    /* Support Strings also*/
-    case MATH_EQ:
-    case MATH_NOT_EQ:
-         if (!lrc || !rrc) return false;
-         lchild = root->left;
-         rchild = root->right;
-
-         if (lchild->u.opd_node.is_numeric == false) {
-             // this API is used only after  mexpr_validate_expression_tree( )
-             assert(rchild->u.opd_node.is_numeric == false);
-             assert(lchild->u.opd_node.is_resolved &&
-                    rchild->u.opd_node.is_resolved);
-
-            lval.dtype = MEXPR_DTYPE_STRING;
-            lval.u.str_val = lchild->u.opd_node.opd_value.string_name;
-            rval.dtype = MEXPR_DTYPE_STRING;
-            rval.u.str_val = rchild->u.opd_node.opd_value.string_name;
-
-            res = mexpt_compute (root->token_code, lval, rval);
-            assert(res.dtype == MEXPR_DTYPE_BOOL);
-
-             root->u.ineq_node.is_optimized = true;
-             root->u.ineq_node.result = res.u.b_val;
-
-             mexpt_destroy(root->left, true);
-             mexpt_destroy(root->right, true);
-             root->left = NULL;
-             root->right = NULL;
-             return true;
-         }
-         else
-         {
-             assert(lchild->u.opd_node.is_numeric);
-             assert(rchild->u.opd_node.is_numeric);
-            lval.dtype = MEXPR_DTYPE_DOUBLE;
-            lval.u.d_val = lchild->u.opd_node.opd_value.math_val;
-            rval.dtype = MEXPR_DTYPE_DOUBLE;
-            rval.u.d_val = rchild->u.opd_node.opd_value.math_val;
-
-            res = mexpt_compute (root->token_code, lval, rval);
-            assert(res.dtype == MEXPR_DTYPE_BOOL);
-             root->u.ineq_node.is_optimized = true;
-             root->u.ineq_node.result =res.u.b_val;
-
-             mexpt_destroy(root->left, true);
-             mexpt_destroy(root->right, true);
-             root->left = NULL;
-             root->right = NULL;
-             return true;
-         }
-        break;
-
-
           case MATH_OR:
         {
             if (!lrc && !rrc) return false;
@@ -1038,7 +1451,8 @@ mexpt_optimize (mexpt_node_t *root) {
                 return true;
             }
         }
-        break;
+        /* Only one side is known and it does not decide the result */
+        return false;
 
 
 
@@ -1109,125 +1523,33 @@ mexpt_optimize (mexpt_node_t *root) {
                 return true;
             }
         }
-        break;
+        /* Only one side is known and it does not decide the result */
+        return false;
 
-    /* Supported on Strings also */
+    /* Folded with the kernels of the literal dtypes, so int op int stays int
+        (/ truncates) except for ^. Strings are supported by + - max min */
     case MATH_PLUS:
     case MATH_MINUS:
-            if (!lrc || !rrc) return false;
-            lchild = root->left;
-            rchild = root->right;
-
-            if (lchild->u.opd_node.is_numeric) {
-                lval.dtype = MEXPR_DTYPE_DOUBLE;
-                lval.u.d_val = lchild->u.opd_node.opd_value.math_val ;
-            }
-            else {
-                lval.dtype = MEXPR_DTYPE_STRING;
-                lval.u.str_val = lchild->u.opd_node.opd_value.string_name;
-            }
-            if (rchild->u.opd_node.is_numeric) {
-                rval.dtype = MEXPR_DTYPE_DOUBLE;
-                rval.u.d_val = rchild->u.opd_node.opd_value.math_val ;
-            }
-            else {
-                rval.dtype = MEXPR_DTYPE_STRING;
-                rval.u.str_val = rchild->u.opd_node.opd_value.string_name;
-            }            
-    
-            res = mexpt_compute (root->token_code, lval, rval);
-            
-            if (res.dtype == MEXPR_DTYPE_DOUBLE) {
-                root->token_code = MATH_DOUBLE_VALUE;
-                root->u.opd_node.is_numeric = true;
-                root->u.opd_node.opd_value.math_val = res.u.d_val;
-            }
-            else if (res.dtype == MEXPR_DTYPE_STRING) {
-                root->token_code = MATH_STRING_VALUE;
-                root->u.opd_node.is_numeric = false;
-                memset (root->u.opd_node.opd_value.string_name, 0,
-                    sizeof (root->u.opd_node.opd_value.string_name));
-                strncpy(root->u.opd_node.opd_value.string_name,
-                    res.u.str_val, sizeof (root->u.opd_node.opd_value.string_name));
-            }
-            root->u.opd_node.is_resolved = true;
-            mexpt_destroy(root->left, true);
-            mexpt_destroy(root->right, true);
-            root->left = NULL;
-            root->right = NULL;
-            return true;     
-        break;        
-
     case MATH_MUL:
     case MATH_DIV:
     case MATH_POW:
-            if (!lrc || !rrc) return false;
-            lchild = root->left;
-            rchild = root->right;
-            assert (lchild->u.opd_node.is_numeric); 
-            assert (rchild->u.opd_node.is_numeric);
-            lval.dtype = MEXPR_DTYPE_DOUBLE;
-            lval.u.d_val = lchild->u.opd_node.opd_value.math_val;
-            rval.dtype = MEXPR_DTYPE_DOUBLE;
-            rval.u.d_val = rchild->u.opd_node.opd_value.math_val;
-            res = mexpt_compute (root->token_code, lval, rval);
-            root->token_code = MATH_DOUBLE_VALUE;
-            root->u.opd_node.is_numeric = true;
-            root->u.opd_node.opd_value.math_val = res.u.d_val;
-            root->u.opd_node.is_resolved = true;
-            mexpt_destroy(root->left, true);
-            mexpt_destroy(root->right, true);
-            root->left = NULL;
-            root->right = NULL;
-            return true;     
-        break;              
-
     case MATH_MAX:
     case MATH_MIN:
             if (!lrc || !rrc) return false;
-            lchild = root->left;
-            rchild = root->right;
-
-            if (lchild->u.opd_node.is_numeric) {
-                lval.dtype = MEXPR_DTYPE_DOUBLE;
-                lval.u.d_val = lchild->u.opd_node.opd_value.math_val ;
-            }
-            else {
-                lval.dtype = MEXPR_DTYPE_STRING;
-                lval.u.str_val = lchild->u.opd_node.opd_value.string_name;
-            }
-            if (rchild->u.opd_node.is_numeric) {
-                rval.dtype = MEXPR_DTYPE_DOUBLE;
-                rval.u.d_val = rchild->u.opd_node.opd_value.math_val ;
-            }
-            else {
-                rval.dtype = MEXPR_DTYPE_STRING;
-                rval.u.str_val = rchild->u.opd_node.opd_value.string_name;
-            }         
 
-            res = mexpt_compute (root->token_code, lval, rval);
+            lval = mexpt_leaf_value (root->left);
+            rval = mexpt_leaf_value (root->right);
 
-            if (res.dtype == MEXPR_DTYPE_DOUBLE) {
-                root->token_code = MATH_DOUBLE_VALUE;
-                root->u.opd_node.is_numeric = true;
-                root->u.opd_node.opd_value.math_val = res.u.d_val;
-            }
-            else if (res.dtype == MEXPR_DTYPE_STRING) {
-                root->token_code = MATH_STRING_VALUE;
-                root->u.opd_node.is_numeric = false;
-                memset (root->u.opd_node.opd_value.string_name, 0,
-                    sizeof (root->u.opd_node.opd_value.string_name));
-                strncpy(root->u.opd_node.opd_value.string_name,
-                    res.u.str_val, sizeof (root->u.opd_node.opd_value.string_name));
-            }
+            /* Divide by zero, integer overflow or a string too long are
+                left for the evaluation to report */
+            res = mexpt_fold_compute (root->token_code, lval, rval);
+            if (!mexpt_set_leaf_value (root, res)) return false;
 
-            root->u.opd_node.is_resolved = true;
             mexpt_destroy(root->left, true);
             mexpt_destroy(root->right, true);
             root->left = NULL;
             root->right = NULL;
-            return true;     
-        break;           
+            return true;
 
         default:
             assert(0);
@@ -1236,14 +1558,52 @@ mexpt_optimize (mexpt_node_t *root) {
     return true;
 }
 
-/* Caution : If the function fails, the caller must assume that child_tree and leaf_node
-    are already freed memory and should not attempt to manipulate or free them again !*/
 bool
-mexpt_concatenate_mexpt_trees (mexpt_tree_t *parent_tree, 
-                                                       mexpt_node_t *leaf_node,
-                                                       mexpt_tree_t *child_tree) {
+mexpt_optimize (mexpt_node_t *root) {
+
+    bool rc;
+
+    if (!root) return false;
+
+    bool lrc = mexpt_optimize  (root->left);
+    bool rrc = mexpt_optimize  (root->right);
+
+    /* Node may have been folded, or its children may have been */
+    rc = mexpt_optimize_node (root, lrc, rrc);
+    mexpt_infer_node (root);
+    return rc;
+}
+
+static void
+mexpt_tree_adopt_node_pools (mexpt_tree_t *parent_tree, mexpt_tree_t *child_tree) {
+
+    mexpt_node_pool_t *pool;
 
-    mexpt_node_t *curr_node;
+    while ((pool = child_tree->node_pools)) {
+        child_tree->node_pools = pool->next;
+        pool->next = parent_tree->node_pools;
+        parent_tree->node_pools = pool;
+    }
+
+    /* Parent tree now has nodes outside of its first pool */
+    parent_tree->is_flat = false;
+}
+
+#define MEXPT_NODE_CLEAN         0
+#define MEXPT_NODE_DIRTY_PATH    1   /* some descendant was spliced in */
+#define MEXPT_NODE_DIRTY_SUBTREE 2   /* root of a spliced in subtree */
+
+/* Replaces leaf_node by the root of child_tree, consumes child_tree and leaf_node.
+    Marks the spliced subtree and the path above it dirty. Returns true if
+    leaf_node was the root of parent_tree */
+static bool
+mexpt_splice_tree (mexpt_tree_t *parent_tree,
+                              mexpt_node_t *leaf_node,
+                              mexpt_tree_t *child_tree) {
+
+    int i;
+    bool leaf_is_root;
+    mexpt_node_t *node;
 
     assert (leaf_node->left == NULL && leaf_node->right == NULL);
     assert (child_tree->root);
@@ -1251,44 +1611,463 @@ mexpt_concatenate_mexpt_trees (mexpt_tree_t *parent_tree,
                 leaf_node->token_code == MATH_IDENTIFIER_IDENTIFIER);
     assert (!leaf_node->u.opd_node.is_resolved);
 
-    if (!leaf_node->parent) {
+    /* Nodes of child tree now belong to parent tree, and so do its pools */
+    mexpt_tree_adopt_node_pools (parent_tree, child_tree);
+
+    mexpt_node_remove_opd_index (leaf_node);
+
+    leaf_is_root = (leaf_node->parent == NULL);
+
+    if (leaf_is_root) {
         assert (parent_tree->root == leaf_node);
-        free(leaf_node);
         parent_tree->root = child_tree->root;
-        child_tree->root = NULL;
-        parent_tree->opd_list_head.lst_right = child_tree->opd_list_head.lst_right;
-        parent_tree->opd_list_head.lst_right->lst_left = &parent_tree->opd_list_head;
-        free(child_tree);
-        return true;
     }
+    else {
+        mexpt_node_t *parent_node = leaf_node->parent;
 
-    mexpt_node_t *parent_node = leaf_node->parent;
+        if (parent_node->left == leaf_node)
+            parent_node->left = child_tree->root;
+        else
+            parent_node->right = child_tree->root;
 
-    if (parent_node->left == leaf_node)
-        parent_node->left = child_tree->root;
-    else
-        parent_node->right = child_tree->root;
+        child_tree->root->parent = parent_node;
+    }
 
-    child_tree->root->parent = parent_node;
+    if (!leaf_node->is_pooled) free(leaf_node);
+
+    child_tree->root->dirty = MEXPT_NODE_DIRTY_SUBTREE;
+    for (node = child_tree->root->parent;
+          node && node->dirty == MEXPT_NODE_CLEAN;
+          node = node->parent) {
+
+        node->dirty = MEXPT_NODE_DIRTY_PATH;
+    }
     child_tree->root = NULL;
 
-    mexpt_node_remove_list (leaf_node);
-    free(leaf_node);
+    /* Append operands of child tree to the operand index of parent tree */
+    for (i = 0; i < child_tree->opd_index.n_opds; i++) {
+        mexpt_opd_index_add (parent_tree, child_tree->opd_index.opds[i]);
+    }
+    mexpt_opd_index_free (&child_tree->opd_index);
+    free(child_tree);
+
+    return leaf_is_root;
+}
+
+/* Revalidates dirty nodes only, clean nodes contribute their cached dtype */
+static mexpr_dtypes_t
+mexpr_validate_dirty (mexpt_node_t *node) {
+
+    mexpr_dtypes_t lrc, rrc;
+
+    if (!node) return MEXPR_DTYPE_INVALID;
+
+    switch (node->dirty) {
+
+        case MEXPT_NODE_DIRTY_SUBTREE:
+            return mexpr_validate_expression_tree_internal (node);
+        case MEXPT_NODE_DIRTY_PATH:
+            lrc = mexpr_validate_dirty (node->left);
+            rrc = mexpr_validate_dirty (node->right);
+            node->dtype = mexpr_validate_node (node, lrc, rrc);
+            mexpt_infer_node (node);
+            return node->dtype;
+        default:
+            return node->dtype;
+    }
+}
+
+/* Reoptimizes dirty nodes only and marks them clean. A clean node is as optimized
+    as it can be already, so it is constant only if it is a constant leaf */
+static bool
+mexpt_optimize_dirty (mexpt_node_t *node) {
+
+    bool lrc, rrc;
+
+    if (!node) return false;
+
+    switch (node->dirty) {
+
+        case MEXPT_NODE_DIRTY_SUBTREE:
+            node->dirty = MEXPT_NODE_CLEAN;
+            return mexpt_optimize (node);
+        case MEXPT_NODE_DIRTY_PATH:
+            node->dirty = MEXPT_NODE_CLEAN;
+            lrc = mexpt_optimize_dirty (node->left);
+            rrc = mexpt_optimize_dirty (node->right);
+            rrc = mexpt_optimize_node (node, lrc, rrc);
+            mexpt_infer_node (node);
+            return rrc;
+        default:
+            return mexpt_node_is_constant (node);
+    }
+}
+
+static void
+mexpt_clear_dirty (mexpt_node_t *node) {
+
+    if (!node || node->dirty == MEXPT_NODE_CLEAN) return;
+
+    node->dirty = MEXPT_NODE_CLEAN;
+    mexpt_clear_dirty (node->left);
+    mexpt_clear_dirty (node->right);
+}
+
+/* Revalidates and reoptimizes the paths marked dirty by mexpt_splice_tree( ).
+    Falls back to full validation if the dtypes cached on parent_tree are stale */
+static bool
+mexpt_revalidate_dirty (mexpt_tree_t *parent_tree) {
+
+    if (parent_tree->is_validated) {
+        parent_tree->is_validated = 
+            (mexpr_validate_dirty (parent_tree->root) != MEXPR_DTYPE_INVALID);
+    }
+    else {
+        mexpr_validate_expression_tree (parent_tree);
+    }
+
+    if (!parent_tree->is_validated) {
+        mexpt_clear_dirty (parent_tree->root);
+        return false;
+    }
+
+    mexpt_optimize_dirty (parent_tree->root);
+    return true;
+}
+
+/* Caution : If the function fails, the caller must assume that child_tree and leaf_node
+    are already freed memory and should not attempt to manipulate or free them again !*/
+bool
+mexpt_concatenate_mexpt_trees (mexpt_tree_t *parent_tree, 
+                                                       mexpt_node_t *leaf_node,
+                                                       mexpt_tree_t *child_tree) {
+
+    bool child_validated = child_tree->is_validated;
+
+    if (mexpt_splice_tree (parent_tree, leaf_node, child_tree)) {
+        /* child tree is the whole of parent tree now */
+        mexpt_clear_dirty (parent_tree->root);
+        parent_tree->is_validated = child_validated;
+        return true;
+    }
+
+    return mexpt_revalidate_dirty (parent_tree);
+}
+
+bool
+mexpt_substitute_operands (mexpt_tree_t *parent_tree,
+                                                mexpt_subst_t *substs,
+                                                int n_substs) {
+
+    int i, n_leaves = 0, max_leaves = 0;
+    mexpt_node_t *leaf_node;
+    mexpt_node_t **leaves = NULL;
+    int *leaf_subst = NULL;
+
+    /* Collect the leaves first, so that operands brought in by the child
+        trees are never substituted */
+    for (i = 0; i < n_substs; i++) {
+
+        for (leaf_node = mexpt_tree_lookup_operand (parent_tree, substs[i].opd_name, NULL);
+              leaf_node;
+              leaf_node = mexpt_tree_lookup_operand (parent_tree, substs[i].opd_name, leaf_node)) {
+
+            /* Resolved operand, or already taken by an earlier entry of substs */
+            if (leaf_node->u.opd_node.is_resolved ||
+                 leaf_node->dirty != MEXPT_NODE_CLEAN) continue;
+
+            if (n_leaves == max_leaves) {
+                max_leaves = max_leaves ? max_leaves * 2 : 16;
+                leaves = (mexpt_node_t **)realloc (leaves, max_leaves * sizeof (*leaves));
+                leaf_subst = (int *)realloc (leaf_subst, max_leaves * sizeof (*leaf_subst));
+            }
+            leaf_node->dirty = MEXPT_NODE_DIRTY_SUBTREE;
+            leaves[n_leaves] = leaf_node;
+            leaf_subst[n_leaves++] = i;
+        }
+    }
+
+    for (i = 0; i < n_leaves; i++) {
+
+        leaves[i]->dirty = MEXPT_NODE_CLEAN;
+        mexpt_splice_tree (parent_tree, leaves[i],
+                mexpt_clone (substs[leaf_subst[i]].child_tree));
+    }
+
+    free (leaves);
+    free (leaf_subst);
+
+    if (!n_leaves) return true;
+    return mexpt_revalidate_dirty (parent_tree);
+}
+
+/* ====================x================x=================== */
+/* Auto-Parameterization of Literals */
+
+static inline bool
+Math_is_literal (int token_code) {
+
+    switch (token_code) {
+
+        case MATH_INTEGER_VALUE:
+        case MATH_DOUBLE_VALUE:
+        case MATH_STRING_VALUE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/* Postfix span of one subtree : [start, end] are contiguous in postfix order */
+typedef struct mexpr_param_span_ {
+
+    int start;
+    int end;
+    bool is_const;
+} mexpr_param_span_t;
+
+static inline uint64_t
+mexpr_param_shape_update (uint64_t hash,
+                                              mexpr_param_shape_t *shape,
+                                              const void *data,
+                                              int len) {
+
+    memcpy (shape->data + shape->len, data, len);
+    shape->len += len;
+    return mexpr_fingerprint_update (hash, data, len);
+}
+
+static void
+mexpr_param_lift_literal (lex_data_t **postfix, int index, mexpr_param_vec_t *params) {
+
+    char *endptr;
+    lex_data_t *lex_data = postfix[index];
+    lex_data_t *placeholder = &params->placeholders[params->n_params];
+    mexpr_var_t *param = &params->params[params->n_params];
+
+    switch (lex_data->token_code) {
+
+        case MATH_INTEGER_VALUE:
+            /* Same as mexpr_create_mexpt_node( ), double if out of range */
+            errno = 0;
+            param->dtype = MEXPR_DTYPE_INT;
+            param->u.int_val = strtoll ((char *)lex_data->token_val, &endptr, 10);
+            if (errno == ERANGE) {
+                param->dtype = MEXPR_DTYPE_DOUBLE;
+                param->u.d_val = strtod ((char *)lex_data->token_val, &endptr);
+            }
+            break;
+        case MATH_DOUBLE_VALUE:
+            param->dtype = MEXPR_DTYPE_DOUBLE;
+            param->u.d_val = strtod ((char *)lex_data->token_val, &endptr);
+            break;
+        case MATH_STRING_VALUE:
+            /* skip enclosing ' or " */
+            *param = mexpr_var_string ((unsigned char *)calloc (1, lex_data->token_len - 1),
+                                                  lex_data->token_len - 2);
+            memcpy (param->u.str_val, lex_data->token_val + 1, param->str_len);
+            break;
+        default:
+            assert(0);
+    }
+
+    placeholder->token_code = MATH_IDENTIFIER;
+    placeholder->token_val = (uint8_t *)calloc (1, 16);
+    placeholder->token_len = snprintf ((char *)placeholder->token_val, 16, "%c%d",
+                                                                MEXPR_PARAM_PREFIX, params->n_params);
+    postfix[index] = placeholder;
+    params->n_params++;
+}
+
+/* Lifts the literals of the postfix stream into params. Literals which are
+    operands of a foldable (all constant) operator are retained inline. 
+    params takes the ownership of postfix array. Returns the shape fingerprint*/
+uint64_t
+mexpr_parameterize_postfix (lex_data_t **postfix, int size, mexpr_param_vec_t *params) {
+
+    int i, j, n_opnds;
+    bool all_const;
+    uint32_t shape_len;
+    lex_data_t *lex_data;
+    mexpr_param_span_t opnds[2];
+    uint64_t hash = MEXPR_FNV_OFFSET_BASIS;
+
+    memset (params, 0, sizeof (*params));
+    params->postfix = postfix;
+    params->postfix_size = size;
+    params->params = (mexpr_var_t *)calloc (size ? size : 1, sizeof (mexpr_var_t));
+    params->placeholders = (lex_data_t *)calloc (size ? size : 1, sizeof (lex_data_t));
+
+    mexpr_param_span_t *stack = (mexpr_param_span_t *)calloc (
+                                                        size ? size : 1, sizeof (mexpr_param_span_t));
+    int top = -1;
+
+    /* Pass 1 : simulate the tree construction to find the literals which
+        are combined with a non-constant operand */
+    for (i = 0; i < size; i++) {
+
+        lex_data = postfix[i];
+
+        if (!Math_is_operator (lex_data->token_code)) {
+            top++;
+            stack[top].start = i;
+            stack[top].end = i;
+            stack[top].is_const = Math_is_literal (lex_data->token_code);
+            continue;
+        }
+
+        n_opnds = Math_is_unary_operator (lex_data->token_code) ? 1 : 2;
+        assert (top + 1 >= n_opnds);
+
+        all_const = true;
+        for (j = n_opnds - 1; j >= 0; j--) {
+            opnds[j] = stack[top--];
+            if (!opnds[j].is_const) all_const = false;
+        }
+
+        if (!all_const) {
+            for (j = 0; j < n_opnds; j++) {
+                /* Only bare literals are lifted, constant sub-expressions
+                    are left for mexpt_optimize( ) to fold */
+                if (opnds[j].is_const && opnds[j].start == opnds[j].end) {
+                    mexpr_param_lift_literal (postfix, opnds[j].start, params);
+                }
+            }
+        }
+
+        top++;
+        stack[top].start = opnds[0].start;
+        stack[top].end = i;
+        stack[top].is_const = all_const;
+    }
+
+    free (stack);
+
+    /* Pass 2 : fingerprint the parameterized stream. Placeholders contribute
+        the literal type only, everything else contributes its token text. The
+        shape keeps the same bytes, to tell apart streams whose fingerprints
+        collide */
+    shape_len = 0;
+    for (i = 0; i < size; i++) {
+        shape_len += 2 * sizeof (int) + sizeof (mexpr_dtypes_t) + postfix[i]->token_len;
+    }
+    params->shape = (mexpr_param_shape_t *)malloc (sizeof (mexpr_param_shape_t) + shape_len);
+    params->shape->ref_count = 1;
+    params->shape->len = 0;
+
+    for (i = 0; i < size; i++) {
+
+        lex_data = postfix[i];
+        hash = mexpr_param_shape_update (hash, params->shape,
+                                                                &lex_data->token_code, sizeof (lex_data->token_code));
+
+        if (lex_data >= params->placeholders &&
+             lex_data < params->placeholders + params->n_params) {
+
+            mexpr_dtypes_t dtype = params->params[lex_data - params->placeholders].dtype;
+            hash = mexpr_param_shape_update (hash, params->shape, &dtype, sizeof (dtype));
+            continue;
+        }
+
+        if (mexpr_is_white_space (lex_data->token_code) ||
+             Math_is_operator (lex_data->token_code)) continue;
+
+        hash = mexpr_param_shape_update (hash, params->shape,
+                                                                &lex_data->token_len, sizeof (lex_data->token_len));
+        hash = mexpr_param_shape_update (hash, params->shape,
+                                                                lex_data->token_val, lex_data->token_len);
+    }
+
+    params->fingerprint = hash;
+    return hash;
+}
+
+/* Tree keeps a reference to the shape it was built from, its clones share it */
+mexpt_tree_t *
+mexpr_param_vec_build_tree (mexpr_param_vec_t *params) {
 
-    mexpt_iterate_operands_begin (parent_tree, curr_node) {
+    mexpt_tree_t *tree = mexpr_convert_postfix_to_expression_tree (
+                                            params->postfix, params->postfix_size);
 
-        if (!curr_node->lst_right) break;
+    tree->param_shape = mexpr_param_shape_ref (params->shape);
+    return tree;
+}
 
-    } mexpt_iterate_operands_end (parent_tree, curr_node) ;
+static mexpr_var_t
+mexpr_param_compute_fn (void *data_src) {
 
-    if (!curr_node) {
-        curr_node = &parent_tree->opd_list_head;
+    return *(mexpr_var_t *)data_src;
+}
+
+mexpr_param_shape_t *
+mexpr_param_shape_ref (mexpr_param_shape_t *shape) {
+
+    if (shape) __atomic_add_fetch (&shape->ref_count, 1, __ATOMIC_RELAXED);
+    return shape;
+}
+
+void
+mexpr_param_shape_unref (mexpr_param_shape_t *shape) {
+
+    if (shape && __atomic_sub_fetch (&shape->ref_count, 1, __ATOMIC_ACQ_REL) == 0) {
+        free (shape);
     }
-     curr_node->lst_right = child_tree->opd_list_head.lst_right;
-     curr_node->lst_right->lst_left = curr_node;
-     free(child_tree);
+}
+
+/* Binds placeholder operands $i of the tree to params->params[i]. tree is typically
+    a clone of the cached tree built from an expression of the same fingerprint :
+    the stream the tree was built from must be the one of params, else the
+    fingerprints collided and nothing is bound */
+bool
+mexpt_bind_parameters (mexpt_tree_t *tree, mexpr_param_vec_t *params) {
 
-     if (!mexpr_validate_expression_tree (parent_tree)) return false;
-     mexpt_optimize (parent_tree->root);
-     return true;
-}
\ No newline at end of file
+    int index;
+    mexpt_node_t *opd_node;
+    mexpr_param_shape_t *shape = tree->param_shape;
+
+    if (shape && shape != params->shape &&
+            (shape->len != params->shape->len ||
+             memcmp (shape->data, params->shape->data, shape->len) != 0)) {
+        return false;
+    }
+
+    mexpt_iterate_operands_begin (tree, opd_node) {
+
+        if (!mexpt_node_is_param (opd_node)) continue;
+
+        index = atoi ((char *)opd_node->u.opd_node.opd_value.variable_name + 1);
+        if (index < 0 || index >= params->n_params) return false;
+
+        /* Tree without a shape : at least the dtype it was bound with */
+        if (opd_node->rt_dtype != MEXPR_DTYPE_UNKNOWN &&
+                opd_node->rt_dtype != params->params[index].dtype) return false;
+
+        mexpt_install_operand (opd_node, &params->params[index],
+                mexpr_param_compute_fn, params->params[index].dtype);
+        opd_node->u.opd_node.is_numeric =
+                (params->params[index].dtype != MEXPR_DTYPE_STRING);
+
+    } mexpt_iterate_operands_end (tree, opd_node);
+
+    return true;
+}
+
+void
+mexpr_param_vec_free (mexpr_param_vec_t *params) {
+
+    int i;
+
+    for (i = 0; i < params->n_params; i++) {
+
+        if (params->params[i].dtype == MEXPR_DTYPE_STRING) {
+            free (params->params[i].u.str_val);
+        }
+        free (params->placeholders[i].token_val);
+    }
+
+    free (params->params);
+    free (params->placeholders);
+    free (params->postfix);
+    mexpr_param_shape_unref (params->shape);
+    memset (params, 0, sizeof (*params));
+}
@@ -5,6 +5,8 @@
 #include <stdbool.h>
 
 #include "MexprEnums.h"
+#include "MexprArena.h"
+#include "MexprIntern.h"
 
 /*
 1. Appln must create an expression tree
@@ -24,6 +26,9 @@
 
 typedef struct mexpt_tree_ mexpt_tree_t;
 typedef struct mexpt_node_  mexpt_node_t;
+typedef struct mexpt_node_pool_ mexpt_node_pool_t;
+typedef struct mexpt_col_stats_ mexpt_col_stats_t;
+typedef struct mexpr_param_shape_ mexpr_param_shape_t;
 
 struct mexpt_node_ {
 
@@ -35,6 +40,33 @@ struct mexpt_node_ {
     */
     int token_code;
 
+    /* Node is carved out of a mexpt_node_pool_t of the tree and must not be freed
+        individually. Pool is freed by mexpt_tree_destroy( ) */
+    bool is_pooled;
+
+    /* Result dtype of this subtree, as computed by the last validation */
+    mexpr_dtypes_t dtype;
+
+    /* Node lies on a path touched by mexpt_substitute_operands( ) and is yet to be
+        revalidated and reoptimized */
+    uint8_t dirty;
+
+    /* dtype mexpt_evaluate( ) returns for this node unless evaluation fails,
+        MEXPR_DTYPE_UNKNOWN if it is known only at run time. When dtypes of
+        both children are known, opr_fn is the kernel preselected from MexprDb */
+    mexpr_dtypes_t rt_dtype;
+    operator_fn_ptr_t opr_fn;
+
+    /* Inline cache of operator node whose kernel is not preselected : operand
+        dtypes seen by the last evaluation and the kernel for them. Node goes
+        megamorphic (generic dispatch only) after MEXPT_IC_MAX_MISSES misses.
+        Written by mexpt_evaluate( ), hence threads sharing a tree evaluate it
+        with mexpt_evaluate_shared( ) */
+    mexpr_dtypes_t ic_ltype;
+    mexpr_dtypes_t ic_rtype;
+    operator_fn_ptr_t ic_opr_fn;
+    uint8_t ic_misses;
+
     union {
 
         /* Below fields are relevant only when this node is operand nodes*/
@@ -43,10 +75,13 @@ struct mexpt_node_ {
             
             bool is_resolved;
             bool is_numeric;     /* Is this Operand constant Number or constant AlphaNumberic ?*/
+            uint16_t str_len;    /* MATH_STRING_VALUE : length of string_name */
+            const mexpr_istr_t *istr;   /* MATH_STRING_VALUE : string_name interned */
             
             /* ToDo : Replace this union with mexpr_var_t */
             union {
-                double math_val;
+                double math_val;        /* MATH_DOUBLE_VALUE */
+                int64_t int_val;        /* MATH_INTEGER_VALUE */
                 unsigned char string_name[MEXPR_TREE_OPERAND_LEN_MAX];
                 unsigned char variable_name[MEXPR_TREE_OPERAND_LEN_MAX];
             } opd_value;
@@ -54,6 +89,17 @@ struct mexpt_node_ {
             void *data_src;
             mexpr_var_t (*compute_fn_ptr) (void *);
 
+            /* Statistics of the column, for MexprSelectivity. Owned by Appln */
+            const mexpt_col_stats_t *stats;
+
+            /* Entry of this operand in the operand index of its owning tree */
+            mexpt_tree_t *tree;
+            int opd_pos;            /* slot in tree->opd_index.opds */
+            int unresolved_pos;     /* slot in tree->opd_index.unresolved, -1 if resolved */
+            uint32_t name_hash;
+            mexpt_node_t *hash_next;
+            mexpt_node_t *hash_prev;
+
         } opd_node;
 
 
@@ -74,26 +120,186 @@ struct mexpt_node_ {
 
     mexpt_node_t *left;
     mexpt_node_t *right;
-    mexpt_node_t *lst_left;
-    mexpt_node_t *lst_right;
     mexpt_node_t *parent;
 
 } ;
 
+#define MEXPT_IC_MAX_MISSES 4
+
+/* Contiguous block of nodes : the parser and mexpt_clone( ) allocate all
+    nodes of the tree they build from a single pool */
+struct mexpt_node_pool_ {
+
+    mexpt_node_pool_t *next;
+    int n_nodes;
+    mexpt_node_t *nodes;
+};
+
+/* Operand index of a tree : all operand nodes in a vector, the unresolved ones
+    in a second vector, and a hash on operand name. Removal is O(1) swap with the
+    last slot, so the order of operands is not preserved */
+typedef struct mexpt_opd_index_ {
+
+    mexpt_node_t **opds;
+    int n_opds;
+    int max_opds;
+
+    mexpt_node_t **unresolved;
+    int n_unresolved;
+    int max_unresolved;
+
+    mexpt_node_t **buckets;     /* chained through opd_node.hash_next */
+    int n_buckets;              /* power of 2 */
+} mexpt_opd_index_t;
+
 struct mexpt_tree_ {
 
     mexpt_node_t *root;
-    mexpt_node_t opd_list_head;
+    mexpt_opd_index_t opd_index;
+    mexpt_node_pool_t *node_pools;
+    /* All nodes of the tree live in the single pool node_pools, so the
+        tree can be cloned with one memcpy of the pool */
+    bool is_flat;
+    /* dtypes cached on the nodes are up to date */
+    bool is_validated;
+    /* Parameterized stream the tree was built from, see mexpt_bind_parameters( ) */
+    mexpr_param_shape_t *param_shape;
 };
 
+/* Operands are visited from the last slot to the first. Body may destroy the
+    current operand, or splice a tree in its place : removed slot is refilled by
+    an operand already visited, operands appended by the splice are not visited */
 #define mexpt_iterate_operands_begin(tree_ptr, node_ptr)  \
-    { mexpt_node_t *_next_node = NULL; \
-    for (node_ptr = tree_ptr->opd_list_head.lst_right; node_ptr; node_ptr = _next_node){ \
-        _next_node = node_ptr->lst_right;
+    { int _opd_pos; \
+    for (_opd_pos = (tree_ptr)->opd_index.n_opds - 1; _opd_pos >= 0; _opd_pos--){ \
+        if (_opd_pos >= (tree_ptr)->opd_index.n_opds) continue; \
+        node_ptr = (tree_ptr)->opd_index.opds[_opd_pos];
 
 #define mexpt_iterate_operands_end(tree_ptr, node_ptr) }}
 
 
+static inline bool 
+Math_is_operator (int token_code) {
+
+    /* Supported Operators In MatheMatical Expression */
+
+    switch (token_code) {
+
+        case MATH_PLUS:
+        case MATH_MINUS:
+        case MATH_MUL:
+        case MATH_DIV:
+        case MATH_MAX:
+        case MATH_MIN:
+        case MATH_POW:
+        case MATH_SIN:
+	    case MATH_COS:
+        case MATH_SQR:
+        case MATH_SQRT:
+        case MATH_BRACKET_START:
+        case MATH_BRACKET_END:
+        case MATH_OR:
+        case MATH_AND:
+        case MATH_LESS_THAN:
+	    case MATH_LESS_THAN_EQ: 
+        case MATH_GREATER_THAN:
+        case MATH_EQ:
+        case MATH_NOT_EQ:
+        return true;
+    }
+
+    return false;
+}
+
+static inline bool 
+Math_is_unary_operator (int token_code) {
+
+    /* Supported Operators In MatheMatical Expression */
+
+    switch (token_code) {
+
+        case MATH_SIN:
+	    case MATH_COS:
+        case MATH_SQR:
+        case MATH_SQRT:
+        return true;
+    }
+
+    return false;
+}
+
+static inline bool 
+Math_is_binary_operator (int token_code) {
+
+    /* Supported Operators In MatheMatical Expression */
+
+    switch (token_code) {
+
+        case MATH_MAX:
+        case MATH_MIN:
+        case MATH_PLUS:
+        case MATH_MINUS:
+        case MATH_MUL:
+        case MATH_DIV:
+        case MATH_POW:
+        case MATH_AND:
+        case MATH_OR:
+        case MATH_GREATER_THAN:
+        case MATH_LESS_THAN:
+	    case MATH_LESS_THAN_EQ:
+        case MATH_EQ:
+        case MATH_NOT_EQ:
+        return true;
+    }
+
+    return false;
+}
+
+static inline bool 
+Math_is_ineq_operator (int token_code) {
+
+    switch (token_code) {
+
+        case MATH_LESS_THAN:
+	    case MATH_LESS_THAN_EQ:
+        case MATH_GREATER_THAN:
+        case MATH_EQ:
+        case MATH_NOT_EQ:
+        return true;
+    }
+
+    return false;    
+}
+
+static inline bool 
+Math_is_logical_operator (int token_code) {
+
+    switch (token_code) {
+
+        case MATH_OR:
+        case MATH_AND:
+        return true;
+    }
+
+    return false;    
+}
+
+static inline bool 
+Math_is_operand (int token_code) {
+
+    switch (token_code) {
+
+        case MATH_IDENTIFIER:
+        case MATH_IDENTIFIER_IDENTIFIER:
+        case MATH_INTEGER_VALUE:
+        case MATH_DOUBLE_VALUE:
+        case MATH_STRING_VALUE:
+            return true;
+        default:
+            return false;
+    }
+}
+
 typedef struct lex_data_ lex_data_t;
 
 lex_data_t **
@@ -118,9 +324,47 @@ mexpr_debug_print_expression_tree (mexpt_node_t *root) ;
 void 
 mexpt_destroy (mexpt_node_t *root, bool free_data_src);
 
+/* Destroys all nodes of the tree, node pools and the tree itself */
+void
+mexpt_tree_destroy (mexpt_tree_t *tree, bool free_data_src);
+
+/* Nodes of the subtree rooted at node */
+int
+mexpt_count_nodes (mexpt_node_t *node);
+
+/* String results are valid until the next evaluation on the calling thread,
+    see MexprArena.h */
 mexpr_var_t
 mexpt_evaluate (mexpt_node_t *root);
 
+/* String results are allocated from arena, valid until the Appln resets it */
+mexpr_var_t
+mexpt_evaluate_in (mexpt_node_t *root, mexpr_arena_t *arena);
+
+/* Same results as mexpt_evaluate( ), but never writes the tree : kernels not
+    preselected are dispatched from MexprDb instead of the inline caches. Any
+    number of threads may evaluate one tree with it at the same time, as long
+    as nobody changes the tree meanwhile */
+mexpr_var_t
+mexpt_evaluate_shared (mexpt_node_t *root);
+
+/* Applies the MexprDb operator on already computed operand values.
+    For unary operators, pass the operand value as both lrc and rrc */
+mexpr_var_t 
+mexpt_compute (int opr_token_code,
+                            mexpr_var_t lrc,
+                            mexpr_var_t rrc);
+
+/* dtype of the result of the MexprDb operator for the given operand dtypes,
+    MEXPR_DTYPE_INVALID if MexprDb does not support the combination. Read from
+    the dtype table of MexprDb, no kernel is run. An operand of
+    MEXPR_DTYPE_UNKNOWN stands for any dtype : the result is the one all
+    supported combinations agree on, else MEXPR_DTYPE_UNKNOWN */
+mexpr_dtypes_t
+mexpt_opr_result_dtype (int opr_token_code,
+                                        mexpr_dtypes_t ld,
+                                        mexpr_dtypes_t rd);
+
 bool 
 mexpr_double_is_integer (double d);
 
@@ -133,18 +377,44 @@ mexpt_tree_install_operand_properties (
                 void *data_src,
                 mexpr_var_t (*compute_fn_ptr)(void *)) ;
 
+/* Declares that compute_fn_ptr of the installed operand always returns dtype
+    (e.g. type of the column in the schema). Operators whose operand dtypes are
+    all known then get their kernel preselected for mexpt_evaluate( ) */
+void
+mexpt_tree_set_operand_dtype (mexpt_node_t *node, mexpr_dtypes_t dtype);
+
+/* Attaches statistics of the column the operand reads, see MexprSelectivity.h */
+void
+mexpt_tree_set_operand_stats (mexpt_node_t *node, const mexpt_col_stats_t *stats);
+
 bool
 mexpt_optimize (mexpt_node_t *root);
 
 mexpt_node_t *
 mexpt_get_unresolved_operand_node (mexpt_tree_t *tree);
 
-uint8_t 
+int 
 mexpt_remove_unresolved_operands (mexpt_tree_t *tree, bool free_data_src) ;
 
+/* Returns the next operand named name after prev, first one if prev is NULL */
+mexpt_node_t *
+mexpt_tree_lookup_operand (mexpt_tree_t *tree, const char *name, mexpt_node_t *prev);
+
 mexpt_tree_t *
 mexpt_clone (mexpt_tree_t *tree);
 
+/* New tree of clones of the subtrees rooted at nodes[0 .. n_nodes - 1] joined
+    by and, e.g. the conjuncts of a condition left after some were pushed down.
+    A single subtree is cloned as is. Subtrees may be parts of different trees,
+    which are left untouched. Operands keep their installed properties, new
+    tree is validated */
+mexpt_tree_t *
+mexpt_clone_conjunction (mexpt_node_t **nodes, int n_nodes);
+
+/* Same, joined by or */
+mexpt_tree_t *
+mexpt_clone_disjunction (mexpt_node_t **nodes, int n_nodes);
+
 static inline bool  
 mexpt_node_is_operand (mexpt_node_t *node) {
 
@@ -152,12 +422,113 @@ mexpt_node_is_operand (mexpt_node_t *node) {
         node->token_code == MATH_IDENTIFIER_IDENTIFIER) ;
 }
 
+/* Integer converts to double without rounding (|val| <= 2^53, or enough
+    trailing zero bits), so double code comparing it agrees with MexprDb */
+static inline bool
+mexpt_int_is_exact_double (int64_t val) {
+
+    double d = (double)val;
+
+    return d < 9223372036854775808.0 && (int64_t)d == val;
+}
+
 void 
-mexpt_node_remove_list (mexpt_node_t *node) ;
+mexpt_node_remove_opd_index (mexpt_node_t *node) ;
 
 bool
 mexpt_concatenate_mexpt_trees (mexpt_tree_t *parent_tree, 
                                                        mexpt_node_t *leaf_node,
                                                        mexpt_tree_t *child_tree);
 
+/* Substitution of operands by trees (e.g. expansion of view columns) */
+typedef struct mexpt_subst_ {
+
+    const char *opd_name;
+    mexpt_tree_t *child_tree;
+} mexpt_subst_t;
+
+/* Replaces every unresolved operand of parent_tree named substs[i].opd_name by a
+    clone of substs[i].child_tree. All splices are done first, then only the paths
+    from the spliced subtrees up to the root are revalidated and reoptimized.
+    Operands brought in by the child trees are not substituted.
+    Child trees remain owned by the caller. On failure parent_tree is left
+    with the substitutions done and must not be used any further */
+bool
+mexpt_substitute_operands (mexpt_tree_t *parent_tree,
+                                                mexpt_subst_t *substs,
+                                                int n_substs);
+
+/* Auto-Parameterization of Literals
+
+    Literals are lifted out of the postfix token stream into a parameter vector and
+    replaced by placeholder operands named $0, $1, ... Expressions which differ only
+    in literal values (a.x > 10, a.x > 11) then produce the same fingerprint and the
+    same tree shape, so Appln can cache one validated/optimized tree per fingerprint
+    and just clone it and bind the parameters of every new query.
+
+    Literals which take part in constant folding (both operands of an operator are
+    constants, e.g. 2 * 3 or sqrt(16)) are left inline and their values become part
+    of the fingerprint, so that mexpt_optimize( ) still folds them.
+
+    1. postfix = mexpr_convert_infix_to_postfix ( )
+    2. mexpr_parameterize_postfix (postfix, size, &params)
+    3. Lookup Appln cache by params.fingerprint, on miss :
+            tree = mexpr_param_vec_build_tree (&params), validate, optimize, cache it
+    4. mexpt_bind_parameters (mexpt_clone (cached tree), &params), false if the
+       cached tree was built from another stream of the same fingerprint : the
+       clone is then destroyed and the lookup handled as a miss
+    5. Resolve remaining operands and evaluate as usual
+    6. mexpr_param_vec_free (&params) once the tree is not evaluated anymore
+*/
+
+#define MEXPR_PARAM_PREFIX  '$'
+
+/* Parameterized stream as the fingerprint hashes it, shared by reference */
+struct mexpr_param_shape_ {
+
+    int ref_count;
+    uint32_t len;
+    unsigned char data[];
+};
+
+typedef struct mexpr_param_vec_ {
+
+    int n_params;
+    mexpr_var_t *params;
+    uint64_t fingerprint;
+    mexpr_param_shape_t *shape;
+
+    /* Parameterized postfix stream, owned by this vector. Entries point to
+        placeholders owned by this vector or to lex data of the Parser stack, hence
+        mexpr_param_vec_build_tree( ) must be called before Parser_stack_reset( ) */
+    lex_data_t **postfix;
+    int postfix_size;
+    lex_data_t *placeholders;
+} mexpr_param_vec_t;
+
+uint64_t
+mexpr_parameterize_postfix (lex_data_t **postfix, int size, mexpr_param_vec_t *params);
+
+mexpt_tree_t *
+mexpr_param_vec_build_tree (mexpr_param_vec_t *params);
+
+bool
+mexpt_bind_parameters (mexpt_tree_t *tree, mexpr_param_vec_t *params);
+
+void
+mexpr_param_vec_free (mexpr_param_vec_t *params);
+
+mexpr_param_shape_t *
+mexpr_param_shape_ref (mexpr_param_shape_t *shape);
+
+void
+mexpr_param_shape_unref (mexpr_param_shape_t *shape);
+
+static inline bool
+mexpt_node_is_param (mexpt_node_t *node) {
+
+    return (node->token_code == MATH_IDENTIFIER &&
+        node->u.opd_node.opd_value.variable_name[0] == MEXPR_PARAM_PREFIX);
+}
+
 #endif 
@@ -0,0 +1,484 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "MexprEnums.h"
+#include "MExpr.h"
+#include "MexprAdaptive.h"
+
+/* Outcome of a child */
+#define MEXPT_ADAPT_TRUE    0
+#define MEXPT_ADAPT_FALSE   1
+#define MEXPT_ADAPT_FAILED  2
+
+#define MEXPT_ADAPT_ORDER_GET(order, pos)   (int)(((order) >> (4 * (pos))) & 0xf)
+
+static __thread uint64_t mexpt_adapt_rng;
+
+static uint64_t
+mexpt_adapt_now_ns (void) {
+
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* xorshift64, per thread so that evaluators never share a cache line to pick
+    samples, and handles evaluated in turn are not sampled in lockstep */
+static bool
+mexpt_adapt_pick_sample (uint32_t sample_period) {
+
+    uint64_t x = mexpt_adapt_rng;
+
+    if (!x) x = (uint64_t)(uintptr_t)&mexpt_adapt_rng ^ 0x9e3779b97f4a7c15ULL;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    mexpt_adapt_rng = x;
+    return x % sample_period == 0;
+}
+
+static inline bool
+mexpt_adapt_is_group_node (mexpt_node_t *node, int token_code) {
+
+    /* Optimized away and / or are leaves */
+    return node->left && node->right && node->token_code == token_code;
+}
+
+static void
+mexpt_adapt_flatten (mexpt_node_t *node,
+                                  int token_code,
+                                  mexpt_node_t ***nodes,
+                                  int *n_nodes) {
+
+    if (mexpt_adapt_is_group_node (node, token_code)) {
+        mexpt_adapt_flatten (node->left, token_code, nodes, n_nodes);
+        mexpt_adapt_flatten (node->right, token_code, nodes, n_nodes);
+        return;
+    }
+    *nodes = (mexpt_node_t **)realloc (*nodes, (*n_nodes + 1) * sizeof (mexpt_node_t *));
+    (*nodes)[(*n_nodes)++] = node;
+}
+
+static mexpt_adapt_group_t *
+mexpt_adapt_build_group (mexpt_adaptive_t *handle,
+                                          int token_code,
+                                          mexpt_node_t **nodes,
+                                          int n_nodes,
+                                          bool exact);
+
+static mexpt_adapt_group_t *
+mexpt_adapt_build_nested (mexpt_adaptive_t *handle,
+                                          mexpt_node_t *node,
+                                          bool exact) {
+
+    int n_nodes = 0;
+    mexpt_node_t **nodes = NULL;
+    mexpt_adapt_group_t *group;
+
+    mexpt_adapt_flatten (node, node->token_code, &nodes, &n_nodes);
+    group = mexpt_adapt_build_group (handle, node->token_code, nodes, n_nodes, exact);
+    free (nodes);
+    return group;
+}
+
+/* Children past MEXPT_ADAPT_MAX_CHILDREN go into a nested group of the same
+    operator, in the last position */
+static mexpt_adapt_group_t *
+mexpt_adapt_build_group (mexpt_adaptive_t *handle,
+                                          int token_code,
+                                          mexpt_node_t **nodes,
+                                          int n_nodes,
+                                          bool exact) {
+
+    int i;
+    bool child_exact;
+    mexpt_node_t *node;
+    mexpt_adapt_group_t *group = (mexpt_adapt_group_t *)calloc (1, sizeof (mexpt_adapt_group_t));
+
+    group->token_code = token_code;
+    group->index = handle->n_groups;
+    group->exact = exact;
+    group->n_children = n_nodes > MEXPT_ADAPT_MAX_CHILDREN ? MEXPT_ADAPT_MAX_CHILDREN : n_nodes;
+    group->children = (mexpt_adapt_child_t *)calloc (group->n_children,
+                                                    sizeof (mexpt_adapt_child_t));
+
+    handle->groups = (mexpt_adapt_group_t **)realloc (handle->groups,
+                                (handle->n_groups + 1) * sizeof (mexpt_adapt_group_t *));
+    handle->groups[handle->n_groups++] = group;
+
+    /* An or needs to know whether its children failed, so does a child of a
+        group which does */
+    child_exact = !handle->opts.failed_is_false && (exact || token_code == MATH_OR);
+
+    for (i = 0; i < group->n_children; i++) {
+
+        group->order |= (uint64_t)i << (4 * i);
+
+        if (i == MEXPT_ADAPT_MAX_CHILDREN - 1 && n_nodes > MEXPT_ADAPT_MAX_CHILDREN) {
+            group->children[i].group = mexpt_adapt_build_group (handle, token_code,
+                                                nodes + i, n_nodes - i, exact);
+            continue;
+        }
+
+        node = nodes[i];
+        if (mexpt_adapt_is_group_node (node, MATH_AND) ||
+                mexpt_adapt_is_group_node (node, MATH_OR)) {
+            group->children[i].group = mexpt_adapt_build_nested (handle, node, child_exact);
+        }
+        else {
+            group->children[i].node = node;
+        }
+    }
+    return group;
+}
+
+mexpt_adaptive_t *
+mexpt_adaptive_create (mexpt_tree_t *tree, const mexpt_adapt_opts_t *opts) {
+
+    mexpt_adaptive_t *handle = (mexpt_adaptive_t *)calloc (1, sizeof (mexpt_adaptive_t));
+
+    handle->tree = tree;
+    if (opts) handle->opts = *opts;
+    if (!handle->opts.sample_period) handle->opts.sample_period = MEXPT_ADAPT_DEFAULT_PERIOD;
+    if (!handle->opts.window) handle->opts.window = MEXPT_ADAPT_DEFAULT_WINDOW;
+
+    if (tree->root && (mexpt_adapt_is_group_node (tree->root, MATH_AND) ||
+                                mexpt_adapt_is_group_node (tree->root, MATH_OR))) {
+        mexpt_adapt_build_nested (handle, tree->root, false);
+    }
+    return handle;
+}
+
+/* Probability the child decides its group, over the window */
+static double
+mexpt_adapt_decide_rate (mexpt_adaptive_t *handle,
+                                        mexpt_adapt_group_t *group,
+                                        uint64_t n_true,
+                                        uint64_t n_false,
+                                        uint64_t n_samples) {
+
+    uint64_t n_failed = n_samples - n_true - n_false;
+
+    if (handle->opts.failed_is_false) {
+        return group->token_code == MATH_AND ?
+                    (double)(n_false + n_failed) / n_samples : (double)n_true / n_samples;
+    }
+    if (group->token_code == MATH_AND && !group->exact) {
+        return (double)(n_false + n_failed) / n_samples;
+    }
+    return (double)n_failed / n_samples;
+}
+
+/* Closes the slot of the window : orders children by cost / decide rate, and
+    opens the oldest slot again */
+static void
+mexpt_adapt_reorder (mexpt_adaptive_t *handle, mexpt_adapt_group_t *group) {
+
+    int i, j, k;
+    uint64_t n_samples = 0, n_true, n_false, cost_ns;
+    uint64_t order = 0;
+    uint32_t slot = __atomic_load_n (&group->slot, __ATOMIC_RELAXED);
+    uint32_t next = (slot + 1) % MEXPT_ADAPT_N_SLOTS;
+    double rate;
+    double rank[MEXPT_ADAPT_MAX_CHILDREN], cost[MEXPT_ADAPT_MAX_CHILDREN];
+    int sorted[MEXPT_ADAPT_MAX_CHILDREN];
+    mexpt_adapt_child_t *child;
+
+    for (k = 0; k < MEXPT_ADAPT_N_SLOTS; k++) {
+        n_samples += __atomic_load_n (&group->n_samples[k], __ATOMIC_RELAXED);
+    }
+
+    for (i = 0; n_samples && i < group->n_children; i++) {
+
+        child = &group->children[i];
+        n_true = n_false = cost_ns = 0;
+
+        for (k = 0; k < MEXPT_ADAPT_N_SLOTS; k++) {
+            n_true += __atomic_load_n (&child->n_true[k], __ATOMIC_RELAXED);
+            n_false += __atomic_load_n (&child->n_false[k], __ATOMIC_RELAXED);
+            cost_ns += __atomic_load_n (&child->cost_ns[k], __ATOMIC_RELAXED);
+        }
+        /* Racing evaluators may have counted in a later slot already */
+        if (n_true > n_samples) n_true = n_samples;
+        if (n_true + n_false > n_samples) n_false = n_samples - n_true;
+
+        rate = mexpt_adapt_decide_rate (handle, group, n_true, n_false, n_samples);
+        cost[i] = (double)cost_ns / n_samples;
+        rank[i] = rate > 0 ? cost[i] / rate : INFINITY;
+
+        /* Insertion, stable : equal children keep the order of the tree */
+        for (j = i; j > 0 && (rank[sorted[j - 1]] > rank[i] ||
+                    (rank[sorted[j - 1]] == rank[i] && cost[sorted[j - 1]] > cost[i])); j--) {
+            sorted[j] = sorted[j - 1];
+        }
+        sorted[j] = i;
+    }
+
+    if (n_samples) {
+
+        for (i = 0; i < group->n_children; i++) {
+            order |= (uint64_t)sorted[i] << (4 * i);
+        }
+        if (order != __atomic_load_n (&group->order, __ATOMIC_RELAXED)) {
+            __atomic_store_n (&group->order, order, __ATOMIC_RELAXED);
+            __atomic_add_fetch (&group->n_reorders, 1, __ATOMIC_RELAXED);
+        }
+    }
+
+    for (i = 0; i < group->n_children; i++) {
+        __atomic_store_n (&group->children[i].n_true[next], 0, __ATOMIC_RELAXED);
+        __atomic_store_n (&group->children[i].n_false[next], 0, __ATOMIC_RELAXED);
+        __atomic_store_n (&group->children[i].cost_ns[next], 0, __ATOMIC_RELAXED);
+    }
+    __atomic_store_n (&group->n_samples[next], 0, __ATOMIC_RELAXED);
+    __atomic_store_n (&group->slot, next, __ATOMIC_RELAXED);
+    __atomic_store_n (&group->n_in_slot, 0, __ATOMIC_RELAXED);
+}
+
+static int
+mexpt_adapt_evaluate_group (mexpt_adaptive_t *handle,
+                                              mexpt_adapt_group_t *group,
+                                              bool sample);
+
+static int
+mexpt_adapt_evaluate_child (mexpt_adaptive_t *handle,
+                                             mexpt_adapt_child_t *child,
+                                             bool sample) {
+
+    mexpr_var_t res;
+
+    if (child->group) return mexpt_adapt_evaluate_group (handle, child->group, sample);
+
+    /* Concurrent evaluators share the tree */
+    res = mexpt_evaluate_shared (child->node);
+    if (res.dtype == MEXPR_DTYPE_BOOL) {
+        return res.u.b_val ? MEXPT_ADAPT_TRUE : MEXPT_ADAPT_FALSE;
+    }
+    return handle->opts.failed_is_false ? MEXPT_ADAPT_FALSE : MEXPT_ADAPT_FAILED;
+}
+
+/* Every child is evaluated and counted */
+static int
+mexpt_adapt_sample_group (mexpt_adaptive_t *handle, mexpt_adapt_group_t *group) {
+
+    int i, outcome;
+    bool any_true = false, any_false = false, any_failed = false;
+    uint64_t start;
+    uint32_t slot = __atomic_load_n (&group->slot, __ATOMIC_RELAXED);
+    mexpt_adapt_child_t *child;
+
+    for (i = 0; i < group->n_children; i++) {
+
+        child = &group->children[i];
+        start = mexpt_adapt_now_ns ();
+        outcome = mexpt_adapt_evaluate_child (handle, child, true);
+        __atomic_add_fetch (&child->cost_ns[slot], mexpt_adapt_now_ns () - start, __ATOMIC_RELAXED);
+
+        switch (outcome) {
+            case MEXPT_ADAPT_TRUE:
+                __atomic_add_fetch (&child->n_true[slot], 1, __ATOMIC_RELAXED);
+                any_true = true;
+                break;
+            case MEXPT_ADAPT_FALSE:
+                __atomic_add_fetch (&child->n_false[slot], 1, __ATOMIC_RELAXED);
+                any_false = true;
+                break;
+            default:
+                any_failed = true;
+        }
+    }
+
+    __atomic_add_fetch (&group->n_samples[slot], 1, __ATOMIC_RELAXED);
+
+    /* Exactly one evaluator closes the window */
+    if (__atomic_add_fetch (&group->n_in_slot, 1, __ATOMIC_RELAXED) == handle->opts.window) {
+        mexpt_adapt_reorder (handle, group);
+    }
+
+    if (any_failed) return MEXPT_ADAPT_FAILED;
+    if (group->token_code == MATH_AND) return any_false ? MEXPT_ADAPT_FALSE : MEXPT_ADAPT_TRUE;
+    return any_true ? MEXPT_ADAPT_TRUE : MEXPT_ADAPT_FALSE;
+}
+
+static int
+mexpt_adapt_evaluate_group (mexpt_adaptive_t *handle,
+                                              mexpt_adapt_group_t *group,
+                                              bool sample) {
+
+    int pos, outcome;
+    bool is_and = group->token_code == MATH_AND;
+    int res = is_and ? MEXPT_ADAPT_TRUE : MEXPT_ADAPT_FALSE;
+    uint64_t order;
+
+    if (sample) return mexpt_adapt_sample_group (handle, group);
+
+    order = __atomic_load_n (&group->order, __ATOMIC_RELAXED);
+
+    for (pos = 0; pos < group->n_children; pos++) {
+
+        outcome = mexpt_adapt_evaluate_child (handle,
+                            &group->children[MEXPT_ADAPT_ORDER_GET (order, pos)], false);
+
+        if (handle->opts.failed_is_false) {
+            if (is_and && outcome == MEXPT_ADAPT_FALSE) return outcome;
+            if (!is_and && outcome == MEXPT_ADAPT_TRUE) return outcome;
+            continue;
+        }
+
+        /* A failed child fails the group whatever the other children. An and
+            whose outcome is not needed stops on false too : it is not true */
+        if (outcome == MEXPT_ADAPT_FAILED) return outcome;
+        if (is_and && outcome == MEXPT_ADAPT_FALSE) {
+            if (!group->exact) return outcome;
+            res = outcome;
+        }
+        if (!is_and && outcome == MEXPT_ADAPT_TRUE) res = outcome;
+    }
+    return res;
+}
+
+bool
+mexpt_adaptive_evaluate (mexpt_adaptive_t *handle) {
+
+    bool sample;
+    mexpr_var_t res;
+
+    if (!handle->n_groups) {
+        res = mexpt_evaluate_shared (handle->tree->root);
+        return res.dtype == MEXPR_DTYPE_BOOL && res.u.b_val;
+    }
+
+    sample = mexpt_adapt_pick_sample (handle->opts.sample_period);
+    if (sample) __atomic_add_fetch (&handle->n_sampled, 1, __ATOMIC_RELAXED);
+
+    return mexpt_adapt_evaluate_group (handle, handle->groups[0], sample) == MEXPT_ADAPT_TRUE;
+}
+
+void
+mexpt_adaptive_get_stats (mexpt_adaptive_t *handle, mexpt_adapt_stats_t *stats) {
+
+    int i;
+
+    memset (stats, 0, sizeof (*stats));
+    stats->n_sampled = __atomic_load_n (&handle->n_sampled, __ATOMIC_RELAXED);
+    stats->n_groups = handle->n_groups;
+
+    for (i = 0; i < handle->n_groups; i++) {
+        stats->n_reorders += __atomic_load_n (&handle->groups[i]->n_reorders, __ATOMIC_RELAXED);
+        stats->n_preds += handle->groups[i]->n_children;
+    }
+}
+
+int
+mexpt_adaptive_get_pred_stats (mexpt_adaptive_t *handle,
+                                                  mexpt_adapt_pred_stats_t *preds,
+                                                  int max_preds) {
+
+    int i, pos, k;
+    int n_preds = 0;
+    uint64_t order, n_samples, n_true, n_false, cost_ns;
+    mexpt_adapt_group_t *group;
+    mexpt_adapt_child_t *child;
+    mexpt_adapt_pred_stats_t *pred;
+
+    for (i = 0; i < handle->n_groups; i++) {
+
+        group = handle->groups[i];
+        order = __atomic_load_n (&group->order, __ATOMIC_RELAXED);
+        n_samples = 0;
+
+        for (k = 0; k < MEXPT_ADAPT_N_SLOTS; k++) {
+            n_samples += __atomic_load_n (&group->n_samples[k], __ATOMIC_RELAXED);
+        }
+
+        for (pos = 0; pos < group->n_children && n_preds < max_preds; pos++) {
+
+            child = &group->children[MEXPT_ADAPT_ORDER_GET (order, pos)];
+            pred = &preds[n_preds++];
+            n_true = n_false = cost_ns = 0;
+
+            for (k = 0; k < MEXPT_ADAPT_N_SLOTS; k++) {
+                n_true += __atomic_load_n (&child->n_true[k], __ATOMIC_RELAXED);
+                n_false += __atomic_load_n (&child->n_false[k], __ATOMIC_RELAXED);
+                cost_ns += __atomic_load_n (&child->cost_ns[k], __ATOMIC_RELAXED);
+            }
+
+            pred->group = i;
+            pred->position = pos;
+            pred->node = child->node;
+            pred->nested_group = child->group ? child->group->index : -1;
+            pred->n_samples = n_samples;
+            pred->true_rate = n_samples ? (double)n_true / n_samples : 0;
+            pred->fail_rate = n_samples && n_true + n_false < n_samples ?
+                                    (double)(n_samples - n_true - n_false) / n_samples : 0;
+            pred->cost_ns = n_samples ? (double)cost_ns / n_samples : 0;
+        }
+    }
+    return n_preds;
+}
+
+/* Leftmost operand names the predicate */
+static const char *
+mexpt_adapt_pred_name (mexpt_node_t *node) {
+
+    while (node->left) node = node->left;
+    if (mexpt_node_is_operand (node) && (node->token_code == MATH_IDENTIFIER ||
+                node->token_code == MATH_IDENTIFIER_IDENTIFIER)) {
+        return (const char *)node->u.opd_node.opd_value.variable_name;
+    }
+    return "constant";
+}
+
+void
+mexpt_adaptive_print_stats (mexpt_adaptive_t *handle) {
+
+    int i, n_preds;
+    mexpt_adapt_stats_t stats;
+    mexpt_adapt_pred_stats_t *preds, *pred;
+
+    mexpt_adaptive_get_stats (handle, &stats);
+
+    printf ("Sampled evaluations : %llu, reorders : %u\n",
+                (unsigned long long)stats.n_sampled, stats.n_reorders);
+
+    preds = (mexpt_adapt_pred_stats_t *)calloc (stats.n_preds + 1, sizeof (*preds));
+    n_preds = mexpt_adaptive_get_pred_stats (handle, preds, stats.n_preds);
+
+    for (i = 0; i < n_preds; i++) {
+
+        pred = &preds[i];
+        if (pred->position == 0) {
+            printf ("Group %d : %s, %llu samples in window\n", pred->group,
+                        handle->groups[pred->group]->token_code == MATH_AND ? "and" : "or",
+                        (unsigned long long)pred->n_samples);
+        }
+
+        if (pred->node) {
+            printf ("  %d. predicate on %s (token %d)", pred->position,
+                        mexpt_adapt_pred_name (pred->node), pred->node->token_code);
+        }
+        else {
+            printf ("  %d. group %d", pred->position, pred->nested_group);
+        }
+        printf (" : true %.3f, failed %.3f, %.1f ns\n",
+                    pred->true_rate, pred->fail_rate, pred->cost_ns);
+    }
+    free (preds);
+}
+
+void
+mexpt_adaptive_destroy (mexpt_adaptive_t *handle, bool free_data_src) {
+
+    int i;
+
+    for (i = 0; i < handle->n_groups; i++) {
+        free (handle->groups[i]->children);
+        free (handle->groups[i]);
+    }
+    free (handle->groups);
+    mexpt_tree_destroy (handle->tree, free_data_src);
+    free (handle);
+}
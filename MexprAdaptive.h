@@ -0,0 +1,144 @@
+#ifndef __MEXPR_ADAPTIVE__
+#define __MEXPR_ADAPTIVE__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "MExpr.h"
+
+/* Adaptive Evaluation of Conditions
+
+    Appln filtering rows with a resolved and validated condition wraps it into
+    a handle, and calls mexpt_adaptive_evaluate( ), which tells whether
+    mexpt_evaluate( ) would return bool true, without evaluating every node :
+
+    Chains of and (or) are flattened into groups of up to
+    MEXPT_ADAPT_MAX_CHILDREN children : predicates, and nested groups of the
+    other operator. A group stops at the first child deciding it, e.g. the
+    first child of an and not true, and evaluates its children in an order
+    which is learnt :
+
+    One evaluation in sample_period (picked at random per thread) evaluates
+    every child of every group, and records per child whether it was true,
+    false or failed, and how long it took. Over a sliding window of the last
+    MEXPT_ADAPT_N_SLOTS * window sampled evaluations of the group, children
+    are ordered by cost / probability of deciding the group, ascending :
+    cheap predicates rejecting most rows go first in an and.
+
+    A failed predicate (operand or kernel returning MEXPR_DTYPE_INVALID) fails
+    the whole condition in MexprDb, whatever the other operand of and / or.
+    Hence an or can only stop early on a failed child, and or groups rarely
+    save work. Appln reading a failed predicate as false (like SQL WHERE reads
+    unknown) sets failed_is_false : or groups then stop at their first true
+    child, and the result differs from mexpt_evaluate( ) only on rows where a
+    predicate fails.
+
+    The order of a group is one word, loaded by evaluators and replaced by
+    whichever evaluator closes a window : concurrent evaluators are safe, and
+    see a new order on their next call. Statistics are counted with atomic
+    builtins on sampled evaluations only. Predicates are evaluated with
+    mexpt_evaluate_shared( ), which never writes the tree, so that concurrent
+    evaluators share it.
+
+    The handle owns the tree, which Appln must not change afterwards.
+*/
+
+#define MEXPT_ADAPT_MAX_CHILDREN        16
+#define MEXPT_ADAPT_N_SLOTS             4
+#define MEXPT_ADAPT_DEFAULT_PERIOD      64
+#define MEXPT_ADAPT_DEFAULT_WINDOW      256
+
+typedef struct mexpt_adapt_group_ mexpt_adapt_group_t;
+
+typedef struct mexpt_adapt_child_ {
+
+    mexpt_node_t *node;             /* predicate, NULL for a nested group */
+    mexpt_adapt_group_t *group;
+
+    /* Per slot of the window, accessed with atomic builtins only */
+    uint64_t n_true[MEXPT_ADAPT_N_SLOTS];
+    uint64_t n_false[MEXPT_ADAPT_N_SLOTS];
+    uint64_t cost_ns[MEXPT_ADAPT_N_SLOTS];
+} mexpt_adapt_child_t;
+
+struct mexpt_adapt_group_ {
+
+    int token_code;                 /* MATH_AND or MATH_OR */
+    int index;                      /* in the handle, 0 is the root group */
+    bool exact;                     /* outcome needed : true, false or failed */
+    int n_children;
+    mexpt_adapt_child_t *children;
+
+    /* Shared by concurrent evaluators, accessed with atomic builtins only */
+    uint64_t order;                 /* 4 bits per position : index of the child */
+    uint64_t n_samples[MEXPT_ADAPT_N_SLOTS];
+    uint64_t n_in_slot;             /* samples since the slot was opened */
+    uint32_t slot;
+    uint32_t n_reorders;
+};
+
+typedef struct mexpt_adapt_opts_ {
+
+    uint32_t sample_period;         /* 0 is MEXPT_ADAPT_DEFAULT_PERIOD */
+    uint32_t window;                /* 0 is MEXPT_ADAPT_DEFAULT_WINDOW */
+    bool failed_is_false;
+} mexpt_adapt_opts_t;
+
+typedef struct mexpt_adaptive_ {
+
+    mexpt_tree_t *tree;
+    mexpt_adapt_opts_t opts;
+    int n_groups;
+    mexpt_adapt_group_t **groups;   /* NULL root group : root is no and / or */
+
+    uint64_t n_sampled;             /* atomic */
+} mexpt_adaptive_t;
+
+typedef struct mexpt_adapt_stats_ {
+
+    uint64_t n_sampled;             /* evaluations sampled so far */
+    uint32_t n_reorders;            /* windows which changed an order */
+    int n_groups;
+    int n_preds;
+} mexpt_adapt_stats_t;
+
+typedef struct mexpt_adapt_pred_stats_ {
+
+    int group;                      /* index of the group */
+    int position;                   /* in its current order */
+    mexpt_node_t *node;             /* NULL for a nested group */
+    int nested_group;               /* index of the nested group, -1 if none */
+
+    /* Over the sliding window */
+    uint64_t n_samples;
+    double true_rate;
+    double fail_rate;
+    double cost_ns;
+} mexpt_adapt_pred_stats_t;
+
+/* opts NULL are the defaults */
+mexpt_adaptive_t *
+mexpt_adaptive_create (mexpt_tree_t *tree, const mexpt_adapt_opts_t *opts);
+
+/* true iff the condition holds on the current operand values */
+bool
+mexpt_adaptive_evaluate (mexpt_adaptive_t *handle);
+
+void
+mexpt_adaptive_get_stats (mexpt_adaptive_t *handle, mexpt_adapt_stats_t *stats);
+
+/* Fills up to max_preds children of all groups, group by group, each group
+    in its current order. Returns the number filled */
+int
+mexpt_adaptive_get_pred_stats (mexpt_adaptive_t *handle,
+                                                  mexpt_adapt_pred_stats_t *preds,
+                                                  int max_preds);
+
+void
+mexpt_adaptive_print_stats (mexpt_adaptive_t *handle);
+
+/* Destroys the handle and its tree, no evaluator may be running */
+void
+mexpt_adaptive_destroy (mexpt_adaptive_t *handle, bool free_data_src);
+
+#endif
@@ -0,0 +1,123 @@
+#include <stdlib.h>
+#include <string.h>
+#include "MexprArena.h"
+
+/* Arena of the thread, and the arena of the evaluation running on it */
+static __thread mexpr_arena_t mexpr_thread_arena;
+static __thread mexpr_arena_t *mexpr_cur_arena;
+
+static mexpr_arena_block_t *
+mexpr_arena_block_new (uint32_t size) {
+
+    mexpr_arena_block_t *block = (mexpr_arena_block_t *)malloc (
+                                                sizeof (mexpr_arena_block_t) + size);
+
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+void
+mexpr_arena_init (mexpr_arena_t *arena) {
+
+    memset (arena, 0, sizeof (*arena));
+}
+
+void *
+mexpr_arena_alloc (mexpr_arena_t *arena, uint32_t size) {
+
+    uint32_t block_size;
+    mexpr_arena_block_t *block = arena->blocks;
+
+    size = (size + 7) & ~7U;
+
+    if (!block || block->size - block->used < size) {
+
+        block_size = MEXPR_ARENA_BLOCK_MIN;
+        if (block) block_size = block->size < (1U << 30) ? block->size * 2 : block->size;
+        if (block_size < size) block_size = size;
+        block = mexpr_arena_block_new (block_size);
+        block->next = arena->blocks;
+        arena->blocks = block;
+    }
+
+    block->used += size;
+    arena->n_bytes += size;
+    if (arena->n_bytes > arena->max_bytes) arena->max_bytes = arena->n_bytes;
+    return block->data + block->used - size;
+}
+
+void
+mexpr_arena_reset (mexpr_arena_t *arena) {
+
+    uint64_t total = 0;
+    mexpr_arena_block_t *block, *next;
+
+    arena->n_bytes = 0;
+    if (!arena->blocks) return;
+
+    /* Coalesce into one block big enough for what the arena held, so the next
+        evaluations carve a single block */
+    if (arena->blocks->next) {
+
+        for (block = arena->blocks; block; block = next) {
+            next = block->next;
+            total += block->size;
+            free (block);
+        }
+        arena->blocks = mexpr_arena_block_new (total > UINT32_MAX ? UINT32_MAX : (uint32_t)total);
+        return;
+    }
+
+    arena->blocks->used = 0;
+}
+
+void
+mexpr_arena_free (mexpr_arena_t *arena) {
+
+    mexpr_arena_block_t *block, *next;
+
+    for (block = arena->blocks; block; block = next) {
+        next = block->next;
+        free (block);
+    }
+    memset (arena, 0, sizeof (*arena));
+}
+
+mexpr_arena_t *
+mexpr_arena_current (void) {
+
+    return mexpr_cur_arena ? mexpr_cur_arena : &mexpr_thread_arena;
+}
+
+mexpr_arena_t *
+mexpr_arena_enter (mexpr_arena_t *arena) {
+
+    mexpr_arena_t *prev = mexpr_cur_arena;
+
+    if (!arena) {
+
+        /* Nested evaluation shares the arena of the outer one, whose strings
+            are still in use */
+        if (prev) return prev;
+
+        arena = &mexpr_thread_arena;
+        mexpr_arena_reset (arena);
+    }
+
+    mexpr_cur_arena = arena;
+    return prev;
+}
+
+void
+mexpr_arena_leave (mexpr_arena_t *prev) {
+
+    mexpr_cur_arena = prev;
+}
+
+void
+mexpr_arena_thread_cleanup (void) {
+
+    mexpr_arena_free (&mexpr_thread_arena);
+}
@@ -0,0 +1,76 @@
+#ifndef __MEXPR_ARENA__
+#define __MEXPR_ARENA__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Evaluation Arena
+
+    String values (MEXPR_DTYPE_STRING) are views : str_val and str_len of
+    mexpr_var_t. Views of literals and operands point into the tree or the
+    Appln's data, strings built during an evaluation (string + string) are
+    allocated from an arena and stay valid until the arena is reset.
+
+    mexpt_evaluate( ) uses an arena of the calling thread, reset when the next
+    evaluation starts on that thread, so a result may be used until then
+    without copying it. mexpt_evaluate_in( ) takes an arena of the Appln,
+    which decides when to mexpr_arena_reset( ) it, e.g. after a batch of rows.
+
+    Arena keeps its memory across resets : once it has grown to the needs of
+    an evaluation, evaluations allocate nothing from the heap.
+*/
+
+#define MEXPR_ARENA_BLOCK_MIN   4096
+
+typedef struct mexpr_arena_block_ mexpr_arena_block_t;
+
+struct mexpr_arena_block_ {
+
+    mexpr_arena_block_t *next;
+    uint32_t size;
+    uint32_t used;
+    unsigned char data[];
+};
+
+typedef struct mexpr_arena_ {
+
+    mexpr_arena_block_t *blocks;    /* block being carved first */
+    uint64_t n_bytes;               /* handed out since the last reset */
+    uint64_t max_bytes;             /* highest n_bytes ever */
+} mexpr_arena_t;
+
+/* An all zero arena is initialized too */
+void
+mexpr_arena_init (mexpr_arena_t *arena);
+
+/* size bytes aligned on 8, never fails */
+void *
+mexpr_arena_alloc (mexpr_arena_t *arena, uint32_t size);
+
+/* Invalidates everything allocated so far, memory is kept for reuse */
+void
+mexpr_arena_reset (mexpr_arena_t *arena);
+
+void
+mexpr_arena_free (mexpr_arena_t *arena);
+
+/* Arena the string kernels of MexprDb allocate from : the one of the running
+    evaluation, otherwise the calling thread's arena */
+mexpr_arena_t *
+mexpr_arena_current (void);
+
+/* Evaluators bracket an evaluation with these. NULL selects the calling
+    thread's arena, reset unless an evaluation already runs on this thread
+    (operand callback evaluating another tree). Returns the arena to pass to
+    mexpr_arena_leave( ) */
+mexpr_arena_t *
+mexpr_arena_enter (mexpr_arena_t *arena);
+
+void
+mexpr_arena_leave (mexpr_arena_t *prev);
+
+/* Frees the calling thread's arena, for threads about to exit */
+void
+mexpr_arena_thread_cleanup (void);
+
+#endif
@@ -0,0 +1,1103 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include "MexprEnums.h"
+#include "MExpr.h"
+#include "MexprBatch.h"
+#include "MexprVmath.h"
+
+/* ====================x================x=================== */
+/* Plan Compiler */
+
+/* sin and cos nodes on the same argument, and the slots of their results
+    once the sincos instruction is emitted */
+typedef struct mexpt_batch_pair_ {
+
+    mexpt_node_t *sin_node;
+    mexpt_node_t *cos_node;
+    int sin_slot;
+    int cos_slot;
+} mexpt_batch_pair_t;
+
+typedef struct mexpt_batch_ctx_ {
+
+    mexpt_batch_plan_t *plan;
+    const char **col_names;
+    int max_instrs;
+
+    double *consts;
+    int max_consts;
+
+    /* Scratch vectors, freed ones are reused by later instructions */
+    int *free_vecs;
+    int n_free_vecs;
+    int max_free_vecs;
+
+    mexpt_batch_pair_t *pairs;
+    int n_pairs;
+    int max_pairs;
+
+    /* sin and cos nodes of the tree, in post order */
+    mexpt_node_t **trig_nodes;
+    int n_trig_nodes;
+    int max_trig_nodes;
+} mexpt_batch_ctx_t;
+
+static const char *mexpt_batch_op_names[MEXPT_BATCH_OP_MAX] = {
+
+    "add", "sub", "mul", "div", "max", "min", "pow", "sqr", "sqrt", "sin", "cos",
+    "lt", "le", "gt", "eq", "ne", "sincos", "fma", "fms", "fnma", "powi"
+};
+
+static bool
+mexpt_batch_is_int_literal (mexpt_node_t *node) {
+
+    return node && !node->left && !node->right &&
+                node->token_code == MATH_INTEGER_VALUE;
+}
+
+static bool
+mexpt_batch_is_leaf (mexpt_node_t *node) {
+
+    return !node->left && !node->right;
+}
+
+/* Value of a constant leaf : literal, or optimized Ineq or Logical node */
+static bool
+mexpt_batch_leaf_const (mexpt_node_t *node, double *val) {
+
+    switch (node->token_code) {
+
+        case MATH_IDENTIFIER:
+        case MATH_IDENTIFIER_IDENTIFIER:
+        case MATH_STRING_VALUE:
+            return false;
+        case MATH_INTEGER_VALUE:
+            /* Comparisons of MexprDb are exact, of double vectors are not */
+            if (!mexpt_int_is_exact_double (node->u.opd_node.opd_value.int_val)) return false;
+            *val = (double)node->u.opd_node.opd_value.int_val;
+            return true;
+        case MATH_DOUBLE_VALUE:
+            *val = node->u.opd_node.opd_value.math_val;
+            return true;
+        default:
+            break;
+    }
+
+    if (Math_is_ineq_operator (node->token_code)) {
+        *val = node->u.ineq_node.result ? 1.0 : 0.0;
+        return true;
+    }
+    if (Math_is_logical_operator (node->token_code)) {
+        *val = node->u.log_op_node.result ? 1.0 : 0.0;
+        return true;
+    }
+    return false;
+}
+
+static bool
+mexpt_batch_same_subtree (mexpt_node_t *node1, mexpt_node_t *node2) {
+
+    double val1, val2;
+
+    if (!node1 || !node2) return node1 == node2;
+    if (node1->token_code != node2->token_code) return false;
+
+    if (mexpt_batch_is_leaf (node1) || mexpt_batch_is_leaf (node2)) {
+
+        if (!mexpt_batch_is_leaf (node1) || !mexpt_batch_is_leaf (node2)) return false;
+
+        if (mexpt_node_is_operand (node1)) {
+            return strcmp ((char *)node1->u.opd_node.opd_value.variable_name,
+                                (char *)node2->u.opd_node.opd_value.variable_name) == 0;
+        }
+        if (!mexpt_batch_leaf_const (node1, &val1) ||
+                !mexpt_batch_leaf_const (node2, &val2)) return false;
+        return memcmp (&val1, &val2, sizeof (val1)) == 0;
+    }
+
+    return mexpt_batch_same_subtree (node1->left, node2->left) &&
+                mexpt_batch_same_subtree (node1->right, node2->right);
+}
+
+/* Pre-pass : constant table and sin/cos nodes */
+static void
+mexpt_batch_collect (mexpt_batch_ctx_t *ctx, mexpt_node_t *node) {
+
+    int i;
+    double val;
+    mexpt_batch_plan_t *plan = ctx->plan;
+
+    if (!node) return;
+
+    mexpt_batch_collect (ctx, node->left);
+    mexpt_batch_collect (ctx, node->right);
+
+    if (mexpt_batch_is_leaf (node)) {
+
+        if (!mexpt_batch_leaf_const (node, &val)) return;
+
+        for (i = 0; i < plan->n_consts; i++) {
+            if (memcmp (&ctx->consts[i], &val, sizeof (val)) == 0) return;
+        }
+        if (plan->n_consts == ctx->max_consts) {
+            ctx->max_consts = ctx->max_consts ? ctx->max_consts * 2 : 8;
+            ctx->consts = (double *)realloc (ctx->consts, ctx->max_consts * sizeof (double));
+        }
+        ctx->consts[plan->n_consts++] = val;
+        return;
+    }
+
+    if (node->token_code != MATH_SIN && node->token_code != MATH_COS) return;
+
+    if (ctx->n_trig_nodes == ctx->max_trig_nodes) {
+        ctx->max_trig_nodes = ctx->max_trig_nodes ? ctx->max_trig_nodes * 2 : 8;
+        ctx->trig_nodes = (mexpt_node_t **)realloc (ctx->trig_nodes,
+                                    ctx->max_trig_nodes * sizeof (mexpt_node_t *));
+    }
+    ctx->trig_nodes[ctx->n_trig_nodes++] = node;
+}
+
+/* Pairs every sin node with a cos node on the same argument */
+static void
+mexpt_batch_pair_trig_nodes (mexpt_batch_ctx_t *ctx) {
+
+    int i, j;
+    mexpt_node_t *sin_node, *cos_node;
+
+    for (i = 0; i < ctx->n_trig_nodes; i++) {
+
+        sin_node = ctx->trig_nodes[i];
+        if (!sin_node || sin_node->token_code != MATH_SIN) continue;
+
+        for (j = 0; j < ctx->n_trig_nodes; j++) {
+
+            cos_node = ctx->trig_nodes[j];
+            if (!cos_node || cos_node->token_code != MATH_COS) continue;
+            if (!mexpt_batch_same_subtree (sin_node->left, cos_node->left)) continue;
+
+            if (ctx->n_pairs == ctx->max_pairs) {
+                ctx->max_pairs = ctx->max_pairs ? ctx->max_pairs * 2 : 4;
+                ctx->pairs = (mexpt_batch_pair_t *)realloc (ctx->pairs,
+                                    ctx->max_pairs * sizeof (mexpt_batch_pair_t));
+            }
+            ctx->pairs[ctx->n_pairs].sin_node = sin_node;
+            ctx->pairs[ctx->n_pairs].cos_node = cos_node;
+            ctx->pairs[ctx->n_pairs].sin_slot = -1;
+            ctx->pairs[ctx->n_pairs].cos_slot = -1;
+            ctx->n_pairs++;
+
+            ctx->trig_nodes[j] = NULL;
+            break;
+        }
+    }
+}
+
+static int
+mexpt_batch_const_slot (mexpt_batch_ctx_t *ctx, double val) {
+
+    int i;
+    mexpt_batch_plan_t *plan = ctx->plan;
+
+    for (i = 0; i < plan->n_consts; i++) {
+        if (memcmp (&ctx->consts[i], &val, sizeof (val)) == 0) {
+            return plan->n_cols + i;
+        }
+    }
+    assert (0);
+    return -1;
+}
+
+static int
+mexpt_batch_alloc_vec (mexpt_batch_ctx_t *ctx) {
+
+    mexpt_batch_plan_t *plan = ctx->plan;
+
+    if (ctx->n_free_vecs) return ctx->free_vecs[--ctx->n_free_vecs];
+    return plan->n_cols + plan->n_consts + plan->n_vecs++;
+}
+
+/* Columns and constants are never freed */
+static void
+mexpt_batch_free_vec (mexpt_batch_ctx_t *ctx, int slot) {
+
+    mexpt_batch_plan_t *plan = ctx->plan;
+
+    if (slot < plan->n_cols + plan->n_consts) return;
+
+    if (ctx->n_free_vecs == ctx->max_free_vecs) {
+        ctx->max_free_vecs = ctx->max_free_vecs ? ctx->max_free_vecs * 2 : 8;
+        ctx->free_vecs = (int *)realloc (ctx->free_vecs, ctx->max_free_vecs * sizeof (int));
+    }
+    ctx->free_vecs[ctx->n_free_vecs++] = slot;
+}
+
+/* Result vector is allocated before the operands are freed, so that no
+    instruction writes over its own operands */
+static int
+mexpt_batch_emit (mexpt_batch_ctx_t *ctx, mexpt_batch_op_t op, int a, int b, int c) {
+
+    mexpt_batch_instr_t *instr;
+    mexpt_batch_plan_t *plan = ctx->plan;
+
+    if (plan->n_instrs == ctx->max_instrs) {
+        ctx->max_instrs = ctx->max_instrs ? ctx->max_instrs * 2 : 16;
+        plan->instrs = (mexpt_batch_instr_t *)realloc (plan->instrs,
+                                    ctx->max_instrs * sizeof (mexpt_batch_instr_t));
+    }
+
+    instr = &plan->instrs[plan->n_instrs++];
+    instr->op = op;
+    instr->dst = mexpt_batch_alloc_vec (ctx);
+    instr->dst2 = -1;
+    instr->a = a;
+    instr->b = b;
+    instr->c = c;
+    instr->imm = 0;
+
+    if (op == MEXPT_BATCH_SINCOS) {
+        instr->dst2 = mexpt_batch_alloc_vec (ctx);
+    }
+
+    if (a >= 0) mexpt_batch_free_vec (ctx, a);
+    if (b >= 0) mexpt_batch_free_vec (ctx, b);
+    if (c >= 0) mexpt_batch_free_vec (ctx, c);
+    return instr->dst;
+}
+
+static int mexpt_batch_compile_node (mexpt_batch_ctx_t *ctx, mexpt_node_t *node);
+
+/* sin or cos node of a pair : the first of the two to be compiled emits the
+    sincos instruction, the second one just takes its other result */
+static int
+mexpt_batch_compile_pair (mexpt_batch_ctx_t *ctx, mexpt_batch_pair_t *pair,
+                                            mexpt_node_t *node) {
+
+    int a;
+    mexpt_batch_plan_t *plan = ctx->plan;
+
+    if (pair->sin_slot < 0) {
+
+        a = mexpt_batch_compile_node (ctx, node->left);
+        if (a < 0) return -1;
+
+        pair->sin_slot = mexpt_batch_emit (ctx, MEXPT_BATCH_SINCOS, a, -1, -1);
+        pair->cos_slot = plan->instrs[plan->n_instrs - 1].dst2;
+        plan->n_sincos++;
+    }
+
+    return node == pair->sin_node ? pair->sin_slot : pair->cos_slot;
+}
+
+/* a * b + c and friends */
+static int
+mexpt_batch_compile_fma (mexpt_batch_ctx_t *ctx, mexpt_node_t *node) {
+
+    int a, b, c;
+    mexpt_batch_op_t op;
+    mexpt_node_t *mul, *addend;
+
+    if (node->left->token_code == MATH_MUL && !mexpt_batch_is_leaf (node->left)) {
+        mul = node->left;
+        addend = node->right;
+        op = node->token_code == MATH_PLUS ? MEXPT_BATCH_FMA : MEXPT_BATCH_FMS;
+    }
+    else if (node->right->token_code == MATH_MUL && !mexpt_batch_is_leaf (node->right)) {
+        mul = node->right;
+        addend = node->left;
+        op = node->token_code == MATH_PLUS ? MEXPT_BATCH_FMA : MEXPT_BATCH_FNMA;
+    }
+    else {
+        return -2;
+    }
+
+    /* int * int would use integer kernels of MexprDb */
+    if (mexpt_batch_is_int_literal (mul->left) &&
+            mexpt_batch_is_int_literal (mul->right)) return -2;
+
+    if ((a = mexpt_batch_compile_node (ctx, mul->left)) < 0) return -1;
+    if ((b = mexpt_batch_compile_node (ctx, mul->right)) < 0) return -1;
+    if ((c = mexpt_batch_compile_node (ctx, addend)) < 0) return -1;
+
+    ctx->plan->n_fma++;
+    return mexpt_batch_emit (ctx, op, a, b, c);
+}
+
+/* Returns the slot holding the result of the subtree, -1 if not supported */
+static int
+mexpt_batch_compile_node (mexpt_batch_ctx_t *ctx, mexpt_node_t *node) {
+
+    int i, a, b;
+    double val;
+    mexpt_batch_op_t op;
+
+    if (mexpt_batch_is_leaf (node)) {
+
+        if (mexpt_node_is_operand (node)) {
+            for (i = 0; i < ctx->plan->n_cols; i++) {
+                if (strcmp ((char *)node->u.opd_node.opd_value.variable_name,
+                                ctx->col_names[i]) == 0) return i;
+            }
+            return -1;
+        }
+        if (!mexpt_batch_leaf_const (node, &val)) return -1;
+        return mexpt_batch_const_slot (ctx, val);
+    }
+
+    /* int op int would use integer kernels of MexprDb, such subtrees are
+        folded by mexpt_optimize( ) */
+    if (mexpt_batch_is_int_literal (node->left) &&
+         (!node->right || mexpt_batch_is_int_literal (node->right))) return -1;
+
+    for (i = 0; i < ctx->n_pairs; i++) {
+        if (ctx->pairs[i].sin_node == node || ctx->pairs[i].cos_node == node) {
+            return mexpt_batch_compile_pair (ctx, &ctx->pairs[i], node);
+        }
+    }
+
+    /* Unary operators */
+    if (!node->right) {
+
+        switch (node->token_code) {
+
+            case MATH_SQR:  op = MEXPT_BATCH_SQR;  break;
+            case MATH_SQRT: op = MEXPT_BATCH_SQRT; break;
+            case MATH_SIN:  op = MEXPT_BATCH_SIN;  break;
+            case MATH_COS:  op = MEXPT_BATCH_COS;  break;
+            default:
+                return -1;
+        }
+
+        if ((a = mexpt_batch_compile_node (ctx, node->left)) < 0) return -1;
+        return mexpt_batch_emit (ctx, op, a, -1, -1);
+    }
+
+    if ((ctx->plan->flags & MEXPT_BATCH_FUSE_FMA) &&
+            (node->token_code == MATH_PLUS || node->token_code == MATH_MINUS)) {
+
+        a = mexpt_batch_compile_fma (ctx, node);
+        if (a != -2) return a;
+    }
+
+    /* x ^ 2 and friends */
+    if ((ctx->plan->flags & MEXPT_BATCH_VMATH) && node->token_code == MATH_POW &&
+            mexpt_batch_is_leaf (node->right) &&
+            mexpt_batch_leaf_const (node->right, &val) &&
+            val == (int)val &&
+            fabs (val) <= MEXPR_VMATH_POW_INT_MAX) {
+
+        if ((a = mexpt_batch_compile_node (ctx, node->left)) < 0) return -1;
+        a = mexpt_batch_emit (ctx, MEXPT_BATCH_POWI, a, -1, -1);
+        ctx->plan->instrs[ctx->plan->n_instrs - 1].imm = (int)val;
+        return a;
+    }
+
+    switch (node->token_code) {
+
+        case MATH_PLUS:             op = MEXPT_BATCH_ADD; break;
+        case MATH_MINUS:            op = MEXPT_BATCH_SUB; break;
+        case MATH_MUL:
+        case MATH_AND:              op = MEXPT_BATCH_MUL; break;   /* 1.0 * 1.0 */
+        case MATH_DIV:              op = MEXPT_BATCH_DIV; break;
+        case MATH_MAX:
+        case MATH_OR:               op = MEXPT_BATCH_MAX; break;
+        case MATH_MIN:              op = MEXPT_BATCH_MIN; break;
+        case MATH_POW:              op = MEXPT_BATCH_POW; break;
+        case MATH_LESS_THAN:        op = MEXPT_BATCH_LT;  break;
+        case MATH_LESS_THAN_EQ:     op = MEXPT_BATCH_LE;  break;
+        case MATH_GREATER_THAN:     op = MEXPT_BATCH_GT;  break;
+        case MATH_EQ:               op = MEXPT_BATCH_EQ;  break;
+        case MATH_NOT_EQ:           op = MEXPT_BATCH_NE;  break;
+        default:
+            return -1;
+    }
+
+    if ((a = mexpt_batch_compile_node (ctx, node->left)) < 0) return -1;
+    if ((b = mexpt_batch_compile_node (ctx, node->right)) < 0) return -1;
+    return mexpt_batch_emit (ctx, op, a, b, -1);
+}
+
+/* ====================x================x=================== */
+/* Public API */
+
+mexpt_batch_plan_t *
+mexpt_batch_compile (mexpt_tree_t *tree,
+                                    const char **col_names,
+                                    int n_cols,
+                                    uint32_t flags) {
+
+    int i, j;
+    int n_slots;
+    mexpt_batch_ctx_t ctx;
+    mexpt_batch_plan_t *plan;
+
+    if (!tree->root) return NULL;
+
+    plan = (mexpt_batch_plan_t *)calloc (1, sizeof (mexpt_batch_plan_t));
+    plan->n_cols = n_cols;
+    plan->flags = flags;
+
+    memset (&ctx, 0, sizeof (ctx));
+    ctx.plan = plan;
+    ctx.col_names = col_names;
+
+    mexpt_batch_collect (&ctx, tree->root);
+    if (flags & MEXPT_BATCH_FUSE_SINCOS) mexpt_batch_pair_trig_nodes (&ctx);
+
+    plan->result = mexpt_batch_compile_node (&ctx, tree->root);
+
+    if (plan->result < 0) {
+        free (ctx.consts);
+        free (ctx.free_vecs);
+        free (ctx.pairs);
+        free (ctx.trig_nodes);
+        free (plan->instrs);
+        free (plan);
+        return NULL;
+    }
+
+    /* Constants are filled once, scratch vectors on every chunk */
+    plan->vecs = (double *)malloc ((size_t)(plan->n_consts + plan->n_vecs) *
+                                    MEXPT_BATCH_CHUNK * sizeof (double));
+    n_slots = n_cols + plan->n_consts + plan->n_vecs;
+    plan->slots = (const double **)calloc (n_slots + 2 * plan->n_instrs,
+                                    sizeof (double *));
+    plan->invalid = (uint8_t *)malloc (MEXPT_BATCH_CHUNK);
+
+    for (i = 0; i < plan->n_consts + plan->n_vecs; i++) {
+        plan->slots[n_cols + i] = plan->vecs + (size_t)i * MEXPT_BATCH_CHUNK;
+    }
+
+    plan->col_vecs = (double *)malloc ((size_t)(n_cols ? n_cols : 1) *
+                                    MEXPT_BATCH_CHUNK * sizeof (double));
+    plan->hoist_vecs = (double *)malloc ((size_t)(plan->n_instrs ? 2 * plan->n_instrs : 1) *
+                                    MEXPT_BATCH_CHUNK * sizeof (double));
+    plan->batch_instrs = (mexpt_batch_instr_t *)malloc (
+                                    (plan->n_instrs ? plan->n_instrs : 1) *
+                                    sizeof (mexpt_batch_instr_t));
+    plan->uniform = (uint8_t *)calloc (n_slots + 2 * plan->n_instrs, 1);
+    plan->defs = (int *)malloc ((n_slots ? n_slots : 1) * sizeof (int));
+    plan->run_cols = (mexpt_batch_col_t *)calloc (n_cols ? n_cols : 1,
+                                    sizeof (mexpt_batch_col_t));
+    plan->col_pos = (uint64_t *)calloc (n_cols ? n_cols : 1, sizeof (uint64_t));
+
+    for (i = 0; i < 2 * plan->n_instrs; i++) {
+        plan->slots[n_slots + i] = plan->hoist_vecs + (size_t)i * MEXPT_BATCH_CHUNK;
+        plan->uniform[n_slots + i] = 1;
+    }
+    for (i = 0; i < plan->n_consts; i++) {
+        for (j = 0; j < MEXPT_BATCH_CHUNK; j++) {
+            plan->vecs[(size_t)i * MEXPT_BATCH_CHUNK + j] = ctx.consts[i];
+        }
+    }
+
+    free (ctx.consts);
+    free (ctx.free_vecs);
+    free (ctx.pairs);
+    free (ctx.trig_nodes);
+    return plan;
+}
+
+#define MEXPT_BATCH_LOOP(expr) \
+    for (i = 0; i < n; i++) d[i] = (expr)
+
+static void
+mexpt_batch_run_instr (const mexpt_batch_instr_t *instr,
+                                    const double **slots,
+                                    uint8_t *__restrict invalid,
+                                    int n,
+                                    bool vmath) {
+
+    int i;
+    double *__restrict d = (double *)slots[instr->dst];
+    const double *__restrict a = slots[instr->a];
+    const double *__restrict b = instr->b >= 0 ? slots[instr->b] : NULL;
+    const double *__restrict c = instr->c >= 0 ? slots[instr->c] : NULL;
+
+    switch (instr->op) {
+
+        case MEXPT_BATCH_ADD:   MEXPT_BATCH_LOOP (a[i] + b[i]); break;
+        case MEXPT_BATCH_SUB:   MEXPT_BATCH_LOOP (a[i] - b[i]); break;
+        case MEXPT_BATCH_MUL:   MEXPT_BATCH_LOOP (a[i] * b[i]); break;
+        case MEXPT_BATCH_DIV:
+            /* MexprDb fails the evaluation on zero divisor */
+            for (i = 0; i < n; i++) invalid[i] |= (b[i] == 0.0);
+            MEXPT_BATCH_LOOP (a[i] / b[i]);
+            break;
+        /* l > r ? l : r, same as MexprDb for NaN operands too */
+        case MEXPT_BATCH_MAX:   MEXPT_BATCH_LOOP (a[i] > b[i] ? a[i] : b[i]); break;
+        case MEXPT_BATCH_MIN:   MEXPT_BATCH_LOOP (a[i] < b[i] ? a[i] : b[i]); break;
+        case MEXPT_BATCH_POW:
+            if (vmath) mexpr_vmath_pow (a, b, d, n);
+            else MEXPT_BATCH_LOOP (pow (a[i], b[i]));
+            break;
+        case MEXPT_BATCH_POWI:  mexpr_vmath_powi (a, instr->imm, d, n); break;
+        case MEXPT_BATCH_SQR:   MEXPT_BATCH_LOOP (a[i] * a[i]); break;
+        case MEXPT_BATCH_SQRT:  mexpr_vmath_sqrt (a, d, n); break;
+        case MEXPT_BATCH_SIN:
+            if (vmath) mexpr_vmath_sin (a, d, n);
+            else MEXPT_BATCH_LOOP (sin (a[i]));
+            break;
+        case MEXPT_BATCH_COS:
+            if (vmath) mexpr_vmath_cos (a, d, n);
+            else MEXPT_BATCH_LOOP (cos (a[i]));
+            break;
+        case MEXPT_BATCH_LT:    MEXPT_BATCH_LOOP (a[i] < b[i] ? 1.0 : 0.0); break;
+        case MEXPT_BATCH_LE:    MEXPT_BATCH_LOOP (a[i] <= b[i] ? 1.0 : 0.0); break;
+        case MEXPT_BATCH_GT:    MEXPT_BATCH_LOOP (a[i] > b[i] ? 1.0 : 0.0); break;
+        case MEXPT_BATCH_EQ:    MEXPT_BATCH_LOOP (a[i] == b[i] ? 1.0 : 0.0); break;
+        case MEXPT_BATCH_NE:    MEXPT_BATCH_LOOP (a[i] != b[i] ? 1.0 : 0.0); break;
+        case MEXPT_BATCH_SINCOS:
+        {
+            double *__restrict d2 = (double *)slots[instr->dst2];
+
+            if (vmath) {
+                mexpr_vmath_sincos (a, d, d2, n);
+                break;
+            }
+#if defined(__GLIBC__)
+            for (i = 0; i < n; i++) sincos (a[i], &d[i], &d2[i]);
+#else
+            for (i = 0; i < n; i++) {
+                d[i] = sin (a[i]);
+                d2[i] = cos (a[i]);
+            }
+#endif
+            break;
+        }
+        /* Inlined to one instruction when built for FMA capable targets */
+        case MEXPT_BATCH_FMA:   MEXPT_BATCH_LOOP (fma (a[i], b[i], c[i])); break;
+        case MEXPT_BATCH_FMS:   MEXPT_BATCH_LOOP (fma (a[i], b[i], -c[i])); break;
+        case MEXPT_BATCH_FNMA:  MEXPT_BATCH_LOOP (fma (-a[i], b[i], c[i])); break;
+        default:
+            assert (0);
+    }
+}
+
+void
+mexpt_batch_eval (mexpt_batch_plan_t *plan,
+                            const double **cols,
+                            uint64_t n_rows,
+                            double *out) {
+
+    int i, c, n;
+    uint64_t off;
+    const double *res;
+
+    for (off = 0; off < n_rows; off += n) {
+
+        n = n_rows - off < MEXPT_BATCH_CHUNK ? (int)(n_rows - off) : MEXPT_BATCH_CHUNK;
+
+        for (c = 0; c < plan->n_cols; c++) {
+            plan->slots[c] = cols[c] + off;
+        }
+        memset (plan->invalid, 0, n);
+
+        for (i = 0; i < plan->n_instrs; i++) {
+            mexpt_batch_run_instr (&plan->instrs[i], plan->slots, plan->invalid, n,
+                                                plan->flags & MEXPT_BATCH_VMATH);
+        }
+
+        res = plan->slots[plan->result];
+        for (i = 0; i < n; i++) {
+            out[off + i] = plan->invalid[i] ? NAN : res[i];
+        }
+    }
+}
+
+/* ====================x================x=================== */
+/* Encoded Columns */
+
+/* Slot an instruction reads instead of slot : hoisted result if the last
+    instruction writing slot was computed once per batch */
+static int
+mexpt_batch_hoisted_slot (mexpt_batch_plan_t *plan, int slot) {
+
+    int def;
+    int n_slots = plan->n_cols + plan->n_consts + plan->n_vecs;
+
+    if (slot < plan->n_cols + plan->n_consts || slot >= n_slots) return slot;
+    def = plan->defs[slot];
+    if (def < 0 || !plan->uniform[slot]) return slot;
+    return n_slots + 2 * def + (plan->instrs[def].dst2 == slot);
+}
+
+static void
+mexpt_batch_broadcast (double *vec, double val) {
+
+    int i;
+
+    for (i = 0; i < MEXPT_BATCH_CHUNK; i++) vec[i] = val;
+}
+
+/* Computes the instructions whose operands are all constant in the batch,
+    and leaves the others in batch_instrs. Returns the slot of the result,
+    *invalid_all is set if a hoisted instruction failed */
+static int
+mexpt_batch_hoist (mexpt_batch_plan_t *plan,
+                                const mexpt_batch_col_t *cols,
+                                bool *invalid_all) {
+
+    int i, c;
+    bool uniform;
+    mexpt_batch_instr_t instr;
+    int n_slots = plan->n_cols + plan->n_consts + plan->n_vecs;
+
+    for (c = 0; c < plan->n_cols; c++) {
+
+        plan->uniform[c] = (cols[c].enc == MEXPT_BATCH_COL_CONST);
+        if (!plan->uniform[c]) continue;
+        mexpt_batch_broadcast (plan->col_vecs + (size_t)c * MEXPT_BATCH_CHUNK,
+                                            cols[c].values[0]);
+        plan->slots[c] = plan->col_vecs + (size_t)c * MEXPT_BATCH_CHUNK;
+    }
+    for (i = plan->n_cols; i < n_slots; i++) {
+        plan->uniform[i] = (i < plan->n_cols + plan->n_consts);
+        plan->defs[i] = -1;
+    }
+
+    *invalid_all = false;
+    plan->n_batch_instrs = 0;
+    plan->n_hoisted = 0;
+
+    for (i = 0; i < plan->n_instrs; i++) {
+
+        instr = plan->instrs[i];
+        uniform = plan->uniform[instr.a] &&
+                        (instr.b < 0 || plan->uniform[instr.b]) &&
+                        (instr.c < 0 || plan->uniform[instr.c]);
+
+        instr.a = mexpt_batch_hoisted_slot (plan, instr.a);
+        if (instr.b >= 0) instr.b = mexpt_batch_hoisted_slot (plan, instr.b);
+        if (instr.c >= 0) instr.c = mexpt_batch_hoisted_slot (plan, instr.c);
+
+        if (uniform) {
+
+            instr.dst = n_slots + 2 * i;
+            if (instr.dst2 >= 0) instr.dst2 = n_slots + 2 * i + 1;
+
+            plan->invalid[0] = 0;
+            mexpt_batch_run_instr (&instr, plan->slots, plan->invalid, 1,
+                                                plan->flags & MEXPT_BATCH_VMATH);
+            *invalid_all |= plan->invalid[0];
+
+            mexpt_batch_broadcast ((double *)plan->slots[instr.dst], plan->slots[instr.dst][0]);
+            if (instr.dst2 >= 0) {
+                mexpt_batch_broadcast ((double *)plan->slots[instr.dst2],
+                                                    plan->slots[instr.dst2][0]);
+            }
+            plan->n_hoisted++;
+        }
+        else {
+            plan->batch_instrs[plan->n_batch_instrs++] = instr;
+        }
+
+        plan->defs[plan->instrs[i].dst] = i;
+        plan->uniform[plan->instrs[i].dst] = uniform;
+        if (plan->instrs[i].dst2 >= 0) {
+            plan->defs[plan->instrs[i].dst2] = i;
+            plan->uniform[plan->instrs[i].dst2] = uniform;
+        }
+    }
+
+    return mexpt_batch_hoisted_slot (plan, plan->result);
+}
+
+/* Values of the run length column for rows [off, off + n) */
+static void
+mexpt_batch_decode_runs (const mexpt_batch_col_t *col,
+                                        uint64_t off,
+                                        int n,
+                                        double *vec) {
+
+    int i = 0;
+    uint64_t lo = 0, hi = col->n_runs - 1, mid;
+
+    /* First run ending past off */
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (col->run_ends[mid] > off) hi = mid;
+        else lo = mid + 1;
+    }
+
+    while (i < n) {
+        for ( ; i < n && off + i < col->run_ends[lo]; i++) vec[i] = col->values[lo];
+        lo++;
+    }
+}
+
+/* Plan on columns which are FLAT, CONST or RLE, n_rows results into out */
+static void
+mexpt_batch_eval_chunks (mexpt_batch_plan_t *plan,
+                                        const mexpt_batch_col_t *cols,
+                                        uint64_t n_rows,
+                                        double *out) {
+
+    int i, c, n;
+    int result;
+    uint64_t off;
+    bool invalid_all;
+    const double *res;
+
+    result = mexpt_batch_hoist (plan, cols, &invalid_all);
+    plan->n_computed = 0;
+
+    if (invalid_all || plan->uniform[result]) {
+        for (off = 0; off < n_rows; off++) {
+            out[off] = invalid_all ? NAN : plan->slots[result][0];
+        }
+        return;
+    }
+
+    for (off = 0; off < n_rows; off += n) {
+
+        n = n_rows - off < MEXPT_BATCH_CHUNK ? (int)(n_rows - off) : MEXPT_BATCH_CHUNK;
+
+        for (c = 0; c < plan->n_cols; c++) {
+
+            switch (cols[c].enc) {
+
+                case MEXPT_BATCH_COL_FLAT:
+                    plan->slots[c] = cols[c].values + off;
+                    break;
+                case MEXPT_BATCH_COL_RLE:
+                    plan->slots[c] = plan->col_vecs + (size_t)c * MEXPT_BATCH_CHUNK;
+                    mexpt_batch_decode_runs (&cols[c], off, n, (double *)plan->slots[c]);
+                    break;
+                default:
+                    break;
+            }
+        }
+        memset (plan->invalid, 0, n);
+
+        for (i = 0; i < plan->n_batch_instrs; i++) {
+            mexpt_batch_run_instr (&plan->batch_instrs[i], plan->slots, plan->invalid, n,
+                                                plan->flags & MEXPT_BATCH_VMATH);
+        }
+
+        res = plan->slots[result];
+        for (i = 0; i < n; i++) {
+            out[off + i] = plan->invalid[i] ? NAN : res[i];
+        }
+    }
+    plan->n_computed = n_rows;
+}
+
+static bool
+mexpt_batch_cols_valid (mexpt_batch_plan_t *plan,
+                                    const mexpt_batch_col_t *cols,
+                                    uint64_t n_rows) {
+
+    int c;
+    uint64_t r;
+
+    for (c = 0; c < plan->n_cols; c++) {
+
+        if (cols[c].enc != MEXPT_BATCH_COL_RLE) continue;
+
+        if (!cols[c].n_runs || cols[c].run_ends[cols[c].n_runs - 1] < n_rows) {
+            printf ("Error : Batch : Runs of column %d do not cover %llu rows\n",
+                        c, (unsigned long long)n_rows);
+            return false;
+        }
+        for (r = 1; r < cols[c].n_runs; r++) {
+            if (cols[c].run_ends[r] <= cols[c].run_ends[r - 1]) {
+                printf ("Error : Batch : Runs of column %d are not ascending\n", c);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/* Segments of rows on which the results are computed : one per merged run if
+    no column is FLAT, *ends gives their ends. Otherwise one per row, and
+    *ends is NULL. Results are in *vals */
+static uint64_t
+mexpt_batch_eval_segments (mexpt_batch_plan_t *plan,
+                                            const mexpt_batch_col_t *cols,
+                                            uint64_t n_rows,
+                                            const double **vals,
+                                            const uint64_t **ends) {
+
+    int c;
+    bool flat = false;
+    uint64_t row, end, n_runs;
+    double *res;
+
+    for (c = 0; c < plan->n_cols; c++) {
+        if (cols[c].enc == MEXPT_BATCH_COL_FLAT) flat = true;
+        plan->col_pos[c] = 0;
+    }
+
+    /* Merge the run boundaries of all columns, first counting them */
+    n_runs = 0;
+    if (!flat) {
+
+        for (row = 0; row < n_rows; row = end) {
+
+            end = n_rows;
+            for (c = 0; c < plan->n_cols; c++) {
+
+                if (cols[c].enc != MEXPT_BATCH_COL_RLE) continue;
+                if (cols[c].run_ends[plan->col_pos[c]] <= row) plan->col_pos[c]++;
+                if (cols[c].run_ends[plan->col_pos[c]] < end) {
+                    end = cols[c].run_ends[plan->col_pos[c]];
+                }
+            }
+            n_runs++;
+        }
+    }
+
+    if ((flat ? n_rows : n_runs) > plan->max_seg_vals) {
+        plan->max_seg_vals = flat ? n_rows : n_runs;
+        free (plan->seg_vals);
+        plan->seg_vals = (double *)malloc (plan->max_seg_vals * sizeof (double));
+    }
+    if (!flat && n_runs > plan->max_runs) {
+        plan->max_runs = n_runs;
+        free (plan->run_vals);
+        free (plan->run_ends);
+        plan->run_vals = (double *)malloc ((size_t)(plan->n_cols ? plan->n_cols : 1) *
+                                                        plan->max_runs * sizeof (double));
+        plan->run_ends = (uint64_t *)malloc (plan->max_runs * sizeof (uint64_t));
+    }
+    res = plan->seg_vals;
+    *vals = res;
+
+    if (flat) {
+        mexpt_batch_eval_chunks (plan, cols, n_rows, res);
+        *ends = NULL;
+        return n_rows;
+    }
+
+    /* Values of the columns per merged run, RLE columns become FLAT ones */
+    for (c = 0; c < plan->n_cols; c++) {
+
+        plan->col_pos[c] = 0;
+        plan->run_cols[c] = cols[c];
+        if (cols[c].enc != MEXPT_BATCH_COL_RLE) continue;
+        plan->run_cols[c].enc = MEXPT_BATCH_COL_FLAT;
+        plan->run_cols[c].values = plan->run_vals + (size_t)c * plan->max_runs;
+    }
+
+    for (n_runs = 0, row = 0; row < n_rows; row = end, n_runs++) {
+
+        end = n_rows;
+        for (c = 0; c < plan->n_cols; c++) {
+
+            if (cols[c].enc != MEXPT_BATCH_COL_RLE) continue;
+            if (cols[c].run_ends[plan->col_pos[c]] <= row) plan->col_pos[c]++;
+            plan->run_vals[(size_t)c * plan->max_runs + n_runs] =
+                                            cols[c].values[plan->col_pos[c]];
+            if (cols[c].run_ends[plan->col_pos[c]] < end) {
+                end = cols[c].run_ends[plan->col_pos[c]];
+            }
+        }
+        plan->run_ends[n_runs] = end;
+    }
+
+    mexpt_batch_eval_chunks (plan, plan->run_cols, n_runs, res);
+    *ends = plan->run_ends;
+    return n_runs;
+}
+
+bool
+mexpt_batch_eval_cols (mexpt_batch_plan_t *plan,
+                                    const mexpt_batch_col_t *cols,
+                                    uint64_t n_rows,
+                                    double *out) {
+
+    int c;
+    bool flat = false;
+    uint64_t i, row, n_segs;
+    const double *vals;
+    const uint64_t *ends;
+
+    if (!mexpt_batch_cols_valid (plan, cols, n_rows)) return false;
+
+    for (c = 0; c < plan->n_cols; c++) {
+        if (cols[c].enc == MEXPT_BATCH_COL_FLAT) flat = true;
+    }
+
+    /* Straight into out */
+    if (flat) {
+        mexpt_batch_eval_chunks (plan, cols, n_rows, out);
+        return true;
+    }
+
+    n_segs = mexpt_batch_eval_segments (plan, cols, n_rows, &vals, &ends);
+    for (i = 0, row = 0; i < n_segs; i++) {
+        for ( ; row < ends[i]; row++) out[row] = vals[i];
+    }
+    return true;
+}
+
+/* Same results belong to the same run : bit equal (0.0 and -0.0 differ), or
+    both NaN */
+static inline bool
+mexpt_batch_same_result (double a, double b) {
+
+    return memcmp (&a, &b, sizeof (a)) == 0 || (a != a && b != b);
+}
+
+bool
+mexpt_batch_eval_runs (mexpt_batch_plan_t *plan,
+                                    const mexpt_batch_col_t *cols,
+                                    uint64_t n_rows,
+                                    mexpt_batch_runs_t *runs) {
+
+    uint64_t i, n_segs, end;
+    const double *vals;
+    const uint64_t *ends;
+
+    if (!mexpt_batch_cols_valid (plan, cols, n_rows)) return false;
+
+    n_segs = mexpt_batch_eval_segments (plan, cols, n_rows, &vals, &ends);
+    runs->n_runs = 0;
+
+    for (i = 0; i < n_segs; i++) {
+
+        end = ends ? ends[i] : i + 1;
+
+        if (runs->n_runs &&
+                mexpt_batch_same_result (runs->values[runs->n_runs - 1], vals[i])) {
+            runs->ends[runs->n_runs - 1] = end;
+            continue;
+        }
+        if (runs->n_runs == runs->max_runs) {
+            runs->max_runs = runs->max_runs ? runs->max_runs * 2 : 64;
+            runs->values = (double *)realloc (runs->values, runs->max_runs * sizeof (double));
+            runs->ends = (uint64_t *)realloc (runs->ends, runs->max_runs * sizeof (uint64_t));
+        }
+        runs->values[runs->n_runs] = vals[i];
+        runs->ends[runs->n_runs] = end;
+        runs->n_runs++;
+    }
+    return true;
+}
+
+bool
+mexpt_batch_filter_ranges (mexpt_batch_plan_t *plan,
+                                        const mexpt_batch_col_t *cols,
+                                        uint64_t n_rows,
+                                        mexpt_batch_ranges_t *ranges) {
+
+    uint64_t i, n_segs, begin, end;
+    const double *vals;
+    const uint64_t *ends;
+
+    if (!mexpt_batch_cols_valid (plan, cols, n_rows)) return false;
+
+    n_segs = mexpt_batch_eval_segments (plan, cols, n_rows, &vals, &ends);
+    ranges->n_ranges = 0;
+    ranges->n_selected = 0;
+
+    for (i = 0, begin = 0; i < n_segs; i++, begin = end) {
+
+        end = ends ? ends[i] : i + 1;
+
+        /* NaN is a failed row */
+        if (vals[i] == 0.0 || vals[i] != vals[i]) continue;
+
+        ranges->n_selected += end - begin;
+        if (ranges->n_ranges && ranges->ends[ranges->n_ranges - 1] == begin) {
+            ranges->ends[ranges->n_ranges - 1] = end;
+            continue;
+        }
+        if (ranges->n_ranges == ranges->max_ranges) {
+            ranges->max_ranges = ranges->max_ranges ? ranges->max_ranges * 2 : 64;
+            ranges->begins = (uint64_t *)realloc (ranges->begins,
+                                        ranges->max_ranges * sizeof (uint64_t));
+            ranges->ends = (uint64_t *)realloc (ranges->ends,
+                                        ranges->max_ranges * sizeof (uint64_t));
+        }
+        ranges->begins[ranges->n_ranges] = begin;
+        ranges->ends[ranges->n_ranges] = end;
+        ranges->n_ranges++;
+    }
+    return true;
+}
+
+void
+mexpt_batch_runs_free (mexpt_batch_runs_t *runs) {
+
+    free (runs->values);
+    free (runs->ends);
+    memset (runs, 0, sizeof (*runs));
+}
+
+void
+mexpt_batch_ranges_free (mexpt_batch_ranges_t *ranges) {
+
+    free (ranges->begins);
+    free (ranges->ends);
+    memset (ranges, 0, sizeof (*ranges));
+}
+
+static void
+mexpt_batch_print_slot (mexpt_batch_plan_t *plan, int slot) {
+
+    if (slot < plan->n_cols) printf ("col%d", slot);
+    else if (slot < plan->n_cols + plan->n_consts) printf ("%g", plan->slots[slot][0]);
+    else printf ("v%d", slot - plan->n_cols - plan->n_consts);
+}
+
+void
+mexpt_batch_print (mexpt_batch_plan_t *plan) {
+
+    int i;
+    mexpt_batch_instr_t *instr;
+
+    printf ("Batch plan : %d instructions, %d vectors, %d constants, %d fma, %d sincos\n",
+                plan->n_instrs, plan->n_vecs, plan->n_consts, plan->n_fma, plan->n_sincos);
+
+    for (i = 0; i < plan->n_instrs; i++) {
+
+        instr = &plan->instrs[i];
+        printf ("  ");
+        mexpt_batch_print_slot (plan, instr->dst);
+        if (instr->dst2 >= 0) {
+            printf (", ");
+            mexpt_batch_print_slot (plan, instr->dst2);
+        }
+        printf (" = %s (", mexpt_batch_op_names[instr->op]);
+        mexpt_batch_print_slot (plan, instr->a);
+        if (instr->b >= 0) {
+            printf (", ");
+            mexpt_batch_print_slot (plan, instr->b);
+        }
+        if (instr->c >= 0) {
+            printf (", ");
+            mexpt_batch_print_slot (plan, instr->c);
+        }
+        if (instr->op == MEXPT_BATCH_POWI) printf (", %d", instr->imm);
+        printf (")\n");
+    }
+
+    printf ("  result = ");
+    mexpt_batch_print_slot (plan, plan->result);
+    printf ("\n");
+}
+
+void
+mexpt_batch_free (mexpt_batch_plan_t *plan) {
+
+    free (plan->instrs);
+    free (plan->vecs);
+    free (plan->slots);
+    free (plan->invalid);
+    free (plan->col_vecs);
+    free (plan->hoist_vecs);
+    free (plan->batch_instrs);
+    free (plan->uniform);
+    free (plan->defs);
+    free (plan->run_vals);
+    free (plan->run_ends);
+    free (plan->seg_vals);
+    free (plan->run_cols);
+    free (plan->col_pos);
+    free (plan);
+}
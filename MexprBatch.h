@@ -0,0 +1,230 @@
+#ifndef __MEXPR_BATCH__
+#define __MEXPR_BATCH__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "MExpr.h"
+
+/* Batch Evaluation of Numeric Expression Trees
+
+    mexpt_batch_compile( ) turns a validated and optimized tree into a plan of
+    vector instructions. mexpt_batch_eval( ) runs the plan over columns of
+    doubles, MEXPT_BATCH_CHUNK rows at a time : every instruction is one tight
+    loop over the chunk, which the compiler vectorizes. Every operand of the tree
+    is bound to a column by name, col_names[i] is the name of cols[i].
+
+    Supported trees and results are the ones of MexprJit : double and integer
+    literals, operands, + - * / sqr sqrt max min sin cos pow, < <= > = != and or.
+    Ineq and Logical operators give 1.0 or 0.0, rows on which mexpt_evaluate( )
+    fails (divide by zero) give NaN. Otherwise mexpt_batch_compile( ) returns NULL.
+
+    Fusion, selected by flags :
+
+    MEXPT_BATCH_FUSE_SINCOS : sin(x) and cos(x) on structurally equal arguments
+        (e.g. sin(t) * x + cos(t) * y) evaluate x once, and both results with a
+        single sincos( ). Results are the ones of separate sin( ) and cos( ).
+
+    MEXPT_BATCH_FUSE_FMA : a * b + c, c + a * b, a * b - c and c - a * b are
+        computed with one fma( ), rounding once instead of twice. Results may
+        then differ from mexpt_evaluate( ) in the last bit, hence opt-in.
+
+    MEXPT_BATCH_VMATH : sin, cos and pow run vector kernels of MexprVmath
+        instead of libm, x ^ e for a small integer literal e becomes a powi.
+        Error bounds are documented in MexprVmath.h, hence opt-in too.
+        sqrt always runs the vector kernel, it is correctly rounded.
+
+    Encoded columns : mexpt_batch_eval_cols( ) takes columns which may be
+    constant within the batch (MEXPT_BATCH_COL_CONST) or run length encoded
+    (MEXPT_BATCH_COL_RLE), next to plain ones (MEXPT_BATCH_COL_FLAT).
+
+    - Instructions whose operands are all constant in the batch are computed
+        once per batch, their results are broadcast to the other instructions.
+    - If no column is FLAT, run boundaries of all columns are merged, and the
+        plan is computed once per merged run (a single time if all columns are
+        constant), then the results are expanded to the rows.
+    - Otherwise runs are decoded chunk by chunk.
+
+    mexpt_batch_eval_runs( ) gives the results as runs, equal results of
+    adjacent rows are merged. mexpt_batch_filter_ranges( ) gives the rows on
+    which a predicate is true (non zero, not NaN) as ranges of rows.
+    Results are the ones of mexpt_batch_eval( ) on the decoded columns.
+
+    Plan owns scratch vectors, one evaluation at a time per plan.
+*/
+
+#define MEXPT_BATCH_CHUNK   256
+
+#define MEXPT_BATCH_FUSE_SINCOS     (1 << 0)
+#define MEXPT_BATCH_FUSE_FMA        (1 << 1)
+#define MEXPT_BATCH_VMATH           (1 << 2)
+#define MEXPT_BATCH_FUSE_DEFAULT    MEXPT_BATCH_FUSE_SINCOS
+
+typedef enum mexpt_batch_op_ {
+
+    MEXPT_BATCH_ADD,
+    MEXPT_BATCH_SUB,
+    MEXPT_BATCH_MUL,
+    MEXPT_BATCH_DIV,
+    MEXPT_BATCH_MAX,
+    MEXPT_BATCH_MIN,
+    MEXPT_BATCH_POW,
+    MEXPT_BATCH_SQR,
+    MEXPT_BATCH_SQRT,
+    MEXPT_BATCH_SIN,
+    MEXPT_BATCH_COS,
+    MEXPT_BATCH_LT,
+    MEXPT_BATCH_LE,
+    MEXPT_BATCH_GT,
+    MEXPT_BATCH_EQ,
+    MEXPT_BATCH_NE,
+    /* Fused */
+    MEXPT_BATCH_SINCOS,     /* dst = sin(a), dst2 = cos(a) */
+    MEXPT_BATCH_FMA,        /* dst = a * b + c */
+    MEXPT_BATCH_FMS,        /* dst = a * b - c */
+    MEXPT_BATCH_FNMA,       /* dst = c - a * b */
+    MEXPT_BATCH_POWI,       /* dst = a ^ imm, MEXPT_BATCH_VMATH only */
+    MEXPT_BATCH_OP_MAX
+} mexpt_batch_op_t;
+
+typedef enum mexpt_batch_col_enc_ {
+
+    MEXPT_BATCH_COL_FLAT,       /* values[row] */
+    MEXPT_BATCH_COL_CONST,      /* values[0] for every row */
+    MEXPT_BATCH_COL_RLE         /* values[run] for rows up to run_ends[run] */
+} mexpt_batch_col_enc_t;
+
+typedef struct mexpt_batch_col_ {
+
+    mexpt_batch_col_enc_t enc;
+    const double *values;
+    /* MEXPT_BATCH_COL_RLE : n_runs ascending row indexes, each one past the
+        last row of its run. Last one is at least n_rows */
+    const uint64_t *run_ends;
+    uint64_t n_runs;
+} mexpt_batch_col_t;
+
+/* Results of mexpt_batch_eval_runs( ) : values[i] for rows up to ends[i].
+    Arrays are grown by the evaluation, zero the struct before first use */
+typedef struct mexpt_batch_runs_ {
+
+    uint64_t n_runs;
+    uint64_t max_runs;
+    double *values;
+    uint64_t *ends;
+} mexpt_batch_runs_t;
+
+/* Rows [begins[i], ends[i]) selected by mexpt_batch_filter_ranges( ) */
+typedef struct mexpt_batch_ranges_ {
+
+    uint64_t n_ranges;
+    uint64_t max_ranges;
+    uint64_t n_selected;            /* rows in all ranges */
+    uint64_t *begins;
+    uint64_t *ends;
+} mexpt_batch_ranges_t;
+
+/* Operands and results are slots : columns first, then constants, then
+    scratch vectors, then results of instructions computed once per batch */
+typedef struct mexpt_batch_instr_ {
+
+    mexpt_batch_op_t op;
+    int dst;
+    int dst2;
+    int a;
+    int b;
+    int c;
+    int imm;
+} mexpt_batch_instr_t;
+
+typedef struct mexpt_batch_plan_ {
+
+    int n_cols;
+    int n_consts;
+    int n_vecs;
+    int result;                     /* slot of the result */
+
+    int n_instrs;
+    mexpt_batch_instr_t *instrs;
+
+    uint32_t flags;
+    int n_fma;                      /* fused ops in the plan */
+    int n_sincos;
+
+    /* Slot base pointers for the current chunk, and the memory behind
+        constants and scratch vectors */
+    const double **slots;
+    double *vecs;
+    uint8_t *invalid;
+
+    /* Encoded columns : chunk vectors of the columns (broadcast constants,
+        decoded runs), two hoisted result vectors per instruction, and the
+        instructions left for the chunk loop, operands redirected */
+    double *col_vecs;
+    double *hoist_vecs;
+    mexpt_batch_instr_t *batch_instrs;
+    int n_batch_instrs;
+    uint8_t *uniform;               /* per slot : constant in the batch */
+    int *defs;                      /* per slot : last instruction writing it */
+
+    /* Merged runs : values of the columns per run, the columns as seen by
+        the chunk loop, and a run cursor per column. Results per merged run,
+        or per row if a column is FLAT */
+    double *run_vals;
+    uint64_t *run_ends;
+    uint64_t max_runs;
+    double *seg_vals;
+    uint64_t max_seg_vals;
+    mexpt_batch_col_t *run_cols;
+    uint64_t *col_pos;
+
+    /* Last evaluation of encoded columns */
+    int n_hoisted;                  /* instructions computed once */
+    uint64_t n_computed;            /* rows (or runs) the chunk loop ran on */
+} mexpt_batch_plan_t;
+
+mexpt_batch_plan_t *
+mexpt_batch_compile (mexpt_tree_t *tree,
+                                    const char **col_names,
+                                    int n_cols,
+                                    uint32_t flags);
+
+/* cols[i] points to n_rows doubles of column i, out receives n_rows results */
+void
+mexpt_batch_eval (mexpt_batch_plan_t *plan,
+                            const double **cols,
+                            uint64_t n_rows,
+                            double *out);
+
+/* Return false, printing an error, on malformed run length columns */
+bool
+mexpt_batch_eval_cols (mexpt_batch_plan_t *plan,
+                                    const mexpt_batch_col_t *cols,
+                                    uint64_t n_rows,
+                                    double *out);
+
+bool
+mexpt_batch_eval_runs (mexpt_batch_plan_t *plan,
+                                    const mexpt_batch_col_t *cols,
+                                    uint64_t n_rows,
+                                    mexpt_batch_runs_t *runs);
+
+bool
+mexpt_batch_filter_ranges (mexpt_batch_plan_t *plan,
+                                        const mexpt_batch_col_t *cols,
+                                        uint64_t n_rows,
+                                        mexpt_batch_ranges_t *ranges);
+
+void
+mexpt_batch_runs_free (mexpt_batch_runs_t *runs);
+
+void
+mexpt_batch_ranges_free (mexpt_batch_ranges_t *ranges);
+
+void
+mexpt_batch_print (mexpt_batch_plan_t *plan);
+
+void
+mexpt_batch_free (mexpt_batch_plan_t *plan);
+
+#endif
@@ -0,0 +1,293 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <malloc.h>
+#include "UserParserL.h"
+#include "ParserMexpr.h"
+#include "MexprEnums.h"
+#include "MExpr.h"
+
+/* Measures latency of mexpt_clone( ) on parsed trees of increasing size
+
+    Usage : mexprclone [nodes per size]
+
+    Trees of about 10, 100 and 360 nodes are parsed from conjunctions of 1, 10
+    and 36 copies of MEXPRCLONE_CONJUNCT, the longest the parser takes. Each
+    is cloned until nodes per size nodes (2M if not given) are copied, in
+    batches of MEXPRCLONE_BATCH, two ways :
+
+        walk    the tree with is_flat cleared, as parsed trees were cloned
+                before the parser built them flat : nodes are copied in
+                pre-order into the pool of the clone, and operands are
+                indexed again
+        flat    the parsed tree as is : the clone is one copy of the pool, a
+                relocation of the links and a copy of the operand index
+
+    For reference, node by node copies the tree with one malloc( ) per node,
+    links only : a lower bound of cloning without a node pool, which also
+    rebuilt the operand list.
+
+    glibc gives the heap back to the kernel when a batch of clones is freed,
+    and the next batch then page faults on every pool, whichever way it is
+    cloned : mallopt( ) keeps freed memory in the heap, so that clones are
+    timed rather than page faults.
+
+    Prints ns per clone and per node of each, the speedup of flat over walk,
+    and ns per mexpt_tree_destroy( ) of a flat clone, best of
+    MEXPRCLONE_REPEAT runs. Clones are checked to have the node count, the
+    operands and the result of their source.
+*/
+
+#define MEXPRCLONE_CONJUNCT     "a*b+c>d/2"
+#define MEXPRCLONE_BATCH        64
+#define MEXPRCLONE_REPEAT       3
+
+static const int mexprclone_n_conjuncts[] = {1, 10, 36};
+
+static double mexprclone_vals[4] = {3, 4, 5, 6};
+
+static double
+mexprclone_now (void) {
+
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static mexpr_var_t
+mexprclone_col_compute (void *data_src) {
+
+    mexpr_var_t res;
+
+    res.dtype = MEXPR_DTYPE_DOUBLE;
+    res.u.d_val = *(double *)data_src;
+    return res;
+}
+
+/* Conjunction of n_conjuncts copies of MEXPRCLONE_CONJUNCT */
+static mexpt_tree_t *
+mexprclone_build (int n_conjuncts) {
+
+    int i;
+    mexpt_tree_t *tree;
+    mexpt_node_t *opd_node = NULL;
+    const char *name;
+    char *expr = (char *)lex_buffer;
+
+    if (n_conjuncts * (strlen (MEXPRCLONE_CONJUNCT) + 5) >= MAX_STRING_SIZE) {
+        printf ("Error : Conjunction of %d conjuncts is too long\n", n_conjuncts);
+        return NULL;
+    }
+
+    /* Parser rewinds by rescanning lex_buffer */
+    strcpy (expr, MEXPRCLONE_CONJUNCT);
+    for (i = 1; i < n_conjuncts; i++) {
+        strcat (expr, " and " MEXPRCLONE_CONJUNCT);
+    }
+    lex_set_scan_buffer ((const char *)lex_buffer);
+
+    tree = Parser_Mexpr_Condition_build_expression_tree ();
+    Parser_stack_reset ();
+
+    if (!tree) {
+        printf ("Error : Exp Tree could not built for %d conjuncts\n", n_conjuncts);
+        return NULL;
+    }
+
+    mexpt_iterate_operands_begin (tree, opd_node) {
+
+        name = (const char *)opd_node->u.opd_node.opd_value.variable_name;
+        opd_node->u.opd_node.is_numeric = true;
+        mexpt_tree_install_operand_properties (opd_node, &mexprclone_vals[name[0] - 'a'],
+                                                                     mexprclone_col_compute);
+
+    } mexpt_iterate_operands_end (tree, opd_node);
+
+    if (!mexpr_validate_expression_tree (tree)) {
+        printf ("Error : Conjunction of %d conjuncts is not a valid condition\n", n_conjuncts);
+        mexpt_tree_destroy (tree, false);
+        return NULL;
+    }
+    return tree;
+}
+
+static mexpt_node_t *
+mexprclone_node_by_node (mexpt_node_t *src_node, mexpt_node_t *parent) {
+
+    mexpt_node_t *dst_node = (mexpt_node_t *)malloc (sizeof (mexpt_node_t));
+
+    memcpy (dst_node, src_node, sizeof (mexpt_node_t));
+    dst_node->parent = parent;
+    if (src_node->left) dst_node->left = mexprclone_node_by_node (src_node->left, dst_node);
+    if (src_node->right) dst_node->right = mexprclone_node_by_node (src_node->right, dst_node);
+    return dst_node;
+}
+
+static void
+mexprclone_node_by_node_free (mexpt_node_t *node) {
+
+    if (!node) return;
+    mexprclone_node_by_node_free (node->left);
+    mexprclone_node_by_node_free (node->right);
+    free (node);
+}
+
+/* Operands named name, found through the operand index */
+static int
+mexprclone_n_named (mexpt_tree_t *tree, const char *name) {
+
+    int n = 0;
+    mexpt_node_t *node = NULL;
+
+    while ((node = mexpt_tree_lookup_operand (tree, name, node))) n++;
+    return n;
+}
+
+static bool
+mexprclone_same (mexpt_tree_t *tree, mexpt_tree_t *clone, int n_nodes) {
+
+    mexpr_var_t res1, res2;
+
+    if (mexpt_count_nodes (clone->root) != n_nodes) return false;
+    if (clone->opd_index.n_opds != tree->opd_index.n_opds) return false;
+    if (mexprclone_n_named (clone, "d") != mexprclone_n_named (tree, "d")) return false;
+
+    res1 = mexpt_evaluate_shared (tree->root);
+    res2 = mexpt_evaluate_shared (clone->root);
+    return res1.dtype == res2.dtype && res1.u.b_val == res2.u.b_val;
+}
+
+/* Best ns per clone of src, and per destroy of the clones */
+static bool
+mexprclone_time (mexpt_tree_t *src,
+                           int n_nodes,
+                           int n_clones,
+                           double *t_clone,
+                           double *t_destroy) {
+
+    int r, i, done, batch;
+    double start, t_c, t_d;
+    mexpt_tree_t *clones[MEXPRCLONE_BATCH];
+
+    *t_clone = *t_destroy = INFINITY;
+
+    for (r = 0; r < MEXPRCLONE_REPEAT; r++) {
+
+        t_c = t_d = 0;
+
+        for (done = 0; done < n_clones; done += batch) {
+
+            batch = n_clones - done < MEXPRCLONE_BATCH ? n_clones - done : MEXPRCLONE_BATCH;
+
+            start = mexprclone_now ();
+            for (i = 0; i < batch; i++) {
+                clones[i] = mexpt_clone (src);
+            }
+            t_c += mexprclone_now () - start;
+
+            if (done == 0 && !mexprclone_same (src, clones[0], n_nodes)) return false;
+
+            start = mexprclone_now ();
+            for (i = 0; i < batch; i++) {
+                mexpt_tree_destroy (clones[i], false);
+            }
+            t_d += mexprclone_now () - start;
+        }
+
+        *t_clone = fmin (*t_clone, t_c / n_clones * 1e9);
+        *t_destroy = fmin (*t_destroy, t_d / n_clones * 1e9);
+    }
+    return true;
+}
+
+static double
+mexprclone_time_node_by_node (mexpt_tree_t *src, int n_clones) {
+
+    int r, i, done, batch;
+    double start, t, t_best = INFINITY;
+    mexpt_node_t *roots[MEXPRCLONE_BATCH];
+
+    for (r = 0; r < MEXPRCLONE_REPEAT; r++) {
+
+        t = 0;
+
+        for (done = 0; done < n_clones; done += batch) {
+
+            batch = n_clones - done < MEXPRCLONE_BATCH ? n_clones - done : MEXPRCLONE_BATCH;
+
+            start = mexprclone_now ();
+            for (i = 0; i < batch; i++) {
+                roots[i] = mexprclone_node_by_node (src->root, NULL);
+            }
+            t += mexprclone_now () - start;
+
+            for (i = 0; i < batch; i++) {
+                mexprclone_node_by_node_free (roots[i]);
+            }
+        }
+        t_best = fmin (t_best, t / n_clones * 1e9);
+    }
+    return t_best;
+}
+
+int
+main (int argc, char **argv) {
+
+    int i, n_nodes, n_clones;
+    long n_total = 2 * 1024 * 1024;
+    bool ok = true;
+    double t_walk, t_flat, t_nbn, t_destroy, t_unused;
+    mexpt_tree_t *tree;
+
+    if (argc > 2) {
+        printf ("Usage : %s [nodes per size]\n", argv[0]);
+        return 1;
+    }
+    if (argc > 1) n_total = atol (argv[1]);
+
+    mallopt (M_TRIM_THRESHOLD, 256 * 1024 * 1024);
+    mallopt (M_MMAP_THRESHOLD, 32 * 1024 * 1024);
+
+    parse_init ();
+
+    printf ("%ld nodes per size, ns per clone (per node)\n", n_total);
+    printf ("%6s  %7s  %18s  %18s  %6s  %18s  %9s\n", "nodes", "clones", "walk", "flat",
+                "x", "node by node", "destroy");
+
+    for (i = 0; i < (int)(sizeof (mexprclone_n_conjuncts) / sizeof (int)); i++) {
+
+        tree = mexprclone_build (mexprclone_n_conjuncts[i]);
+        if (!tree) return 1;
+
+        n_nodes = mexpt_count_nodes (tree->root);
+        n_clones = n_total / n_nodes > 0 ? n_total / n_nodes : 1;
+
+        if (!tree->is_flat) {
+            printf ("Error : Parser built a tree of %d nodes which is not flat\n", n_nodes);
+            ok = false;
+        }
+
+        if (!mexprclone_time (tree, n_nodes, n_clones, &t_flat, &t_destroy)) ok = false;
+
+        /* Walk path, as for a tree not in one pool */
+        tree->is_flat = false;
+        if (!mexprclone_time (tree, n_nodes, n_clones, &t_walk, &t_unused)) ok = false;
+        tree->is_flat = true;
+
+        if (!ok) {
+            printf ("Error : Clone of a tree of %d nodes differs from its source\n", n_nodes);
+        }
+        t_nbn = mexprclone_time_node_by_node (tree, n_clones);
+
+        printf ("%6d  %7d  %9.0f (%5.1f)  %9.0f (%5.1f)  %6.2f  %9.0f (%5.1f)  %9.0f\n",
+                    n_nodes, n_clones, t_walk, t_walk / n_nodes, t_flat, t_flat / n_nodes,
+                    t_walk / t_flat, t_nbn, t_nbn / n_nodes, t_destroy);
+
+        mexpt_tree_destroy (tree, false);
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,853 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <assert.h>
+#include <ctype.h>
+#include <math.h>
+#include <dlfcn.h>
+#include "MexprEnums.h"
+#include "MExpr.h"
+#include "MexprCodegen.h"
+
+/* ====================x================x=================== */
+/* Text Buffer */
+
+static void
+mexpr_codegen_buf_append (mexpr_codegen_buf_t *buf, const char *data, uint32_t len) {
+
+    if (buf->size + len + 1 > buf->max_size) {
+
+        uint32_t max_size = buf->max_size ? buf->max_size * 2 : 1024;
+        while (buf->size + len + 1 > max_size) max_size *= 2;
+        buf->data = (char *)realloc (buf->data, max_size);
+        buf->max_size = max_size;
+    }
+    memcpy (buf->data + buf->size, data, len);
+    buf->size += len;
+    buf->data[buf->size] = '\0';
+}
+
+static void
+mexpr_codegen_printf (mexpr_codegen_buf_t *buf, const char *fmt, ...) {
+
+    int len;
+    va_list ap;
+    char line[256];
+
+    va_start (ap, fmt);
+    len = vsnprintf (line, sizeof (line), fmt, ap);
+    va_end (ap);
+    assert (len >= 0);
+
+    if (len < (int)sizeof (line)) {
+        mexpr_codegen_buf_append (buf, line, len);
+        return;
+    }
+
+    /* Long line, reserve room and format again in place */
+    mexpr_codegen_buf_append (buf, "", 0);
+    if (buf->size + len + 1 > buf->max_size) {
+        buf->max_size = (buf->size + len + 1) * 2;
+        buf->data = (char *)realloc (buf->data, buf->max_size);
+    }
+    va_start (ap, fmt);
+    vsnprintf (buf->data + buf->size, len + 1, fmt, ap);
+    va_end (ap);
+    buf->size += len;
+}
+
+static void
+mexpr_codegen_buf_free (mexpr_codegen_buf_t *buf) {
+
+    free (buf->data);
+    memset (buf, 0, sizeof (*buf));
+}
+
+/* ====================x================x=================== */
+/* Code Generation */
+
+/* Per expression state, t<N> is the local holding the value of the N-th node
+    in post-order */
+typedef struct mexpr_codegen_ctx_ {
+
+    mexpr_codegen_t *cg;
+    mexpr_codegen_buf_t body;
+    int n_tmps;
+} mexpr_codegen_ctx_t;
+
+static const char *
+mexpr_codegen_ctype (mexpr_dtypes_t dtype) {
+
+    switch (dtype) {
+        case MEXPR_DTYPE_INT:
+            return "int64_t";
+        case MEXPR_DTYPE_BOOL:
+            return "int";
+        case MEXPR_DTYPE_DOUBLE:
+            return "double";
+        case MEXPR_DTYPE_STRING:
+            return "mexpr_gen_str_t";
+        default:
+            assert (0);
+            return NULL;
+    }
+}
+
+static const char *
+mexpr_codegen_union_field (mexpr_dtypes_t dtype) {
+
+    switch (dtype) {
+        case MEXPR_DTYPE_INT:
+            return "int_val";
+        case MEXPR_DTYPE_DOUBLE:
+            return "d_val";
+        case MEXPR_DTYPE_STRING:
+            return "str_val";
+        case MEXPR_DTYPE_BOOL:
+            return "b_val";
+        default:
+            assert (0);
+            return NULL;
+    }
+}
+
+static const char *
+mexpr_codegen_dtype_name (mexpr_dtypes_t dtype) {
+
+    switch (dtype) {
+        case MEXPR_DTYPE_INT:
+            return "int";
+        case MEXPR_DTYPE_DOUBLE:
+            return "double";
+        case MEXPR_DTYPE_STRING:
+            return "string";
+        case MEXPR_DTYPE_BOOL:
+            return "bool";
+        default:
+            return "invalid";
+    }
+}
+
+static bool
+mexpr_codegen_is_identifier (const char *name) {
+
+    int i;
+
+    if (!name[0] || !(isalpha ((unsigned char)name[0]) || name[0] == '_')) return false;
+
+    for (i = 1; name[i]; i++) {
+        if (!(isalnum ((unsigned char)name[i]) || name[i] == '_')) return false;
+    }
+    return i < MEXPR_TREE_OPERAND_LEN_MAX;
+}
+
+/* Names the lexer reads as operands, [a-zA-Z0-9_]+ or table.column : nothing
+    else can match an operand, and the name is safe in the row layout comment */
+static bool
+mexpr_codegen_is_column_name (const char *name) {
+
+    int i, n_dots = 0;
+
+    for (i = 0; name[i]; i++) {
+
+        if (isalnum ((unsigned char)name[i]) || name[i] == '_') continue;
+
+        if (name[i] != '.' || n_dots++ || i == 0 || !name[i + 1]) return false;
+    }
+    return i > 0 && i < MEXPR_TREE_OPERAND_LEN_MAX;
+}
+
+/* C string literal, non printable bytes as octal escapes */
+static void
+mexpr_codegen_emit_string_literal (mexpr_codegen_buf_t *buf, const unsigned char *str) {
+
+    char esc[8];
+
+    mexpr_codegen_buf_append (buf, "\"", 1);
+
+    for (; *str; str++) {
+
+        if (*str == '"' || *str == '\\') {
+            esc[0] = '\\';
+            esc[1] = *str;
+            mexpr_codegen_buf_append (buf, esc, 2);
+        }
+        else if (isprint (*str)) {
+            mexpr_codegen_buf_append (buf, (const char *)str, 1);
+        }
+        else {
+            snprintf (esc, sizeof (esc), "\\%03o", *str);
+            mexpr_codegen_buf_append (buf, esc, 4);
+        }
+    }
+
+    mexpr_codegen_buf_append (buf, "\"", 1);
+}
+
+/* double t<tmp> = val, folded constants may be inf or nan which %.17g prints
+    as no C literal */
+static void
+mexpr_codegen_emit_double (mexpr_codegen_buf_t *buf, int tmp, double val) {
+
+    if (val != val) {
+        mexpr_codegen_printf (buf, "    double t%d = %sNAN;\n", tmp, signbit (val) ? "-" : "");
+    }
+    else if (isinf (val)) {
+        mexpr_codegen_printf (buf, "    double t%d = %sHUGE_VAL;\n", tmp, val < 0 ? "-" : "");
+    }
+    else {
+        mexpr_codegen_printf (buf, "    double t%d = %.17g;\n", tmp, val);
+    }
+}
+
+/* Operand t<tmp> of dtype, converted to double as MexprDb kernels do */
+static void
+mexpr_codegen_emit_as_double (mexpr_codegen_buf_t *buf, int tmp, mexpr_dtypes_t dtype) {
+
+    if (dtype == MEXPR_DTYPE_INT) {
+        mexpr_codegen_printf (buf, "(double)t%d", tmp);
+    }
+    else {
+        mexpr_codegen_printf (buf, "t%d", tmp);
+    }
+}
+
+static bool
+mexpr_codegen_emit_leaf (mexpr_codegen_ctx_t *ctx,
+                                          mexpt_node_t *node,
+                                          int tmp,
+                                          mexpr_dtypes_t *dtype) {
+
+    int i;
+    mexpr_codegen_t *cg = ctx->cg;
+    mexpr_codegen_buf_t *body = &ctx->body;
+
+    switch (node->token_code) {
+
+        case MATH_IDENTIFIER:
+        case MATH_IDENTIFIER_IDENTIFIER:
+            for (i = 0; i < cg->n_cols; i++) {
+                if (strcmp ((char *)node->u.opd_node.opd_value.variable_name,
+                                cg->cols[i].name) == 0) break;
+            }
+            if (i == cg->n_cols) {
+                printf ("Error : Codegen : Operand %s is not a column\n",
+                            node->u.opd_node.opd_value.variable_name);
+                return false;
+            }
+            *dtype = cg->cols[i].dtype;
+            if (*dtype == MEXPR_DTYPE_STRING) {
+                mexpr_codegen_printf (body,
+                    "    mexpr_gen_str_t t%d = {(const char *)row[%d].u.str_val, "
+                    "row[%d].str_len, row[%d].str_interned};\n",
+                    tmp, i, i, i);
+            }
+            else {
+                mexpr_codegen_printf (body, "    %s t%d = row[%d].u.%s;\n",
+                                                    mexpr_codegen_ctype (*dtype), tmp, i,
+                                                    mexpr_codegen_union_field (*dtype));
+            }
+            return true;
+        case MATH_INTEGER_VALUE:
+            *dtype = MEXPR_DTYPE_INT;
+            /* -9223372036854775808 is not a C literal, but negation of one */
+            if (node->u.opd_node.opd_value.int_val == INT64_MIN) {
+                mexpr_codegen_printf (body, "    int64_t t%d = INT64_MIN;\n", tmp);
+                return true;
+            }
+            mexpr_codegen_printf (body, "    int64_t t%d = %lldLL;\n",
+                                                tmp, (long long)node->u.opd_node.opd_value.int_val);
+            return true;
+        case MATH_DOUBLE_VALUE:
+            *dtype = MEXPR_DTYPE_DOUBLE;
+            mexpr_codegen_emit_double (body, tmp, node->u.opd_node.opd_value.math_val);
+            return true;
+        case MATH_STRING_VALUE:
+            *dtype = MEXPR_DTYPE_STRING;
+            mexpr_codegen_printf (body, "    mexpr_gen_str_t t%d = {", tmp);
+            mexpr_codegen_emit_string_literal (body, node->u.opd_node.opd_value.string_name);
+            mexpr_codegen_printf (body, ", %u, 0};\n", node->u.opd_node.str_len);
+            return true;
+        default:
+            break;
+    }
+
+    /* Optimized Ineq or Logical node */
+    if (Math_is_ineq_operator (node->token_code)) {
+        *dtype = MEXPR_DTYPE_BOOL;
+        mexpr_codegen_printf (body, "    int t%d = %d;\n", tmp, node->u.ineq_node.result ? 1 : 0);
+        return true;
+    }
+    if (Math_is_logical_operator (node->token_code)) {
+        *dtype = MEXPR_DTYPE_BOOL;
+        mexpr_codegen_printf (body, "    int t%d = %d;\n", tmp, node->u.log_op_node.result ? 1 : 0);
+        return true;
+    }
+
+    printf ("Error : Codegen : Unexpected leaf, token code %d\n", node->token_code);
+    return false;
+}
+
+/* Test of mexpr_gen_cmp_int_double( ) result for the Ineq operator */
+static const char *
+mexpr_codegen_cmp_test (int opr) {
+
+    switch (opr) {
+        case MATH_LESS_THAN_EQ: return "<= 0";
+        case MATH_LESS_THAN:    return "< 0";
+        case MATH_GREATER_THAN: return "== 1";
+        case MATH_EQ:           return "== 0";
+        default:                return "!= 0";
+    }
+}
+
+/* Checked builtin of int op int, NULL if it cannot overflow */
+static const char *
+mexpr_codegen_overflow_builtin (int opr) {
+
+    switch (opr) {
+        case MATH_PLUS:     return "__builtin_add_overflow";
+        case MATH_MINUS:    return "__builtin_sub_overflow";
+        case MATH_MUL:
+        case MATH_SQR:      return "__builtin_mul_overflow";
+        default:            return NULL;
+    }
+}
+
+/* Right hand side of t<tmp> = ..., the same formula as the MexprDb kernel for the
+    operand dtypes. For unary operators r == l and rd == ld */
+static bool
+mexpr_codegen_emit_opr (mexpr_codegen_buf_t *body,
+                                          int opr,
+                                          int l, mexpr_dtypes_t ld,
+                                          int r, mexpr_dtypes_t rd) {
+
+    bool ints = (ld == MEXPR_DTYPE_INT && rd == MEXPR_DTYPE_INT);
+    bool strs = (ld == MEXPR_DTYPE_STRING && rd == MEXPR_DTYPE_STRING);
+    const char *c_opr = NULL;
+
+    switch (opr) {
+
+        case MATH_LESS_THAN_EQ: c_opr = "<="; break;
+        case MATH_LESS_THAN:    c_opr = "<";  break;
+        case MATH_GREATER_THAN: c_opr = ">";  break;
+        case MATH_EQ:           c_opr = "=="; break;
+        case MATH_NOT_EQ:       c_opr = "!="; break;
+        case MATH_OR:           c_opr = "||"; break;
+        case MATH_AND:          c_opr = "&&"; break;
+        case MATH_MUL:          c_opr = "*";  break;
+        case MATH_PLUS:         c_opr = "+";  break;
+        case MATH_MINUS:        c_opr = "-";  break;
+        default:                break;
+    }
+
+    switch (opr) {
+
+        case MATH_EQ:
+        case MATH_NOT_EQ:
+            if (strs) {
+                mexpr_codegen_printf (body, "%smexpr_gen_str_eq (t%d, t%d)",
+                                                    opr == MATH_EQ ? "" : "!", l, r);
+                return true;
+            }
+            /* fall through */
+        case MATH_LESS_THAN_EQ:
+        case MATH_LESS_THAN:
+        case MATH_GREATER_THAN:
+            if (ints) {
+                mexpr_codegen_printf (body, "t%d %s t%d", l, c_opr, r);
+                return true;
+            }
+            /* Exact, as MexprDb compares int with double */
+            if (ld == MEXPR_DTYPE_INT && rd == MEXPR_DTYPE_DOUBLE) {
+                mexpr_codegen_printf (body, "mexpr_gen_cmp_int_double (t%d, t%d) %s",
+                                                    l, r, mexpr_codegen_cmp_test (opr));
+                return true;
+            }
+            if (ld == MEXPR_DTYPE_DOUBLE && rd == MEXPR_DTYPE_INT) {
+                mexpr_codegen_printf (body, "mexpr_gen_cmp_double_int (t%d, t%d) %s",
+                                                    l, r, mexpr_codegen_cmp_test (opr));
+                return true;
+            }
+            /* fall through */
+        case MATH_MUL:
+        case MATH_MINUS:
+            mexpr_codegen_emit_as_double (body, l, ld);
+            mexpr_codegen_printf (body, " %s ", c_opr);
+            mexpr_codegen_emit_as_double (body, r, rd);
+            return true;
+        case MATH_OR:
+        case MATH_AND:
+            mexpr_codegen_printf (body, "t%d %s t%d", l, c_opr, r);
+            return true;
+        case MATH_PLUS:
+            if (strs) {
+                mexpr_codegen_printf (body, "mexpr_gen_str_cat (&s%d, t%d, t%d, &ok)", l, l, r);
+                return true;
+            }
+            if (ints) {
+                mexpr_codegen_printf (body, "t%d + t%d", l, r);
+                return true;
+            }
+            mexpr_codegen_emit_as_double (body, l, ld);
+            mexpr_codegen_printf (body, " + ");
+            mexpr_codegen_emit_as_double (body, r, rd);
+            return true;
+        case MATH_DIV:
+            if (ints) {
+                /* No UB on rows which are not ok : x / 0 and INT64_MIN / -1 */
+                mexpr_codegen_printf (body,
+                    "t%d == 0 ? 0 : (t%d == -1 ? (int64_t)(0 - (uint64_t)t%d) : t%d / t%d)",
+                    r, r, l, l, r);
+                return true;
+            }
+            mexpr_codegen_emit_as_double (body, l, ld);
+            mexpr_codegen_printf (body, " / ");
+            mexpr_codegen_emit_as_double (body, r, rd);
+            return true;
+        case MATH_SQR:
+            mexpr_codegen_printf (body, "t%d * t%d", l, l);
+            return true;
+        case MATH_SQRT:
+        case MATH_SIN:
+        case MATH_COS:
+            mexpr_codegen_printf (body, "%s (",
+                opr == MATH_SQRT ? "sqrt" : (opr == MATH_SIN ? "sin" : "cos"));
+            mexpr_codegen_emit_as_double (body, l, ld);
+            mexpr_codegen_printf (body, ")");
+            return true;
+        case MATH_POW:
+            if (ld == MEXPR_DTYPE_STRING || rd == MEXPR_DTYPE_STRING) return false;
+            mexpr_codegen_printf (body, "pow (");
+            mexpr_codegen_emit_as_double (body, l, ld);
+            mexpr_codegen_printf (body, ", ");
+            mexpr_codegen_emit_as_double (body, r, rd);
+            mexpr_codegen_printf (body, ")");
+            return true;
+        case MATH_MAX:
+        case MATH_MIN:
+            c_opr = (opr == MATH_MAX) ? ">" : "<";
+            if (strs) {
+                mexpr_codegen_printf (body, "t%d.len %s t%d.len ? t%d : t%d",
+                                                    l, c_opr, r, l, r);
+                return true;
+            }
+            if (ints) {
+                mexpr_codegen_printf (body, "t%d %s t%d ? t%d : t%d", l, c_opr, r, l, r);
+                return true;
+            }
+            mexpr_codegen_emit_as_double (body, l, ld);
+            mexpr_codegen_printf (body, " %s ", c_opr);
+            mexpr_codegen_emit_as_double (body, r, rd);
+            mexpr_codegen_printf (body, " ? ");
+            mexpr_codegen_emit_as_double (body, l, ld);
+            mexpr_codegen_printf (body, " : ");
+            mexpr_codegen_emit_as_double (body, r, rd);
+            return true;
+        default:
+            return false;
+    }
+}
+
+/* Emits the statements of the subtree, returns the local holding its value
+    in *tmp and its dtype in *dtype */
+static bool
+mexpr_codegen_emit_node (mexpr_codegen_ctx_t *ctx,
+                                           mexpt_node_t *node,
+                                           int *tmp,
+                                           mexpr_dtypes_t *dtype) {
+
+    int l, r;
+    mexpr_dtypes_t ld, rd;
+    mexpr_codegen_buf_t *body = &ctx->body;
+
+    if (!node->left && !node->right) {
+        *tmp = ctx->n_tmps++;
+        return mexpr_codegen_emit_leaf (ctx, node, *tmp, dtype);
+    }
+
+    if (!mexpr_codegen_emit_node (ctx, node->left, &l, &ld)) return false;
+
+    if (node->right) {
+        if (!mexpr_codegen_emit_node (ctx, node->right, &r, &rd)) return false;
+    }
+    else {
+        /* Unary operators are applied as MexprDb[opr][ld][ld] */
+        r = l;
+        rd = ld;
+    }
+
+    *dtype = mexpt_opr_result_dtype (node->token_code, ld, rd);
+
+    if (*dtype == MEXPR_DTYPE_INVALID) {
+        printf ("Error : Codegen : Operator %d not supported on (%s, %s)\n",
+                    node->token_code,
+                    mexpr_codegen_dtype_name (ld), mexpr_codegen_dtype_name (rd));
+        return false;
+    }
+
+    *tmp = ctx->n_tmps++;
+
+    if (node->token_code == MATH_PLUS && *dtype == MEXPR_DTYPE_STRING) {
+        /* l is the local of the left operand, buffer is named after it */
+        mexpr_codegen_printf (body, "    static __thread mexpr_gen_buf_t s%d;\n", l);
+    }
+
+    if (node->token_code == MATH_DIV && *dtype == MEXPR_DTYPE_INT) {
+        mexpr_codegen_printf (body, "    ok &= (t%d != 0 && !(t%d == INT64_MIN && t%d == -1));\n",
+                                            r, l, r);
+    }
+    else if (node->token_code == MATH_DIV) {
+        mexpr_codegen_printf (body, "    ok &= (");
+        mexpr_codegen_emit_as_double (body, r, rd);
+        mexpr_codegen_printf (body, " != 0);\n");
+    }
+
+    /* int + - * int and sqr int fail on overflow, as in MexprDb */
+    if (*dtype == MEXPR_DTYPE_INT && ld == MEXPR_DTYPE_INT && rd == MEXPR_DTYPE_INT &&
+            mexpr_codegen_overflow_builtin (node->token_code)) {
+        mexpr_codegen_printf (body, "    int64_t t%d;\n    ok &= !%s (t%d, t%d, &t%d);\n",
+                                            *tmp, mexpr_codegen_overflow_builtin (node->token_code),
+                                            l, r, *tmp);
+        return true;
+    }
+
+    mexpr_codegen_printf (body, "    %s t%d = ", mexpr_codegen_ctype (*dtype), *tmp);
+
+    if (!mexpr_codegen_emit_opr (body, node->token_code, l, ld, r, rd)) {
+        printf ("Error : Codegen : Operator %d not supported on (%s, %s)\n",
+                    node->token_code,
+                    mexpr_codegen_dtype_name (ld), mexpr_codegen_dtype_name (rd));
+        return false;
+    }
+
+    mexpr_codegen_printf (body, ";\n");
+    return true;
+}
+
+/* ====================x================x=================== */
+/* Public API */
+
+mexpr_codegen_t *
+mexpr_codegen_create (void) {
+
+    return (mexpr_codegen_t *)calloc (1, sizeof (mexpr_codegen_t));
+}
+
+bool
+mexpr_codegen_add_column (mexpr_codegen_t *cg, const char *name, mexpr_dtypes_t dtype) {
+
+    int i;
+
+    if (dtype >= MEXPR_DTYPE_MAX) {
+        printf ("Error : Codegen : Column %s has invalid dtype\n", name);
+        return false;
+    }
+
+    if (!mexpr_codegen_is_column_name (name)) {
+        printf ("Error : Codegen : %s is not a valid column name\n", name);
+        return false;
+    }
+
+    for (i = 0; i < cg->n_cols; i++) {
+        if (strcmp (cg->cols[i].name, name) == 0) {
+            printf ("Error : Codegen : Duplicate column %s\n", name);
+            return false;
+        }
+    }
+
+    if (cg->n_cols == cg->max_cols) {
+        cg->max_cols = cg->max_cols ? cg->max_cols * 2 : 8;
+        cg->cols = (mexpr_codegen_col_t *)realloc (cg->cols,
+                            cg->max_cols * sizeof (mexpr_codegen_col_t));
+    }
+
+    strcpy (cg->cols[cg->n_cols].name, name);
+    cg->cols[cg->n_cols].dtype = dtype;
+    cg->n_cols++;
+    return true;
+}
+
+bool
+mexpr_codegen_add_expression (mexpr_codegen_t *cg,
+                                                 const char *fn_name,
+                                                 mexpt_tree_t *tree) {
+
+    int tmp;
+    uint32_t off;
+    mexpr_dtypes_t dtype;
+    mexpr_codegen_ctx_t ctx;
+
+    if (!mexpr_codegen_is_identifier (fn_name)) {
+        printf ("Error : Codegen : %s is not a valid function name\n", fn_name);
+        return false;
+    }
+
+    for (off = 0; off < cg->names.size; off += strlen (cg->names.data + off) + 1) {
+        if (strcmp (cg->names.data + off, fn_name) == 0) {
+            printf ("Error : Codegen : Duplicate expression %s\n", fn_name);
+            return false;
+        }
+    }
+
+    if (!tree->root) return false;
+
+    memset (&ctx, 0, sizeof (ctx));
+    ctx.cg = cg;
+
+    if (!mexpr_codegen_emit_node (&ctx, tree->root, &tmp, &dtype)) {
+        mexpr_codegen_buf_free (&ctx.body);
+        return false;
+    }
+
+    mexpr_codegen_printf (&cg->src,
+        "static inline mexpr_var_t\n%s_eval (const mexpr_var_t *row) {\n\n"
+        "    int ok = 1;\n", fn_name);
+    mexpr_codegen_buf_append (&cg->src, ctx.body.data, ctx.body.size);
+    mexpr_codegen_printf (&cg->src,
+        "    mexpr_var_t res;\n"
+        "    res.dtype = ok ? %d : %d;\n", dtype, MEXPR_DTYPE_INVALID);
+
+    if (dtype == MEXPR_DTYPE_STRING) {
+        mexpr_codegen_printf (&cg->src, "    res.str_len = t%d.len;\n", tmp);
+        mexpr_codegen_printf (&cg->src, "    res.str_interned = t%d.interned;\n", tmp);
+        mexpr_codegen_printf (&cg->src, "    res.u.str_val = (unsigned char *)t%d.ptr;\n", tmp);
+    }
+    else {
+        mexpr_codegen_printf (&cg->src, "    res.u.%s = t%d;\n",
+                                            mexpr_codegen_union_field (dtype), tmp);
+    }
+
+    mexpr_codegen_printf (&cg->src,
+        "    return res;\n}\n\n"
+        "mexpr_var_t\n%s (const mexpr_var_t *row) {\n\n"
+        "    return %s_eval (row);\n}\n\n"
+        "void\n%s_batch (const mexpr_var_t *rows, uint64_t n_rows, mexpr_var_t *out) {\n\n"
+        "    uint64_t i;\n"
+        "    for (i = 0; i < n_rows; i++) out[i] = %s_eval (rows + i * MEXPR_GEN_N_COLS);\n"
+        "}\n\n",
+        fn_name, fn_name, fn_name, fn_name);
+
+    mexpr_codegen_buf_append (&cg->names, fn_name, strlen (fn_name) + 1);
+    cg->n_exprs++;
+    mexpr_codegen_buf_free (&ctx.body);
+    return true;
+}
+
+bool
+mexpr_codegen_write_source (mexpr_codegen_t *cg, FILE *fp) {
+
+    int i;
+    mexpr_codegen_buf_t hdr;
+
+    memset (&hdr, 0, sizeof (hdr));
+
+    /* Self contained : mexpr_var_t is redeclared with the same layout as in
+        MexprEnums.h so that the source builds without this library's headers */
+    mexpr_codegen_printf (&hdr,
+        "/* Generated by MexprCodegen, do not edit */\n\n"
+        "#include <stdint.h>\n#include <stdbool.h>\n#include <stdio.h>\n"
+        "#include <stdlib.h>\n#include <string.h>\n#include <math.h>\n\n"
+        "typedef struct mexpr_var {\n\n"
+        "    int dtype;\n"
+        "    uint32_t str_len : 31;\n"
+        "    uint32_t str_interned : 1;\n\n"
+        "    union {\n\n"
+        "        int64_t int_val;\n"
+        "        double d_val;\n"
+        "        unsigned char *str_val;\n"
+        "        bool b_val;\n\n"
+        "    } u;\n"
+        "} mexpr_var_t;\n\n"
+        "/* Exact int and double comparison of MexprDb, 2 if unordered */\n"
+        "static inline int\n"
+        "mexpr_gen_cmp_int_double (int64_t i, double d) {\n\n"
+        "    int64_t d_int;\n"
+        "    double d_frac;\n\n"
+        "    if (d != d) return 2;\n"
+        "    if (d >= 9223372036854775808.0) return -1;\n"
+        "    if (d < -9223372036854775808.0) return 1;\n"
+        "    d_int = (int64_t)d;\n"
+        "    if (i != d_int) return i < d_int ? -1 : 1;\n"
+        "    d_frac = d - (double)d_int;\n"
+        "    if (d_frac == 0) return 0;\n"
+        "    return d_frac > 0 ? -1 : 1;\n"
+        "}\n\n"
+        "static inline int\n"
+        "mexpr_gen_cmp_double_int (double d, int64_t i) {\n\n"
+        "    int cmp = mexpr_gen_cmp_int_double (i, d);\n\n"
+        "    return cmp == 2 ? cmp : -cmp;\n"
+        "}\n\n"
+        "/* Strings are views, as in MexprDb */\n"
+        "typedef struct mexpr_gen_str {\n\n"
+        "    const char *ptr;\n"
+        "    uint32_t len;\n"
+        "    uint32_t interned;\n"
+        "} mexpr_gen_str_t;\n\n"
+        "typedef struct mexpr_gen_buf {\n\n"
+        "    char *data;\n"
+        "    uint32_t size;\n"
+        "} mexpr_gen_buf_t;\n\n"
+        "static inline int\n"
+        "mexpr_gen_str_eq (mexpr_gen_str_t l, mexpr_gen_str_t r) {\n\n"
+        "    if (l.ptr == r.ptr) return l.len == r.len;\n"
+        "    if (l.interned && r.interned) return 0;\n"
+        "    return l.len == r.len && memcmp (l.ptr, r.ptr, l.len) == 0;\n"
+        "}\n\n"
+        "#define MEXPR_GEN_STR_LEN_MAX %uU\n\n"
+        "/* Into the buffer of the node, grown as needed and reused. Fails the row\n"
+        "    past MEXPR_GEN_STR_LEN_MAX, as MexprDb does */\n"
+        "static inline mexpr_gen_str_t\n"
+        "mexpr_gen_str_cat (mexpr_gen_buf_t *buf, mexpr_gen_str_t l, mexpr_gen_str_t r,\n"
+        "                            int *ok) {\n\n"
+        "    mexpr_gen_str_t res;\n"
+        "    uint32_t len = l.len + r.len;\n\n"
+        "    res.ptr = \"\";\n"
+        "    res.len = 0;\n"
+        "    res.interned = 0;\n"
+        "    if (len > MEXPR_GEN_STR_LEN_MAX) {\n"
+        "        *ok = 0;\n"
+        "        return res;\n"
+        "    }\n"
+        "    if (len + 1 > buf->size) {\n"
+        "        buf->size = (len + 1) * 2;\n"
+        "        buf->data = (char *)realloc (buf->data, buf->size);\n"
+        "    }\n"
+        "    memcpy (buf->data, l.ptr, l.len);\n"
+        "    memcpy (buf->data + l.len, r.ptr, r.len);\n"
+        "    buf->data[len] = '\\0';\n"
+        "    res.ptr = buf->data;\n"
+        "    res.len = len;\n"
+        "    return res;\n"
+        "}\n\n"
+        "#define MEXPR_GEN_N_COLS %d\n\n"
+        "const int mexpr_gen_n_cols = MEXPR_GEN_N_COLS;\n\n", MEXPR_STR_LEN_MAX, cg->n_cols);
+
+    mexpr_codegen_printf (&hdr, "/* Row layout :\n");
+    for (i = 0; i < cg->n_cols; i++) {
+        mexpr_codegen_printf (&hdr, "    row[%d]  %s  %s\n", i,
+                                            cg->cols[i].name,
+                                            mexpr_codegen_dtype_name (cg->cols[i].dtype));
+    }
+    mexpr_codegen_printf (&hdr, "*/\n\n");
+
+    if (fwrite (hdr.data, 1, hdr.size, fp) != hdr.size ||
+         (cg->src.size && fwrite (cg->src.data, 1, cg->src.size, fp) != cg->src.size)) {
+        printf ("Error : Codegen : Could not write generated source\n");
+        mexpr_codegen_buf_free (&hdr);
+        return false;
+    }
+
+    mexpr_codegen_buf_free (&hdr);
+    return true;
+}
+
+bool
+mexpr_codegen_build (mexpr_codegen_t *cg, const char *so_path) {
+
+    FILE *fp;
+    int rc;
+    char *cmd;
+    char c_path[512];
+    const char *cc = getenv ("CC");
+
+    if (!cc || !cc[0]) cc = MEXPR_CODEGEN_CC;
+
+    if (strchr (so_path, '\'') || strchr (cc, '\'')) {
+        printf ("Error : Codegen : Quote in path %s\n", so_path);
+        return false;
+    }
+
+    if (snprintf (c_path, sizeof (c_path), "%s.c", so_path) >= (int)sizeof (c_path)) {
+        printf ("Error : Codegen : Path %s too long\n", so_path);
+        return false;
+    }
+
+    fp = fopen (c_path, "w");
+    if (!fp) {
+        printf ("Error : Codegen : Could not open %s\n", c_path);
+        return false;
+    }
+
+    if (!mexpr_codegen_write_source (cg, fp)) {
+        fclose (fp);
+        return false;
+    }
+
+    if (fclose (fp) != 0) {
+        printf ("Error : Codegen : Could not write %s\n", c_path);
+        return false;
+    }
+
+    cmd = (char *)malloc (strlen (cc) + strlen (MEXPR_CODEGEN_CFLAGS) + strlen (so_path) +
+                                    strlen (c_path) + 32);
+    sprintf (cmd, "%s %s -o '%s' '%s' -lm", cc, MEXPR_CODEGEN_CFLAGS, so_path, c_path);
+    rc = system (cmd);
+
+    if (rc != 0) {
+        printf ("Error : Codegen : '%s' failed\n", cmd);
+        free (cmd);
+        return false;
+    }
+
+    free (cmd);
+    return true;
+}
+
+void
+mexpr_codegen_free (mexpr_codegen_t *cg) {
+
+    free (cg->cols);
+    mexpr_codegen_buf_free (&cg->src);
+    mexpr_codegen_buf_free (&cg->names);
+    free (cg);
+}
+
+mexpr_codegen_lib_t *
+mexpr_codegen_load (const char *so_path) {
+
+    void *handle;
+    const int *n_cols;
+    mexpr_codegen_lib_t *lib;
+
+    handle = dlopen (so_path, RTLD_NOW | RTLD_LOCAL);
+    if (!handle) {
+        printf ("Error : Codegen : %s\n", dlerror ());
+        return NULL;
+    }
+
+    n_cols = (const int *)dlsym (handle, "mexpr_gen_n_cols");
+    if (!n_cols) {
+        printf ("Error : Codegen : %s is not a generated expression set\n", so_path);
+        dlclose (handle);
+        return NULL;
+    }
+
+    lib = (mexpr_codegen_lib_t *)calloc (1, sizeof (mexpr_codegen_lib_t));
+    lib->handle = handle;
+    lib->n_cols = *n_cols;
+    return lib;
+}
+
+mexpr_codegen_row_fn_t
+mexpr_codegen_lookup (mexpr_codegen_lib_t *lib, const char *fn_name) {
+
+    return (mexpr_codegen_row_fn_t)dlsym (lib->handle, fn_name);
+}
+
+mexpr_codegen_batch_fn_t
+mexpr_codegen_lookup_batch (mexpr_codegen_lib_t *lib, const char *fn_name) {
+
+    char name[MEXPR_TREE_OPERAND_LEN_MAX + 8];
+
+    snprintf (name, sizeof (name), "%s_batch", fn_name);
+    return (mexpr_codegen_batch_fn_t)dlsym (lib->handle, name);
+}
+
+void
+mexpr_codegen_unload (mexpr_codegen_lib_t *lib) {
+
+    dlclose (lib->handle);
+    free (lib);
+}
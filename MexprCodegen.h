@@ -0,0 +1,120 @@
+#ifndef __MEXPR_CODEGEN__
+#define __MEXPR_CODEGEN__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "MExpr.h"
+
+/* Ahead of Time C Code Generation for Expression Sets
+
+    For rule sets which rarely change, Appln can turn its expression trees into C
+    source once, build it into a shared object with the system compiler and load
+    it with dlopen( ) instead of walking trees with mexpt_evaluate( ).
+
+    1. mexpr_codegen_create( ), declare the row layout with
+        mexpr_codegen_add_column( ) : row[i] of every evaluation is a mexpr_var_t
+        holding the value of column i, and must be of the declared dtype.
+    2. mexpr_codegen_add_expression( ) for every tree of the set. Operands are
+        bound to columns by name, dtypes are checked against MexprDb at this point.
+    3. mexpr_codegen_build( ) writes <so_path>.c and compiles it into so_path.
+        mexpr_codegen_write_source( ) gives the source only.
+    4. mexpr_codegen_load( ), then mexpr_codegen_lookup( ) and
+        mexpr_codegen_lookup_batch( ) by expression name.
+
+    For each expression <name> the shared object exports :
+
+    mexpr_var_t <name> (const mexpr_var_t *row);
+    void <name>_batch (const mexpr_var_t *rows, uint64_t n_rows, mexpr_var_t *out);
+
+    Generated code is typed and straight line : every node is one C statement on a
+    local of the node's dtype, a zero divisor or an integer overflow clears a
+    validity flag instead of branching. Results, including the dtype and
+    MEXPR_DTYPE_INVALID on divide by zero and overflow, are the ones
+    mexpt_evaluate( ) gives when operand callbacks return values of the column
+    dtypes. Strings are views (str_val, str_len) as in MexprDb. string + string
+    is built in a per thread buffer of the node, valid until the next evaluation
+    of the expression on that thread.
+*/
+
+/* Default compiler, overridden by $CC. sin, cos and pow stay libm calls :
+    compilers fold pow (x, 2.0) into x * x and constant arguments at build
+    time, which differ from libm in the last bit */
+#define MEXPR_CODEGEN_CC    "cc"
+#define MEXPR_CODEGEN_CFLAGS    "-O2 -fPIC -shared -fwrapv " \
+                                                "-fno-builtin-sin -fno-builtin-cos -fno-builtin-pow"
+
+typedef struct mexpr_codegen_col_ {
+
+    char name[MEXPR_TREE_OPERAND_LEN_MAX];
+    mexpr_dtypes_t dtype;
+} mexpr_codegen_col_t;
+
+typedef struct mexpr_codegen_buf_ {
+
+    char *data;
+    uint32_t size;
+    uint32_t max_size;
+} mexpr_codegen_buf_t;
+
+typedef struct mexpr_codegen_ {
+
+    mexpr_codegen_col_t *cols;
+    int n_cols;
+    int max_cols;
+
+    /* Generated functions of all expressions added so far */
+    mexpr_codegen_buf_t src;
+
+    /* Names of the expressions, each '\0' terminated */
+    mexpr_codegen_buf_t names;
+    int n_exprs;
+} mexpr_codegen_t;
+
+typedef mexpr_var_t (*mexpr_codegen_row_fn_t) (const mexpr_var_t *row);
+typedef void (*mexpr_codegen_batch_fn_t) (const mexpr_var_t *rows,
+                                                                  uint64_t n_rows,
+                                                                  mexpr_var_t *out);
+
+typedef struct mexpr_codegen_lib_ {
+
+    void *handle;
+    int n_cols;
+} mexpr_codegen_lib_t;
+
+mexpr_codegen_t *
+mexpr_codegen_create (void);
+
+/* name must read as an operand : [a-zA-Z0-9_]+ or table.column */
+bool
+mexpr_codegen_add_column (mexpr_codegen_t *cg, const char *name, mexpr_dtypes_t dtype);
+
+/* fn_name must be a C identifier, unique in the set */
+bool
+mexpr_codegen_add_expression (mexpr_codegen_t *cg,
+                                                 const char *fn_name,
+                                                 mexpt_tree_t *tree);
+
+bool
+mexpr_codegen_write_source (mexpr_codegen_t *cg, FILE *fp);
+
+bool
+mexpr_codegen_build (mexpr_codegen_t *cg, const char *so_path);
+
+void
+mexpr_codegen_free (mexpr_codegen_t *cg);
+
+mexpr_codegen_lib_t *
+mexpr_codegen_load (const char *so_path);
+
+mexpr_codegen_row_fn_t
+mexpr_codegen_lookup (mexpr_codegen_lib_t *lib, const char *fn_name);
+
+mexpr_codegen_batch_fn_t
+mexpr_codegen_lookup_batch (mexpr_codegen_lib_t *lib, const char *fn_name);
+
+void
+mexpr_codegen_unload (mexpr_codegen_lib_t *lib);
+
+#endif
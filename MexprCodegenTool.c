@@ -0,0 +1,412 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <time.h>
+#include "UserParserL.h"
+#include "ParserMexpr.h"
+#include "MexprEnums.h"
+#include "MexprCodegen.h"
+
+/* Builds an expression file into a shared object, see MexprCodegen.h
+
+    Usage : mexprcc [-bench <rows>] <expression file> <output .so>
+
+    Expression file, one declaration per line, '#' starts a comment line :
+
+        column <name> int|double|string|bool
+        <function name> : <expression>
+
+    Columns define the row layout in the order they are declared, and must be
+    declared before the expressions using them.
+
+    With -bench, the shared object is then loaded and every expression is
+    evaluated on rows random rows by mexpt_evaluate( ) on its optimized tree,
+    by the generated row function and by the generated batch function.
+    Prints the number of rows on which results differ, ns per row of the three,
+    best of MEXPRCC_REPEAT runs, and the speedup over mexpt_evaluate( ). String
+    results of the batch function share one buffer, they are checked through
+    the row function only. Int columns are in [1, 1000], rows on which MexprDb
+    fails are reported by MexprDb on every run.
+*/
+
+#define MEXPRCC_REPEAT      3
+
+typedef struct mexprcc_bench_expr_ {
+
+    char *fn_name;
+    mexpt_tree_t *tree;
+} mexprcc_bench_expr_t;
+
+static mexprcc_bench_expr_t *mexprcc_bench_exprs;
+static int mexprcc_n_bench_exprs;
+
+static const char *mexprcc_bench_strs[] = {"abc", "xyz", "hello", "", "a b c", "abcabc"};
+
+/* Row read by operand callbacks of mexpt_evaluate( ) */
+static const mexpr_var_t *mexprcc_row;
+
+static char *
+mexprcc_trim (char *str) {
+
+    char *end;
+
+    while (isspace ((unsigned char)*str)) str++;
+    end = str + strlen (str);
+    while (end > str && isspace ((unsigned char)end[-1])) end--;
+    *end = '\0';
+    return str;
+}
+
+static bool
+mexprcc_dtype_from_name (const char *name, mexpr_dtypes_t *dtype) {
+
+    if (strcmp (name, "int") == 0) *dtype = MEXPR_DTYPE_INT;
+    else if (strcmp (name, "double") == 0) *dtype = MEXPR_DTYPE_DOUBLE;
+    else if (strcmp (name, "string") == 0) *dtype = MEXPR_DTYPE_STRING;
+    else if (strcmp (name, "bool") == 0) *dtype = MEXPR_DTYPE_BOOL;
+    else return false;
+    return true;
+}
+
+/* Returns the tree of the expression, NULL if not compiled */
+static mexpt_tree_t *
+mexprcc_add_expression (mexpr_codegen_t *cg, const char *fn_name, const char *expr) {
+
+    mexpt_tree_t *tree;
+
+    if (strlen (expr) >= MAX_STRING_SIZE) {
+        printf ("Error : Expression %s is too long\n", fn_name);
+        return NULL;
+    }
+
+    /* Parser rewinds by rescanning lex_buffer */
+    strcpy ((char *)lex_buffer, expr);
+    lex_set_scan_buffer ((const char *)lex_buffer);
+
+    tree = Parser_Mexpr_Condition_build_expression_tree ();
+
+    if (!tree) {
+        tree = Parser_Mexpr_build_math_expression_tree ();
+    }
+
+    if (!tree) {
+        printf ("Error : Exp Tree could not built for %s\n", fn_name);
+        Parser_stack_reset ();
+        return NULL;
+    }
+    Parser_stack_reset ();
+
+    if (!mexpr_codegen_add_expression (cg, fn_name, tree)) {
+        mexpt_tree_destroy (tree, false);
+        return NULL;
+    }
+    return tree;
+}
+
+static double
+mexprcc_now (void) {
+
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static mexpr_var_t
+mexprcc_col_compute (void *data_src) {
+
+    return mexprcc_row[*(int *)data_src];
+}
+
+static bool
+mexprcc_same (mexpr_var_t v1, mexpr_var_t v2) {
+
+    if (v1.dtype != v2.dtype) return false;
+
+    switch (v1.dtype) {
+
+        case MEXPR_DTYPE_INT:
+            return v1.u.int_val == v2.u.int_val;
+        case MEXPR_DTYPE_DOUBLE:
+            if (v1.u.d_val != v1.u.d_val) return v2.u.d_val != v2.u.d_val;
+            return memcmp (&v1.u.d_val, &v2.u.d_val, sizeof (double)) == 0;
+        case MEXPR_DTYPE_BOOL:
+            return v1.u.b_val == v2.u.b_val;
+        case MEXPR_DTYPE_STRING:
+            return v1.str_len == v2.str_len &&
+                        memcmp (v1.u.str_val, v2.u.str_val, v1.str_len) == 0;
+        default:
+            return true;
+    }
+}
+
+static void
+mexprcc_bench_generate (mexpr_codegen_t *cg, mexpr_var_t *rows, uint64_t n_rows) {
+
+    int c;
+    uint64_t row;
+    const char *str;
+    mexpr_var_t *var;
+
+    for (row = 0; row < n_rows; row++) {
+        for (c = 0; c < cg->n_cols; c++) {
+
+            var = &rows[row * cg->n_cols + c];
+            var->dtype = cg->cols[c].dtype;
+
+            switch (var->dtype) {
+
+                case MEXPR_DTYPE_INT:
+                    var->u.int_val = 1 + rand () % 1000;
+                    break;
+                case MEXPR_DTYPE_DOUBLE:
+                    var->u.d_val = (double)rand () / RAND_MAX * 20 - 10;
+                    break;
+                case MEXPR_DTYPE_BOOL:
+                    var->u.b_val = rand () % 2;
+                    break;
+                default:
+                    str = mexprcc_bench_strs[rand () % (sizeof (mexprcc_bench_strs) /
+                                                                        sizeof (mexprcc_bench_strs[0]))];
+                    *var = mexpr_var_string ((unsigned char *)str, strlen (str));
+                    break;
+            }
+        }
+    }
+}
+
+/* Binds operands of the tree to the columns of mexprcc_row, as the generated
+    code reads them */
+static bool
+mexprcc_bench_bind (mexpr_codegen_t *cg, mexpt_tree_t *tree) {
+
+    int c;
+    mexpt_node_t *opd_node = NULL;
+
+    mexpt_iterate_operands_begin (tree, opd_node) {
+
+        for (c = 0; c < cg->n_cols; c++) {
+            if (strcmp ((char *)opd_node->u.opd_node.opd_value.variable_name,
+                            cg->cols[c].name) == 0) break;
+        }
+        if (c == cg->n_cols) return false;
+
+        opd_node->u.opd_node.is_numeric = cg->cols[c].dtype != MEXPR_DTYPE_STRING;
+        mexpt_tree_install_operand_properties (opd_node, malloc (sizeof (int)),
+                                                                     mexprcc_col_compute);
+        *(int *)opd_node->u.opd_node.data_src = c;
+        mexpt_tree_set_operand_dtype (opd_node, cg->cols[c].dtype);
+
+    } mexpt_iterate_operands_end (tree, opd_node);
+
+    if (!mexpr_validate_expression_tree (tree)) return false;
+    mexpt_optimize (tree->root);
+    return true;
+}
+
+static void
+mexprcc_bench_expr (mexpr_codegen_t *cg,
+                                 mexpr_codegen_lib_t *lib,
+                                 mexprcc_bench_expr_t *expr,
+                                 const mexpr_var_t *rows,
+                                 uint64_t n_rows,
+                                 mexpr_var_t *ref,
+                                 mexpr_var_t *out) {
+
+    int r;
+    uint64_t row, n_mismatches = 0;
+    double start, t_interp, t_row, t_batch;
+    mexpr_codegen_row_fn_t row_fn = mexpr_codegen_lookup (lib, expr->fn_name);
+    mexpr_codegen_batch_fn_t batch_fn = mexpr_codegen_lookup_batch (lib, expr->fn_name);
+
+    if (!row_fn || !batch_fn) return;
+
+    if (!mexprcc_bench_bind (cg, expr->tree)) {
+        printf ("%-24s  not evaluated by mexpt_evaluate\n", expr->fn_name);
+        return;
+    }
+
+    /* Check, string results are valid until the next evaluation */
+    for (row = 0; row < n_rows; row++) {
+        mexprcc_row = rows + row * cg->n_cols;
+        ref[row] = mexpt_evaluate (expr->tree->root);
+        if (!mexprcc_same (ref[row], row_fn (mexprcc_row))) n_mismatches++;
+    }
+    batch_fn (rows, n_rows, out);
+    for (row = 0; row < n_rows; row++) {
+        if (ref[row].dtype == MEXPR_DTYPE_STRING && out[row].dtype == MEXPR_DTYPE_STRING) continue;
+        if (!mexprcc_same (ref[row], out[row])) n_mismatches++;
+    }
+
+    t_interp = t_row = t_batch = INFINITY;
+
+    for (r = 0; r < MEXPRCC_REPEAT; r++) {
+
+        start = mexprcc_now ();
+        for (row = 0; row < n_rows; row++) {
+            mexprcc_row = rows + row * cg->n_cols;
+            ref[row] = mexpt_evaluate (expr->tree->root);
+        }
+        t_interp = fmin (t_interp, mexprcc_now () - start);
+
+        start = mexprcc_now ();
+        for (row = 0; row < n_rows; row++) {
+            out[row] = row_fn (rows + row * cg->n_cols);
+        }
+        t_row = fmin (t_row, mexprcc_now () - start);
+
+        start = mexprcc_now ();
+        batch_fn (rows, n_rows, out);
+        t_batch = fmin (t_batch, mexprcc_now () - start);
+    }
+
+    printf ("%-24s  %10llu  %8.1f  %8.1f  %8.1f  %7.1f  %7.1f\n", expr->fn_name,
+                (unsigned long long)n_mismatches, t_interp / n_rows * 1e9,
+                t_row / n_rows * 1e9, t_batch / n_rows * 1e9,
+                t_interp / t_row, t_interp / t_batch);
+}
+
+static bool
+mexprcc_bench (mexpr_codegen_t *cg, const char *so_path, uint64_t n_rows) {
+
+    int i;
+    mexpr_var_t *rows, *ref, *out;
+    mexpr_codegen_lib_t *lib = mexpr_codegen_load (so_path);
+
+    if (!lib) return false;
+
+    srand (1);
+    rows = (mexpr_var_t *)malloc (n_rows * (cg->n_cols ? cg->n_cols : 1) *
+                                                    sizeof (mexpr_var_t));
+    ref = (mexpr_var_t *)malloc (n_rows * sizeof (mexpr_var_t));
+    out = (mexpr_var_t *)malloc (n_rows * sizeof (mexpr_var_t));
+    mexprcc_bench_generate (cg, rows, n_rows);
+
+    printf ("%llu rows, ns per row\n", (unsigned long long)n_rows);
+    printf ("%-24s  %10s  %8s  %8s  %8s  %7s  %7s\n", "expression", "mismatches",
+                "interp", "gen row", "gen batch", "x row", "x batch");
+
+    for (i = 0; i < mexprcc_n_bench_exprs; i++) {
+        mexprcc_bench_expr (cg, lib, &mexprcc_bench_exprs[i], rows, n_rows, ref, out);
+    }
+
+    free (rows);
+    free (ref);
+    free (out);
+    mexpr_codegen_unload (lib);
+    return true;
+}
+
+static void
+mexprcc_bench_free (void) {
+
+    int i;
+
+    for (i = 0; i < mexprcc_n_bench_exprs; i++) {
+        free (mexprcc_bench_exprs[i].fn_name);
+        mexpt_tree_destroy (mexprcc_bench_exprs[i].tree, true);
+    }
+    free (mexprcc_bench_exprs);
+}
+
+int
+main (int argc, char **argv) {
+
+    FILE *fp;
+    int line_no = 0;
+    uint64_t n_bench_rows = 0;
+    char line[MAX_EXPR_LEN + MEXPR_TREE_OPERAND_LEN_MAX];
+    char *str, *sep;
+    mexpr_dtypes_t dtype;
+    mexpr_codegen_t *cg;
+    mexpt_tree_t *tree;
+
+    if (argc == 5 && strcmp (argv[1], "-bench") == 0) {
+        n_bench_rows = strtoull (argv[2], NULL, 10);
+        if (!n_bench_rows) n_bench_rows = 1;
+        argc -= 2;
+        argv += 2;
+    }
+
+    if (argc != 3) {
+        printf ("Usage : %s [-bench <rows>] <expression file> <output .so>\n", argv[0]);
+        return 1;
+    }
+
+    fp = fopen (argv[1], "r");
+    if (!fp) {
+        printf ("Error : Could not open %s\n", argv[1]);
+        return 1;
+    }
+
+    parse_init ();
+    cg = mexpr_codegen_create ();
+
+    while (fgets (line, sizeof (line), fp)) {
+
+        line_no++;
+        str = mexprcc_trim (line);
+
+        if (str[0] == '\0' || str[0] == '#') continue;
+
+        if (strncmp (str, "column", 6) == 0 && isspace ((unsigned char)str[6])) {
+
+            char name[MEXPR_TREE_OPERAND_LEN_MAX], type[16];
+
+            if (sscanf (str + 6, "%191s %15s", name, type) != 2 ||
+                    !mexprcc_dtype_from_name (type, &dtype)) {
+                printf ("Error : %s:%d : Bad column declaration\n", argv[1], line_no);
+                goto fail;
+            }
+            if (!mexpr_codegen_add_column (cg, name, dtype)) goto fail;
+            continue;
+        }
+
+        sep = strchr (str, ':');
+        if (!sep) {
+            printf ("Error : %s:%d : Expected <function name> : <expression>\n",
+                        argv[1], line_no);
+            goto fail;
+        }
+
+        *sep = '\0';
+        str = mexprcc_trim (str);
+        tree = mexprcc_add_expression (cg, str, mexprcc_trim (sep + 1));
+        if (!tree) {
+            printf ("Error : %s:%d : Expression not compiled\n", argv[1], line_no);
+            goto fail;
+        }
+
+        if (!n_bench_rows) {
+            mexpt_tree_destroy (tree, false);
+            continue;
+        }
+        mexprcc_bench_exprs = (mexprcc_bench_expr_t *)realloc (mexprcc_bench_exprs,
+                            (mexprcc_n_bench_exprs + 1) * sizeof (mexprcc_bench_expr_t));
+        mexprcc_bench_exprs[mexprcc_n_bench_exprs].fn_name = strdup (str);
+        mexprcc_bench_exprs[mexprcc_n_bench_exprs].tree = tree;
+        mexprcc_n_bench_exprs++;
+    }
+
+    fclose (fp);
+    fp = NULL;
+
+    if (!mexpr_codegen_build (cg, argv[2])) goto fail;
+
+    printf ("%d expressions on %d columns built into %s\n",
+                cg->n_exprs, cg->n_cols, argv[2]);
+
+    if (n_bench_rows && !mexprcc_bench (cg, argv[2], n_bench_rows)) goto fail;
+
+    mexprcc_bench_free ();
+    mexpr_codegen_free (cg);
+    return 0;
+
+fail:
+    if (fp) fclose (fp);
+    mexprcc_bench_free ();
+    mexpr_codegen_free (cg);
+    return 1;
+}
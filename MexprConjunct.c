@@ -0,0 +1,343 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "MexprEnums.h"
+#include "MExpr.h"
+#include "MexprConjunct.h"
+
+/* Or of its nodes */
+typedef struct mexpt_clause_ {
+
+    int n_nodes;
+    mexpt_node_t **nodes;
+} mexpt_clause_t;
+
+/* And of its clauses */
+typedef struct mexpt_clause_vec_ {
+
+    int n_clauses;
+    mexpt_clause_t *clauses;
+} mexpt_clause_vec_t;
+
+static int
+mexpt_conj_add_table (mexpt_conj_split_t *split, const char *name, int len) {
+
+    int i;
+
+    for (i = 0; i < split->n_tables; i++) {
+        if ((int)strlen (split->tables[i]) == len &&
+                strncmp (split->tables[i], name, len) == 0) {
+            return i;
+        }
+    }
+    if (split->n_tables == MEXPT_CONJ_MAX_TABLES) return -1;
+
+    split->tables = (char **)realloc (split->tables, (split->n_tables + 1) * sizeof (char *));
+    split->tables[split->n_tables] = strndup (name, len);
+    return split->n_tables++;
+}
+
+/* Tables referenced by the subtree. *other : it references a plain operand, or
+    a table past MEXPT_CONJ_MAX_TABLES */
+static uint64_t
+mexpt_conj_refs (mexpt_conj_split_t *split, mexpt_node_t *node, bool *other) {
+
+    int table;
+    const char *name;
+    const char *dot;
+
+    if (!node) return 0;
+
+    switch (node->token_code) {
+
+        case MATH_IDENTIFIER_IDENTIFIER:
+            name = (const char *)node->u.opd_node.opd_value.variable_name;
+            dot = strchr (name, '.');
+            table = mexpt_conj_add_table (split, name, dot ? (int)(dot - name) : (int)strlen (name));
+            if (table < 0) {
+                *other = true;
+                return 0;
+            }
+            return 1ULL << table;
+        case MATH_IDENTIFIER:
+            if (!mexpt_node_is_param (node)) *other = true;
+            return 0;
+        default:
+            return mexpt_conj_refs (split, node->left, other) |
+                        mexpt_conj_refs (split, node->right, other);
+    }
+}
+
+static uint64_t
+mexpt_conj_clause_refs (mexpt_conj_split_t *split, mexpt_clause_t *clause, bool *other) {
+
+    int i;
+    uint64_t tables = 0;
+
+    for (i = 0; i < clause->n_nodes; i++) {
+        tables |= mexpt_conj_refs (split, clause->nodes[i], other);
+    }
+    return tables;
+}
+
+static void
+mexpt_conj_vec_add (mexpt_clause_vec_t *vec, mexpt_clause_t *clause) {
+
+    vec->clauses = (mexpt_clause_t *)realloc (vec->clauses,
+                            (vec->n_clauses + 1) * sizeof (mexpt_clause_t));
+    vec->clauses[vec->n_clauses++] = *clause;
+}
+
+static void
+mexpt_conj_vec_free (mexpt_clause_vec_t *vec) {
+
+    int i;
+
+    for (i = 0; i < vec->n_clauses; i++) {
+        free (vec->clauses[i].nodes);
+    }
+    free (vec->clauses);
+    vec->clauses = NULL;
+    vec->n_clauses = 0;
+}
+
+/* (l1 and l2) or (r1 and r2) is (l1 or r1) and (l1 or r2) and (l2 or r1) and
+    (l2 or r2) : worth it if a clause references fewer tables than the or */
+static bool
+mexpt_conj_distribute (mexpt_conj_split_t *split,
+                                    mexpt_node_t *node,
+                                    mexpt_clause_vec_t *lvec,
+                                    mexpt_clause_vec_t *rvec,
+                                    int max_clauses,
+                                    mexpt_clause_vec_t *vec) {
+
+    int i, j;
+    bool other = false;
+    uint64_t tables;
+    mexpt_clause_t clause;
+    int n_tables = __builtin_popcountll (mexpt_conj_refs (split, node, &other));
+    bool narrower = false;
+
+    if (lvec->n_clauses == 1 && rvec->n_clauses == 1) return false;
+    if (lvec->n_clauses * rvec->n_clauses > max_clauses) return false;
+
+    for (i = 0; i < lvec->n_clauses && !narrower; i++) {
+        for (j = 0; j < rvec->n_clauses && !narrower; j++) {
+            other = false;
+            tables = mexpt_conj_clause_refs (split, &lvec->clauses[i], &other) |
+                        mexpt_conj_clause_refs (split, &rvec->clauses[j], &other);
+            narrower = !other && __builtin_popcountll (tables) < n_tables;
+        }
+    }
+    if (!narrower) return false;
+
+    for (i = 0; i < lvec->n_clauses; i++) {
+        for (j = 0; j < rvec->n_clauses; j++) {
+
+            clause.n_nodes = lvec->clauses[i].n_nodes + rvec->clauses[j].n_nodes;
+            clause.nodes = (mexpt_node_t **)malloc (clause.n_nodes * sizeof (mexpt_node_t *));
+            memcpy (clause.nodes, lvec->clauses[i].nodes,
+                        lvec->clauses[i].n_nodes * sizeof (mexpt_node_t *));
+            memcpy (clause.nodes + lvec->clauses[i].n_nodes, rvec->clauses[j].nodes,
+                        rvec->clauses[j].n_nodes * sizeof (mexpt_node_t *));
+            mexpt_conj_vec_add (vec, &clause);
+        }
+    }
+    return true;
+}
+
+static void
+mexpt_conj_cnf (mexpt_conj_split_t *split,
+                            mexpt_node_t *node,
+                            int max_clauses,
+                            mexpt_clause_vec_t *vec) {
+
+    mexpt_clause_t clause;
+    mexpt_clause_vec_t lvec, rvec;
+
+    memset (&lvec, 0, sizeof (lvec));
+    memset (&rvec, 0, sizeof (rvec));
+
+    /* Optimized away and / or are leaves */
+    if (node->left && node->right && node->token_code == MATH_AND) {
+
+        mexpt_conj_cnf (split, node->left, max_clauses, vec);
+        mexpt_conj_cnf (split, node->right, max_clauses, vec);
+        return;
+    }
+
+    if (node->left && node->right && node->token_code == MATH_OR) {
+
+        mexpt_conj_cnf (split, node->left, max_clauses, &lvec);
+        mexpt_conj_cnf (split, node->right, max_clauses, &rvec);
+
+        if (mexpt_conj_distribute (split, node, &lvec, &rvec, max_clauses, vec)) {
+            mexpt_conj_vec_free (&lvec);
+            mexpt_conj_vec_free (&rvec);
+            return;
+        }
+        mexpt_conj_vec_free (&lvec);
+        mexpt_conj_vec_free (&rvec);
+    }
+
+    clause.n_nodes = 1;
+    clause.nodes = (mexpt_node_t **)malloc (sizeof (mexpt_node_t *));
+    clause.nodes[0] = node;
+    mexpt_conj_vec_add (vec, &clause);
+}
+
+static void
+mexpt_conj_classify (mexpt_conj_split_t *split,
+                                  mexpt_clause_t *clause,
+                                  mexpt_conjunct_t *conj) {
+
+    bool other = false;
+    bool lother = false, rother = false;
+    uint64_t ltables, rtables;
+    mexpt_node_t *node = clause->nodes[0];
+
+    memset (conj, 0, sizeof (*conj));
+    conj->tables = mexpt_conj_clause_refs (split, clause, &other);
+    conj->tree = clause->n_nodes == 1 ?
+                        mexpt_clone_conjunction (clause->nodes, 1) :
+                        mexpt_clone_disjunction (clause->nodes, clause->n_nodes);
+
+    if (other) {
+        conj->kind = MEXPT_CONJ_JOIN;
+        return;
+    }
+
+    switch (__builtin_popcountll (conj->tables)) {
+        case 0:
+            conj->kind = MEXPT_CONJ_CONST;
+            return;
+        case 1:
+            conj->kind = MEXPT_CONJ_FILTER;
+            return;
+        default:
+            conj->kind = MEXPT_CONJ_JOIN;
+            break;
+    }
+
+    if (clause->n_nodes != 1 || node->token_code != MATH_EQ ||
+            !node->left || !node->right) {
+        return;
+    }
+
+    ltables = mexpt_conj_refs (split, node->left, &lother);
+    rtables = mexpt_conj_refs (split, node->right, &rother);
+
+    if (lother || rother || __builtin_popcountll (ltables) != 1 ||
+            __builtin_popcountll (rtables) != 1 || ltables == rtables) {
+        return;
+    }
+
+    conj->kind = MEXPT_CONJ_EQUI_JOIN;
+    conj->keys[0] = mexpt_clone_conjunction (&node->left, 1);
+    conj->keys[1] = mexpt_clone_conjunction (&node->right, 1);
+    conj->key_tables[0] = __builtin_ctzll (ltables);
+    conj->key_tables[1] = __builtin_ctzll (rtables);
+}
+
+mexpt_conj_split_t *
+mexpt_conj_split (mexpt_tree_t *tree, int max_clauses) {
+
+    int i;
+    mexpt_clause_vec_t vec;
+    mexpt_conj_split_t *split = (mexpt_conj_split_t *)calloc (1, sizeof (mexpt_conj_split_t));
+
+    if (!tree->root) return split;
+    if (max_clauses <= 0) max_clauses = MEXPT_CONJ_MAX_CLAUSES;
+
+    memset (&vec, 0, sizeof (vec));
+    mexpt_conj_cnf (split, tree->root, max_clauses, &vec);
+
+    split->n_conjuncts = vec.n_clauses;
+    split->conjuncts = (mexpt_conjunct_t *)calloc (vec.n_clauses, sizeof (mexpt_conjunct_t));
+
+    for (i = 0; i < vec.n_clauses; i++) {
+        mexpt_conj_classify (split, &vec.clauses[i], &split->conjuncts[i]);
+    }
+
+    mexpt_conj_vec_free (&vec);
+    return split;
+}
+
+int
+mexpt_conj_table (const mexpt_conj_split_t *split, const char *table) {
+
+    int i;
+
+    for (i = 0; i < split->n_tables; i++) {
+        if (strcmp (split->tables[i], table) == 0) return i;
+    }
+    return -1;
+}
+
+mexpt_tree_t *
+mexpt_conj_pushdown (const mexpt_conj_split_t *split, const char *table) {
+
+    int i;
+    int n_nodes = 0;
+    mexpt_node_t **nodes;
+    mexpt_tree_t *tree = NULL;
+    int index = mexpt_conj_table (split, table);
+
+    if (index < 0) return NULL;
+
+    nodes = (mexpt_node_t **)malloc ((split->n_conjuncts + 1) * sizeof (mexpt_node_t *));
+
+    for (i = 0; i < split->n_conjuncts; i++) {
+
+        if (split->conjuncts[i].kind == MEXPT_CONJ_FILTER &&
+                split->conjuncts[i].tables == (1ULL << index)) {
+            nodes[n_nodes++] = split->conjuncts[i].tree->root;
+        }
+    }
+
+    if (n_nodes) tree = mexpt_clone_conjunction (nodes, n_nodes);
+    free (nodes);
+    return tree;
+}
+
+void
+mexpt_conj_split_print (const mexpt_conj_split_t *split) {
+
+    int i, j;
+    const mexpt_conjunct_t *conj;
+    static const char *kinds[] = {"const", "filter", "equi join", "join"};
+
+    for (i = 0; i < split->n_conjuncts; i++) {
+
+        conj = &split->conjuncts[i];
+        printf ("Conjunct %d : %s, tables", i, kinds[conj->kind]);
+
+        for (j = 0; j < split->n_tables; j++) {
+            if (conj->tables & (1ULL << j)) printf (" %s", split->tables[j]);
+        }
+        if (conj->kind == MEXPT_CONJ_EQUI_JOIN) {
+            printf (", keys of %s and %s", split->tables[conj->key_tables[0]],
+                        split->tables[conj->key_tables[1]]);
+        }
+        printf ("\n");
+    }
+}
+
+void
+mexpt_conj_split_free (mexpt_conj_split_t *split) {
+
+    int i;
+
+    for (i = 0; i < split->n_conjuncts; i++) {
+
+        mexpt_tree_destroy (split->conjuncts[i].tree, false);
+        if (split->conjuncts[i].keys[0]) mexpt_tree_destroy (split->conjuncts[i].keys[0], false);
+        if (split->conjuncts[i].keys[1]) mexpt_tree_destroy (split->conjuncts[i].keys[1], false);
+    }
+    for (i = 0; i < split->n_tables; i++) {
+        free (split->tables[i]);
+    }
+    free (split->conjuncts);
+    free (split->tables);
+    free (split);
+}
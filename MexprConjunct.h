@@ -0,0 +1,95 @@
+#ifndef __MEXPR_CONJUNCT__
+#define __MEXPR_CONJUNCT__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "MExpr.h"
+
+/* Conjunct Splitting for Join Planning
+
+    A condition over several tables, e.g. out of
+    Parser_Mexpr_Condition_build_expression_tree( ) :
+
+        a.x > 5 and b.y < 3 and a.id = b.aid and (a.z = 1 or b.w = 2)
+
+    is split by mexpt_conj_split( ) into its conjuncts, each a tree of its own,
+    classified by the set of tables (qualifiers of its table.column operands,
+    MATH_IDENTIFIER_IDENTIFIER) it references :
+
+        a.x > 5                 MEXPT_CONJ_FILTER       push down to the scan of a
+        b.y < 3                 MEXPT_CONJ_FILTER       push down to the scan of b
+        a.id = b.aid            MEXPT_CONJ_EQUI_JOIN    hash join on keys a.id, b.aid
+        a.z = 1 or b.w = 2      MEXPT_CONJ_JOIN         evaluate on joined rows
+
+    An or of ands is distributed into clauses (conjunctive normal form) when
+    this is cheap : at most max_clauses clauses come out of it, and one of them
+    references fewer tables than the or, e.g.
+
+        (a.x = 1 and b.y = 2) or (a.x = 3 and b.y = 4)
+            ->  (a.x = 1 or a.x = 3)                    filter of a
+                (a.x = 1 or b.y = 4), (b.y = 2 or a.x = 3)  join
+                (b.y = 2 or b.y = 4)                    filter of b
+
+    A row (of the joined tables) satisfies the condition if and only if it
+    satisfies every conjunct : MexprDb propagates a failed evaluation to the
+    root whatever the other operand of and / or, and every leaf of the
+    condition is in some conjunct. Keys of an equi-join compare as = does (int
+    and double exactly, NaN equal to nothing).
+
+    Conjuncts are clones : the tree is left untouched, operands keep their
+    installed properties. Plain operands (MATH_IDENTIFIER other than bound
+    parameters) belong to no known table, conjuncts using them are
+    MEXPT_CONJ_JOIN. At most 64 tables.
+*/
+
+#define MEXPT_CONJ_MAX_CLAUSES  16
+#define MEXPT_CONJ_MAX_TABLES   64
+
+typedef enum mexpt_conj_kind_ {
+
+    MEXPT_CONJ_CONST,       /* references no operand : literals, parameters */
+    MEXPT_CONJ_FILTER,      /* references a single table */
+    MEXPT_CONJ_EQUI_JOIN,   /* keys[0] = keys[1], each over a single table */
+    MEXPT_CONJ_JOIN         /* anything else */
+} mexpt_conj_kind_t;
+
+typedef struct mexpt_conjunct_ {
+
+    mexpt_conj_kind_t kind;
+    uint64_t tables;            /* bit i : references tables[i] of the split */
+    mexpt_tree_t *tree;
+
+    /* MEXPT_CONJ_EQUI_JOIN : sides of the =, keys[i] references key_tables[i] */
+    mexpt_tree_t *keys[2];
+    int key_tables[2];
+} mexpt_conjunct_t;
+
+typedef struct mexpt_conj_split_ {
+
+    int n_tables;
+    char **tables;              /* in order of first reference */
+
+    int n_conjuncts;
+    mexpt_conjunct_t *conjuncts;
+} mexpt_conj_split_t;
+
+/* max_clauses <= 0 is MEXPT_CONJ_MAX_CLAUSES */
+mexpt_conj_split_t *
+mexpt_conj_split (mexpt_tree_t *tree, int max_clauses);
+
+/* Index of the table in split->tables, -1 if not referenced */
+int
+mexpt_conj_table (const mexpt_conj_split_t *split, const char *table);
+
+/* And of the filters of table, NULL if none. Caller owns the tree */
+mexpt_tree_t *
+mexpt_conj_pushdown (const mexpt_conj_split_t *split, const char *table);
+
+void
+mexpt_conj_split_print (const mexpt_conj_split_t *split);
+
+void
+mexpt_conj_split_free (mexpt_conj_split_t *split);
+
+#endif
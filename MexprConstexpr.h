@@ -0,0 +1,944 @@
+#ifndef __MEXPR_CONSTEXPR__
+#define __MEXPR_CONSTEXPR__
+
+#if !defined(__cplusplus) || __cplusplus < 201703L
+#error "MexprConstexpr.h needs C++17"
+#endif
+
+#include <stdint.h>
+#include <limits.h>
+#include <string.h>
+#include <math.h>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+
+#include "MexprEnums.h"
+
+/* Compile Time Expressions (header only, C++17)
+
+    For formulas fixed in the source code, the expression literal is parsed by the
+    compiler instead of at startup, and evaluates without a tree :
+
+        struct emp_t { int age; double salary; const char *dept; };
+
+        constexpr auto rule = MEXPR_CT_EXPR ("salary * 1.1 > 5000 and dept = 'HR'");
+
+        auto res = rule (emp, MEXPR_CT_BIND ("salary", &emp_t::salary),
+                                MEXPR_CT_BIND ("dept", &emp_t::dept));
+        if (res.valid && res.value) ...
+
+    The literal is tokenized as Parser.l does and parsed with the grammar of
+    ExpressionParser.c, a condition (S or Q) first, then a math expression (E),
+    with the operator precedence of Math_operator_precedence( ). Syntax errors
+    and operators applied to dtypes MexprDb does not support fail the build.
+
+    Every node is an inline function of its children, typed by the dtypes MexprDb
+    gives : int, double, bool, or std::string_view for strings. An operand binds
+    by name to a member pointer of the row, or to a lambda taking the row (or
+    nothing); integral values are int64_t operands, floating point values are
+    double operands. Results are the ones of mexpt_evaluate( ) on the same values,
+    res.valid is false where mexpt_evaluate( ) returns MEXPR_DTYPE_INVALID
+    (divide by zero, integer overflow).
+
+    Not usable in constant expressions : sqrt sin cos pow, which call libm like
+    MexprDb, and string + string. MexprDb builds concatenated strings in the
+    evaluation arena (see MexprArena.h) and returns views valid until that
+    arena is reset; here there is no arena, the view is of a static buffer
+    overwritten by the next string + string, and holds at most
+    2 * MEXPR_MAX_STRING_VAL_LEN - 1 chars. Double literals must convert
+    exactly (at most 15 significant digits), integer literals must fit an
+    int64_t.
+
+    The static_assert self test is MexprConstexprTest.cpp, checked by compile.sh.
+*/
+
+#ifndef MEXPR_CT_MAX_NODES
+#define MEXPR_CT_MAX_NODES  64
+#endif
+
+namespace mexpr_ct {
+
+/* ====================x================x=================== */
+/* Parser */
+
+typedef struct ast_node_ {
+
+    int token_code = 0;         /* MATH_* operator or operand */
+    int left = -1;              /* index of children, -1 if none */
+    int right = -1;
+    int64_t int_val = 0;
+    double d_val = 0;
+    std::string_view text;      /* variable name, or string literal without quotes */
+} ast_node_t;
+
+typedef struct ast_ {
+
+    ast_node_t nodes[MEXPR_CT_MAX_NODES];
+    int n_nodes = 0;
+    int root = -1;
+    const char *err = nullptr;  /* nullptr if parsed */
+    int err_pos = 0;
+} ast_t;
+
+typedef struct token_ {
+
+    int token_code;         /* -1 at end of input */
+    std::string_view text;
+} token_t;
+
+class parser_t {
+
+    std::string_view src;
+    int pos;
+
+    static constexpr bool
+    is_ident_char (char c) {
+
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                  (c >= '0' && c <= '9') || c == '_';
+    }
+
+    static constexpr bool
+    is_digit (char c) {
+
+        return c >= '0' && c <= '9';
+    }
+
+    constexpr int
+    run_len (int from, bool (*pred) (char)) const {
+
+        int i = from;
+        while (i < (int)src.size () && pred (src[i])) i++;
+        return i - from;
+    }
+
+    /* Lengths of the Parser.l patterns matching at p, 0 if none */
+    constexpr int
+    int_len (int p) const {
+
+        if (p < (int)src.size () && src[p] == '-') {
+            if (p + 1 >= (int)src.size () || src[p + 1] < '1' || src[p + 1] > '9') return 0;
+            return 1 + run_len (p + 1, is_digit);
+        }
+        if (p >= (int)src.size () || !is_digit (src[p])) return 0;
+        if (src[p] == '0') return 1;
+        return run_len (p, is_digit);
+    }
+
+    constexpr int
+    double_len (int p) const {
+
+        int i = p;
+        if (i < (int)src.size () && src[i] == '-') i++;
+        i += run_len (i, is_digit);
+        if (i >= (int)src.size () || src[i] != '.') return 0;
+        if (run_len (i + 1, is_digit) == 0) return 0;
+        return i + 1 + run_len (i + 1, is_digit) - p;
+    }
+
+    constexpr int
+    ident_ident_len (int p) const {
+
+        int l = run_len (p, is_ident_char);
+        if (!l || p + l >= (int)src.size () || src[p + l] != '.') return 0;
+        int r = run_len (p + l + 1, is_ident_char);
+        return r ? l + 1 + r : 0;
+    }
+
+    static constexpr int
+    keyword (std::string_view word) {
+
+        if (word == "and") return MATH_AND;
+        if (word == "or") return MATH_OR;
+        if (word == "sqrt") return MATH_SQRT;
+        if (word == "sqr") return MATH_SQR;
+        if (word == "mmax") return MATH_MAX;
+        if (word == "mmin") return MATH_MIN;
+        if (word == "sin") return MATH_SIN;
+        if (word == "cos") return MATH_COS;
+        if (word == "pow") return MATH_POW;
+        return -1;
+    }
+
+    /* Longest match, ties go to the rule listed first in Parser.l */
+    constexpr token_t
+    lex () {
+
+        while (pos < (int)src.size ()) {
+
+            char c = src[pos];
+            int p = pos;
+
+            if (c == ' ' || c == '\t' || c == '\n') {
+                pos++;
+                continue;
+            }
+
+            if (c == '\'' || c == '"') {
+                size_t end = src.find (c, p + 1);
+                if (end == std::string_view::npos) {
+                    pos = (int)src.size ();
+                    return token_t {MATH_MAX_CODE, src.substr (p)};
+                }
+                pos = (int)end + 1;
+                return token_t {MATH_STRING_VALUE, src.substr (p, end + 1 - p)};
+            }
+
+            int best = 0, code = -1, len = 0;
+
+            len = src.substr (p, 2) == "<=" ? 2 : 0;
+            if (len > best) { best = len; code = MATH_LESS_THAN_EQ; }
+            len = src.substr (p, 2) == "!=" ? 2 : 0;
+            if (len > best) { best = len; code = MATH_NOT_EQ; }
+
+            switch (c) {
+                case '(': len = 1; code = best ? code : MATH_BRACKET_START; break;
+                case ')': len = 1; code = best ? code : MATH_BRACKET_END; break;
+                case '<': len = 1; code = best ? code : MATH_LESS_THAN; break;
+                case '>': len = 1; code = best ? code : MATH_GREATER_THAN; break;
+                case '=': len = 1; code = best ? code : MATH_EQ; break;
+                case '*': len = 1; code = best ? code : MATH_MUL; break;
+                case '+': len = 1; code = best ? code : MATH_PLUS; break;
+                case '-': len = 1; code = best ? code : MATH_MINUS; break;
+                case '/': len = 1; code = best ? code : MATH_DIV; break;
+                case ',': len = 1; code = best ? code : MATH_COMMA; break;
+                default: len = 0; break;
+            }
+            if (len > best) best = len;
+
+            int word = run_len (p, is_ident_char);
+            if (word && word > best && keyword (src.substr (p, word)) >= 0) {
+                best = word;
+                code = keyword (src.substr (p, word));
+            }
+
+            len = int_len (p);
+            if (len > best) { best = len; code = MATH_INTEGER_VALUE; }
+            len = double_len (p);
+            if (len > best) { best = len; code = MATH_DOUBLE_VALUE; }
+            if (word > best) { best = word; code = MATH_IDENTIFIER; }
+            len = ident_ident_len (p);
+            if (len > best) { best = len; code = MATH_IDENTIFIER_IDENTIFIER; }
+
+            /* Any other character is ignored */
+            if (!best) {
+                pos++;
+                continue;
+            }
+
+            pos = p + best;
+            return token_t {code, src.substr (p, best)};
+        }
+
+        return token_t {-1, std::string_view ()};
+    }
+
+    constexpr void
+    fail (const char *err) {
+
+        if (!ast.err || pos > ast.err_pos) {
+            ast.err = err;
+            ast.err_pos = pos;
+        }
+    }
+
+    constexpr int
+    add_node (int token_code, int left, int right) {
+
+        if (ast.n_nodes == MEXPR_CT_MAX_NODES) {
+            fail ("too many nodes, raise MEXPR_CT_MAX_NODES");
+            return -1;
+        }
+
+        ast_node_t &node = ast.nodes[ast.n_nodes];
+        node.token_code = token_code;
+        node.left = left;
+        node.right = right;
+        node.int_val = 0;
+        node.d_val = 0;
+        node.text = std::string_view ();
+        return ast.n_nodes++;
+    }
+
+    /* strtoll( ) of the token, which must fit an int64_t */
+    constexpr bool
+    int_value (std::string_view text, int64_t *val) {
+
+        bool neg = text[0] == '-';
+        uint64_t v = 0;
+
+        for (size_t i = neg ? 1 : 0; i < text.size (); i++) {
+            if (v > (UINT64_MAX - 9) / 10) return false;
+            v = v * 10 + (text[i] - '0');
+        }
+        if (v > (uint64_t)INT64_MAX + (neg ? 1 : 0)) return false;
+        *val = neg ? (int64_t)(0 - v) : (int64_t)v;
+        return true;
+    }
+
+    /* strtod( ) of the token : mantissa / 10^k is correctly rounded when both
+        are exact doubles, other literals are rejected */
+    constexpr bool
+    double_value (std::string_view text, double *val) {
+
+        bool neg = text[0] == '-';
+        uint64_t mant = 0;
+        int frac = -1;
+        double p10 = 1;
+
+        for (size_t i = neg ? 1 : 0; i < text.size (); i++) {
+            if (text[i] == '.') {
+                frac = 0;
+                continue;
+            }
+            mant = mant * 10 + (text[i] - '0');
+            if (mant > ((uint64_t)1 << 53)) return false;
+            if (frac >= 0) frac++;
+        }
+        if (frac > 22) return false;
+        for (int i = 0; i < frac; i++) p10 *= 10;
+        *val = (double)mant / p10;
+        if (neg) *val = -*val;
+        return true;
+    }
+
+    constexpr int
+    leaf (token_t tok) {
+
+        int n = add_node (tok.token_code, -1, -1);
+        if (n < 0) return -1;
+
+        ast_node_t &node = ast.nodes[n];
+
+        switch (tok.token_code) {
+            case MATH_INTEGER_VALUE:
+                if (!int_value (tok.text, &node.int_val)) {
+                    fail ("integer literal does not fit an int64_t");
+                    return -1;
+                }
+                break;
+            case MATH_DOUBLE_VALUE:
+                if (!double_value (tok.text, &node.d_val)) {
+                    fail ("double literal has too many digits to convert exactly");
+                    return -1;
+                }
+                break;
+            case MATH_STRING_VALUE:
+                node.text = tok.text.substr (1, tok.text.size () - 2);
+                break;
+            default:
+                node.text = tok.text;
+                break;
+        }
+        return n;
+    }
+
+    /* F -> ( E ) | P ( E ) | INTEGER | DECIMAL | VAR | G ( E, E ) | 'SENTENCE' */
+    constexpr int
+    F () {
+
+        int chkp = pos, n_nodes = ast.n_nodes;
+        token_t tok = lex ();
+        int l = -1, r = -1;
+
+        switch (tok.token_code) {
+
+            case MATH_BRACKET_START:
+                l = E ();
+                if (l >= 0 && lex ().token_code == MATH_BRACKET_END) return l;
+                break;
+            case MATH_INTEGER_VALUE:
+            case MATH_DOUBLE_VALUE:
+            case MATH_IDENTIFIER:
+            case MATH_IDENTIFIER_IDENTIFIER:
+            case MATH_STRING_VALUE:
+                return leaf (tok);
+            case MATH_SQRT:
+            case MATH_SQR:
+            case MATH_SIN:
+            case MATH_COS:
+                if (lex ().token_code != MATH_BRACKET_START) break;
+                l = E ();
+                if (l < 0 || lex ().token_code != MATH_BRACKET_END) break;
+                return add_node (tok.token_code, l, -1);
+            case MATH_MAX:
+            case MATH_MIN:
+            case MATH_POW:
+                if (lex ().token_code != MATH_BRACKET_START) break;
+                l = E ();
+                if (l < 0 || lex ().token_code != MATH_COMMA) break;
+                r = E ();
+                if (r < 0 || lex ().token_code != MATH_BRACKET_END) break;
+                return add_node (tok.token_code, l, r);
+            default:
+                break;
+        }
+
+        fail ("syntax error");
+        pos = chkp;
+        ast.n_nodes = n_nodes;
+        return -1;
+    }
+
+    /* T -> F T', T' -> * F T' | / F T' | $ */
+    constexpr int
+    T () {
+
+        int l = F ();
+
+        while (l >= 0) {
+
+            int chkp = pos, n_nodes = ast.n_nodes;
+            token_t tok = lex ();
+            int r = -1;
+
+            if (tok.token_code != MATH_MUL && tok.token_code != MATH_DIV) {
+                pos = chkp;
+                break;
+            }
+            r = F ();
+            if (r < 0) {
+                pos = chkp;
+                ast.n_nodes = n_nodes;
+                break;
+            }
+            l = add_node (tok.token_code, l, r);
+        }
+        return l;
+    }
+
+    /* E -> T E', E' -> + T E' | - T E' | $ */
+    constexpr int
+    E () {
+
+        int l = T ();
+
+        while (l >= 0) {
+
+            int chkp = pos, n_nodes = ast.n_nodes;
+            token_t tok = lex ();
+            int r = -1;
+
+            if (tok.token_code != MATH_PLUS && tok.token_code != MATH_MINUS) {
+                pos = chkp;
+                break;
+            }
+            r = T ();
+            if (r < 0) {
+                pos = chkp;
+                ast.n_nodes = n_nodes;
+                break;
+            }
+            l = add_node (tok.token_code, l, r);
+        }
+        return l;
+    }
+
+    /* Q -> E Ineq E | ( Q ) */
+    constexpr int
+    Q () {
+
+        int chkp = pos, n_nodes = ast.n_nodes;
+        int l = -1, r = -1;
+        token_t tok = {-1, std::string_view ()};
+
+        if (lex ().token_code == MATH_BRACKET_START) {
+            l = Q ();
+            if (l >= 0 && lex ().token_code == MATH_BRACKET_END) return l;
+        }
+        pos = chkp;
+        ast.n_nodes = n_nodes;
+
+        l = E ();
+        if (l < 0) return -1;
+
+        tok = lex ();
+        switch (tok.token_code) {
+            case MATH_LESS_THAN:
+            case MATH_LESS_THAN_EQ:
+            case MATH_GREATER_THAN:
+            case MATH_EQ:
+            case MATH_NOT_EQ:
+                break;
+            default:
+                fail ("expected an inequality");
+                pos = chkp;
+                ast.n_nodes = n_nodes;
+                return -1;
+        }
+
+        r = E ();
+        if (r < 0) {
+            pos = chkp;
+            ast.n_nodes = n_nodes;
+            return -1;
+        }
+        return add_node (tok.token_code, l, r);
+    }
+
+    /* Inequalities combined with 'and', binding tighter than 'or', and brackets */
+    constexpr int
+    K () {
+
+        int chkp = pos, n_nodes = ast.n_nodes;
+        int l = -1;
+
+        if (lex ().token_code == MATH_BRACKET_START) {
+            l = S ();
+            if (l >= 0 && lex ().token_code == MATH_BRACKET_END) return l;
+        }
+        pos = chkp;
+        ast.n_nodes = n_nodes;
+        return Q ();
+    }
+
+    constexpr int
+    logical (int token_code, int (parser_t::*operand) ()) {
+
+        int l = (this->*operand) ();
+
+        while (l >= 0) {
+
+            int chkp = pos, n_nodes = ast.n_nodes;
+            int r = -1;
+
+            if (lex ().token_code != token_code) {
+                pos = chkp;
+                break;
+            }
+            r = (this->*operand) ();
+            if (r < 0) {
+                pos = chkp;
+                ast.n_nodes = n_nodes;
+                break;
+            }
+            l = add_node (token_code, l, r);
+        }
+        return l;
+    }
+
+    constexpr int
+    J () {
+
+        return logical (MATH_AND, &parser_t::K);
+    }
+
+    constexpr int
+    S () {
+
+        return logical (MATH_OR, &parser_t::J);
+    }
+
+    constexpr bool
+    at_end () {
+
+        int chkp = pos;
+        bool end = lex ().token_code == -1;
+        pos = chkp;
+        return end;
+    }
+
+public :
+
+    ast_t ast;
+
+    constexpr
+    parser_t (std::string_view src) : src (src), pos (0), ast () {}
+
+    constexpr void
+    parse () {
+
+        /* Condition first, then math expression, as Appln does */
+        ast.root = S ();
+        if (ast.root >= 0 && at_end ()) {
+            ast.err = nullptr;
+            return;
+        }
+
+        pos = 0;
+        ast.n_nodes = 0;
+        ast.root = E ();
+        if (ast.root >= 0 && at_end ()) {
+            ast.err = nullptr;
+            return;
+        }
+
+        ast.root = -1;
+        fail ("syntax error");
+    }
+};
+
+constexpr ast_t
+parse (std::string_view src) {
+
+    parser_t parser (src);
+    parser.parse ();
+    return parser.ast;
+}
+
+/* ====================x================x=================== */
+/* Operand Bindings */
+
+template <class T>
+struct dependent_false : std::false_type {};
+
+template <class T>
+struct dtype_of;
+
+template <> struct dtype_of<int64_t> { static constexpr mexpr_dtypes_t value = MEXPR_DTYPE_INT; };
+template <> struct dtype_of<double> { static constexpr mexpr_dtypes_t value = MEXPR_DTYPE_DOUBLE; };
+template <> struct dtype_of<bool>   { static constexpr mexpr_dtypes_t value = MEXPR_DTYPE_BOOL; };
+template <> struct dtype_of<std::string_view> { static constexpr mexpr_dtypes_t value = MEXPR_DTYPE_STRING; };
+
+/* Value of an operand as the dtype MexprDb sees */
+template <class T>
+constexpr auto
+canonical (const T &val) {
+
+    if constexpr (std::is_same_v<T, bool>) {
+        return val;
+    }
+    else if constexpr (std::is_integral_v<T> || std::is_enum_v<T>) {
+        return (int64_t)val;
+    }
+    else if constexpr (std::is_floating_point_v<T>) {
+        return (double)val;
+    }
+    else if constexpr (std::is_convertible_v<const T &, std::string_view>) {
+        return std::string_view (val);
+    }
+    else {
+        static_assert (dependent_false<T>::value,
+                            "MexprConstexpr : operand must be integral, floating point or string");
+    }
+}
+
+template <class Name, class Getter>
+struct binding_t {
+
+    Getter getter;
+
+    static constexpr std::string_view
+    name () {
+
+        return Name::str ();
+    }
+
+    template <class Row>
+    constexpr auto
+    value (const Row &row) const {
+
+        if constexpr (std::is_member_object_pointer_v<Getter>) {
+            return canonical (row.*getter);
+        }
+        else if constexpr (std::is_invocable_v<const Getter &, const Row &>) {
+            return canonical (getter (row));
+        }
+        else {
+            return canonical (getter ());
+        }
+    }
+};
+
+template <class Name, class Getter>
+constexpr binding_t<Name, Getter>
+bind (Name, Getter getter) {
+
+    return binding_t<Name, Getter> {getter};
+}
+
+template <class... B>
+constexpr int
+binding_index (std::string_view name) {
+
+    std::string_view names[] = {B::name ()..., std::string_view ()};
+
+    for (int i = 0; i < (int)sizeof...(B); i++) {
+        if (names[i] == name) return i;
+    }
+    return -1;
+}
+
+/* ====================x================x=================== */
+/* Operators, the formulas of the MexprDb kernels */
+
+template <class T>
+constexpr bool is_numeric_v = std::is_same_v<T, int64_t> || std::is_same_v<T, double>;
+
+template <class T>
+constexpr double
+as_double (T val) {
+
+    return (double)val;
+}
+
+/* mexpr_cmp_int_double( ) of MexprDb, 2 if unordered */
+constexpr int
+cmp_int_double (int64_t i, double d) {
+
+    if (d != d) return 2;
+    if (d >= 9223372036854775808.0) return -1;
+    if (d < -9223372036854775808.0) return 1;
+
+    int64_t d_int = (int64_t)d;
+    if (i != d_int) return i < d_int ? -1 : 1;
+    double d_frac = d - (double)d_int;
+    if (d_frac == 0) return 0;
+    return d_frac > 0 ? -1 : 1;
+}
+
+/* l <=> r, exact when one is an integer and the other a double */
+template <class L, class R>
+constexpr int
+cmp_numeric (L l, R r) {
+
+    if constexpr (std::is_same_v<L, int64_t> && std::is_same_v<R, double>) {
+        return cmp_int_double (l, r);
+    }
+    else if constexpr (std::is_same_v<L, double> && std::is_same_v<R, int64_t>) {
+        int cmp = cmp_int_double (r, l);
+        return cmp == 2 ? cmp : -cmp;
+    }
+    else {
+        if (l != l || r != r) return 2;
+        return l < r ? -1 : (l > r ? 1 : 0);
+    }
+}
+
+/* math_plus_opr_fn_string_string_string */
+inline std::string_view
+concat (std::string_view l, std::string_view r) {
+
+    static char str_out[MEXPR_MAX_STRING_VAL_LEN + MEXPR_MAX_STRING_VAL_LEN];
+    size_t l_len = l.size () < sizeof (str_out) - 1 ? l.size () : sizeof (str_out) - 1;
+    size_t r_len = r.size () < sizeof (str_out) - 1 - l_len ? r.size () : sizeof (str_out) - 1 - l_len;
+
+    memcpy (str_out, l.data (), l_len);
+    memcpy (str_out + l_len, r.data (), r_len);
+    str_out[l_len + r_len] = '\0';
+    return std::string_view (str_out, l_len + r_len);
+}
+
+#define MEXPR_CT_UNSUPPORTED \
+    "MexprConstexpr : operator not supported on these dtypes, see MexprDb"
+
+template <int Opr, class L>
+constexpr auto
+apply_unary (L l, bool &ok) {
+
+    static_assert (is_numeric_v<L>, MEXPR_CT_UNSUPPORTED);
+
+    if constexpr (Opr == MATH_SQR && std::is_same_v<L, int64_t>) {
+        int64_t res = 0;
+        ok &= !__builtin_mul_overflow (l, l, &res);
+        return res;
+    }
+    else if constexpr (Opr == MATH_SQR) {
+        return l * l;
+    }
+    else if constexpr (Opr == MATH_SQRT) {
+        return sqrt (as_double (l));
+    }
+    else if constexpr (Opr == MATH_SIN) {
+        return sin (as_double (l));
+    }
+    else if constexpr (Opr == MATH_COS) {
+        return cos (as_double (l));
+    }
+    else {
+        static_assert (dependent_false<L>::value, MEXPR_CT_UNSUPPORTED);
+    }
+}
+
+template <int Opr, class L, class R>
+constexpr auto
+apply_binary (L l, R r, bool &ok) {
+
+    constexpr bool ints = std::is_same_v<L, int64_t> && std::is_same_v<R, int64_t>;
+    constexpr bool nums = is_numeric_v<L> && is_numeric_v<R>;
+    constexpr bool strs = std::is_same_v<L, std::string_view> &&
+                                    std::is_same_v<R, std::string_view>;
+    constexpr bool bools = std::is_same_v<L, bool> && std::is_same_v<R, bool>;
+
+    if constexpr (Opr == MATH_LESS_THAN_EQ || Opr == MATH_LESS_THAN ||
+                        Opr == MATH_GREATER_THAN) {
+
+        static_assert (nums, MEXPR_CT_UNSUPPORTED);
+        int cmp = cmp_numeric (l, r);
+        if constexpr (Opr == MATH_LESS_THAN_EQ) return cmp <= 0;
+        else if constexpr (Opr == MATH_LESS_THAN) return cmp < 0;
+        else return cmp == 1;
+    }
+    else if constexpr (Opr == MATH_EQ || Opr == MATH_NOT_EQ) {
+
+        static_assert (nums || strs, MEXPR_CT_UNSUPPORTED);
+        bool eq = false;
+        if constexpr (strs) eq = (l == r);
+        else eq = (cmp_numeric (l, r) == 0);
+        return Opr == MATH_EQ ? eq : !eq;
+    }
+    else if constexpr (Opr == MATH_AND || Opr == MATH_OR) {
+
+        static_assert (bools, MEXPR_CT_UNSUPPORTED);
+        /* Both operands are evaluated, like mexpt_evaluate( ) */
+        return Opr == MATH_AND ? (l && r) : (l || r);
+    }
+    else if constexpr (Opr == MATH_PLUS && strs) {
+
+        return concat (l, r);
+    }
+    else if constexpr (Opr == MATH_PLUS || Opr == MATH_MINUS || Opr == MATH_MUL) {
+
+        static_assert (nums, MEXPR_CT_UNSUPPORTED);
+        if constexpr (ints) {
+            /* Overflow invalidates the result */
+            int64_t res = 0;
+            if constexpr (Opr == MATH_PLUS) ok &= !__builtin_add_overflow (l, r, &res);
+            else if constexpr (Opr == MATH_MINUS) ok &= !__builtin_sub_overflow (l, r, &res);
+            else ok &= !__builtin_mul_overflow (l, r, &res);
+            return res;
+        }
+        else {
+            if constexpr (Opr == MATH_PLUS) return as_double (l) + as_double (r);
+            else if constexpr (Opr == MATH_MINUS) return as_double (l) - as_double (r);
+            else return as_double (l) * as_double (r);
+        }
+    }
+    else if constexpr (Opr == MATH_DIV) {
+
+        static_assert (nums, MEXPR_CT_UNSUPPORTED);
+        /* Zero divisor invalidates the result, the division itself is done
+            by 1 so that it stays a constant expression */
+        ok &= (as_double (r) != 0);
+        if constexpr (ints) {
+            ok &= !(l == INT64_MIN && r == -1);
+            if (r == 0) return (int64_t)0;
+            if (r == -1) return (int64_t)(0 - (uint64_t)l);
+            return l / r;
+        }
+        else {
+            return as_double (l) / (as_double (r) != 0 ? as_double (r) : 1.0);
+        }
+    }
+    else if constexpr (Opr == MATH_MAX || Opr == MATH_MIN) {
+
+        static_assert (nums || strs, MEXPR_CT_UNSUPPORTED);
+        if constexpr (strs) {
+            if constexpr (Opr == MATH_MAX) return l.size () > r.size () ? l : r;
+            else return l.size () < r.size () ? l : r;
+        }
+        else if constexpr (ints) {
+            if constexpr (Opr == MATH_MAX) return l > r ? l : r;
+            else return l < r ? l : r;
+        }
+        else {
+            if constexpr (Opr == MATH_MAX)
+                return as_double (l) > as_double (r) ? as_double (l) : as_double (r);
+            else
+                return as_double (l) < as_double (r) ? as_double (l) : as_double (r);
+        }
+    }
+    else if constexpr (Opr == MATH_POW) {
+
+        static_assert (nums, MEXPR_CT_UNSUPPORTED);
+        return pow (as_double (l), as_double (r));
+    }
+    else {
+        static_assert (dependent_false<L>::value, MEXPR_CT_UNSUPPORTED);
+    }
+}
+
+/* ====================x================x=================== */
+/* Expression Templates */
+
+template <class Src>
+struct program_t {
+
+    static constexpr ast_t ast = parse (Src::str ());
+    static_assert (ast.err == nullptr,
+                        "MexprConstexpr : expression does not parse, see program_t<>::ast.err");
+};
+
+template <class P, int I>
+struct node_t {
+
+    template <class Row, class... B>
+    static constexpr auto
+    eval (const Row &row, const std::tuple<const B &...> &binds, bool &ok) {
+
+        constexpr ast_node_t node = P::ast.nodes[I];
+
+        if constexpr (node.token_code == MATH_INTEGER_VALUE) {
+            return P::ast.nodes[I].int_val;
+        }
+        else if constexpr (node.token_code == MATH_DOUBLE_VALUE) {
+            return P::ast.nodes[I].d_val;
+        }
+        else if constexpr (node.token_code == MATH_STRING_VALUE) {
+            return P::ast.nodes[I].text;
+        }
+        else if constexpr (node.token_code == MATH_IDENTIFIER ||
+                                node.token_code == MATH_IDENTIFIER_IDENTIFIER) {
+            constexpr int k = binding_index<B...> (P::ast.nodes[I].text);
+            static_assert (k >= 0, "MexprConstexpr : operand has no binding");
+            return std::get<k> (binds).value (row);
+        }
+        else if constexpr (node.right < 0) {
+            return apply_unary<node.token_code> (
+                            node_t<P, node.left>::eval (row, binds, ok), ok);
+        }
+        else {
+            auto l = node_t<P, node.left>::eval (row, binds, ok);
+            auto r = node_t<P, node.right>::eval (row, binds, ok);
+            return apply_binary<node.token_code> (l, r, ok);
+        }
+    }
+};
+
+template <class T>
+struct result_t {
+
+    T value;
+    bool valid;
+    static constexpr mexpr_dtypes_t dtype = dtype_of<T>::value;
+};
+
+template <class Src>
+struct expr_t {
+
+    using program = program_t<Src>;
+
+    template <class Row, class... B>
+    constexpr auto
+    operator() (const Row &row, const B &... binds) const {
+
+        bool ok = true;
+        auto val = node_t<program, program::ast.root>::eval (
+                            row, std::tuple<const B &...> (binds...), ok);
+        return result_t<decltype (val)> {val, ok};
+    }
+};
+
+template <class Src>
+constexpr expr_t<Src>
+make_expr (Src) {
+
+    return expr_t<Src> {};
+}
+
+} /* namespace mexpr_ct */
+
+/* The literal is carried in the type of a local class, so that it is a
+    constant in every instantiation */
+#define MEXPR_CT_EXPR(str_literal)                                              \
+    ::mexpr_ct::make_expr ([] {                                                 \
+        struct src_ { static constexpr ::std::string_view str () { return str_literal; } }; \
+        return src_ {}; } ())
+
+#define MEXPR_CT_BIND(name_literal, getter)                                     \
+    ::mexpr_ct::bind ([] {                                                      \
+        struct name_ { static constexpr ::std::string_view str () { return name_literal; } }; \
+        return name_ {}; } (), getter)
+
+#endif
@@ -0,0 +1,74 @@
+#include "MexprConstexpr.h"
+
+/* Self Test of MexprConstexpr.h, every check is a static_assert : the file
+    compiles if and only if the test passes, see compile.sh */
+
+namespace mexpr_ct {
+namespace self_test {
+
+struct row_t {
+
+    int n;
+    double a;
+    const char *s;
+};
+
+inline constexpr row_t row = {3, 1.5, "abc"};
+inline constexpr auto b_n = MEXPR_CT_BIND ("n", &row_t::n);
+inline constexpr auto b_a = MEXPR_CT_BIND ("a", &row_t::a);
+inline constexpr auto b_s = MEXPR_CT_BIND ("s", &row_t::s);
+inline constexpr auto b_xy = MEXPR_CT_BIND ("x.y", [] (const row_t &r) { return r.a * 2; });
+
+/* Lexer follows Parser.l */
+static_assert (parse ("sqrtx").nodes[0].token_code == MATH_IDENTIFIER);
+static_assert (parse ("-5 + n").nodes[0].int_val == -5);
+static_assert (parse (".25").nodes[0].d_val == 0.25);
+static_assert (parse ("x.y").nodes[0].token_code == MATH_IDENTIFIER_IDENTIFIER);
+static_assert (parse ("'a b'").nodes[0].text == "a b");
+
+/* Grammar of ExpressionParser.c */
+static_assert (parse ("a +").err != nullptr);
+static_assert (parse ("a > b > c").err != nullptr);
+static_assert (parse ("mmax(a)").err != nullptr);
+static_assert (parse ("sqrt a").err != nullptr);
+static_assert (parse ("(a > b) and ((a + 1) * 2 = b)").err == nullptr);
+
+/* dtypes and values of MexprDb */
+inline constexpr auto e_int = MEXPR_CT_EXPR ("n * 2 + 1");
+static_assert (e_int (row, b_n).value == 7 && e_int (row, b_n).dtype == MEXPR_DTYPE_INT);
+
+inline constexpr auto e_idiv = MEXPR_CT_EXPR ("n / 2");
+static_assert (e_idiv (row, b_n).value == 1 && e_idiv (row, b_n).dtype == MEXPR_DTYPE_INT);
+
+inline constexpr auto e_big = MEXPR_CT_EXPR ("n + 9007199254740992");
+static_assert (e_big (row, b_n).value == 9007199254740995 && e_big (row, b_n).valid);
+
+inline constexpr auto e_ovf = MEXPR_CT_EXPR ("n * 4611686018427387904");
+static_assert (!e_ovf (row, b_n).valid);
+
+inline constexpr auto e_exact = MEXPR_CT_EXPR ("9007199254740993 > 9007199254740992 * 1.0");
+static_assert (e_exact (row).value);
+
+inline constexpr auto e_div0 = MEXPR_CT_EXPR ("a / (n - 3)");
+static_assert (!e_div0 (row, b_n, b_a).valid);
+
+inline constexpr auto e_prec = MEXPR_CT_EXPR ("1 + 2 * 3 - 4 / 2 - a - 0.25");
+static_assert (e_prec (row, b_a).value == 3.25);
+
+inline constexpr auto e_fn = MEXPR_CT_EXPR ("sqr(n) - mmax(n, 4) + mmin(n, a)");
+static_assert (e_fn (row, b_n, b_a).value == 6.5);
+
+inline constexpr auto e_log = MEXPR_CT_EXPR ("n > 2 and a <= 1.5 or n = 7");
+static_assert (e_log (row, b_n, b_a).value && e_log (row, b_n, b_a).dtype == MEXPR_DTYPE_BOOL);
+
+inline constexpr auto e_grp = MEXPR_CT_EXPR ("n > 2 and (a > 2 or n = 7)");
+static_assert (!e_grp (row, b_n, b_a).value);
+
+inline constexpr auto e_str = MEXPR_CT_EXPR ("s = 'abc' and mmax(s, 'de') != 'de'");
+static_assert (e_str (row, b_s).value);
+
+inline constexpr auto e_lambda = MEXPR_CT_EXPR ("x.y * n");
+static_assert (e_lambda (row, b_xy, b_n).value == 9.0);
+
+} /* namespace self_test */
+} /* namespace mexpr_ct */
@@ -1,11 +1,33 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <assert.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
 #include "MexprEnums.h"
+#include "MexprArena.h"
 
-typedef  mexpr_var_t (*operator_fn_ptr_t) (mexpr_var_t , mexpr_var_t);
+/* Strings are views, equal if of same length and bytes. Interned strings
+    are equal only if they are the same entry of MexprIntern */
+static inline bool
+mexpr_str_equal (mexpr_var_t lrc, mexpr_var_t rrc) {
+
+    if (lrc.u.str_val == rrc.u.str_val) return lrc.str_len == rrc.str_len;
+    if (lrc.str_interned && rrc.str_interned) return false;
+    return lrc.str_len == rrc.str_len &&
+                memcmp (lrc.u.str_val, rrc.u.str_val, lrc.str_len) == 0;
+}
+
+/* Set while mexpt_optimize( ) folds literals : a kernel that fails leaves
+    the node for the evaluation, which reports the error */
+static __thread bool mexpr_db_quiet;
+
+static inline void
+mexpr_db_report (const char *err) {
+
+    if (!mexpr_db_quiet) printf ("Error : %s\n", err);
+}
 
 //MATH_LESS_THAN_EQ
 static inline mexpr_var_t  
@@ -17,8 +39,8 @@ math_less_than_eq_opr_fn_int_int_bool (mexpr_var_t lrc, mexpr_var_t rrc) {
 
     ret.dtype = MEXPR_DTYPE_BOOL;
 
-    int lopnd_val = lrc.u.int_val;
-    int ropnd_val = rrc.u.int_val;
+    int64_t lopnd_val = lrc.u.int_val;
+    int64_t ropnd_val = rrc.u.int_val;
 
     ret.u.b_val = lopnd_val <= ropnd_val;
     return ret;
@@ -33,10 +55,10 @@ math_less_than_eq_opr_fn_int_double_bool (mexpr_var_t lrc, mexpr_var_t rrc) {
 
     ret.dtype = MEXPR_DTYPE_BOOL;
 
-    int lopnd_val = lrc.u.int_val;
+    int64_t lopnd_val = lrc.u.int_val;
     double ropnd_val = rrc.u.d_val;
 
-    ret.u.b_val = ((double)lopnd_val <= ropnd_val);
+    ret.u.b_val = mexpr_cmp_int_double (lopnd_val, ropnd_val) <= 0;
     return ret;
 }
 
@@ -50,9 +72,9 @@ math_less_than_eq_opr_fn_double_int_bool (mexpr_var_t lrc, mexpr_var_t rrc) {
     ret.dtype = MEXPR_DTYPE_BOOL;
 
     double lopnd_val = lrc.u.d_val;
-    int ropnd_val = rrc.u.int_val;
+    int64_t ropnd_val = rrc.u.int_val;
 
-    ret.u.b_val = lopnd_val <= (double)ropnd_val;
+    ret.u.b_val = mexpr_cmp_double_int (lopnd_val, ropnd_val) <= 0;
     return ret;
 }
 
@@ -65,8 +87,8 @@ math_less_than_eq_opr_fn_double_double_bool (mexpr_var_t lrc, mexpr_var_t rrc) {
 
     ret.dtype = MEXPR_DTYPE_BOOL;
 
-    double lopnd_val = lrc.u.int_val;
-    double ropnd_val = rrc.u.int_val;
+    double lopnd_val = lrc.u.d_val;
+    double ropnd_val = rrc.u.d_val;
 
     ret.u.b_val = lopnd_val <= ropnd_val;
     return ret;
@@ -83,8 +105,8 @@ math_less_than_opr_fn_int_int_bool (mexpr_var_t lrc, mexpr_var_t rrc) {
 
     ret.dtype = MEXPR_DTYPE_BOOL;
 
-    int lopnd_val = lrc.u.int_val;
-    int ropnd_val = rrc.u.int_val;
+    int64_t lopnd_val = lrc.u.int_val;
+    int64_t ropnd_val = rrc.u.int_val;
 
     ret.u.b_val = lopnd_val < ropnd_val;
     return ret;
@@ -99,10 +121,10 @@ math_less_than_opr_fn_int_double_bool (mexpr_var_t lrc, mexpr_var_t rrc) {
 
     ret.dtype = MEXPR_DTYPE_BOOL;
 
-    int lopnd_val = lrc.u.int_val;
+    int64_t lopnd_val = lrc.u.int_val;
     double ropnd_val = rrc.u.d_val;
 
-    ret.u.b_val = (double)lopnd_val < ropnd_val;
+    ret.u.b_val = mexpr_cmp_int_double (lopnd_val, ropnd_val) < 0;
     return ret;
 }
 
@@ -116,9 +138,9 @@ math_less_than_opr_fn_double_int_bool (mexpr_var_t lrc, mexpr_var_t rrc) {
     ret.dtype = MEXPR_DTYPE_BOOL;
 
     double lopnd_val = lrc.u.d_val;
-    int ropnd_val = rrc.u.int_val;
+    int64_t ropnd_val = rrc.u.int_val;
 
-    ret.u.b_val = lopnd_val < (double)ropnd_val;
+    ret.u.b_val = mexpr_cmp_double_int (lopnd_val, ropnd_val) < 0;
     return ret;
 }
 
@@ -149,8 +171,8 @@ math_greater_than_opr_fn_int_int_bool (mexpr_var_t lrc, mexpr_var_t rrc) {
 
     ret.dtype = MEXPR_DTYPE_BOOL;
 
-    int lopnd_val = lrc.u.int_val;
-    int ropnd_val = rrc.u.int_val;
+    int64_t lopnd_val = lrc.u.int_val;
+    int64_t ropnd_val = rrc.u.int_val;
 
     ret.u.b_val = lopnd_val > ropnd_val;
     return ret;
@@ -165,10 +187,10 @@ math_greater_than_opr_fn_int_double_bool (mexpr_var_t lrc, mexpr_var_t rrc) {
 
     ret.dtype = MEXPR_DTYPE_BOOL;
 
-    int lopnd_val = lrc.u.int_val;
+    int64_t lopnd_val = lrc.u.int_val;
     double ropnd_val = rrc.u.d_val;
 
-    ret.u.b_val = (double)lopnd_val > ropnd_val;
+    ret.u.b_val = mexpr_cmp_int_double (lopnd_val, ropnd_val) == 1;
     return ret;
 }
 
@@ -182,9 +204,9 @@ math_greater_than_opr_fn_double_int_bool (mexpr_var_t lrc, mexpr_var_t rrc) {
     ret.dtype = MEXPR_DTYPE_BOOL;
 
     double lopnd_val = lrc.u.d_val;
-    int ropnd_val = rrc.u.int_val;
+    int64_t ropnd_val = rrc.u.int_val;
 
-    ret.u.b_val = lopnd_val > (double)ropnd_val;
+    ret.u.b_val = mexpr_cmp_double_int (lopnd_val, ropnd_val) == 1;
     return ret;
 }
 
@@ -214,8 +236,8 @@ math_equal_opr_fn_int_int_bool (mexpr_var_t lrc, mexpr_var_t rrc) {
 
     ret.dtype = MEXPR_DTYPE_BOOL;
 
-    int lopnd_val = lrc.u.int_val;
-    int ropnd_val = rrc.u.int_val;
+    int64_t lopnd_val = lrc.u.int_val;
+    int64_t ropnd_val = rrc.u.int_val;
 
     ret.u.b_val = (lopnd_val == ropnd_val);
     return ret;
@@ -230,10 +252,10 @@ math_equal_opr_fn_int_double_bool (mexpr_var_t lrc, mexpr_var_t rrc) {
 
     ret.dtype = MEXPR_DTYPE_BOOL;
 
-    int lopnd_val = lrc.u.int_val;
+    int64_t lopnd_val = lrc.u.int_val;
     double ropnd_val = rrc.u.d_val;
 
-    ret.u.b_val = ((double)lopnd_val == ropnd_val);
+    ret.u.b_val = (mexpr_cmp_int_double (lopnd_val, ropnd_val) == 0);
     return ret;
 }
 
@@ -247,9 +269,9 @@ math_equal_opr_fn_double_int_bool (mexpr_var_t lrc, mexpr_var_t rrc) {
     ret.dtype = MEXPR_DTYPE_BOOL;
 
     double lopnd_val = lrc.u.d_val;
-    int ropnd_val = rrc.u.int_val;
+    int64_t ropnd_val = rrc.u.int_val;
 
-    ret.u.b_val = (lopnd_val == (double)ropnd_val);
+    ret.u.b_val = (mexpr_cmp_double_int (lopnd_val, ropnd_val) == 0);
     return ret;
 }
 
@@ -278,10 +300,7 @@ math_equal_opr_fn_string_string_bool (mexpr_var_t lrc, mexpr_var_t rrc) {
 
     ret.dtype = MEXPR_DTYPE_BOOL;
 
-    unsigned char* lopnd_val = lrc.u.str_val;
-    unsigned char* ropnd_val = rrc.u.str_val;
-
-    ret.u.b_val = (strcmp ( lopnd_val,  ropnd_val) == 0);
+    ret.u.b_val = mexpr_str_equal (lrc, rrc);
     return ret;
 }
 
@@ -297,8 +316,8 @@ math_nequal_opr_fn_int_int_bool (mexpr_var_t lrc, mexpr_var_t rrc) {
 
     ret.dtype = MEXPR_DTYPE_BOOL;
 
-    int lopnd_val = lrc.u.int_val;
-    int ropnd_val = rrc.u.int_val;
+    int64_t lopnd_val = lrc.u.int_val;
+    int64_t ropnd_val = rrc.u.int_val;
 
     ret.u.b_val = (lopnd_val != ropnd_val);
     return ret;
@@ -313,10 +332,10 @@ math_nequal_opr_fn_int_double_bool (mexpr_var_t lrc, mexpr_var_t rrc) {
 
     ret.dtype = MEXPR_DTYPE_BOOL;
 
-    int lopnd_val = lrc.u.int_val;
+    int64_t lopnd_val = lrc.u.int_val;
     double ropnd_val = rrc.u.d_val;
 
-    ret.u.b_val = ((double)lopnd_val != ropnd_val);
+    ret.u.b_val = (mexpr_cmp_int_double (lopnd_val, ropnd_val) != 0);
     return ret;
 }
 
@@ -330,9 +349,9 @@ math_nequal_opr_fn_double_int_bool (mexpr_var_t lrc, mexpr_var_t rrc) {
     ret.dtype = MEXPR_DTYPE_BOOL;
 
     double lopnd_val = lrc.u.d_val;
-    int ropnd_val = rrc.u.int_val;
+    int64_t ropnd_val = rrc.u.int_val;
 
-    ret.u.b_val = (lopnd_val != (double)ropnd_val);
+    ret.u.b_val = (mexpr_cmp_double_int (lopnd_val, ropnd_val) != 0);
     return ret;
 }
 
@@ -361,10 +380,7 @@ math_nequal_opr_fn_string_string_bool (mexpr_var_t lrc, mexpr_var_t rrc) {
 
     ret.dtype = MEXPR_DTYPE_BOOL;
 
-    unsigned char* lopnd_val = lrc.u.str_val;
-    unsigned char* ropnd_val = rrc.u.str_val;
-
-    ret.u.b_val = (strcmp ( lopnd_val,  ropnd_val) != 0);
+    ret.u.b_val = !mexpr_str_equal (lrc, rrc);
     return ret;
 }
 
@@ -407,7 +423,10 @@ math_mul_opr_fn_int_int_int  (mexpr_var_t lrc, mexpr_var_t rrc) {
 
     ret.dtype = MEXPR_DTYPE_INT;
 
-    ret.u.int_val = lrc.u.int_val * rrc.u.int_val;
+    if (__builtin_mul_overflow (lrc.u.int_val, rrc.u.int_val, &ret.u.int_val)) {
+        mexpr_db_report ("Integer Overflow");
+        ret.dtype = MEXPR_DTYPE_INVALID;
+    }
     return ret;
 }
 
@@ -453,21 +472,28 @@ math_mul_opr_fn_double_double_double  (mexpr_var_t lrc, mexpr_var_t rrc) {
 
 // MATH_DIV
 static inline mexpr_var_t  
-math_div_opr_fn_int_int_double (mexpr_var_t lrc, mexpr_var_t rrc) {
+math_div_opr_fn_int_int_int (mexpr_var_t lrc, mexpr_var_t rrc) {
 
     mexpr_var_t  ret;
     assert (lrc.dtype == MEXPR_DTYPE_INT);
     assert (rrc.dtype == MEXPR_DTYPE_INT);
 
-    ret.dtype = MEXPR_DTYPE_DOUBLE;
+    ret.dtype = MEXPR_DTYPE_INT;
 
     if (rrc.u.int_val == 0) {
-        printf ("Error : Divide by Zero\n");
+        mexpr_db_report ("Divide by Zero");
         ret.dtype = MEXPR_DTYPE_INVALID;
         return ret;
     }
-    
-    ret.u.d_val= (double) (lrc.u.int_val / rrc.u.int_val);
+
+    /* Truncating division, INT64_MIN / -1 is the only overflow */
+    if (lrc.u.int_val == INT64_MIN && rrc.u.int_val == -1) {
+        mexpr_db_report ("Integer Overflow");
+        ret.dtype = MEXPR_DTYPE_INVALID;
+        return ret;
+    }
+
+    ret.u.int_val = lrc.u.int_val / rrc.u.int_val;
     return ret;
 }
 
@@ -481,7 +507,7 @@ math_div_opr_fn_int_double_double (mexpr_var_t lrc, mexpr_var_t rrc) {
     ret.dtype = MEXPR_DTYPE_DOUBLE;
 
     if (rrc.u.d_val == 0) {
-        printf ("Error : Divide by Zero\n");
+        mexpr_db_report ("Divide by Zero");
         ret.dtype = MEXPR_DTYPE_INVALID;
         return ret;
     }
@@ -501,7 +527,7 @@ math_div_opr_fn_double_int_double (mexpr_var_t lrc, mexpr_var_t rrc) {
     ret.dtype = MEXPR_DTYPE_DOUBLE;
 
     if (rrc.u.int_val == 0) {
-        printf ("Error : Divide by Zero\n");
+        mexpr_db_report ("Divide by Zero");
         ret.dtype = MEXPR_DTYPE_INVALID;
         return ret;
     }
@@ -520,7 +546,7 @@ math_div_opr_fn_double_double_double (mexpr_var_t lrc, mexpr_var_t rrc) {
     ret.dtype = MEXPR_DTYPE_DOUBLE;
 
     if (rrc.u.d_val == 0) {
-        printf ("Error : Divide by Zero\n");
+        mexpr_db_report ("Divide by Zero");
         ret.dtype = MEXPR_DTYPE_INVALID;
         return ret;
     }
@@ -539,7 +565,10 @@ math_sqr_opr_fn_int_nan_int (mexpr_var_t lrc, mexpr_var_t rrc) {
 
     ret.dtype = MEXPR_DTYPE_INT;
 
-    ret.u.int_val =  lrc.u.int_val * lrc.u.int_val;
+    if (__builtin_mul_overflow (lrc.u.int_val, lrc.u.int_val, &ret.u.int_val)) {
+        mexpr_db_report ("Integer Overflow");
+        ret.dtype = MEXPR_DTYPE_INVALID;
+    }
     return ret;
 }
 
@@ -641,12 +670,7 @@ math_max_opr_fn_string_string_string (mexpr_var_t lrc, mexpr_var_t rrc) {
     assert (lrc.dtype == MEXPR_DTYPE_STRING);
     assert (rrc.dtype == MEXPR_DTYPE_STRING);
 
-    ret.dtype = MEXPR_DTYPE_STRING;
-
-    int l_len = strlen (lrc.u.str_val);
-    int r_len = strlen (rrc.u.str_val);
-
-    ret.u.str_val = l_len > r_len ? lrc.u.str_val : rrc.u.str_val;
+    ret = lrc.str_len > rrc.str_len ? lrc : rrc;
     return ret;
 }
 
@@ -711,12 +735,7 @@ math_min_opr_fn_string_string_string (mexpr_var_t lrc, mexpr_var_t rrc) {
     assert (lrc.dtype == MEXPR_DTYPE_STRING);
     assert (rrc.dtype == MEXPR_DTYPE_STRING);
 
-    ret.dtype = MEXPR_DTYPE_STRING;
-
-    int l_len = strlen (lrc.u.str_val);
-    int r_len = strlen (rrc.u.str_val);
-
-    ret.u.str_val = l_len < r_len ? lrc.u.str_val : rrc.u.str_val;
+    ret = lrc.str_len < rrc.str_len ? lrc : rrc;
     return ret;
 }
 
@@ -730,7 +749,10 @@ math_plus_opr_fn_int_int_int  (mexpr_var_t lrc, mexpr_var_t rrc) {
 
     ret.dtype = MEXPR_DTYPE_INT;
 
-    ret.u.int_val = lrc.u.int_val + rrc.u.int_val;
+    if (__builtin_add_overflow (lrc.u.int_val, rrc.u.int_val, &ret.u.int_val)) {
+        mexpr_db_report ("Integer Overflow");
+        ret.dtype = MEXPR_DTYPE_INVALID;
+    }
     return ret;
 }
 
@@ -776,17 +798,26 @@ math_plus_opr_fn_double_double_double  (mexpr_var_t lrc, mexpr_var_t rrc) {
 static inline mexpr_var_t  
 math_plus_opr_fn_string_string_string (mexpr_var_t lrc, mexpr_var_t rrc) {
 
-    mexpr_var_t  ret;
-    static unsigned char str_out [MEXPR_MAX_STRING_VAL_LEN + MEXPR_MAX_STRING_VAL_LEN];
+    mexpr_var_t ret;
+    unsigned char *str_out;
+    uint32_t len = lrc.str_len + rrc.str_len;
 
     assert (lrc.dtype == MEXPR_DTYPE_STRING);
     assert (rrc.dtype == MEXPR_DTYPE_STRING);
 
-    ret.dtype = MEXPR_DTYPE_STRING;    
+    if (len > MEXPR_STR_LEN_MAX) {
+        mexpr_db_report ("String too long");
+        ret.dtype = MEXPR_DTYPE_INVALID;
+        return ret;
+    }
+
+    /* Owned by the arena of the evaluation, valid until it is reset */
+    str_out = (unsigned char *)mexpr_arena_alloc (mexpr_arena_current (), len + 1);
+    memcpy (str_out, lrc.u.str_val, lrc.str_len);
+    memcpy (str_out + lrc.str_len, rrc.u.str_val, rrc.str_len);
+    str_out[len] = '\0';
 
-    snprintf (str_out, sizeof (str_out), "%s%s", lrc.u.str_val, rrc.u.str_val);
-    ret.u.str_val = str_out;
-    return ret;
+    return mexpr_var_string (str_out, len);
 }
 
 // MATH_MINUS
@@ -799,7 +830,10 @@ math_minus_opr_fn_int_int_int  (mexpr_var_t lrc, mexpr_var_t rrc) {
 
     ret.dtype = MEXPR_DTYPE_INT;
 
-    ret.u.int_val = lrc.u.int_val -  rrc.u.int_val;
+    if (__builtin_sub_overflow (lrc.u.int_val, rrc.u.int_val, &ret.u.int_val)) {
+        mexpr_db_report ("Integer Overflow");
+        ret.dtype = MEXPR_DTYPE_INVALID;
+    }
     return ret;
 }
 
@@ -1142,7 +1176,7 @@ static operator_fn_ptr_t MexprDb[MATH_OPR_MAX][MEXPR_DTYPE_MAX][MEXPR_DTYPE_MAX]
 
         // ---------------  MATH_DIV
 
-        math_div_opr_fn_int_int_double, /* int , int */
+        math_div_opr_fn_int_int_int, /* int , int */
         math_div_opr_fn_int_double_double, /* int , double */
         math_opr_fn_not_supported, /* int , string*/
         math_opr_fn_not_supported, /* int , bool*/
@@ -1160,7 +1194,7 @@ static operator_fn_ptr_t MexprDb[MATH_OPR_MAX][MEXPR_DTYPE_MAX][MEXPR_DTYPE_MAX]
         math_opr_fn_not_supported,    /* bool , int */
         math_opr_fn_not_supported,    /* bool , double */
         math_opr_fn_not_supported,    /* bool , string*/
-        math_and_opr_fn_bol_bool_bool, /* bool , bool*/
+        math_opr_fn_not_supported, /* bool , bool*/
 
 
         // ---------------  MATH_SQR
@@ -1359,8 +1393,8 @@ static operator_fn_ptr_t MexprDb[MATH_OPR_MAX][MEXPR_DTYPE_MAX][MEXPR_DTYPE_MAX]
 
         math_pow_opr_fn_double_int_double, /* double , int */
         math_pow_opr_fn_double_double_double, /* double , double */
-        math_cos_opr_fn_double_nan_double, /* double , string*/
-        math_cos_opr_fn_double_nan_double, /* double , bool*/
+        math_opr_fn_not_supported, /* double , string*/
+        math_opr_fn_not_supported, /* double , bool*/
 
         math_opr_fn_not_supported, /* string , int */
         math_opr_fn_not_supported, /* string , double */
@@ -1375,607 +1409,158 @@ static operator_fn_ptr_t MexprDb[MATH_OPR_MAX][MEXPR_DTYPE_MAX][MEXPR_DTYPE_MAX]
 
 };
 
-typedef mexpr_dtypes_t (*operator_fn_dtypes_supported_ptr_t) (mexpr_dtypes_t , mexpr_dtypes_t);
-
-// MATH_LESS_THAN_EQ
-static mexpr_dtypes_t 
-math_less_than_eq_dtypes_supported (mexpr_dtypes_t ld, mexpr_dtypes_t rd) {
-
-    switch (ld) {
-
-        case MEXPR_DTYPE_INT:
-        case MEXPR_DTYPE_DOUBLE:
-            switch (rd) {
-                case MEXPR_DTYPE_INT:
-                case MEXPR_DTYPE_DOUBLE:
-                    return MEXPR_DTYPE_BOOL;
-                default:
-                    return MEXPR_DTYPE_INVALID;
-            }
-        break;
-        case MEXPR_DTYPE_UNKNOWN:
-            switch (rd) {
-                case MEXPR_DTYPE_INT:
-                case MEXPR_DTYPE_DOUBLE:
-                    return MEXPR_DTYPE_BOOL;
-                case MEXPR_DTYPE_UNKNOWN:
-                    return MEXPR_DTYPE_UNKNOWN;
-                default:
-                    return MEXPR_DTYPE_INVALID;
-            }            
-        break;
-        default:
-             return MEXPR_DTYPE_INVALID;
-    }
-}
-
-// MATH_LESS_THAN
-static mexpr_dtypes_t 
-math_less_than_dtypes_supported (mexpr_dtypes_t ld, mexpr_dtypes_t rd) {
-
-    switch (ld) {
-
-        case MEXPR_DTYPE_INT:
-        case MEXPR_DTYPE_DOUBLE:
-            switch (rd) {
-                case MEXPR_DTYPE_INT:
-                case MEXPR_DTYPE_DOUBLE:
-                    return MEXPR_DTYPE_BOOL;
-                default:
-                    return MEXPR_DTYPE_INVALID;
-            }
-        break;
-        case MEXPR_DTYPE_UNKNOWN:
-            switch (rd) {
-                case MEXPR_DTYPE_INT:
-                case MEXPR_DTYPE_DOUBLE:
-                    return MEXPR_DTYPE_BOOL;
-                case MEXPR_DTYPE_UNKNOWN:
-                    return MEXPR_DTYPE_UNKNOWN;
-                default:
-                    return MEXPR_DTYPE_INVALID;
-            }            
-        break;
-        default:
-             return MEXPR_DTYPE_INVALID;
-    }
-}
-
-// MATH_GREATER_THAN
-static mexpr_dtypes_t 
-math_greater_than_dtypes_supported (mexpr_dtypes_t ld, mexpr_dtypes_t rd) {
-
-    switch (ld) {
-
-        case MEXPR_DTYPE_INT:
-        case MEXPR_DTYPE_DOUBLE:
-            switch (rd) {
-                case MEXPR_DTYPE_INT:
-                case MEXPR_DTYPE_DOUBLE:
-                    return MEXPR_DTYPE_BOOL;
-                default:
-                    return MEXPR_DTYPE_INVALID;
-            }
-        break;
-        case MEXPR_DTYPE_UNKNOWN:
-            switch (rd) {
-                case MEXPR_DTYPE_INT:
-                case MEXPR_DTYPE_DOUBLE:
-                    return MEXPR_DTYPE_BOOL;
-                case MEXPR_DTYPE_UNKNOWN:
-                    return MEXPR_DTYPE_UNKNOWN;
-                default:
-                    return MEXPR_DTYPE_INVALID;
-            }            
-        break;
-        default:
-             return MEXPR_DTYPE_INVALID;
-    }
-}
-
-// MATH_EQ
-static mexpr_dtypes_t 
-math_eq_dtypes_supported (mexpr_dtypes_t ld, mexpr_dtypes_t rd) {
-
-        switch (ld) {
-
-        case MEXPR_DTYPE_INT:
-        case MEXPR_DTYPE_DOUBLE:
-            switch (rd) {
-                case MEXPR_DTYPE_INT:
-                case MEXPR_DTYPE_DOUBLE:
-                case MEXPR_DTYPE_UNKNOWN:
-                    return MEXPR_DTYPE_BOOL;
-                default:
-                    return MEXPR_DTYPE_INVALID;
-            }
-        break;
-        case MEXPR_DTYPE_STRING:
-            switch(rd) {
-                case MEXPR_DTYPE_STRING:
-                case MEXPR_DTYPE_UNKNOWN:
-                    return MEXPR_DTYPE_BOOL;
-                default:
-                    return MEXPR_DTYPE_INVALID;
-            }
-        break;
-        case MEXPR_DTYPE_UNKNOWN:
-            switch(rd) {
-                case MEXPR_DTYPE_STRING:
-                case MEXPR_DTYPE_INT:
-                case MEXPR_DTYPE_DOUBLE:
-                    return MEXPR_DTYPE_BOOL;
-                case MEXPR_DTYPE_UNKNOWN:
-                    return MEXPR_DTYPE_UNKNOWN;
-                default:
-                    return MEXPR_DTYPE_INVALID;
-            }            
-        break;
-        default:
-             return MEXPR_DTYPE_INVALID;
+/* dtype of the result of kernel MexprDb[opr][ld][rd], MEXPR_DTYPE_INVALID where
+    MexprDb has math_opr_fn_not_supported. Validation and kernel preselection
+    both read it, kernels are never run to find out : keep it in step with
+    MexprDb */
+#define MEXPR_DB_I  MEXPR_DTYPE_INT
+#define MEXPR_DB_D  MEXPR_DTYPE_DOUBLE
+#define MEXPR_DB_S  MEXPR_DTYPE_STRING
+#define MEXPR_DB_B  MEXPR_DTYPE_BOOL
+#define MEXPR_DB_X  MEXPR_DTYPE_INVALID
+
+static const mexpr_dtypes_t MexprDb_result_dtype[MATH_OPR_MAX][MEXPR_DTYPE_MAX][MEXPR_DTYPE_MAX] =
+    {
+        /* left \  right : int         double      string      bool */
+        // ---------------  MATH_LESS_THAN_EQ
+        {{MEXPR_DB_B, MEXPR_DB_B, MEXPR_DB_X, MEXPR_DB_X},     /* int */
+         {MEXPR_DB_B, MEXPR_DB_B, MEXPR_DB_X, MEXPR_DB_X},     /* double */
+         {MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X},     /* string */
+         {MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X}},    /* bool */
+        // ---------------  MATH_LESS_THAN
+        {{MEXPR_DB_B, MEXPR_DB_B, MEXPR_DB_X, MEXPR_DB_X},     /* int */
+         {MEXPR_DB_B, MEXPR_DB_B, MEXPR_DB_X, MEXPR_DB_X},     /* double */
+         {MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X},     /* string */
+         {MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X}},    /* bool */
+        // ---------------  MATH_GREATER_THAN
+        {{MEXPR_DB_B, MEXPR_DB_B, MEXPR_DB_X, MEXPR_DB_X},     /* int */
+         {MEXPR_DB_B, MEXPR_DB_B, MEXPR_DB_X, MEXPR_DB_X},     /* double */
+         {MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X},     /* string */
+         {MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X}},    /* bool */
+        // ---------------  MATH_EQ
+        {{MEXPR_DB_B, MEXPR_DB_B, MEXPR_DB_X, MEXPR_DB_X},     /* int */
+         {MEXPR_DB_B, MEXPR_DB_B, MEXPR_DB_X, MEXPR_DB_X},     /* double */
+         {MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_B, MEXPR_DB_X},     /* string */
+         {MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X}},    /* bool */
+        // ---------------  MATH_NOT_EQ
+        {{MEXPR_DB_B, MEXPR_DB_B, MEXPR_DB_X, MEXPR_DB_X},     /* int */
+         {MEXPR_DB_B, MEXPR_DB_B, MEXPR_DB_X, MEXPR_DB_X},     /* double */
+         {MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_B, MEXPR_DB_X},     /* string */
+         {MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X}},    /* bool */
+        // ---------------  MATH_OR
+        {{MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X},     /* int */
+         {MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X},     /* double */
+         {MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X},     /* string */
+         {MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_B}},    /* bool */
+        // ---------------  MATH_AND
+        {{MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X},     /* int */
+         {MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X},     /* double */
+         {MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X},     /* string */
+         {MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_B}},    /* bool */
+        // ---------------  MATH_MUL
+        {{MEXPR_DB_I, MEXPR_DB_D, MEXPR_DB_X, MEXPR_DB_X},     /* int */
+         {MEXPR_DB_D, MEXPR_DB_D, MEXPR_DB_X, MEXPR_DB_X},     /* double */
+         {MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X},     /* string */
+         {MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X}},    /* bool */
+        // ---------------  MATH_DIV
+        {{MEXPR_DB_I, MEXPR_DB_D, MEXPR_DB_X, MEXPR_DB_X},     /* int */
+         {MEXPR_DB_D, MEXPR_DB_D, MEXPR_DB_X, MEXPR_DB_X},     /* double */
+         {MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X},     /* string */
+         {MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X}},    /* bool */
+        // ---------------  MATH_SQR, unary : right operand is ignored
+        {{MEXPR_DB_I, MEXPR_DB_I, MEXPR_DB_I, MEXPR_DB_I},     /* int */
+         {MEXPR_DB_D, MEXPR_DB_D, MEXPR_DB_D, MEXPR_DB_D},     /* double */
+         {MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X},     /* string */
+         {MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X}},    /* bool */
+        // ---------------  MATH_SQRT, unary
+        {{MEXPR_DB_D, MEXPR_DB_D, MEXPR_DB_D, MEXPR_DB_D},     /* int */
+         {MEXPR_DB_D, MEXPR_DB_D, MEXPR_DB_D, MEXPR_DB_D},     /* double */
+         {MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X},     /* string */
+         {MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X}},    /* bool */
+        // ---------------  MATH_MAX
+        {{MEXPR_DB_I, MEXPR_DB_D, MEXPR_DB_X, MEXPR_DB_X},     /* int */
+         {MEXPR_DB_D, MEXPR_DB_D, MEXPR_DB_X, MEXPR_DB_X},     /* double */
+         {MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_S, MEXPR_DB_X},     /* string */
+         {MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X}},    /* bool */
+        // ---------------  MATH_MIN
+        {{MEXPR_DB_I, MEXPR_DB_D, MEXPR_DB_X, MEXPR_DB_X},     /* int */
+         {MEXPR_DB_D, MEXPR_DB_D, MEXPR_DB_X, MEXPR_DB_X},     /* double */
+         {MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_S, MEXPR_DB_X},     /* string */
+         {MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X}},    /* bool */
+        // ---------------  MATH_PLUS
+        {{MEXPR_DB_I, MEXPR_DB_D, MEXPR_DB_X, MEXPR_DB_X},     /* int */
+         {MEXPR_DB_D, MEXPR_DB_D, MEXPR_DB_X, MEXPR_DB_X},     /* double */
+         {MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_S, MEXPR_DB_X},     /* string */
+         {MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X}},    /* bool */
+        // ---------------  MATH_MINUS
+        {{MEXPR_DB_I, MEXPR_DB_D, MEXPR_DB_X, MEXPR_DB_X},     /* int */
+         {MEXPR_DB_D, MEXPR_DB_D, MEXPR_DB_X, MEXPR_DB_X},     /* double */
+         {MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X},     /* string */
+         {MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X}},    /* bool */
+        // ---------------  MATH_SIN, unary
+        {{MEXPR_DB_D, MEXPR_DB_D, MEXPR_DB_D, MEXPR_DB_D},     /* int */
+         {MEXPR_DB_D, MEXPR_DB_D, MEXPR_DB_D, MEXPR_DB_D},     /* double */
+         {MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X},     /* string */
+         {MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X}},    /* bool */
+        // ---------------  MATH_COS, unary
+        {{MEXPR_DB_D, MEXPR_DB_D, MEXPR_DB_D, MEXPR_DB_D},     /* int */
+         {MEXPR_DB_D, MEXPR_DB_D, MEXPR_DB_D, MEXPR_DB_D},     /* double */
+         {MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X},     /* string */
+         {MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X}},    /* bool */
+        // ---------------  MATH_POW
+        {{MEXPR_DB_D, MEXPR_DB_D, MEXPR_DB_X, MEXPR_DB_X},     /* int */
+         {MEXPR_DB_D, MEXPR_DB_D, MEXPR_DB_X, MEXPR_DB_X},     /* double */
+         {MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X},     /* string */
+         {MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X, MEXPR_DB_X}},    /* bool */
+    };
+
+#undef MEXPR_DB_I
+#undef MEXPR_DB_D
+#undef MEXPR_DB_S
+#undef MEXPR_DB_B
+#undef MEXPR_DB_X
+
+/* dtype of the result of MexprDb[opr][ld][rd]. An operand of MEXPR_DTYPE_UNKNOWN
+    may be of any dtype at run time : the result is the one all supported
+    dtypes agree on, MEXPR_DTYPE_UNKNOWN if they do not, MEXPR_DTYPE_INVALID if
+    none is supported. Unary operators are computed as (ld, ld), rd is ignored */
+static mexpr_dtypes_t
+mexpr_opr_result_dtype (int opr_token_code, mexpr_dtypes_t ld, mexpr_dtypes_t rd) {
+
+    int l, r, r_min, r_max;
+    mexpr_dtypes_t dtype, res = MEXPR_DTYPE_INVALID;
+    bool unary = Math_is_unary_operator (opr_token_code);
+
+    if (opr_token_code < 0 || opr_token_code >= MATH_OPR_MAX ||
+            opr_token_code == MATH_BRACKET_START || opr_token_code == MATH_BRACKET_END) {
+        return MEXPR_DTYPE_INVALID;
     }
-}
 
+    if (unary) rd = ld;
 
-// MATH_NOT_EQ
-static mexpr_dtypes_t 
-math_neq_dtypes_supported (mexpr_dtypes_t ld, mexpr_dtypes_t rd) {
-
-        switch (ld) {
-
-        case MEXPR_DTYPE_INT:
-        case MEXPR_DTYPE_DOUBLE:
-            switch (rd) {
-                case MEXPR_DTYPE_INT:
-                case MEXPR_DTYPE_DOUBLE:
-                case MEXPR_DTYPE_UNKNOWN:
-                    return MEXPR_DTYPE_BOOL;
-                default:
-                    return MEXPR_DTYPE_INVALID;
-            }
-        break;
-        case MEXPR_DTYPE_STRING:
-            switch(rd) {
-                case MEXPR_DTYPE_STRING:
-                case MEXPR_DTYPE_UNKNOWN:
-                    return MEXPR_DTYPE_BOOL;
-                default:
-                    return MEXPR_DTYPE_INVALID;
-            }
-        break;
-        case MEXPR_DTYPE_UNKNOWN:
-            switch(rd) {
-                case MEXPR_DTYPE_STRING:
-                case MEXPR_DTYPE_INT:
-                case MEXPR_DTYPE_DOUBLE:
-                    return MEXPR_DTYPE_BOOL;
-                case MEXPR_DTYPE_UNKNOWN:
-                    return MEXPR_DTYPE_UNKNOWN;
-                default:
-                    return MEXPR_DTYPE_INVALID;
-            }            
-        break;
-        default:
-             return MEXPR_DTYPE_INVALID;
+    if (ld < MEXPR_DTYPE_MAX && rd < MEXPR_DTYPE_MAX) {
+        return MexprDb_result_dtype[opr_token_code][ld][rd];
     }
-}
 
-// MATH_OR
-static mexpr_dtypes_t 
-math_or_dtypes_supported (mexpr_dtypes_t ld, mexpr_dtypes_t rd) {
-
-    if (ld == MEXPR_DTYPE_BOOL && rd == MEXPR_DTYPE_BOOL)
-        return MEXPR_DTYPE_BOOL;
-    if (ld == MEXPR_DTYPE_UNKNOWN && rd == MEXPR_DTYPE_BOOL)
-        return rd;
-    if (ld == MEXPR_DTYPE_BOOL && rd == MEXPR_DTYPE_UNKNOWN)
-        return ld;
-    if (ld == MEXPR_DTYPE_UNKNOWN && rd == MEXPR_DTYPE_UNKNOWN)
-        return MEXPR_DTYPE_UNKNOWN;
-
-    return MEXPR_DTYPE_INVALID;
-}
-
-
-// MATH_AND
-static mexpr_dtypes_t 
-math_and_dtypes_supported (mexpr_dtypes_t ld, mexpr_dtypes_t rd) {
-
-    if (ld == MEXPR_DTYPE_BOOL && rd == MEXPR_DTYPE_BOOL)
-        return MEXPR_DTYPE_BOOL;
-    if (ld == MEXPR_DTYPE_UNKNOWN && rd == MEXPR_DTYPE_BOOL)
-        return rd;
-    if (ld == MEXPR_DTYPE_BOOL && rd == MEXPR_DTYPE_UNKNOWN)
-        return ld;
-    if (ld == MEXPR_DTYPE_UNKNOWN && rd == MEXPR_DTYPE_UNKNOWN)
-        return MEXPR_DTYPE_UNKNOWN;
-
-    return MEXPR_DTYPE_INVALID;
-}
-
-
-// MATH_MUL
-static mexpr_dtypes_t 
-math_mul_dtypes_supported (mexpr_dtypes_t ld, mexpr_dtypes_t rd) {
-
-    if ( (ld == MEXPR_DTYPE_INT || ld == MEXPR_DTYPE_DOUBLE) &&
-            (rd == MEXPR_DTYPE_DOUBLE || rd == MEXPR_DTYPE_INT))
-        return MEXPR_DTYPE_DOUBLE;
-    
-    if (ld == MEXPR_DTYPE_UNKNOWN && (rd == MEXPR_DTYPE_INT || rd == MEXPR_DTYPE_DOUBLE))
-        return rd;
-     if (rd == MEXPR_DTYPE_UNKNOWN && (ld == MEXPR_DTYPE_INT || ld == MEXPR_DTYPE_DOUBLE))
-        return ld;
-
-    if (ld == MEXPR_DTYPE_UNKNOWN && rd == MEXPR_DTYPE_UNKNOWN)
-        return MEXPR_DTYPE_UNKNOWN;
-
-    return MEXPR_DTYPE_INVALID;
-}
-
-
-// MATH_DIV
-static mexpr_dtypes_t 
-math_div_dtypes_supported (mexpr_dtypes_t ld, mexpr_dtypes_t rd) {
-
-    if ( (ld == MEXPR_DTYPE_INT || ld == MEXPR_DTYPE_DOUBLE) &&
-            (rd == MEXPR_DTYPE_DOUBLE || rd == MEXPR_DTYPE_INT))
-        return MEXPR_DTYPE_DOUBLE;
-
-    if (ld == MEXPR_DTYPE_UNKNOWN && (rd == MEXPR_DTYPE_INT || rd == MEXPR_DTYPE_DOUBLE))
-        return MEXPR_DTYPE_DOUBLE;
-
-     if (rd == MEXPR_DTYPE_UNKNOWN && (ld == MEXPR_DTYPE_INT || ld == MEXPR_DTYPE_DOUBLE))
-        return MEXPR_DTYPE_DOUBLE;
-
-    if (ld == MEXPR_DTYPE_UNKNOWN && rd == MEXPR_DTYPE_UNKNOWN)
-        return MEXPR_DTYPE_UNKNOWN;
-
-    return MEXPR_DTYPE_INVALID;
-}
-
-
-// MATH_SQR
-static mexpr_dtypes_t 
-math_sqr_dtypes_supported (mexpr_dtypes_t ld, mexpr_dtypes_t rd) {
-
-    if ( (ld == MEXPR_DTYPE_INT || ld == MEXPR_DTYPE_DOUBLE) )
-        return MEXPR_DTYPE_DOUBLE;
-
-    if (ld == MEXPR_DTYPE_UNKNOWN) return MEXPR_DTYPE_UNKNOWN;
-
-    return MEXPR_DTYPE_INVALID;
-}
-
-
-// MATH_SQRT
-static mexpr_dtypes_t 
-math_sqrt_dtypes_supported (mexpr_dtypes_t ld, mexpr_dtypes_t rd) {
-
-    if (ld == MEXPR_DTYPE_INT || ld == MEXPR_DTYPE_DOUBLE)
-        return MEXPR_DTYPE_DOUBLE;
-
-     if (ld == MEXPR_DTYPE_UNKNOWN) return MEXPR_DTYPE_UNKNOWN;
-
-    return MEXPR_DTYPE_INVALID;
-}
-
-
-// MATH_MAX
-static mexpr_dtypes_t 
-math_max_dtypes_supported (mexpr_dtypes_t ld, mexpr_dtypes_t rd) {
-
-    switch (ld) {
-        case MEXPR_DTYPE_INT:
-
-            switch (ld) {
-                case MEXPR_DTYPE_INT:
-                    return MEXPR_DTYPE_INT;
-                case MEXPR_DTYPE_DOUBLE:
-                    return MEXPR_DTYPE_DOUBLE;
-                case MEXPR_DTYPE_STRING:
-                    return MEXPR_DTYPE_INVALID;
-                case MEXPR_DTYPE_UNKNOWN:
-                    return MEXPR_DTYPE_INT;
-                break;
-                default:
-                    return MEXPR_DTYPE_INVALID;
-            }
-            break;        
-
-        case MEXPR_DTYPE_DOUBLE:
-
-            switch (ld) {
-                case MEXPR_DTYPE_INT:
-                    return MEXPR_DTYPE_DOUBLE;
-                case MEXPR_DTYPE_DOUBLE:
-                    return MEXPR_DTYPE_DOUBLE;
-                case MEXPR_DTYPE_STRING:
-                    return MEXPR_DTYPE_INVALID;
-                case MEXPR_DTYPE_UNKNOWN:
-                    return MEXPR_DTYPE_DOUBLE;
-                break;
-                default:
-                    return MEXPR_DTYPE_INVALID;
-            }
-            break;       
-
-
-        case MEXPR_DTYPE_STRING:
-
-            switch (ld) {
-                case MEXPR_DTYPE_INT:
-                    return MEXPR_DTYPE_INVALID;
-                case MEXPR_DTYPE_DOUBLE:
-                    return MEXPR_DTYPE_INVALID;
-                case MEXPR_DTYPE_STRING:
-                    return MEXPR_DTYPE_STRING;
-                case MEXPR_DTYPE_UNKNOWN:
-                    return MEXPR_DTYPE_STRING;
-                break;
-                default:
-                    return MEXPR_DTYPE_INVALID;
-            }
-            break;     
-
-        case MEXPR_DTYPE_UNKNOWN:
-
-            switch (ld) {
-                case MEXPR_DTYPE_INT:
-                    return MEXPR_DTYPE_INT;
-                case MEXPR_DTYPE_DOUBLE:
-                    return MEXPR_DTYPE_DOUBLE;
-                case MEXPR_DTYPE_STRING:
-                    return MEXPR_DTYPE_STRING;
-                case MEXPR_DTYPE_UNKNOWN:
-                    return MEXPR_DTYPE_UNKNOWN;
-                break;
-                default:
-                    return MEXPR_DTYPE_INVALID;
-            }
-        break;
-        default:
-            return MEXPR_DTYPE_INVALID;
+    if ((ld >= MEXPR_DTYPE_MAX && ld != MEXPR_DTYPE_UNKNOWN) ||
+         (rd >= MEXPR_DTYPE_MAX && rd != MEXPR_DTYPE_UNKNOWN)) {
+        return MEXPR_DTYPE_INVALID;
     }
 
-    return MEXPR_DTYPE_INVALID;
-}
-
+    for (l = 0; l < MEXPR_DTYPE_MAX; l++) {
 
-// MATH_MIN
-static mexpr_dtypes_t 
-math_min_dtypes_supported (mexpr_dtypes_t ld, mexpr_dtypes_t rd) {
-
-    switch (ld) {
-        case MEXPR_DTYPE_INT:
-
-            switch (ld) {
-                case MEXPR_DTYPE_INT:
-                    return MEXPR_DTYPE_INT;
-                case MEXPR_DTYPE_DOUBLE:
-                    return MEXPR_DTYPE_DOUBLE;
-                case MEXPR_DTYPE_STRING:
-                    return MEXPR_DTYPE_INVALID;
-                case MEXPR_DTYPE_UNKNOWN:
-                    return MEXPR_DTYPE_INT;
-                break;
-                default:
-                    return MEXPR_DTYPE_INVALID;
-            }
-            break;        
-
-        case MEXPR_DTYPE_DOUBLE:
-
-            switch (ld) {
-                case MEXPR_DTYPE_INT:
-                    return MEXPR_DTYPE_DOUBLE;
-                case MEXPR_DTYPE_DOUBLE:
-                    return MEXPR_DTYPE_DOUBLE;
-                case MEXPR_DTYPE_STRING:
-                    return MEXPR_DTYPE_INVALID;
-                case MEXPR_DTYPE_UNKNOWN:
-                    return MEXPR_DTYPE_DOUBLE;
-                break;
-                default:
-                    return MEXPR_DTYPE_INVALID;
-            }
-            break;       
-
-        case MEXPR_DTYPE_STRING:
-
-            switch (ld) {
-                case MEXPR_DTYPE_INT:
-                    return MEXPR_DTYPE_INVALID;
-                case MEXPR_DTYPE_DOUBLE:
-                    return MEXPR_DTYPE_INVALID;
-                case MEXPR_DTYPE_STRING:
-                    return MEXPR_DTYPE_STRING;
-                case MEXPR_DTYPE_UNKNOWN:
-                    return MEXPR_DTYPE_STRING;
-                break;
-                default:
-                    return MEXPR_DTYPE_INVALID;
-            }
-            break;     
-
-        case MEXPR_DTYPE_UNKNOWN:
-
-            switch (ld) {
-                case MEXPR_DTYPE_INT:
-                    return MEXPR_DTYPE_INT;
-                case MEXPR_DTYPE_DOUBLE:
-                    return MEXPR_DTYPE_DOUBLE;
-                case MEXPR_DTYPE_STRING:
-                    return MEXPR_DTYPE_STRING;
-                case MEXPR_DTYPE_UNKNOWN:
-                    return MEXPR_DTYPE_UNKNOWN;
-                break;
-                default:
-                    return MEXPR_DTYPE_INVALID;
-            }
-        break;
-        default:
-            return MEXPR_DTYPE_INVALID;
-    }
+        if (ld != MEXPR_DTYPE_UNKNOWN && l != ld) continue;
 
-    return MEXPR_DTYPE_INVALID;
-}
+        r_min = unary ? l : (rd == MEXPR_DTYPE_UNKNOWN ? 0 : rd);
+        r_max = unary ? l : (rd == MEXPR_DTYPE_UNKNOWN ? MEXPR_DTYPE_MAX - 1 : rd);
 
-// MATH_PLUS
-static mexpr_dtypes_t 
-math_plus_dtypes_supported (mexpr_dtypes_t ld, mexpr_dtypes_t rd) {
-
-    switch (ld) {
-
-        case MEXPR_DTYPE_INT:
-            switch (rd) {
-                case MEXPR_DTYPE_INT:
-                    return MEXPR_DTYPE_INT;
-                case MEXPR_DTYPE_DOUBLE:
-                    return MEXPR_DTYPE_DOUBLE;
-                case MEXPR_DTYPE_UNKNOWN:
-                    return MEXPR_DTYPE_DOUBLE;
-                default:
-                    return MEXPR_DTYPE_INVALID;
-            }
-            break;
-        case MEXPR_DTYPE_DOUBLE:
-            switch (rd) {
-                case MEXPR_DTYPE_INT:
-                    return MEXPR_DTYPE_DOUBLE;
-                case MEXPR_DTYPE_DOUBLE:
-                    return MEXPR_DTYPE_DOUBLE;
-                case MEXPR_DTYPE_UNKNOWN:
-                    return MEXPR_DTYPE_DOUBLE;
-                default:
-                    return MEXPR_DTYPE_INVALID;
-            }
-            break;            
-        case MEXPR_DTYPE_UNKNOWN:
-            switch (rd) {
-                case MEXPR_DTYPE_INT:
-                case MEXPR_DTYPE_DOUBLE:
-                    return MEXPR_DTYPE_DOUBLE;
-                case MEXPR_DTYPE_STRING:
-                    return MEXPR_DTYPE_STRING;
-                case MEXPR_DTYPE_UNKNOWN:
-                    return MEXPR_DTYPE_UNKNOWN;
-                default:
-                    return MEXPR_DTYPE_INVALID;
-            }
-            break;                 
-        case MEXPR_DTYPE_STRING:
-            switch (rd) {
-                case MEXPR_DTYPE_STRING:
-                 case MEXPR_DTYPE_UNKNOWN:
-                    return MEXPR_DTYPE_STRING;
-                default:
-                    return MEXPR_DTYPE_INVALID;
-            }
-            break;
-        default:
-             return MEXPR_DTYPE_INVALID;
-    }
-}
+        for (r = r_min; r <= r_max; r++) {
 
-// MATH_MINUS
-static mexpr_dtypes_t 
-math_minus_dtypes_supported (mexpr_dtypes_t ld, mexpr_dtypes_t rd) {
-
-    switch (ld) {
-
-        case MEXPR_DTYPE_INT:
-            switch (rd) {
-                case MEXPR_DTYPE_INT:
-                    return MEXPR_DTYPE_INT;
-                case MEXPR_DTYPE_DOUBLE:
-                    return MEXPR_DTYPE_DOUBLE;
-                case MEXPR_DTYPE_UNKNOWN:
-                    return MEXPR_DTYPE_DOUBLE;
-                default:
-                    return MEXPR_DTYPE_INVALID;
-            }
-            break;
-        case MEXPR_DTYPE_DOUBLE:
-            switch (rd) {
-                case MEXPR_DTYPE_INT:
-                    return MEXPR_DTYPE_DOUBLE;
-                case MEXPR_DTYPE_DOUBLE:
-                    return MEXPR_DTYPE_DOUBLE;
-                case MEXPR_DTYPE_UNKNOWN:
-                    return MEXPR_DTYPE_DOUBLE;
-                default:
-                    return MEXPR_DTYPE_INVALID;
-            }
-            break;            
-        case MEXPR_DTYPE_UNKNOWN:
-            switch (rd) {
-                case MEXPR_DTYPE_INT:
-                case MEXPR_DTYPE_DOUBLE:
-                    return MEXPR_DTYPE_DOUBLE;
-                case MEXPR_DTYPE_UNKNOWN:
-                    return MEXPR_DTYPE_UNKNOWN;
-                default:
-                    return MEXPR_DTYPE_INVALID;
-            }
-            break;                 
-        default:
-             return MEXPR_DTYPE_INVALID;
+            dtype = MexprDb_result_dtype[opr_token_code][l][r];
+            if (dtype == MEXPR_DTYPE_INVALID) continue;
+            if (res == MEXPR_DTYPE_INVALID) res = dtype;
+            else if (res != dtype) return MEXPR_DTYPE_UNKNOWN;
+        }
     }
+    return res;
 }
-
-
-// MATH_SIN
-// MATH_COS
-static mexpr_dtypes_t 
-math_trignometry_dtypes_supported (mexpr_dtypes_t ld, mexpr_dtypes_t rd) {
-
-    if (ld == MEXPR_DTYPE_INT || ld == MEXPR_DTYPE_DOUBLE)
-        return MEXPR_DTYPE_DOUBLE;
-    if (ld == MEXPR_DTYPE_UNKNOWN) return MEXPR_DTYPE_UNKNOWN;
-    return MEXPR_DTYPE_INVALID;
-}
-
-
-static mexpr_dtypes_t 
-math_pow_dtypes_supported (mexpr_dtypes_t ld, mexpr_dtypes_t rd) {
-
-    if ( (ld == MEXPR_DTYPE_INT || ld == MEXPR_DTYPE_DOUBLE) &&
-            (rd == MEXPR_DTYPE_DOUBLE || rd == MEXPR_DTYPE_INT))
-        return MEXPR_DTYPE_DOUBLE;
-
-    if (ld == MEXPR_DTYPE_UNKNOWN && (rd == MEXPR_DTYPE_INT || rd == MEXPR_DTYPE_DOUBLE))
-        return MEXPR_DTYPE_DOUBLE;
-
-    if (rd == MEXPR_DTYPE_UNKNOWN && (ld == MEXPR_DTYPE_INT || ld == MEXPR_DTYPE_DOUBLE))
-        return MEXPR_DTYPE_DOUBLE;
-
-    if (ld == MEXPR_DTYPE_UNKNOWN && rd == MEXPR_DTYPE_UNKNOWN) 
-        return MEXPR_DTYPE_UNKNOWN;
-
-    return MEXPR_DTYPE_INVALID;
-}
-
-static operator_fn_dtypes_supported_ptr_t MexprDb_dtypes_supported[MATH_OPR_MAX] =
-    {
-        math_less_than_eq_dtypes_supported,
-        math_less_than_dtypes_supported,
-        math_greater_than_dtypes_supported,
-        math_eq_dtypes_supported,
-        math_neq_dtypes_supported,
-        math_or_dtypes_supported,
-        math_and_dtypes_supported,
-        math_mul_dtypes_supported,
-        math_div_dtypes_supported,
-        math_sqr_dtypes_supported,
-        math_sqrt_dtypes_supported,
-        math_max_dtypes_supported,
-        math_min_dtypes_supported,
-        math_plus_dtypes_supported,
-        math_minus_dtypes_supported,
-        math_trignometry_dtypes_supported,
-        math_trignometry_dtypes_supported,
-        math_pow_dtypes_supported,
-        0,
-        0
-    };
\ No newline at end of file
@@ -0,0 +1,154 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "MexprEnums.h"
+#include "MExpr.h"
+#include "MexprDict.h"
+
+/* Operand of the private clone : the dictionary entry being evaluated */
+typedef struct mexpt_dict_cursor_ {
+
+    const mexpr_var_t *dict;
+    uint32_t code;
+} mexpt_dict_cursor_t;
+
+static mexpr_var_t
+mexpt_dict_entry (void *data_src) {
+
+    mexpt_dict_cursor_t *cursor = (mexpt_dict_cursor_t *)data_src;
+
+    return cursor->dict[cursor->code];
+}
+
+mexpt_dict_plan_t *
+mexpt_dict_compile (mexpt_tree_t *tree,
+                                const char *col_name,
+                                const mexpr_var_t *dict,
+                                uint32_t n_codes) {
+
+    uint32_t code;
+    mexpr_var_t res;
+    mexpt_node_t *opd_node;
+    mexpt_tree_t *clone;
+    mexpt_dict_plan_t *plan;
+    mexpt_dict_cursor_t cursor;
+    bool first = true;
+
+    if (!tree->root) return NULL;
+
+    for (code = 0; code < n_codes; code++) {
+
+        if (dict[code].dtype != MEXPR_DTYPE_STRING) {
+            printf ("Error : Dict : Entry %u is not a string\n", code);
+            return NULL;
+        }
+    }
+
+    /* Tree of the Appln keeps its operands, the clone is bound to the cursor */
+    clone = mexpt_clone (tree);
+    cursor.dict = dict;
+    cursor.code = 0;
+
+    mexpt_iterate_operands_begin (clone, opd_node) {
+
+        if (strcmp ((char *)opd_node->u.opd_node.opd_value.variable_name, col_name)) {
+            printf ("Error : Dict : Operand %s is not the dictionary column %s\n",
+                        opd_node->u.opd_node.opd_value.variable_name, col_name);
+            mexpt_tree_destroy (clone, false);
+            return NULL;
+        }
+        mexpt_tree_install_operand_properties (opd_node, &cursor, mexpt_dict_entry);
+        opd_node->u.opd_node.is_numeric = false;
+        mexpt_tree_set_operand_dtype (opd_node, MEXPR_DTYPE_STRING);
+
+    } mexpt_iterate_operands_end (clone, opd_node);
+
+    if (!mexpr_validate_expression_tree (clone)) {
+        mexpt_tree_destroy (clone, false);
+        return NULL;
+    }
+
+    plan = (mexpt_dict_plan_t *)calloc (1, sizeof (mexpt_dict_plan_t));
+    plan->n_codes = n_codes;
+    plan->dtype = MEXPR_DTYPE_UNKNOWN;
+    plan->values = (mexpr_var_t *)calloc (n_codes ? n_codes : 1, sizeof (mexpr_var_t));
+    plan->match = (uint64_t *)calloc ((n_codes + 63) / 64 + 1, sizeof (uint64_t));
+    mexpr_arena_init (&plan->arena);
+
+    /* Strings built for a code stay in the arena of the plan */
+    for (code = 0; code < n_codes; code++) {
+
+        cursor.code = code;
+        res = mexpt_evaluate_in (clone->root, &plan->arena);
+        plan->values[code] = res;
+
+        if (res.dtype != MEXPR_DTYPE_INVALID) {
+            if (first) plan->dtype = res.dtype;
+            else if (plan->dtype != res.dtype) plan->dtype = MEXPR_DTYPE_UNKNOWN;
+            first = false;
+        }
+
+        if (res.dtype == MEXPR_DTYPE_BOOL && res.u.b_val) {
+            plan->match[code >> 6] |= 1ULL << (code & 63);
+            plan->n_matches++;
+        }
+    }
+
+    mexpt_tree_destroy (clone, false);
+    return plan;
+}
+
+void
+mexpt_dict_eval (const mexpt_dict_plan_t *plan,
+                            const uint32_t *codes,
+                            uint64_t n_rows,
+                            uint8_t *out) {
+
+    uint64_t i;
+
+    for (i = 0; i < n_rows; i++) {
+        out[i] = mexpt_dict_match (plan, codes[i]);
+    }
+}
+
+uint64_t
+mexpt_dict_filter (const mexpt_dict_plan_t *plan,
+                            const uint32_t *codes,
+                            uint64_t n_rows,
+                            uint64_t *sel) {
+
+    uint64_t i;
+    uint64_t n_sel = 0;
+
+    /* Branch free : every row is written, only matches advance */
+    for (i = 0; i < n_rows; i++) {
+        sel[n_sel] = i;
+        n_sel += mexpt_dict_match (plan, codes[i]);
+    }
+    return n_sel;
+}
+
+void
+mexpt_dict_print (const mexpt_dict_plan_t *plan) {
+
+    uint32_t code;
+    uint32_t n_invalid = 0;
+
+    for (code = 0; code < plan->n_codes; code++) {
+        if (plan->values[code].dtype == MEXPR_DTYPE_INVALID) n_invalid++;
+    }
+
+    printf ("Dict plan : %u codes, dtype %d, %u matches, %u invalid, %llu arena bytes\n",
+                plan->n_codes, plan->dtype, plan->n_matches, n_invalid,
+                (unsigned long long)plan->arena.n_bytes);
+}
+
+void
+mexpt_dict_free (mexpt_dict_plan_t *plan) {
+
+    mexpr_arena_free (&plan->arena);
+    free (plan->values);
+    free (plan->match);
+    free (plan);
+}
@@ -0,0 +1,89 @@
+#ifndef __MEXPR_DICT__
+#define __MEXPR_DICT__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "MExpr.h"
+
+/* Evaluation over Dictionary Encoded Columns
+
+    A dictionary encoded column stores per row a code, an index into a
+    dictionary of its n_codes distinct values. An expression whose only
+    operand is that column (s = 'abc', mmax(s, 'k') != s, s + '_x' = 'ab_x' ...)
+    has at most n_codes distinct results : mexpt_dict_compile( ) evaluates the
+    tree once per dictionary entry, into a table of results indexed by code
+    and, for predicates, a bitmap of the codes it is true for.
+
+    Rows are then evaluated without materializing their strings :
+    mexpt_dict_eval( ) and mexpt_dict_filter( ) are one gather from the bitmap
+    per row, mexpt_dict_value( ) one load from the table.
+
+    Results are the ones of mexpt_evaluate( ) with the operand returning the
+    dictionary entry of the row. Codes out of the dictionary, and codes the
+    tree fails on (MEXPR_DTYPE_INVALID), do not match. Result strings may view
+    dictionary entries, which must outlive the plan. Plan is read only once
+    compiled, any number of threads may use it at once.
+*/
+
+typedef struct mexpt_dict_plan_ {
+
+    uint32_t n_codes;
+    mexpr_dtypes_t dtype;       /* of the tree, MEXPR_DTYPE_UNKNOWN if it varies */
+    uint32_t n_matches;         /* codes the predicate is true for */
+
+    mexpr_var_t *values;        /* result per code */
+    uint64_t *match;            /* bit per code : result is bool true */
+
+    /* Owns strings built by the tree (string + string) */
+    mexpr_arena_t arena;
+} mexpt_dict_plan_t;
+
+/* Operands of the tree must all be named col_name. dict[code] is the value
+    of code, a string (mexpr_var_string( ) or mexpr_var_interned( )).
+    Tree is left untouched */
+mexpt_dict_plan_t *
+mexpt_dict_compile (mexpt_tree_t *tree,
+                                const char *col_name,
+                                const mexpr_var_t *dict,
+                                uint32_t n_codes);
+
+static inline bool
+mexpt_dict_match (const mexpt_dict_plan_t *plan, uint32_t code) {
+
+    return code < plan->n_codes &&
+                ((plan->match[code >> 6] >> (code & 63)) & 1);
+}
+
+static inline mexpr_var_t
+mexpt_dict_value (const mexpt_dict_plan_t *plan, uint32_t code) {
+
+    mexpr_var_t res;
+
+    if (code < plan->n_codes) return plan->values[code];
+    res.dtype = MEXPR_DTYPE_INVALID;
+    return res;
+}
+
+/* out[i] = 1 if the predicate is true on row i */
+void
+mexpt_dict_eval (const mexpt_dict_plan_t *plan,
+                            const uint32_t *codes,
+                            uint64_t n_rows,
+                            uint8_t *out);
+
+/* Writes the indexes of the rows the predicate is true on into sel, returns
+    their count. sel holds n_rows entries */
+uint64_t
+mexpt_dict_filter (const mexpt_dict_plan_t *plan,
+                            const uint32_t *codes,
+                            uint64_t n_rows,
+                            uint64_t *sel);
+
+void
+mexpt_dict_print (const mexpt_dict_plan_t *plan);
+
+void
+mexpt_dict_free (mexpt_dict_plan_t *plan);
+
+#endif
@@ -99,15 +99,25 @@ mexpr_get_dtype_from_value_token_code (int token_code) {
     }
 }
 
+#include <stdint.h>
 #include <stdbool.h>
 
+#define MEXPR_STR_LEN_MAX   0x7fffffffU
+
 typedef struct mexpr_var {
 
     mexpr_dtypes_t dtype;
 
+    /* MEXPR_DTYPE_STRING : str_val views str_len bytes, kernels never read
+        past them. Strings built by MexprDb are '\0' terminated too.
+        str_interned : str_val is an entry of MexprIntern. Bit fields keep
+        values in 16 bytes, passed in registers to the kernels */
+    uint32_t str_len : 31;
+    uint32_t str_interned : 1;
+
     union {
 
-        int int_val;
+        int64_t int_val;
         double d_val;
         unsigned char *str_val;
         bool b_val;
@@ -115,5 +125,53 @@ typedef struct mexpr_var {
     } u;
 } mexpr_var_t;
 
+/* String value viewing len bytes at str, operand callbacks returning strings
+    must set str_len, e.g. with this */
+static inline mexpr_var_t
+mexpr_var_string (const unsigned char *str, uint32_t len) {
+
+    mexpr_var_t var;
+
+    var.dtype = MEXPR_DTYPE_STRING;
+    var.str_len = len;
+    var.str_interned = 0;
+    var.u.str_val = (unsigned char *)str;
+    return var;
+}
+
+/* Exact comparison of an integer with a double, (double)i rounds above 2^53.
+    Returns -1, 0 or 1 as i is less than, equal to or greater than d, and
+    MEXPR_CMP_UNORDERED if d is NaN */
+#define MEXPR_CMP_UNORDERED 2
+
+static inline int
+mexpr_cmp_int_double (int64_t i, double d) {
+
+    int64_t d_int;
+    double d_frac;
+
+    if (d != d) return MEXPR_CMP_UNORDERED;
+    if (d >= 9223372036854775808.0) return -1;     /* 2^63 */
+    if (d < -9223372036854775808.0) return 1;
+
+    /* d in range, truncation and the fraction are exact */
+    d_int = (int64_t)d;
+    if (i != d_int) return i < d_int ? -1 : 1;
+    d_frac = d - (double)d_int;
+    if (d_frac == 0) return 0;
+    return d_frac > 0 ? -1 : 1;
+}
+
+static inline int
+mexpr_cmp_double_int (double d, int64_t i) {
+
+    int cmp = mexpr_cmp_int_double (i, d);
+
+    return cmp == MEXPR_CMP_UNORDERED ? cmp : -cmp;
+}
+
+/* Operator kernel of MexprDb */
+typedef  mexpr_var_t (*operator_fn_ptr_t) (mexpr_var_t , mexpr_var_t);
+
 
 #endif 
@@ -0,0 +1,568 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "MexprEnums.h"
+#include "MExpr.h"
+#include "MexprImage.h"
+
+/* ====================x================x=================== */
+/* Image Writer */
+
+typedef struct mexpt_image_buf_ {
+
+    uint8_t *data;
+    uint64_t size;
+    uint64_t max_size;
+} mexpt_image_buf_t;
+
+static uint64_t
+mexpt_image_buf_append (mexpt_image_buf_t *buf, const void *data, uint64_t len) {
+
+    uint64_t off = buf->size;
+
+    if (buf->size + len > buf->max_size) {
+        buf->max_size = (buf->size + len) * 2;
+        buf->data = (uint8_t *)realloc (buf->data, buf->max_size);
+    }
+    memcpy (buf->data + buf->size, data, len);
+    buf->size += len;
+    return off;
+}
+
+/* String table with interning, so that an operand name used by thousands of
+    expressions is stored once */
+typedef struct mexpt_image_strtab_ {
+
+    mexpt_image_buf_t buf;
+    uint32_t *slots;        /* offset + 1 of interned strings, 0 for empty slot */
+    uint32_t n_slots;
+    uint32_t n_strings;
+} mexpt_image_strtab_t;
+
+static uint32_t
+mexpt_image_str_hash (const char *str, uint32_t len) {
+
+    uint32_t i, hash = 2166136261U;
+
+    for (i = 0; i < len; i++) {
+        hash ^= (unsigned char)str[i];
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+static void
+mexpt_image_strtab_rehash (mexpt_image_strtab_t *strtab);
+
+static uint32_t
+mexpt_image_strtab_intern (mexpt_image_strtab_t *strtab, const char *str) {
+
+    uint32_t len = strlen (str);
+    uint32_t slot, off;
+    static const uint8_t pad[4] = {0};
+
+    if ((strtab->n_strings + 1) * 2 > strtab->n_slots) {
+        mexpt_image_strtab_rehash (strtab);
+    }
+
+    slot = mexpt_image_str_hash (str, len) & (strtab->n_slots - 1);
+
+    while (strtab->slots[slot]) {
+
+        off = strtab->slots[slot] - 1;
+
+        if (*(uint32_t *)(strtab->buf.data + off - sizeof (uint32_t)) == len &&
+             memcmp (strtab->buf.data + off, str, len) == 0) {
+            return off;
+        }
+        slot = (slot + 1) & (strtab->n_slots - 1);
+    }
+
+    mexpt_image_buf_append (&strtab->buf, &len, sizeof (len));
+    off = mexpt_image_buf_append (&strtab->buf, str, len);
+    /* NUL terminate and keep every length field 4 byte aligned */
+    mexpt_image_buf_append (&strtab->buf, pad, 4 - (len % 4));
+
+    strtab->slots[slot] = off + 1;
+    strtab->n_strings++;
+    return off;
+}
+
+static void
+mexpt_image_strtab_rehash (mexpt_image_strtab_t *strtab) {
+
+    uint32_t i, slot, off, len;
+    uint32_t *old_slots = strtab->slots;
+    uint32_t old_n_slots = strtab->n_slots;
+
+    strtab->n_slots = old_n_slots ? old_n_slots * 2 : 64;
+    strtab->slots = (uint32_t *)calloc (strtab->n_slots, sizeof (uint32_t));
+
+    for (i = 0; i < old_n_slots; i++) {
+
+        if (!old_slots[i]) continue;
+        off = old_slots[i] - 1;
+        len = *(uint32_t *)(strtab->buf.data + off - sizeof (uint32_t));
+        slot = mexpt_image_str_hash ((char *)strtab->buf.data + off, len) & (strtab->n_slots - 1);
+        while (strtab->slots[slot]) slot = (slot + 1) & (strtab->n_slots - 1);
+        strtab->slots[slot] = old_slots[i];
+    }
+    free (old_slots);
+}
+
+typedef struct mexpt_image_writer_ {
+
+    mexpt_image_buf_t nodes;
+    mexpt_image_buf_t opds;
+    mexpt_image_strtab_t strtab;
+    uint32_t n_nodes;
+    uint32_t n_opds;
+} mexpt_image_writer_t;
+
+/* Emits node and its subtree in pre-order, returns the index of node */
+static uint32_t
+mexpt_image_write_node (mexpt_image_writer_t *writer,
+                                        mexpt_node_t *node,
+                                        uint32_t first_opd) {
+
+    mexpt_image_node_t rec;
+    mexpt_image_opd_t opd_rec;
+    uint32_t index = writer->n_nodes++;
+    uint64_t off;
+
+    memset (&rec, 0, sizeof (rec));
+    rec.token_code = node->token_code;
+    off = mexpt_image_buf_append (&writer->nodes, &rec, sizeof (rec));
+
+    switch (node->token_code) {
+
+        case MATH_IDENTIFIER:
+        case MATH_IDENTIFIER_IDENTIFIER:
+            opd_rec.node = index;
+            opd_rec.name_off = mexpt_image_strtab_intern (&writer->strtab,
+                                            (char *)node->u.opd_node.opd_value.variable_name);
+            mexpt_image_buf_append (&writer->opds, &opd_rec, sizeof (opd_rec));
+            rec.u.opd_index = writer->n_opds++ - first_opd;
+            if (node->u.opd_node.is_numeric) rec.flags |= MEXPT_IMAGE_NODE_NUMERIC;
+            break;
+        case MATH_INTEGER_VALUE:
+            rec.u.int_val = node->u.opd_node.opd_value.int_val;
+            rec.flags |= MEXPT_IMAGE_NODE_RESOLVED | MEXPT_IMAGE_NODE_NUMERIC;
+            break;
+        case MATH_DOUBLE_VALUE:
+            rec.u.math_val = node->u.opd_node.opd_value.math_val;
+            rec.flags |= MEXPT_IMAGE_NODE_RESOLVED | MEXPT_IMAGE_NODE_NUMERIC;
+            break;
+        case MATH_STRING_VALUE:
+            rec.u.str_off = mexpt_image_strtab_intern (&writer->strtab,
+                                            (char *)node->u.opd_node.opd_value.string_name);
+            rec.flags |= MEXPT_IMAGE_NODE_RESOLVED;
+            break;
+        default:
+            /* Ineq and Logical operators may have been folded by mexpt_optimize( ) */
+            if (Math_is_ineq_operator (node->token_code) &&
+                 node->u.ineq_node.is_optimized) {
+                rec.flags |= MEXPT_IMAGE_NODE_OPTIMIZED;
+                if (node->u.ineq_node.result) rec.flags |= MEXPT_IMAGE_NODE_RESULT;
+            }
+            else if (Math_is_logical_operator (node->token_code) &&
+                 node->u.log_op_node.is_optimized) {
+                rec.flags |= MEXPT_IMAGE_NODE_OPTIMIZED;
+                if (node->u.log_op_node.result) rec.flags |= MEXPT_IMAGE_NODE_RESULT;
+            }
+            break;
+    }
+
+    if (node->left) {
+        rec.left = mexpt_image_write_node (writer, node->left, first_opd) - index;
+    }
+    if (node->right) {
+        rec.right = mexpt_image_write_node (writer, node->right, first_opd) - index;
+    }
+
+    /* Buffer may have been reallocated by the children */
+    memcpy (writer->nodes.data + off, &rec, sizeof (rec));
+    return index;
+}
+
+static uint32_t
+mexpt_image_tree_depth (mexpt_node_t *node) {
+
+    uint32_t ldepth, rdepth;
+
+    if (!node) return 0;
+    ldepth = mexpt_image_tree_depth (node->left);
+    rdepth = mexpt_image_tree_depth (node->right);
+    return 1 + (ldepth > rdepth ? ldepth : rdepth);
+}
+
+static inline uint64_t
+mexpt_image_align (uint64_t off) {
+
+    return (off + 7) & ~(uint64_t)7;
+}
+
+bool
+mexpt_image_write (const char *path, mexpt_tree_t **trees, uint32_t n_trees) {
+
+    uint32_t i;
+    mexpt_image_hdr_t hdr;
+    mexpt_image_writer_t writer;
+    mexpt_image_expr_t *exprs;
+    static const uint8_t pad[8] = {0};
+    bool rc = true;
+
+    for (i = 0; i < n_trees; i++) {
+        if (mexpt_image_tree_depth (trees[i]->root) > MEXPT_IMAGE_MAX_DEPTH) {
+            printf ("Error : Expression %u is deeper than %d levels\n", i, MEXPT_IMAGE_MAX_DEPTH);
+            return false;
+        }
+    }
+
+    memset (&writer, 0, sizeof (writer));
+    exprs = (mexpt_image_expr_t *)calloc (n_trees ? n_trees : 1, sizeof (mexpt_image_expr_t));
+
+    for (i = 0; i < n_trees; i++) {
+
+        /* An empty tree is stored with zero nodes and evaluates to invalid */
+        exprs[i].root = writer.n_nodes;
+        exprs[i].first_opd = writer.n_opds;
+        if (trees[i]->root) {
+            mexpt_image_write_node (&writer, trees[i]->root, writer.n_opds);
+        }
+        exprs[i].n_nodes = writer.n_nodes - exprs[i].root;
+        exprs[i].n_opds = writer.n_opds - exprs[i].first_opd;
+    }
+
+    memset (&hdr, 0, sizeof (hdr));
+    hdr.magic = MEXPT_IMAGE_MAGIC;
+    hdr.version = MEXPT_IMAGE_VERSION;
+    hdr.hdr_size = sizeof (hdr);
+    hdr.n_exprs = n_trees;
+    hdr.n_nodes = writer.n_nodes;
+    hdr.n_opds = writer.n_opds;
+    hdr.strtab_size = writer.strtab.buf.size;
+    hdr.exprs_off = mexpt_image_align (sizeof (hdr));
+    hdr.nodes_off = mexpt_image_align (hdr.exprs_off + (uint64_t)n_trees * sizeof (mexpt_image_expr_t));
+    hdr.opds_off = mexpt_image_align (hdr.nodes_off + writer.nodes.size);
+    hdr.strtab_off = mexpt_image_align (hdr.opds_off + writer.opds.size);
+    hdr.file_size = hdr.strtab_off + writer.strtab.buf.size;
+
+    FILE *fp = fopen (path, "wb");
+
+    if (!fp) {
+        printf ("Error : Could not open %s for writing\n", path);
+        rc = false;
+    }
+    else {
+        fwrite (&hdr, sizeof (hdr), 1, fp);
+        fwrite (pad, hdr.exprs_off - sizeof (hdr), 1, fp);
+        fwrite (exprs, sizeof (mexpt_image_expr_t), n_trees, fp);
+        fwrite (pad, hdr.nodes_off - (hdr.exprs_off + (uint64_t)n_trees * sizeof (mexpt_image_expr_t)), 1, fp);
+        fwrite (writer.nodes.data, writer.nodes.size, 1, fp);
+        fwrite (pad, hdr.opds_off - (hdr.nodes_off + writer.nodes.size), 1, fp);
+        fwrite (writer.opds.data, writer.opds.size, 1, fp);
+        fwrite (pad, hdr.strtab_off - (hdr.opds_off + writer.opds.size), 1, fp);
+        fwrite (writer.strtab.buf.data, writer.strtab.buf.size, 1, fp);
+        if (ferror (fp)) rc = false;
+        if (fclose (fp) != 0) rc = false;
+    }
+
+    free (exprs);
+    free (writer.nodes.data);
+    free (writer.opds.data);
+    free (writer.strtab.buf.data);
+    free (writer.strtab.slots);
+    return rc;
+}
+
+/* ====================x================x=================== */
+/* Image Loader */
+
+static bool
+mexpt_image_validate_str (const mexpt_image_t *image, uint32_t str_off) {
+
+    uint32_t len;
+    uint32_t strtab_size = image->hdr->strtab_size;
+
+    if (str_off < sizeof (uint32_t) || str_off >= strtab_size) return false;
+    if (str_off % sizeof (uint32_t)) return false;
+    len = *(const uint32_t *)(image->strtab + str_off - sizeof (uint32_t));
+    if ((uint64_t)str_off + len >= strtab_size) return false;
+    return image->strtab[str_off + len] == '\0';
+}
+
+/* [off, off + len) lies in the image, written so that the sum cannot wrap */
+static inline bool
+mexpt_image_span_valid (const mexpt_image_t *image, uint64_t off, uint64_t len) {
+
+    return off <= image->size && len <= image->size - off;
+}
+
+/* Every node of the expression but its root has exactly one parent, and lies
+    at most MEXPT_IMAGE_MAX_DEPTH levels below the root. Children follow their
+    parent, so the depth of a node is known when the loop reaches it. depth is
+    scratch space of hdr->n_nodes entries */
+static bool
+mexpt_image_validate_tree (const mexpt_image_t *image,
+                                         const mexpt_image_expr_t *expr,
+                                         uint32_t *depth) {
+
+    uint32_t j, child;
+    uint32_t end = expr->root + expr->n_nodes;
+    const mexpt_image_node_t *node;
+
+    if (!expr->n_nodes) return true;
+
+    memset (depth + expr->root, 0, expr->n_nodes * sizeof (uint32_t));
+    depth[expr->root] = 1;
+
+    for (j = expr->root; j < end; j++) {
+
+        node = &image->nodes[j];
+
+        /* Not reachable from the root */
+        if (!depth[j]) return false;
+
+        if (node->left) {
+            child = j + node->left;
+            if (depth[child] || depth[j] >= MEXPT_IMAGE_MAX_DEPTH) return false;
+            depth[child] = depth[j] + 1;
+        }
+        if (node->right) {
+            child = j + node->right;
+            if (depth[child] || depth[j] >= MEXPT_IMAGE_MAX_DEPTH) return false;
+            depth[child] = depth[j] + 1;
+        }
+    }
+    return true;
+}
+
+static bool
+mexpt_image_validate_exprs (const mexpt_image_t *image, uint32_t *depth);
+
+static bool
+mexpt_image_validate (const mexpt_image_t *image) {
+
+    bool rc;
+    uint32_t *depth;
+    const mexpt_image_hdr_t *hdr = image->hdr;
+
+    if (image->size < sizeof (mexpt_image_hdr_t)) return false;
+    if (hdr->magic != MEXPT_IMAGE_MAGIC) return false;
+    if (hdr->version != MEXPT_IMAGE_VERSION) return false;
+    if (hdr->hdr_size != sizeof (mexpt_image_hdr_t)) return false;
+    if (hdr->file_size != image->size) return false;
+
+    if (hdr->exprs_off % 8 || hdr->nodes_off % 8 || hdr->opds_off % 8 || hdr->strtab_off % 8) {
+        return false;
+    }
+    /* Counts are 32 bits, their products do not wrap, offsets are anything */
+    if (!mexpt_image_span_valid (image, hdr->exprs_off,
+                    (uint64_t)hdr->n_exprs * sizeof (mexpt_image_expr_t)) ||
+         !mexpt_image_span_valid (image, hdr->nodes_off,
+                    (uint64_t)hdr->n_nodes * sizeof (mexpt_image_node_t)) ||
+         !mexpt_image_span_valid (image, hdr->opds_off,
+                    (uint64_t)hdr->n_opds * sizeof (mexpt_image_opd_t)) ||
+         !mexpt_image_span_valid (image, hdr->strtab_off, hdr->strtab_size)) {
+        return false;
+    }
+
+    depth = (uint32_t *)malloc ((hdr->n_nodes ? hdr->n_nodes : 1) * sizeof (uint32_t));
+    rc = mexpt_image_validate_exprs (image, depth);
+    free (depth);
+    return rc;
+}
+
+static bool
+mexpt_image_validate_exprs (const mexpt_image_t *image, uint32_t *depth) {
+
+    uint32_t i, j, end;
+    const mexpt_image_hdr_t *hdr = image->hdr;
+
+    for (i = 0; i < hdr->n_exprs; i++) {
+
+        const mexpt_image_expr_t *expr = &image->exprs[i];
+
+        if ((uint64_t)expr->root + expr->n_nodes > hdr->n_nodes) return false;
+        if ((uint64_t)expr->first_opd + expr->n_opds > hdr->n_opds) return false;
+
+        end = expr->root + expr->n_nodes;
+
+        for (j = expr->root; j < end; j++) {
+
+            const mexpt_image_node_t *node = &image->nodes[j];
+
+            if (node->token_code < 0 || node->token_code >= MATH_MAX_CODE) return false;
+            /* Children follow their parent, this also rules out cycles */
+            if (node->left < 0 || node->right < 0) return false;
+            if (node->left && (uint64_t)j + node->left >= end) return false;
+            if (node->right && (uint64_t)j + node->right >= end) return false;
+            if (node->left && node->right && node->left == node->right) return false;
+
+            switch (node->token_code) {
+
+                case MATH_IDENTIFIER:
+                case MATH_IDENTIFIER_IDENTIFIER:
+                    if (node->u.opd_index >= expr->n_opds) return false;
+                    break;
+                case MATH_STRING_VALUE:
+                    if (!mexpt_image_validate_str (image, node->u.str_off)) return false;
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        for (j = expr->first_opd; j < expr->first_opd + expr->n_opds; j++) {
+
+            const mexpt_image_opd_t *opd = &image->opds[j];
+
+            if (opd->node < expr->root || opd->node >= end) return false;
+            if (image->nodes[opd->node].token_code != MATH_IDENTIFIER &&
+                 image->nodes[opd->node].token_code != MATH_IDENTIFIER_IDENTIFIER) return false;
+            if (!mexpt_image_validate_str (image, opd->name_off)) return false;
+        }
+
+        if (!mexpt_image_validate_tree (image, expr, depth)) return false;
+    }
+
+    return true;
+}
+
+mexpt_image_t *
+mexpt_image_open (const char *path) {
+
+    int fd;
+    struct stat st;
+    void *base;
+    mexpt_image_t *image;
+
+    fd = open (path, O_RDONLY);
+    if (fd < 0) {
+        printf ("Error : Could not open %s\n", path);
+        return NULL;
+    }
+
+    if (fstat (fd, &st) < 0 || st.st_size < (off_t)sizeof (mexpt_image_hdr_t)) {
+        close (fd);
+        return NULL;
+    }
+
+    base = mmap (NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close (fd);
+    if (base == MAP_FAILED) return NULL;
+
+    image = (mexpt_image_t *)calloc (1, sizeof (mexpt_image_t));
+    image->base = (const uint8_t *)base;
+    image->size = st.st_size;
+    image->hdr = (const mexpt_image_hdr_t *)base;
+    image->exprs = (const mexpt_image_expr_t *)(image->base + image->hdr->exprs_off);
+    image->nodes = (const mexpt_image_node_t *)(image->base + image->hdr->nodes_off);
+    image->opds = (const mexpt_image_opd_t *)(image->base + image->hdr->opds_off);
+    image->strtab = (const char *)(image->base + image->hdr->strtab_off);
+
+    if (!mexpt_image_validate (image)) {
+        printf ("Error : %s is not a valid expression image\n", path);
+        mexpt_image_close (image);
+        return NULL;
+    }
+
+    return image;
+}
+
+void
+mexpt_image_close (mexpt_image_t *image) {
+
+    munmap ((void *)image->base, image->size);
+    free (image);
+}
+
+/* ====================x================x=================== */
+/* Evaluation directly from the mapping, mirrors mexpt_evaluate( ) */
+
+static mexpr_var_t
+mexpt_image_evaluate_node (const mexpt_image_t *image,
+                                              uint32_t index,
+                                              const mexpt_image_binding_t *bindings) {
+
+    mexpr_var_t res, lrc, rrc;
+    const mexpt_image_node_t *node = &image->nodes[index];
+
+    res.dtype = MEXPR_DTYPE_INVALID;
+
+    /* If I am leaf */
+    if (!node->left && !node->right) {
+
+        switch (node->token_code) {
+
+            case MATH_IDENTIFIER:
+            case MATH_IDENTIFIER_IDENTIFIER:
+                if (!bindings || !bindings[node->u.opd_index].compute_fn_ptr) return res;
+                return bindings[node->u.opd_index].compute_fn_ptr (
+                                bindings[node->u.opd_index].data_src);
+            case MATH_INTEGER_VALUE:
+                res.dtype = MEXPR_DTYPE_INT;
+                res.u.int_val = node->u.int_val;
+                return res;
+            case MATH_DOUBLE_VALUE:
+                res.dtype = MEXPR_DTYPE_DOUBLE;
+                res.u.d_val = node->u.math_val;
+                return res;
+            case MATH_STRING_VALUE:
+                /* Strings of the table are length prefixed */
+                return mexpr_var_string ((unsigned char *)(image->strtab + node->u.str_off),
+                            *(const uint32_t *)(image->strtab + node->u.str_off - sizeof (uint32_t)));
+            default:
+                /* Due to optimization leaf may contain : Ineq Op Or Logical Op also*/
+                if (node->flags & MEXPT_IMAGE_NODE_OPTIMIZED) {
+                    res.dtype = MEXPR_DTYPE_BOOL;
+                    res.u.b_val = (node->flags & MEXPT_IMAGE_NODE_RESULT) != 0;
+                }
+                return res;
+        }
+    }
+
+    if (!node->left || !Math_is_operator (node->token_code) ||
+         node->token_code >= MATH_OPR_MAX) return res;
+
+    lrc = mexpt_image_evaluate_node (image, index + node->left, bindings);
+    if (lrc.dtype == MEXPR_DTYPE_INVALID) return res;
+
+    if (!node->right) {
+        if (!Math_is_unary_operator (node->token_code)) return res;
+        return mexpt_compute (node->token_code, lrc, lrc);
+    }
+
+    rrc = mexpt_image_evaluate_node (image, index + node->right, bindings);
+    if (rrc.dtype == MEXPR_DTYPE_INVALID) return res;
+
+    if (!Math_is_binary_operator (node->token_code)) return res;
+    return mexpt_compute (node->token_code, lrc, rrc);
+}
+
+mexpr_var_t
+mexpt_image_evaluate (const mexpt_image_t *image,
+                                      uint32_t expr_id,
+                                      const mexpt_image_binding_t *bindings) {
+
+    mexpr_var_t res;
+    const mexpt_image_expr_t *expr = &image->exprs[expr_id];
+
+    res.dtype = MEXPR_DTYPE_INVALID;
+
+    mexpr_arena_t *prev;
+
+    assert (expr_id < image->hdr->n_exprs);
+    if (!expr->n_nodes) return res;
+
+    prev = mexpr_arena_enter (NULL);
+    res = mexpt_image_evaluate_node (image, expr->root, bindings);
+    mexpr_arena_leave (prev);
+    return res;
+}
@@ -0,0 +1,145 @@
+#ifndef __MEXPR_IMAGE__
+#define __MEXPR_IMAGE__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "MExpr.h"
+
+/* Binary Image of Expression Trees
+
+    Appln which stores many expressions (rules, views) can write them once into an
+    image file with mexpt_image_write( ) and, at startup, map the file with
+    mexpt_image_open( ) instead of parsing every expression from text. The image is
+    evaluated directly from the mapping : there is no per node allocation and no
+    pointer fixup, hence the same file can be shared read-only by any number of
+    worker processes.
+
+    File Layout (all offsets in bytes from the start of the file) :
+
+    mexpt_image_hdr_t
+    mexpt_image_expr_t  [n_exprs]     per expression : root node, node span, operand span
+    mexpt_image_node_t  [n_nodes]     nodes of all expressions, each expression in pre-order
+    mexpt_image_opd_t   [n_opds]      operand list of all expressions
+    string table                      interned strings, each is [uint32_t len][bytes][\0]
+
+    Child links of a node are relative indices (child index - own index), 0 means no
+    child. Children always follow their parent in pre-order, so relative indices are
+    always positive, which lets the loader reject cycles while validating. The loader
+    also rejects nodes shared by two parents, nodes not reachable from the root, and
+    expressions deeper than MEXPT_IMAGE_MAX_DEPTH, which bounds the recursion of
+    mexpt_image_evaluate( ) on a crafted image.
+*/
+
+#define MEXPT_IMAGE_MAGIC   0x4950584dU     /* "MXPI" */
+#define MEXPT_IMAGE_VERSION 2
+
+/* Levels of nodes of an expression, mexpt_image_write( ) fails on deeper trees */
+#define MEXPT_IMAGE_MAX_DEPTH   4096
+
+typedef struct mexpt_image_hdr_ {
+
+    uint32_t magic;
+    uint16_t version;
+    uint16_t hdr_size;
+    uint32_t n_exprs;
+    uint32_t n_nodes;
+    uint32_t n_opds;
+    uint32_t strtab_size;
+    uint64_t exprs_off;
+    uint64_t nodes_off;
+    uint64_t opds_off;
+    uint64_t strtab_off;
+    uint64_t file_size;
+} mexpt_image_hdr_t;
+
+typedef struct mexpt_image_expr_ {
+
+    uint32_t root;          /* Index into node array */
+    uint32_t n_nodes;
+    uint32_t first_opd;     /* Index into operand array */
+    uint32_t n_opds;
+} mexpt_image_expr_t;
+
+#define MEXPT_IMAGE_NODE_RESOLVED   (1 << 0)
+#define MEXPT_IMAGE_NODE_NUMERIC    (1 << 1)
+#define MEXPT_IMAGE_NODE_OPTIMIZED  (1 << 2)
+#define MEXPT_IMAGE_NODE_RESULT     (1 << 3)
+
+typedef struct mexpt_image_node_ {
+
+    int32_t token_code;
+    uint32_t flags;
+    int32_t left;           /* relative index, 0 if none */
+    int32_t right;          /* relative index, 0 if none */
+
+    union {
+        double math_val;    /* MATH_DOUBLE_VALUE */
+        int64_t int_val;    /* MATH_INTEGER_VALUE */
+        uint32_t str_off;   /* MATH_STRING_VALUE : offset of bytes in string table */
+        uint32_t opd_index; /* MATH_IDENTIFIER(_IDENTIFIER) : index in expression's operand list */
+    } u;
+} mexpt_image_node_t;
+
+typedef struct mexpt_image_opd_ {
+
+    uint32_t node;          /* Index into node array */
+    uint32_t name_off;      /* offset of operand name in string table */
+} mexpt_image_opd_t;
+
+typedef struct mexpt_image_ {
+
+    const uint8_t *base;
+    uint64_t size;
+    const mexpt_image_hdr_t *hdr;
+    const mexpt_image_expr_t *exprs;
+    const mexpt_image_node_t *nodes;
+    const mexpt_image_opd_t *opds;
+    const char *strtab;
+} mexpt_image_t;
+
+/* Operand resolution of an image expression, indexed by operand ordinal.
+    Appln keeps its own binding array per expression and per process, the image
+    itself is never written */
+typedef struct mexpt_image_binding_ {
+
+    void *data_src;
+    mexpr_var_t (*compute_fn_ptr) (void *);
+} mexpt_image_binding_t;
+
+bool
+mexpt_image_write (const char *path, mexpt_tree_t **trees, uint32_t n_trees);
+
+mexpt_image_t *
+mexpt_image_open (const char *path);
+
+void
+mexpt_image_close (mexpt_image_t *image);
+
+static inline uint32_t
+mexpt_image_expr_count (const mexpt_image_t *image) {
+
+    return image->hdr->n_exprs;
+}
+
+static inline uint32_t
+mexpt_image_operand_count (const mexpt_image_t *image, uint32_t expr_id) {
+
+    return image->exprs[expr_id].n_opds;
+}
+
+static inline const char *
+mexpt_image_operand_name (const mexpt_image_t *image, uint32_t expr_id, uint32_t opd_index) {
+
+    const mexpt_image_expr_t *expr = &image->exprs[expr_id];
+    return image->strtab + image->opds[expr->first_opd + opd_index].name_off;
+}
+
+/* String results point into the read-only mapping, Appln must not modify them,
+    or are built in the calling thread's arena like by mexpt_evaluate( ) */
+mexpr_var_t
+mexpt_image_evaluate (const mexpt_image_t *image,
+                                      uint32_t expr_id,
+                                      const mexpt_image_binding_t *bindings);
+
+#endif
@@ -0,0 +1,148 @@
+#include <stdlib.h>
+#include <string.h>
+#include "MexprIntern.h"
+
+#define MEXPR_INTERN_SLOTS_MIN  256
+
+/* Open addressing, linear probing, at most half full */
+static mexpr_istr_t **mexpr_intern_slots;
+static uint32_t mexpr_intern_n_slots;
+static uint32_t mexpr_intern_n_entries;
+static bool mexpr_intern_lock;
+
+static void
+mexpr_intern_acquire (void) {
+
+    while (__atomic_test_and_set (&mexpr_intern_lock, __ATOMIC_ACQUIRE));
+}
+
+static void
+mexpr_intern_release (void) {
+
+    __atomic_clear (&mexpr_intern_lock, __ATOMIC_RELEASE);
+}
+
+uint32_t
+mexpr_str_hash (const unsigned char *str, uint32_t len) {
+
+    uint32_t i;
+    uint32_t hash = 2166136261U;
+
+    for (i = 0; i < len; i++) {
+        hash ^= str[i];
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+/* Slot of the string, or the empty slot where it belongs */
+static uint32_t
+mexpr_intern_find (const unsigned char *str, uint32_t len, uint32_t hash) {
+
+    uint32_t mask = mexpr_intern_n_slots - 1;
+    uint32_t slot = hash & mask;
+    mexpr_istr_t *istr;
+
+    while ((istr = mexpr_intern_slots[slot])) {
+
+        if (istr->hash == hash && istr->len == len &&
+                memcmp (istr->str, str, len) == 0) {
+            return slot;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+static void
+mexpr_intern_grow (void) {
+
+    uint32_t i, slot, mask;
+    uint32_t n_slots = mexpr_intern_n_slots;
+    mexpr_istr_t **slots = mexpr_intern_slots;
+
+    mexpr_intern_n_slots = n_slots ? n_slots * 2 : MEXPR_INTERN_SLOTS_MIN;
+    mexpr_intern_slots = (mexpr_istr_t **)calloc (mexpr_intern_n_slots,
+                                                                sizeof (mexpr_istr_t *));
+    mask = mexpr_intern_n_slots - 1;
+
+    for (i = 0; i < n_slots; i++) {
+
+        if (!slots[i]) continue;
+        slot = slots[i]->hash & mask;
+        while (mexpr_intern_slots[slot]) slot = (slot + 1) & mask;
+        mexpr_intern_slots[slot] = slots[i];
+    }
+    free (slots);
+}
+
+const mexpr_istr_t *
+mexpr_intern (const unsigned char *str, uint32_t len) {
+
+    uint32_t slot;
+    mexpr_istr_t *istr;
+    uint32_t hash = mexpr_str_hash (str, len);
+
+    mexpr_intern_acquire ();
+
+    if ((mexpr_intern_n_entries + 1) * 2 > mexpr_intern_n_slots) {
+        mexpr_intern_grow ();
+    }
+
+    slot = mexpr_intern_find (str, len, hash);
+    istr = mexpr_intern_slots[slot];
+
+    if (!istr) {
+
+        istr = (mexpr_istr_t *)malloc (sizeof (mexpr_istr_t) + len + 1);
+        istr->hash = hash;
+        istr->len = len;
+        memcpy (istr->str, str, len);
+        istr->str[len] = '\0';
+        mexpr_intern_slots[slot] = istr;
+        mexpr_intern_n_entries++;
+    }
+
+    mexpr_intern_release ();
+    return istr;
+}
+
+const mexpr_istr_t *
+mexpr_intern_lookup (const unsigned char *str, uint32_t len) {
+
+    mexpr_istr_t *istr = NULL;
+    uint32_t hash = mexpr_str_hash (str, len);
+
+    mexpr_intern_acquire ();
+
+    if (mexpr_intern_n_slots) {
+        istr = mexpr_intern_slots[mexpr_intern_find (str, len, hash)];
+    }
+
+    mexpr_intern_release ();
+    return istr;
+}
+
+uint32_t
+mexpr_intern_count (void) {
+
+    return __atomic_load_n (&mexpr_intern_n_entries, __ATOMIC_RELAXED);
+}
+
+void
+mexpr_intern_cleanup (void) {
+
+    uint32_t i;
+
+    mexpr_intern_acquire ();
+
+    for (i = 0; i < mexpr_intern_n_slots; i++) {
+        free (mexpr_intern_slots[i]);
+    }
+    free (mexpr_intern_slots);
+    mexpr_intern_slots = NULL;
+    mexpr_intern_n_slots = 0;
+    mexpr_intern_n_entries = 0;
+
+    mexpr_intern_release ();
+}
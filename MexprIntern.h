@@ -0,0 +1,62 @@
+#ifndef __MEXPR_INTERN__
+#define __MEXPR_INTERN__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "MexprEnums.h"
+
+/* String Interning
+
+    One table per process holds a single copy of every interned string,
+    with its hash. Two interned strings are equal if and only if they are
+    the same entry, so MexprDb compares them by pointer. String values
+    (mexpr_var_t) tell they are interned by str_interned.
+
+    String literals of expression trees are interned when the tree is built.
+    Appln interns column values it owns, typically the few distinct values
+    of a low cardinality column, once when loading them, and returns them
+    from operand callbacks with mexpr_var_interned( ). Predicates like
+    name = 'abc' then cost one pointer compare per row.
+
+    Interning takes a lock and may allocate : intern at load time, not per
+    evaluation. Entries are never freed until mexpr_intern_cleanup( ).
+*/
+
+typedef struct mexpr_istr_ {
+
+    uint32_t hash;
+    uint32_t len;
+    unsigned char str[];        /* len bytes, '\0' terminated */
+} mexpr_istr_t;
+
+/* FNV-1a */
+uint32_t
+mexpr_str_hash (const unsigned char *str, uint32_t len);
+
+/* Entry of the string, added if absent. Never fails */
+const mexpr_istr_t *
+mexpr_intern (const unsigned char *str, uint32_t len);
+
+/* Entry of the string, NULL if it was never interned */
+const mexpr_istr_t *
+mexpr_intern_lookup (const unsigned char *str, uint32_t len);
+
+uint32_t
+mexpr_intern_count (void);
+
+/* Frees every entry, for Applns about to exit : no interned string, nor a
+    tree holding one, may be used afterwards */
+void
+mexpr_intern_cleanup (void);
+
+static inline mexpr_var_t
+mexpr_var_interned (const mexpr_istr_t *istr) {
+
+    mexpr_var_t var = mexpr_var_string (istr->str, istr->len);
+
+    var.str_interned = 1;
+    return var;
+}
+
+#endif
@@ -0,0 +1,263 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "UserParserL.h"
+#include "ParserMexpr.h"
+#include "MexprEnums.h"
+#include "MexprIntern.h"
+
+/* Measures string equality filters on a low cardinality column, see
+    MexprIntern.h
+
+    Usage : mexprintern [rows] [distinct values]
+
+    Column s of rows rows (1M if not given) takes one of distinct values
+    values (16 if not given, at most MEXPRINTERN_MAX_VALUES) category_0000,
+    category_0001 ... at random. Every condition is evaluated on the column
+    held three ways :
+
+        copy    every row has its own copy of its value, as read from a file
+        view    rows point to the distinct values, not interned
+        intern  rows hold the distinct values interned, see
+                mexpr_var_interned( )
+
+    Prints rows selected, then ns per row of mexpt_evaluate( ) and of the
+    MexprDb operator alone (mexpt_compute( ) of the root operator on the
+    column value and the literal, for conditions col = 'literal' and
+    col != 'literal'), best of MEXPRINTERN_REPEAT runs. Returns 1 if the
+    three ways select different rows.
+*/
+
+#define MEXPRINTERN_REPEAT      3
+#define MEXPRINTERN_MAX_VALUES  10000
+#define MEXPRINTERN_VALUE_LEN   16
+
+typedef enum {
+
+    MEXPRINTERN_COPY,
+    MEXPRINTERN_VIEW,
+    MEXPRINTERN_INTERN,
+    MEXPRINTERN_N_WAYS
+} mexprintern_way_t;
+
+static const char *mexprintern_conds[] = {
+    "s = 'category_0001'",
+    "s != 'category_0001'",
+    "s = 'category_0001' or s = 'category_0002'",
+    "s = 'category_none'",
+    NULL
+};
+
+/* Column s, held the three ways */
+static mexpr_var_t *mexprintern_cols[MEXPRINTERN_N_WAYS];
+static const mexpr_var_t *mexprintern_col;
+static uint64_t mexprintern_row;
+
+static double
+mexprintern_now (void) {
+
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static mexpr_var_t
+mexprintern_col_compute (void *data_src) {
+
+    return mexprintern_col[mexprintern_row];
+}
+
+static mexpt_tree_t *
+mexprintern_build (const char *cond) {
+
+    mexpt_tree_t *tree;
+    mexpt_node_t *opd_node = NULL;
+
+    /* Parser rewinds by rescanning lex_buffer */
+    strcpy ((char *)lex_buffer, cond);
+    lex_set_scan_buffer ((const char *)lex_buffer);
+
+    tree = Parser_Mexpr_Condition_build_expression_tree ();
+    Parser_stack_reset ();
+
+    if (!tree) {
+        printf ("Error : Exp Tree could not built for %s\n", cond);
+        return NULL;
+    }
+
+    mexpt_iterate_operands_begin (tree, opd_node) {
+
+        if (strcmp ((char *)opd_node->u.opd_node.opd_value.variable_name, "s") != 0) {
+            printf ("Error : Unknown column %s\n",
+                        (char *)opd_node->u.opd_node.opd_value.variable_name);
+            mexpt_tree_destroy (tree, false);
+            return NULL;
+        }
+        opd_node->u.opd_node.is_numeric = false;
+        mexpt_tree_install_operand_properties (opd_node, NULL, mexprintern_col_compute);
+        mexpt_tree_set_operand_dtype (opd_node, MEXPR_DTYPE_STRING);
+
+    } mexpt_iterate_operands_end (tree, opd_node);
+
+    if (!mexpr_validate_expression_tree (tree)) {
+        printf ("Error : %s is not a valid condition\n", cond);
+        mexpt_tree_destroy (tree, false);
+        return NULL;
+    }
+    return tree;
+}
+
+/* Literal of col = 'literal' and col != 'literal', interned as the parser
+    interns it. Returns false for other conditions */
+static bool
+mexprintern_literal (mexpt_tree_t *tree, mexpr_var_t *lit) {
+
+    mexpt_node_t *node = tree->root->right;
+
+    if (tree->root->token_code != MATH_EQ && tree->root->token_code != MATH_NOT_EQ) {
+        return false;
+    }
+    if (!node || node->token_code != MATH_STRING_VALUE) return false;
+
+    *lit = mexpr_var_interned (node->u.opd_node.istr);
+    return true;
+}
+
+/* Returns false if the three ways select different rows */
+static bool
+mexprintern_cond (const char *cond, uint64_t n_rows) {
+
+    int r, way;
+    bool has_lit;
+    double start, t_eval[MEXPRINTERN_N_WAYS], t_cmp[MEXPRINTERN_N_WAYS];
+    uint64_t n_cmp_selected, n_selected[MEXPRINTERN_N_WAYS];
+    mexpr_var_t res, lit;
+    mexpt_tree_t *tree = mexprintern_build (cond);
+
+    if (!tree) return true;
+    has_lit = mexprintern_literal (tree, &lit);
+
+    for (way = 0; way < MEXPRINTERN_N_WAYS; way++) {
+
+        n_cmp_selected = 0;
+        mexprintern_col = mexprintern_cols[way];
+        t_eval[way] = t_cmp[way] = INFINITY;
+
+        for (r = 0; r < MEXPRINTERN_REPEAT; r++) {
+
+            n_selected[way] = 0;
+            start = mexprintern_now ();
+            for (mexprintern_row = 0; mexprintern_row < n_rows; mexprintern_row++) {
+                res = mexpt_evaluate (tree->root);
+                n_selected[way] += res.dtype == MEXPR_DTYPE_BOOL && res.u.b_val;
+            }
+            t_eval[way] = fmin (t_eval[way], mexprintern_now () - start);
+
+            if (!has_lit) continue;
+
+            n_cmp_selected = 0;
+            start = mexprintern_now ();
+            for (mexprintern_row = 0; mexprintern_row < n_rows; mexprintern_row++) {
+                res = mexpt_compute (tree->root->token_code,
+                                                    mexprintern_col[mexprintern_row], lit);
+                n_cmp_selected += res.u.b_val;
+            }
+            t_cmp[way] = fmin (t_cmp[way], mexprintern_now () - start);
+        }
+
+        /* A disagreement of the operator alone shows as one of the three ways */
+        if (has_lit && n_cmp_selected != n_selected[way]) n_selected[way] = UINT64_MAX;
+    }
+
+    printf ("%-44s  %9llu  %7.1f  %7.1f  %7.1f", cond, (unsigned long long)n_selected[0],
+                t_eval[MEXPRINTERN_COPY] / n_rows * 1e9,
+                t_eval[MEXPRINTERN_VIEW] / n_rows * 1e9,
+                t_eval[MEXPRINTERN_INTERN] / n_rows * 1e9);
+    if (has_lit) {
+        printf ("  %7.1f  %7.1f  %7.1f", t_cmp[MEXPRINTERN_COPY] / n_rows * 1e9,
+                    t_cmp[MEXPRINTERN_VIEW] / n_rows * 1e9,
+                    t_cmp[MEXPRINTERN_INTERN] / n_rows * 1e9);
+    }
+    printf ("\n");
+
+    mexpt_tree_destroy (tree, false);
+
+    if (n_selected[MEXPRINTERN_VIEW] != n_selected[MEXPRINTERN_COPY] ||
+            n_selected[MEXPRINTERN_INTERN] != n_selected[MEXPRINTERN_COPY]) {
+        printf ("Error : %s selects %llu, %llu and %llu rows\n", cond,
+                    (unsigned long long)n_selected[MEXPRINTERN_COPY],
+                    (unsigned long long)n_selected[MEXPRINTERN_VIEW],
+                    (unsigned long long)n_selected[MEXPRINTERN_INTERN]);
+        return false;
+    }
+    return true;
+}
+
+int
+main (int argc, char **argv) {
+
+    int i, way, n_values = 16;
+    bool ok = true;
+    uint64_t row, n_rows = 1024 * 1024;
+    uint32_t len;
+    char (*values)[MEXPRINTERN_VALUE_LEN];
+    char (*copies)[MEXPRINTERN_VALUE_LEN];
+
+    if (argc > 3) {
+        printf ("Usage : %s [rows] [distinct values]\n", argv[0]);
+        return 1;
+    }
+    if (argc > 1) n_rows = strtoull (argv[1], NULL, 10);
+    if (argc > 2) n_values = atoi (argv[2]);
+    if (!n_rows) n_rows = 1;
+    if (n_values <= 0) n_values = 1;
+    if (n_values > MEXPRINTERN_MAX_VALUES) n_values = MEXPRINTERN_MAX_VALUES;
+
+    parse_init ();
+    srand (1);
+
+    values = (char (*)[MEXPRINTERN_VALUE_LEN])malloc (n_values * MEXPRINTERN_VALUE_LEN);
+    copies = (char (*)[MEXPRINTERN_VALUE_LEN])malloc (n_rows * MEXPRINTERN_VALUE_LEN);
+    for (way = 0; way < MEXPRINTERN_N_WAYS; way++) {
+        mexprintern_cols[way] = (mexpr_var_t *)malloc (n_rows * sizeof (mexpr_var_t));
+    }
+
+    for (i = 0; i < n_values; i++) {
+        snprintf (values[i], MEXPRINTERN_VALUE_LEN, "category_%04d", i);
+    }
+    len = strlen (values[0]);
+
+    for (row = 0; row < n_rows; row++) {
+
+        i = rand () % n_values;
+        memcpy (copies[row], values[i], MEXPRINTERN_VALUE_LEN);
+
+        mexprintern_cols[MEXPRINTERN_COPY][row] =
+                    mexpr_var_string ((unsigned char *)copies[row], len);
+        mexprintern_cols[MEXPRINTERN_VIEW][row] =
+                    mexpr_var_string ((unsigned char *)values[i], len);
+        mexprintern_cols[MEXPRINTERN_INTERN][row] =
+                    mexpr_var_interned (mexpr_intern ((unsigned char *)values[i], len));
+    }
+
+    printf ("%llu rows, %d distinct values, ns per row\n",
+                (unsigned long long)n_rows, n_values);
+    printf ("%-44s  %9s  %-25s  %s\n", "", "", "mexpt_evaluate", "operator");
+    printf ("%-44s  %9s  %7s  %7s  %7s  %7s  %7s  %7s\n", "condition", "selected",
+                "copy", "view", "intern", "copy", "view", "intern");
+
+    for (i = 0; mexprintern_conds[i]; i++) {
+        ok = mexprintern_cond (mexprintern_conds[i], n_rows) && ok;
+    }
+
+    for (way = 0; way < MEXPRINTERN_N_WAYS; way++) {
+        free (mexprintern_cols[way]);
+    }
+    free (values);
+    free (copies);
+    mexpr_intern_cleanup ();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,496 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+#include "MexprEnums.h"
+#include "MExpr.h"
+#include "MexprInterval.h"
+
+#define MEXPT_IV_INT_EXACT      9007199254740992.0      /* 2^53 */
+#define MEXPT_IV_INT_LIMIT      9223372036854775808.0   /* 2^63 */
+#define MEXPT_IV_TRIG_MAX       1048576.0               /* 2^20 */
+#define MEXPT_IV_LIBM_ULPS      4
+
+/* No outcome */
+static mexpr_interval_t
+mexpt_iv_none (void) {
+
+    return mexpr_interval (INFINITY, -INFINITY);
+}
+
+/* False for NaN bounds too */
+static inline bool
+mexpt_iv_empty (mexpr_interval_t iv) {
+
+    return !(iv.lo <= iv.hi);
+}
+
+static inline bool
+mexpt_iv_has (mexpr_interval_t iv, double val) {
+
+    return iv.lo <= val && val <= iv.hi;
+}
+
+/* Adds an outcome of the operator */
+static inline void
+mexpt_iv_add (mexpr_interval_t *iv, double val) {
+
+    if (val != val) {
+        iv->maybe_nan = true;
+        return;
+    }
+    if (val < iv->lo) iv->lo = val;
+    if (val > iv->hi) iv->hi = val;
+}
+
+static mexpr_interval_t
+mexpt_iv_hull (mexpr_interval_t iv1, mexpr_interval_t iv2) {
+
+    mexpr_interval_t iv = iv1;
+
+    if (!mexpt_iv_empty (iv2)) {
+        mexpt_iv_add (&iv, iv2.lo);
+        mexpt_iv_add (&iv, iv2.hi);
+    }
+    iv.maybe_nan |= iv2.maybe_nan;
+    iv.maybe_invalid |= iv2.maybe_invalid;
+    return iv;
+}
+
+static mexpr_interval_t
+mexpt_iv_bool (bool can_true, bool can_false) {
+
+    mexpr_interval_t iv = mexpt_iv_none ();
+
+    if (can_false) mexpt_iv_add (&iv, 0);
+    if (can_true) mexpt_iv_add (&iv, 1);
+    return iv;
+}
+
+/* Results of libm may be off by a few ulps from the exact ones */
+static void
+mexpt_iv_widen_libm (mexpr_interval_t *iv) {
+
+    int i;
+
+    if (mexpt_iv_empty (*iv)) return;
+    for (i = 0; i < MEXPT_IV_LIBM_ULPS; i++) {
+        iv->lo = nextafter (iv->lo, -INFINITY);
+        iv->hi = nextafter (iv->hi, INFINITY);
+    }
+}
+
+/* Node may compute on int64 : bounds computed in double are rounded and the
+    exact integer may lie past them beyond 2^53, results past int64 fail */
+static void
+mexpt_iv_fix_int (mexpt_node_t *node, mexpr_interval_t *iv) {
+
+    if (node->rt_dtype == MEXPR_DTYPE_DOUBLE || mexpt_iv_empty (*iv)) return;
+
+    if (fabs (iv->lo) >= MEXPT_IV_INT_EXACT) iv->lo = nextafter (iv->lo, -INFINITY);
+    if (fabs (iv->hi) >= MEXPT_IV_INT_EXACT) iv->hi = nextafter (iv->hi, INFINITY);
+    if (iv->lo < -MEXPT_IV_INT_LIMIT || iv->hi >= MEXPT_IV_INT_LIMIT) {
+        iv->maybe_invalid = true;
+    }
+}
+
+static mexpr_interval_t
+mexpt_iv_arith (int opr, mexpr_interval_t a, mexpr_interval_t b) {
+
+    int i, j;
+    double av[2] = {a.lo, a.hi};
+    double bv[2] = {b.lo, b.hi};
+    mexpr_interval_t iv = mexpt_iv_none ();
+
+    iv.maybe_nan = a.maybe_nan || b.maybe_nan;
+    iv.maybe_invalid = a.maybe_invalid || b.maybe_invalid;
+    if (mexpt_iv_empty (a) || mexpt_iv_empty (b)) return iv;
+
+    /* Monotone in each operand : extremes are at the corners, rounding is
+        monotone too */
+    for (i = 0; i < 2; i++) {
+        for (j = 0; j < 2; j++) {
+            switch (opr) {
+                case MATH_PLUS:  mexpt_iv_add (&iv, av[i] + bv[j]); break;
+                case MATH_MINUS: mexpt_iv_add (&iv, av[i] - bv[j]); break;
+                case MATH_MUL:   mexpt_iv_add (&iv, av[i] * bv[j]); break;
+                case MATH_DIV:   mexpt_iv_add (&iv, av[i] / bv[j]); break;
+            }
+        }
+    }
+
+    /* 0 * inf inside the box */
+    if (opr == MATH_MUL &&
+            ((mexpt_iv_has (a, 0) && (isinf (b.lo) || isinf (b.hi))) ||
+             (mexpt_iv_has (b, 0) && (isinf (a.lo) || isinf (a.hi))))) {
+        iv.maybe_nan = true;
+    }
+    return iv;
+}
+
+/* Divisor is split into its negative and positive parts, zero fails */
+static mexpr_interval_t
+mexpt_iv_div (mexpr_interval_t a, mexpr_interval_t b) {
+
+    mexpr_interval_t part;
+    mexpr_interval_t iv = mexpt_iv_none ();
+
+    iv.maybe_nan = a.maybe_nan || b.maybe_nan;
+    iv.maybe_invalid = a.maybe_invalid || b.maybe_invalid || mexpt_iv_has (b, 0);
+    if (mexpt_iv_empty (a) || mexpt_iv_empty (b)) return iv;
+
+    if (b.lo < 0) {
+        part = b;
+        if (part.hi >= 0) part.hi = -DBL_TRUE_MIN;
+        iv = mexpt_iv_hull (iv, mexpt_iv_arith (MATH_DIV, a, part));
+    }
+    if (b.hi > 0) {
+        part = b;
+        if (part.lo <= 0) part.lo = DBL_TRUE_MIN;
+        iv = mexpt_iv_hull (iv, mexpt_iv_arith (MATH_DIV, a, part));
+    }
+    return iv;
+}
+
+/* mmax is l > r ? l : r, mmin l < r ? l : r : NaN on the left gives the
+    right operand, NaN on the right gives NaN */
+static mexpr_interval_t
+mexpt_iv_max_min (bool is_max, mexpr_interval_t a, mexpr_interval_t b) {
+
+    mexpr_interval_t iv = mexpt_iv_none ();
+
+    iv.maybe_nan = b.maybe_nan;
+    iv.maybe_invalid = a.maybe_invalid || b.maybe_invalid;
+
+    if (!mexpt_iv_empty (a) && !mexpt_iv_empty (b)) {
+        iv.lo = is_max ? fmax (a.lo, b.lo) : fmin (a.lo, b.lo);
+        iv.hi = is_max ? fmax (a.hi, b.hi) : fmin (a.hi, b.hi);
+    }
+    if (a.maybe_nan && !mexpt_iv_empty (b)) {
+        mexpt_iv_add (&iv, b.lo);
+        mexpt_iv_add (&iv, b.hi);
+    }
+    return iv;
+}
+
+static mexpr_interval_t
+mexpt_iv_sqr (mexpr_interval_t a) {
+
+    mexpr_interval_t iv = mexpt_iv_arith (MATH_MUL, a, a);
+
+    /* Not a product of independent operands */
+    if (!mexpt_iv_empty (iv) && mexpt_iv_has (a, 0)) iv.lo = 0;
+    else if (!mexpt_iv_empty (iv)) iv.lo = fmin (a.lo * a.lo, a.hi * a.hi);
+    iv.maybe_nan = a.maybe_nan;
+    return iv;
+}
+
+static mexpr_interval_t
+mexpt_iv_sqrt (mexpr_interval_t a) {
+
+    mexpr_interval_t iv = mexpt_iv_none ();
+
+    iv.maybe_nan = a.maybe_nan || a.lo < 0;
+    iv.maybe_invalid = a.maybe_invalid;
+    if (mexpt_iv_empty (a) || a.hi < 0) return iv;
+
+    /* Correctly rounded, no widening */
+    iv.lo = sqrt (a.lo < 0 ? 0 : a.lo);
+    iv.hi = sqrt (a.hi);
+    return iv;
+}
+
+/* Extremes of sin( ) are at pi/2 + k * pi, of cos( ) at k * pi */
+static mexpr_interval_t
+mexpt_iv_trig (bool is_sin, mexpr_interval_t a) {
+
+    double k_lo, k_hi, k;
+    double shift = is_sin ? M_PI / 2 : 0;
+    mexpr_interval_t iv = mexpt_iv_none ();
+
+    iv.maybe_nan = a.maybe_nan || isinf (a.lo) || isinf (a.hi);
+    iv.maybe_invalid = a.maybe_invalid;
+    if (mexpt_iv_empty (a)) return iv;
+
+    if (a.hi - a.lo >= 2 * M_PI || fabs (a.lo) > MEXPT_IV_TRIG_MAX ||
+            fabs (a.hi) > MEXPT_IV_TRIG_MAX) {
+        iv.lo = -1;
+        iv.hi = 1;
+        return iv;
+    }
+
+    mexpt_iv_add (&iv, is_sin ? sin (a.lo) : cos (a.lo));
+    mexpt_iv_add (&iv, is_sin ? sin (a.hi) : cos (a.hi));
+
+    /* Extremes within the interval, or close enough to its ends for pi being
+        rounded to matter */
+    k_lo = ceil ((a.lo - shift) / M_PI - 1e-9);
+    k_hi = floor ((a.hi - shift) / M_PI + 1e-9);
+    for (k = k_lo; k <= k_hi; k++) {
+        mexpt_iv_add (&iv, fmod (fabs (k), 2) == 0 ? 1 : -1);
+    }
+
+    mexpt_iv_widen_libm (&iv);
+    if (iv.lo < -1) iv.lo = -1;
+    if (iv.hi > 1) iv.hi = 1;
+    return iv;
+}
+
+static mexpr_interval_t
+mexpt_iv_pow (mexpr_interval_t a, mexpr_interval_t b) {
+
+    int i, j;
+    double e;
+    double av[2] = {a.lo, a.hi};
+    double bv[2] = {b.lo, b.hi};
+    mexpr_interval_t iv = mexpt_iv_none ();
+
+    iv.maybe_invalid = a.maybe_invalid || b.maybe_invalid;
+    if (mexpt_iv_empty (a) || mexpt_iv_empty (b)) {
+        iv.maybe_nan = a.maybe_nan || b.maybe_nan;
+        return iv;
+    }
+
+    if (b.lo == b.hi && b.lo == trunc (b.lo) && fabs (b.lo) <= MEXPT_IV_INT_EXACT) {
+
+        /* Integer exponent : monotone on either side of 0 */
+        e = b.lo;
+        mexpt_iv_add (&iv, pow (a.lo, e));
+        mexpt_iv_add (&iv, pow (a.hi, e));
+
+        /* Zone maps do not tell -0 from 0 : pow (-0, -1) is -inf */
+        if (e < 0 && mexpt_iv_has (a, 0)) {
+            iv.lo = -INFINITY;
+            iv.hi = INFINITY;
+        }
+        else if (e > 0 && fmod (e, 2) == 0 && a.lo < 0 && a.hi > 0) {
+            iv.lo = 0;
+        }
+        iv.maybe_nan = false;
+    }
+    else if (a.lo >= 0) {
+
+        /* Monotone in the base, and in the exponent */
+        for (i = 0; i < 2; i++) {
+            for (j = 0; j < 2; j++) {
+                mexpt_iv_add (&iv, pow (av[i], bv[j]));
+            }
+        }
+        if (a.lo == 0 && b.lo < 0) iv.lo = -INFINITY;
+    }
+    else {
+        iv.lo = -INFINITY;
+        iv.hi = INFINITY;
+        iv.maybe_nan = true;
+    }
+
+    mexpt_iv_widen_libm (&iv);
+
+    /* pow (NaN, 0) and pow (1, NaN) are 1 */
+    if (a.maybe_nan || b.maybe_nan) {
+        mexpt_iv_add (&iv, 1);
+        iv.maybe_nan = true;
+    }
+    return iv;
+}
+
+static mexpr_interval_t
+mexpt_iv_compare (int opr, mexpr_interval_t a, mexpr_interval_t b) {
+
+    mexpr_interval_t iv;
+    bool can_true = false, can_false = false;
+    bool point;
+
+    if (!mexpt_iv_empty (a) && !mexpt_iv_empty (b)) {
+
+        point = a.lo == a.hi && b.lo == b.hi && a.lo == b.lo;
+
+        switch (opr) {
+            case MATH_LESS_THAN:
+                can_true = a.lo < b.hi;
+                can_false = a.hi >= b.lo;
+                break;
+            case MATH_LESS_THAN_EQ:
+                can_true = a.lo <= b.hi;
+                can_false = a.hi > b.lo;
+                break;
+            case MATH_GREATER_THAN:
+                can_true = a.hi > b.lo;
+                can_false = a.lo <= b.hi;
+                break;
+            case MATH_EQ:
+                can_true = a.lo <= b.hi && b.lo <= a.hi;
+                can_false = !point;
+                break;
+            case MATH_NOT_EQ:
+                can_true = !point;
+                can_false = a.lo <= b.hi && b.lo <= a.hi;
+                break;
+        }
+    }
+
+    /* Unordered */
+    if ((a.maybe_nan && (!mexpt_iv_empty (b) || b.maybe_nan)) ||
+            (b.maybe_nan && !mexpt_iv_empty (a))) {
+        if (opr == MATH_NOT_EQ) can_true = true;
+        else can_false = true;
+    }
+
+    iv = mexpt_iv_bool (can_true, can_false);
+    iv.maybe_invalid = a.maybe_invalid || b.maybe_invalid;
+    return iv;
+}
+
+static mexpr_interval_t
+mexpt_iv_logical (int opr, mexpr_interval_t a, mexpr_interval_t b) {
+
+    mexpr_interval_t iv;
+    bool a_any = !mexpt_iv_empty (a), b_any = !mexpt_iv_empty (b);
+    bool a_true = mexpt_iv_has (a, 1), b_true = mexpt_iv_has (b, 1);
+    bool a_false = mexpt_iv_has (a, 0), b_false = mexpt_iv_has (b, 0);
+
+    if (opr == MATH_AND) {
+        iv = mexpt_iv_bool (a_true && b_true,
+                                    (a_false && b_any) || (b_false && a_any));
+    }
+    else {
+        iv = mexpt_iv_bool ((a_true && b_any) || (b_true && a_any),
+                                    a_false && b_false);
+    }
+    iv.maybe_invalid = a.maybe_invalid || b.maybe_invalid;
+    return iv;
+}
+
+static mexpr_interval_t
+mexpt_iv_leaf (mexpt_node_t *node,
+                        const mexpt_opd_range_t *ranges,
+                        int n_ranges) {
+
+    int i;
+    double val;
+    mexpr_interval_t iv;
+
+    switch (node->token_code) {
+
+        case MATH_IDENTIFIER:
+        case MATH_IDENTIFIER_IDENTIFIER:
+            for (i = 0; i < n_ranges; i++) {
+                if (strcmp ((char *)node->u.opd_node.opd_value.variable_name,
+                                ranges[i].name) == 0) {
+                    return ranges[i].range;
+                }
+            }
+            return mexpr_interval_any ();
+        case MATH_INTEGER_VALUE:
+            val = (double)node->u.opd_node.opd_value.int_val;
+            iv = mexpr_interval (val, val);
+            if (!mexpt_int_is_exact_double (node->u.opd_node.opd_value.int_val)) {
+                iv.lo = nextafter (val, -INFINITY);
+                iv.hi = nextafter (val, INFINITY);
+            }
+            return iv;
+        case MATH_DOUBLE_VALUE:
+            val = node->u.opd_node.opd_value.math_val;
+            iv = mexpr_interval (val, val);
+            if (val != val) {
+                iv = mexpt_iv_none ();
+                iv.maybe_nan = true;
+            }
+            return iv;
+        default:
+            break;
+    }
+
+    /* Due to optimization leaf may contain : Ineq Op Or Logical Op also */
+    if (Math_is_ineq_operator (node->token_code) && node->u.ineq_node.is_optimized) {
+        return mexpt_iv_bool (node->u.ineq_node.result, !node->u.ineq_node.result);
+    }
+    if (Math_is_logical_operator (node->token_code) && node->u.log_op_node.is_optimized) {
+        return mexpt_iv_bool (node->u.log_op_node.result, !node->u.log_op_node.result);
+    }
+    return mexpr_interval_any ();
+}
+
+mexpr_interval_t
+mexpt_interval_eval (mexpt_node_t *root,
+                                const mexpt_opd_range_t *ranges,
+                                int n_ranges) {
+
+    mexpr_interval_t l, r, iv;
+
+    if (!root) return mexpr_interval_any ();
+    if (!root->left && !root->right) return mexpt_iv_leaf (root, ranges, n_ranges);
+
+    l = mexpt_interval_eval (root->left, ranges, n_ranges);
+    r = root->right ? mexpt_interval_eval (root->right, ranges, n_ranges) : l;
+
+    switch (root->token_code) {
+
+        case MATH_PLUS:
+        case MATH_MINUS:
+        case MATH_MUL:
+            iv = mexpt_iv_arith (root->token_code, l, r);
+            mexpt_iv_fix_int (root, &iv);
+            return iv;
+        case MATH_DIV:
+            iv = mexpt_iv_div (l, r);
+            /* Integer division truncates towards 0 the exact quotient, which
+                is within an ulp of the rounded one */
+            if (root->rt_dtype != MEXPR_DTYPE_DOUBLE && !mexpt_iv_empty (iv)) {
+                if (iv.lo > 0) iv.lo = trunc (nextafter (iv.lo, -INFINITY));
+                if (iv.hi < 0) iv.hi = trunc (nextafter (iv.hi, INFINITY));
+            }
+            mexpt_iv_fix_int (root, &iv);
+            return iv;
+        case MATH_SQR:
+            iv = mexpt_iv_sqr (l);
+            mexpt_iv_fix_int (root, &iv);
+            return iv;
+        case MATH_SQRT:
+            return mexpt_iv_sqrt (l);
+        case MATH_SIN:
+        case MATH_COS:
+            return mexpt_iv_trig (root->token_code == MATH_SIN, l);
+        case MATH_POW:
+            return mexpt_iv_pow (l, r);
+        case MATH_MAX:
+        case MATH_MIN:
+            return mexpt_iv_max_min (root->token_code == MATH_MAX, l, r);
+        case MATH_LESS_THAN:
+        case MATH_LESS_THAN_EQ:
+        case MATH_GREATER_THAN:
+        case MATH_EQ:
+        case MATH_NOT_EQ:
+            return mexpt_iv_compare (root->token_code, l, r);
+        case MATH_AND:
+        case MATH_OR:
+            return mexpt_iv_logical (root->token_code, l, r);
+        default:
+            return mexpr_interval_any ();
+    }
+}
+
+mexpt_cond_t
+mexpt_interval_condition (mexpt_tree_t *tree,
+                                        const mexpt_opd_range_t *ranges,
+                                        int n_ranges) {
+
+    mexpr_interval_t iv;
+
+    if (!tree->root) return MEXPT_COND_UNKNOWN;
+
+    /* Not a condition */
+    if (!Math_is_ineq_operator (tree->root->token_code) &&
+            !Math_is_logical_operator (tree->root->token_code)) {
+        return MEXPT_COND_UNKNOWN;
+    }
+
+    iv = mexpt_interval_eval (tree->root, ranges, n_ranges);
+
+    if (!mexpt_iv_has (iv, 1)) return MEXPT_COND_ALWAYS_FALSE;
+    if (!mexpt_iv_has (iv, 0) && !iv.maybe_nan && !iv.maybe_invalid) {
+        return MEXPT_COND_ALWAYS_TRUE;
+    }
+    return MEXPT_COND_UNKNOWN;
+}
@@ -0,0 +1,88 @@
+#ifndef __MEXPR_INTERVAL__
+#define __MEXPR_INTERVAL__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include "MExpr.h"
+
+/* Interval Analysis of Expression Trees
+
+    Given the range of values of every operand over a block of rows (e.g. the
+    min and max of its columns in a zone map), mexpt_interval_eval( ) bounds
+    the outcomes of mexpt_evaluate( ) on any row of the block, and
+    mexpt_interval_condition( ) tells whether a condition is true on every
+    row (block is accepted without evaluating it), true on none (block is
+    skipped), or may be either.
+
+    An interval is a set of outcomes : the values in [lo, hi] (none if
+    lo > hi), NaN if maybe_nan, a failed evaluation (MEXPR_DTYPE_INVALID, e.g.
+    divide by zero, integer overflow) if maybe_invalid. Results of Ineq and
+    Logical operators are the values 0 (false) and 1 (true).
+
+    Bounds are propagated through + - * / sqr sqrt pow mmax mmin sin cos,
+    < <= > = != and or, following MexprDb : comparisons with NaN are false
+    except !=, / fails on a zero divisor, integer results out of int64 fail.
+    Rounding is accounted for, transcendental results are widened by the libm
+    error. Strings, unknown operands and operators give every outcome.
+    A row on which the condition fails or is NaN does not satisfy it.
+*/
+
+typedef struct mexpr_interval_ {
+
+    double lo;
+    double hi;
+    bool maybe_nan;
+    bool maybe_invalid;
+} mexpr_interval_t;
+
+/* Range of the operand named name, MATH_IDENTIFIER_IDENTIFIER (a.x) included */
+typedef struct mexpt_opd_range_ {
+
+    const char *name;
+    mexpr_interval_t range;
+} mexpt_opd_range_t;
+
+typedef enum mexpt_cond_ {
+
+    MEXPT_COND_UNKNOWN,
+    MEXPT_COND_ALWAYS_TRUE,
+    MEXPT_COND_ALWAYS_FALSE
+} mexpt_cond_t;
+
+/* Non NaN values in [lo, hi] */
+static inline mexpr_interval_t
+mexpr_interval (double lo, double hi) {
+
+    mexpr_interval_t iv;
+
+    iv.lo = lo;
+    iv.hi = hi;
+    iv.maybe_nan = false;
+    iv.maybe_invalid = false;
+    return iv;
+}
+
+/* Any outcome */
+static inline mexpr_interval_t
+mexpr_interval_any (void) {
+
+    mexpr_interval_t iv = mexpr_interval (-INFINITY, INFINITY);
+
+    iv.maybe_nan = true;
+    iv.maybe_invalid = true;
+    return iv;
+}
+
+mexpr_interval_t
+mexpt_interval_eval (mexpt_node_t *root,
+                                const mexpt_opd_range_t *ranges,
+                                int n_ranges);
+
+mexpt_cond_t
+mexpt_interval_condition (mexpt_tree_t *tree,
+                                        const mexpt_opd_range_t *ranges,
+                                        int n_ranges);
+
+#endif
@@ -0,0 +1,427 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include <sys/mman.h>
+#include "MexprEnums.h"
+#include "MExpr.h"
+#include "MexprJit.h"
+
+/* ====================x================x=================== */
+/* Code Buffer */
+
+typedef struct mexpt_jit_buf_ {
+
+    uint8_t *data;
+    uint32_t size;
+    uint32_t max_size;
+} mexpt_jit_buf_t;
+
+static void
+mexpt_jit_emit (mexpt_jit_buf_t *buf, const void *bytes, uint32_t len) {
+
+    if (buf->size + len > buf->max_size) {
+        buf->max_size = (buf->size + len) * 2;
+        buf->data = (uint8_t *)realloc (buf->data, buf->max_size);
+    }
+    memcpy (buf->data + buf->size, bytes, len);
+    buf->size += len;
+}
+
+#define EMIT(buf, ...) \
+    do { \
+        static const uint8_t _bytes[] = { __VA_ARGS__ }; \
+        mexpt_jit_emit (buf, _bytes, sizeof (_bytes)); \
+    } while (0)
+
+static void
+mexpt_jit_emit_u32 (mexpt_jit_buf_t *buf, uint32_t val) {
+
+    mexpt_jit_emit (buf, &val, sizeof (val));
+}
+
+static void
+mexpt_jit_emit_u64 (mexpt_jit_buf_t *buf, uint64_t val) {
+
+    mexpt_jit_emit (buf, &val, sizeof (val));
+}
+
+/* ====================x================x=================== */
+/* Code Generation
+
+    Register usage :
+        rbx         pointer to current row
+        r12, r13    batch loop : rows left, output pointer
+        xmm0        result of the node being emitted
+        xmm1-xmm3   scratch
+
+    Stack frame, 16 byte aligned so that libm can be called without fixup :
+        [rsp]               invalid mask, all ones once a divisor was zero
+        [rsp + 8 + 8*d]     left operand of binary node at depth d, kept
+                            in memory across the emission of the right operand
+*/
+
+typedef struct mexpt_jit_ctx_ {
+
+    mexpt_jit_buf_t buf;
+    const char **col_names;
+    int n_cols;
+} mexpt_jit_ctx_t;
+
+static bool
+mexpt_jit_is_int_literal (mexpt_node_t *node) {
+
+    return node && !node->left && !node->right &&
+                node->token_code == MATH_INTEGER_VALUE;
+}
+
+static int
+mexpt_jit_height (mexpt_node_t *node) {
+
+    int lh, rh;
+
+    if (!node) return 0;
+    lh = mexpt_jit_height (node->left);
+    rh = mexpt_jit_height (node->right);
+    return 1 + (lh > rh ? lh : rh);
+}
+
+static void
+mexpt_jit_emit_load_const (mexpt_jit_buf_t *buf, double val) {
+
+    uint64_t bits;
+
+    memcpy (&bits, &val, sizeof (bits));
+    EMIT (buf, 0x48, 0xB8);                     /* movabs rax, imm64 */
+    mexpt_jit_emit_u64 (buf, bits);
+    EMIT (buf, 0x66, 0x48, 0x0F, 0x6E, 0xC0);   /* movq xmm0, rax */
+}
+
+static void
+mexpt_jit_emit_call (mexpt_jit_buf_t *buf, void *fn) {
+
+    EMIT (buf, 0x48, 0xB8);                     /* movabs rax, imm64 */
+    mexpt_jit_emit_u64 (buf, (uint64_t)(uintptr_t)fn);
+    EMIT (buf, 0xFF, 0xD0);                     /* call rax */
+}
+
+/* Turns the compare mask in xmm0 into 1.0 or 0.0 */
+static void
+mexpt_jit_emit_mask_to_bool (mexpt_jit_buf_t *buf) {
+
+    uint64_t one;
+    double d_one = 1.0;
+
+    memcpy (&one, &d_one, sizeof (one));
+    EMIT (buf, 0x48, 0xB8);                     /* movabs rax, 1.0 */
+    mexpt_jit_emit_u64 (buf, one);
+    EMIT (buf, 0x66, 0x48, 0x0F, 0x6E, 0xC8);   /* movq xmm1, rax */
+    EMIT (buf, 0x66, 0x0F, 0x54, 0xC1);         /* andpd xmm0, xmm1 */
+}
+
+static bool
+mexpt_jit_emit_leaf (mexpt_jit_ctx_t *ctx, mexpt_node_t *node) {
+
+    int i;
+
+    switch (node->token_code) {
+
+        case MATH_IDENTIFIER:
+        case MATH_IDENTIFIER_IDENTIFIER:
+            for (i = 0; i < ctx->n_cols; i++) {
+                if (strcmp ((char *)node->u.opd_node.opd_value.variable_name,
+                                ctx->col_names[i]) == 0) break;
+            }
+            if (i == ctx->n_cols) return false;
+            EMIT (&ctx->buf, 0xF2, 0x0F, 0x10, 0x83);   /* movsd xmm0, [rbx + disp32] */
+            mexpt_jit_emit_u32 (&ctx->buf, i * sizeof (double));
+            return true;
+        case MATH_INTEGER_VALUE:
+            /* Comparisons of MexprDb are exact, of double registers are not */
+            if (!mexpt_int_is_exact_double (node->u.opd_node.opd_value.int_val)) return false;
+            mexpt_jit_emit_load_const (&ctx->buf, (double)node->u.opd_node.opd_value.int_val);
+            return true;
+        case MATH_DOUBLE_VALUE:
+            mexpt_jit_emit_load_const (&ctx->buf, node->u.opd_node.opd_value.math_val);
+            return true;
+        case MATH_STRING_VALUE:
+            return false;
+        default:
+            break;
+    }
+
+    /* Optimized Ineq or Logical node */
+    if (Math_is_ineq_operator (node->token_code)) {
+        mexpt_jit_emit_load_const (&ctx->buf, node->u.ineq_node.result ? 1.0 : 0.0);
+        return true;
+    }
+    if (Math_is_logical_operator (node->token_code)) {
+        mexpt_jit_emit_load_const (&ctx->buf, node->u.log_op_node.result ? 1.0 : 0.0);
+        return true;
+    }
+    return false;
+}
+
+static bool
+mexpt_jit_emit_node (mexpt_jit_ctx_t *ctx, mexpt_node_t *node, int depth) {
+
+    mexpt_jit_buf_t *buf = &ctx->buf;
+    uint32_t slot = 8 + 8 * depth;
+
+    if (!node->left && !node->right) {
+        return mexpt_jit_emit_leaf (ctx, node);
+    }
+
+    /* int op int would use integer kernels of MexprDb, such subtrees are
+        folded by mexpt_optimize( ) */
+    if (mexpt_jit_is_int_literal (node->left) &&
+         (!node->right || mexpt_jit_is_int_literal (node->right))) return false;
+
+    if (!mexpt_jit_emit_node (ctx, node->left, depth + 1)) return false;
+
+    /* Unary operators */
+    if (!node->right) {
+
+        switch (node->token_code) {
+
+            case MATH_SQR:
+                EMIT (buf, 0xF2, 0x0F, 0x59, 0xC0);     /* mulsd xmm0, xmm0 */
+                return true;
+            case MATH_SQRT:
+                EMIT (buf, 0xF2, 0x0F, 0x51, 0xC0);     /* sqrtsd xmm0, xmm0 */
+                return true;
+            case MATH_SIN:
+                mexpt_jit_emit_call (buf, (void *)(double (*)(double))sin);
+                return true;
+            case MATH_COS:
+                mexpt_jit_emit_call (buf, (void *)(double (*)(double))cos);
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    EMIT (buf, 0xF2, 0x0F, 0x11, 0x84, 0x24);           /* movsd [rsp + slot], xmm0 */
+    mexpt_jit_emit_u32 (buf, slot);
+
+    if (!mexpt_jit_emit_node (ctx, node->right, depth + 1)) return false;
+
+    EMIT (buf, 0x66, 0x0F, 0x28, 0xC8);                 /* movapd xmm1, xmm0 */
+    EMIT (buf, 0xF2, 0x0F, 0x10, 0x84, 0x24);           /* movsd xmm0, [rsp + slot] */
+    mexpt_jit_emit_u32 (buf, slot);
+
+    switch (node->token_code) {
+
+        case MATH_PLUS:
+            EMIT (buf, 0xF2, 0x0F, 0x58, 0xC1);         /* addsd xmm0, xmm1 */
+            return true;
+        case MATH_MINUS:
+            EMIT (buf, 0xF2, 0x0F, 0x5C, 0xC1);         /* subsd xmm0, xmm1 */
+            return true;
+        case MATH_MUL:
+        case MATH_AND:                                  /* 1.0 * 1.0 */
+            EMIT (buf, 0xF2, 0x0F, 0x59, 0xC1);         /* mulsd xmm0, xmm1 */
+            return true;
+        case MATH_DIV:
+            /* MexprDb fails the evaluation on zero divisor, record it in
+                the invalid mask */
+            EMIT (buf, 0x66, 0x0F, 0x57, 0xD2);         /* xorpd xmm2, xmm2 */
+            EMIT (buf, 0xF2, 0x0F, 0xC2, 0xD1, 0x00);   /* cmpeqsd xmm2, xmm1 */
+            EMIT (buf, 0xF2, 0x0F, 0x10, 0x1C, 0x24);   /* movsd xmm3, [rsp] */
+            EMIT (buf, 0x66, 0x0F, 0x56, 0xD3);         /* orpd xmm2, xmm3 */
+            EMIT (buf, 0xF2, 0x0F, 0x11, 0x14, 0x24);   /* movsd [rsp], xmm2 */
+            EMIT (buf, 0xF2, 0x0F, 0x5E, 0xC1);         /* divsd xmm0, xmm1 */
+            return true;
+        case MATH_MAX:
+        case MATH_OR:
+            /* l > r ? l : r, same as MexprDb for NaN operands too */
+            EMIT (buf, 0xF2, 0x0F, 0x5F, 0xC1);         /* maxsd xmm0, xmm1 */
+            return true;
+        case MATH_MIN:
+            EMIT (buf, 0xF2, 0x0F, 0x5D, 0xC1);         /* minsd xmm0, xmm1 */
+            return true;
+        case MATH_POW:
+            mexpt_jit_emit_call (buf, (void *)(double (*)(double, double))pow);
+            return true;
+
+        /* Ordered predicates, except != which is true on NaN like C */
+        case MATH_LESS_THAN:
+            EMIT (buf, 0xF2, 0x0F, 0xC2, 0xC1, 0x01);   /* cmpltsd xmm0, xmm1 */
+            mexpt_jit_emit_mask_to_bool (buf);
+            return true;
+        case MATH_LESS_THAN_EQ:
+            EMIT (buf, 0xF2, 0x0F, 0xC2, 0xC1, 0x02);   /* cmplesd xmm0, xmm1 */
+            mexpt_jit_emit_mask_to_bool (buf);
+            return true;
+        case MATH_GREATER_THAN:
+            EMIT (buf, 0xF2, 0x0F, 0xC2, 0xC8, 0x01);   /* cmpltsd xmm1, xmm0 */
+            EMIT (buf, 0x66, 0x0F, 0x28, 0xC1);         /* movapd xmm0, xmm1 */
+            mexpt_jit_emit_mask_to_bool (buf);
+            return true;
+        case MATH_EQ:
+            EMIT (buf, 0xF2, 0x0F, 0xC2, 0xC1, 0x00);   /* cmpeqsd xmm0, xmm1 */
+            mexpt_jit_emit_mask_to_bool (buf);
+            return true;
+        case MATH_NOT_EQ:
+            EMIT (buf, 0xF2, 0x0F, 0xC2, 0xC1, 0x04);   /* cmpneqsd xmm0, xmm1 */
+            mexpt_jit_emit_mask_to_bool (buf);
+            return true;
+        default:
+            return false;
+    }
+}
+
+/* Row body : clears the invalid mask, evaluates the tree for the row at rbx into
+    xmm0, and turns xmm0 into NaN if the mask got set */
+static bool
+mexpt_jit_emit_body (mexpt_jit_ctx_t *ctx, mexpt_node_t *root) {
+
+    mexpt_jit_buf_t *buf = &ctx->buf;
+
+    EMIT (buf, 0x48, 0xC7, 0x04, 0x24, 0x00, 0x00, 0x00, 0x00);    /* mov qword [rsp], 0 */
+    if (!mexpt_jit_emit_node (ctx, root, 0)) return false;
+    EMIT (buf, 0xF2, 0x0F, 0x10, 0x0C, 0x24);   /* movsd xmm1, [rsp] */
+    EMIT (buf, 0x66, 0x0F, 0x56, 0xC1);         /* orpd xmm0, xmm1 */
+    return true;
+}
+
+/* double row_fn (const double *row) */
+static bool
+mexpt_jit_emit_row_fn (mexpt_jit_ctx_t *ctx, mexpt_node_t *root, uint32_t frame) {
+
+    mexpt_jit_buf_t *buf = &ctx->buf;
+
+    /* Entry rsp is 8 mod 16, one push makes it 16 byte aligned */
+    EMIT (buf, 0x53);                           /* push rbx */
+    EMIT (buf, 0x48, 0x81, 0xEC);               /* sub rsp, frame */
+    mexpt_jit_emit_u32 (buf, frame);
+    EMIT (buf, 0x48, 0x89, 0xFB);               /* mov rbx, rdi */
+
+    if (!mexpt_jit_emit_body (ctx, root)) return false;
+
+    EMIT (buf, 0x48, 0x81, 0xC4);               /* add rsp, frame */
+    mexpt_jit_emit_u32 (buf, frame);
+    EMIT (buf, 0x5B);                           /* pop rbx */
+    EMIT (buf, 0xC3);                           /* ret */
+    return true;
+}
+
+/* void batch_fn (const double *rows, uint64_t n_rows, double *out) */
+static bool
+mexpt_jit_emit_batch_fn (mexpt_jit_ctx_t *ctx, mexpt_node_t *root, uint32_t frame) {
+
+    uint32_t loop, jz_patch, rel;
+    mexpt_jit_buf_t *buf = &ctx->buf;
+
+    /* Three pushes keep rsp 16 byte aligned */
+    EMIT (buf, 0x53);                           /* push rbx */
+    EMIT (buf, 0x41, 0x54);                     /* push r12 */
+    EMIT (buf, 0x41, 0x55);                     /* push r13 */
+    EMIT (buf, 0x48, 0x81, 0xEC);               /* sub rsp, frame */
+    mexpt_jit_emit_u32 (buf, frame);
+    EMIT (buf, 0x48, 0x89, 0xFB);               /* mov rbx, rdi */
+    EMIT (buf, 0x49, 0x89, 0xF4);               /* mov r12, rsi */
+    EMIT (buf, 0x49, 0x89, 0xD5);               /* mov r13, rdx */
+
+    EMIT (buf, 0x4D, 0x85, 0xE4);               /* test r12, r12 */
+    EMIT (buf, 0x0F, 0x84);                     /* jz done */
+    jz_patch = buf->size;
+    mexpt_jit_emit_u32 (buf, 0);
+
+    loop = buf->size;
+    if (!mexpt_jit_emit_body (ctx, root)) return false;
+
+    EMIT (buf, 0xF2, 0x41, 0x0F, 0x11, 0x45, 0x00);     /* movsd [r13], xmm0 */
+    EMIT (buf, 0x48, 0x81, 0xC3);                       /* add rbx, row size */
+    mexpt_jit_emit_u32 (buf, ctx->n_cols * sizeof (double));
+    EMIT (buf, 0x49, 0x83, 0xC5, 0x08);                 /* add r13, 8 */
+    EMIT (buf, 0x49, 0xFF, 0xCC);                       /* dec r12 */
+    EMIT (buf, 0x0F, 0x85);                             /* jnz loop */
+    rel = loop - (buf->size + 4);
+    mexpt_jit_emit_u32 (buf, rel);
+
+    rel = buf->size - (jz_patch + 4);
+    memcpy (buf->data + jz_patch, &rel, sizeof (rel));
+
+    EMIT (buf, 0x48, 0x81, 0xC4);               /* add rsp, frame */
+    mexpt_jit_emit_u32 (buf, frame);
+    EMIT (buf, 0x41, 0x5D);                     /* pop r13 */
+    EMIT (buf, 0x41, 0x5C);                     /* pop r12 */
+    EMIT (buf, 0x5B);                           /* pop rbx */
+    EMIT (buf, 0xC3);                           /* ret */
+    return true;
+}
+
+/* ====================x================x=================== */
+/* Public API */
+
+mexpt_jit_t *
+mexpt_jit_compile (mexpt_tree_t *tree, const char **col_names, int n_cols) {
+
+#if defined(__x86_64__)
+
+    void *code;
+    uint32_t frame, batch_off, code_size;
+    mexpt_jit_t *jit;
+    mexpt_jit_ctx_t ctx;
+    static const uint8_t nop = 0x90;
+
+    if (!tree->root) return NULL;
+
+    memset (&ctx, 0, sizeof (ctx));
+    ctx.col_names = col_names;
+    ctx.n_cols = n_cols;
+
+    /* invalid mask + one slot per level, rounded up to keep rsp aligned */
+    frame = (8 + 8 * mexpt_jit_height (tree->root) + 15) & ~15U;
+
+    if (!mexpt_jit_emit_row_fn (&ctx, tree->root, frame)) goto unsupported;
+
+    while (ctx.buf.size % 16) mexpt_jit_emit (&ctx.buf, &nop, 1);
+    batch_off = ctx.buf.size;
+
+    if (!mexpt_jit_emit_batch_fn (&ctx, tree->root, frame)) goto unsupported;
+
+    /* Write the code into a RW mapping, then flip it to RX */
+    code_size = (ctx.buf.size + 4095) & ~4095U;
+    code = mmap (NULL, code_size, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code == MAP_FAILED) {
+        printf ("Error : JIT could not map %u bytes of code\n", code_size);
+        free (ctx.buf.data);
+        return NULL;
+    }
+    memcpy (code, ctx.buf.data, ctx.buf.size);
+    free (ctx.buf.data);
+
+    if (mprotect (code, code_size, PROT_READ | PROT_EXEC) != 0) {
+        printf ("Error : JIT could not make code executable\n");
+        munmap (code, code_size);
+        return NULL;
+    }
+
+    jit = (mexpt_jit_t *)calloc (1, sizeof (mexpt_jit_t));
+    jit->code = code;
+    jit->code_size = code_size;
+    jit->n_cols = n_cols;
+    jit->row_fn = (double (*)(const double *))code;
+    jit->batch_fn = (void (*)(const double *, uint64_t, double *))
+                                ((uint8_t *)code + batch_off);
+    return jit;
+
+unsupported:
+    free (ctx.buf.data);
+    return NULL;
+
+#else
+    return NULL;
+#endif
+}
+
+void
+mexpt_jit_free (mexpt_jit_t *jit) {
+
+    munmap (jit->code, jit->code_size);
+    free (jit);
+}
@@ -0,0 +1,60 @@
+#ifndef __MEXPR_JIT__
+#define __MEXPR_JIT__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "MExpr.h"
+
+/* Native Code for Numeric Expression Trees (x86-64, SSE2)
+
+    mexpt_jit_compile( ) turns a validated and optimized tree into machine code in
+    an mmap'd page. Every operand of the tree is bound to a column of a row of
+    doubles by name, col_names[i] is the name of row[i].
+
+    Supported : double and integer literals, operands, + - * / sqr sqrt max min
+    sin cos pow, < <= > = != and or. Results of Ineq and Logical operators are
+    1.0 (true) or 0.0 (false). sin, cos and pow call the same libm functions
+    as MexprDb, so results are bitwise equal to mexpt_evaluate( ) on the same
+    values. Row on which mexpt_evaluate( ) fails (divide by zero) evaluates
+    to NaN.
+
+    Not supported (mexpt_jit_compile( ) returns NULL, Appln keeps using
+    mexpt_evaluate( )) : strings, operators on integer literals only (tree not
+    optimized), operand not found in col_names, non x86-64 hosts.
+*/
+
+typedef struct mexpt_jit_ {
+
+    void *code;
+    uint32_t code_size;
+    int n_cols;
+
+    double (*row_fn) (const double *row);
+
+    /* rows are n_rows consecutive rows of n_cols doubles each */
+    void (*batch_fn) (const double *rows, uint64_t n_rows, double *out);
+} mexpt_jit_t;
+
+mexpt_jit_t *
+mexpt_jit_compile (mexpt_tree_t *tree, const char **col_names, int n_cols);
+
+void
+mexpt_jit_free (mexpt_jit_t *jit);
+
+static inline double
+mexpt_jit_eval (mexpt_jit_t *jit, const double *row) {
+
+    return jit->row_fn (row);
+}
+
+static inline void
+mexpt_jit_eval_batch (mexpt_jit_t *jit,
+                                    const double *rows,
+                                    uint64_t n_rows,
+                                    double *out) {
+
+    jit->batch_fn (rows, n_rows, out);
+}
+
+#endif
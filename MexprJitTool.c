@@ -0,0 +1,278 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "UserParserL.h"
+#include "ParserMexpr.h"
+#include "MexprEnums.h"
+#include "MexprJit.h"
+
+/* Checks native code of MexprJit against mexpt_evaluate( ) and times both,
+    see MexprJit.h
+
+    Usage : mexprjit [rows] [expression ...]
+
+    Every expression (a built-in set if none is given) is evaluated on rows
+    rows (1M if not given) of 4 double columns a, b, c, d by mexpt_evaluate( ),
+    mexpt_jit_eval( ) and mexpt_jit_eval_batch( ). Column values are uniform
+    in [-10, 10) with NaN mixed in, so that unordered compares are covered.
+    MEXPRJIT_EDGE_ROWS more rows, first of the table, also hold 0 and 1 to
+    cover divide by zero : they are checked but not timed, as MexprDb reports
+    every row it fails on.
+
+    Results of the JIT must be bitwise equal to the ones of mexpt_evaluate( ),
+    read as MexprJit.h documents them : true is 1.0, false 0.0, a failed row
+    any NaN. Prints the number of mismatching rows, then ns per row of the
+    three, best of MEXPRJIT_REPEAT runs, and the speedup over mexpt_evaluate( ).
+    Returns 1 if any result differs.
+*/
+
+#define MEXPRJIT_N_COLS     4
+#define MEXPRJIT_REPEAT     3
+#define MEXPRJIT_EDGE_ROWS  256
+
+static const char *mexprjit_col_names[MEXPRJIT_N_COLS] = {"a", "b", "c", "d"};
+
+static const char *mexprjit_exprs[] = {
+    "a * b + c > 5",
+    "a > b and b <= c or a = c",
+    "a != 2 and (b > 1 or c < 0)",
+    "sqr(a - b) + 1 / (c - 1)",
+    "a + 3 * 2 - sqrt(16)",
+    "a / b > 1",
+    "sqrt(a * a + b * b) < c + d",
+    "mmax(a, b) - mmin(c, d)",
+    "sin(a) * cos(b) + pow(c, 2) > d / 2",
+    NULL
+};
+
+/* Row read by operand callbacks of mexpt_evaluate( ) */
+static const double *mexprjit_row;
+
+static double
+mexprjit_now (void) {
+
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static mexpr_var_t
+mexprjit_col_compute (void *data_src) {
+
+    mexpr_var_t res;
+
+    res.dtype = MEXPR_DTYPE_DOUBLE;
+    res.u.d_val = mexprjit_row[*(int *)data_src];
+    return res;
+}
+
+/* Result of mexpt_evaluate( ) as the JIT gives it */
+static double
+mexprjit_interp (mexpt_tree_t *tree) {
+
+    mexpr_var_t res = mexpt_evaluate (tree->root);
+
+    switch (res.dtype) {
+
+        case MEXPR_DTYPE_DOUBLE:
+            return res.u.d_val;
+        case MEXPR_DTYPE_INT:
+            return (double)res.u.int_val;
+        case MEXPR_DTYPE_BOOL:
+            return res.u.b_val ? 1.0 : 0.0;
+        default:
+            return NAN;
+    }
+}
+
+static bool
+mexprjit_same (double x, double y) {
+
+    if (x != x || y != y) return x != x && y != y;
+    return memcmp (&x, &y, sizeof (double)) == 0;
+}
+
+/* Operands own their data_src : mexpt_optimize( ) frees the ones of the
+    subtrees it folds */
+static mexpt_tree_t *
+mexprjit_build (const char *expr) {
+
+    int i;
+    mexpt_tree_t *tree;
+    mexpt_node_t *opd_node = NULL;
+
+    if (strlen (expr) >= MAX_STRING_SIZE) {
+        printf ("Error : Expression %s is too long\n", expr);
+        return NULL;
+    }
+
+    /* Parser rewinds by rescanning lex_buffer */
+    strcpy ((char *)lex_buffer, expr);
+    lex_set_scan_buffer ((const char *)lex_buffer);
+
+    tree = Parser_Mexpr_Condition_build_expression_tree ();
+    if (!tree) {
+        tree = Parser_Mexpr_build_math_expression_tree ();
+    }
+    Parser_stack_reset ();
+
+    if (!tree) {
+        printf ("Error : Exp Tree could not built for %s\n", expr);
+        return NULL;
+    }
+
+    mexpt_iterate_operands_begin (tree, opd_node) {
+
+        for (i = 0; i < MEXPRJIT_N_COLS; i++) {
+            if (strcmp ((char *)opd_node->u.opd_node.opd_value.variable_name,
+                            mexprjit_col_names[i]) == 0) break;
+        }
+        if (i == MEXPRJIT_N_COLS) {
+            printf ("Error : Unknown column %s\n",
+                        (char *)opd_node->u.opd_node.opd_value.variable_name);
+            mexpt_tree_destroy (tree, true);
+            return NULL;
+        }
+
+        opd_node->u.opd_node.is_numeric = true;
+        mexpt_tree_install_operand_properties (opd_node, malloc (sizeof (int)),
+                                                                     mexprjit_col_compute);
+        *(int *)opd_node->u.opd_node.data_src = i;
+
+    } mexpt_iterate_operands_end (tree, opd_node);
+
+    if (!mexpr_validate_expression_tree (tree)) {
+        printf ("Error : %s is not a valid expression\n", expr);
+        mexpt_tree_destroy (tree, true);
+        return NULL;
+    }
+    mexpt_optimize (tree->root);
+    return tree;
+}
+
+/* Returns false if results differ */
+static bool
+mexprjit_expr (const char *expr,
+                        const double *rows,
+                        uint64_t n_rows,
+                        double *ref,
+                        double *out) {
+
+    int r;
+    uint64_t row, n_mismatches = 0;
+    double start, t_interp, t_row, t_batch;
+    mexpt_tree_t *tree;
+    mexpt_jit_t *jit;
+
+    tree = mexprjit_build (expr);
+    if (!tree) return true;
+
+    jit = mexpt_jit_compile (tree, mexprjit_col_names, MEXPRJIT_N_COLS);
+    if (!jit) {
+        printf ("%-40s  not supported by MexprJit\n", expr);
+        mexpt_tree_destroy (tree, true);
+        return true;
+    }
+
+    /* Check */
+    for (row = 0; row < n_rows; row++) {
+        mexprjit_row = rows + row * MEXPRJIT_N_COLS;
+        ref[row] = mexprjit_interp (tree);
+        if (!mexprjit_same (ref[row], mexpt_jit_eval (jit, mexprjit_row))) n_mismatches++;
+    }
+    mexpt_jit_eval_batch (jit, rows, n_rows, out);
+    for (row = 0; row < n_rows; row++) {
+        if (!mexprjit_same (ref[row], out[row])) n_mismatches++;
+    }
+
+    /* Time */
+    rows += MEXPRJIT_EDGE_ROWS * MEXPRJIT_N_COLS;
+    n_rows -= MEXPRJIT_EDGE_ROWS;
+    t_interp = t_row = t_batch = INFINITY;
+
+    for (r = 0; r < MEXPRJIT_REPEAT; r++) {
+
+        start = mexprjit_now ();
+        for (row = 0; row < n_rows; row++) {
+            mexprjit_row = rows + row * MEXPRJIT_N_COLS;
+            ref[row] = mexprjit_interp (tree);
+        }
+        t_interp = fmin (t_interp, mexprjit_now () - start);
+
+        start = mexprjit_now ();
+        for (row = 0; row < n_rows; row++) {
+            out[row] = mexpt_jit_eval (jit, rows + row * MEXPRJIT_N_COLS);
+        }
+        t_row = fmin (t_row, mexprjit_now () - start);
+
+        start = mexprjit_now ();
+        mexpt_jit_eval_batch (jit, rows, n_rows, out);
+        t_batch = fmin (t_batch, mexprjit_now () - start);
+    }
+
+    printf ("%-40s  %10llu  %8.1f  %8.1f  %8.1f  %7.1f  %7.1f\n", expr,
+                (unsigned long long)n_mismatches, t_interp / n_rows * 1e9,
+                t_row / n_rows * 1e9, t_batch / n_rows * 1e9,
+                t_interp / t_row, t_interp / t_batch);
+
+    mexpt_jit_free (jit);
+    mexpt_tree_destroy (tree, true);
+    return n_mismatches == 0;
+}
+
+int
+main (int argc, char **argv) {
+
+    int i;
+    bool ok = true;
+    uint64_t k, n_rows = 1024 * 1024;
+    double *rows, *ref, *out;
+
+    if (argc > 1) n_rows = strtoull (argv[1], NULL, 10);
+    if (!n_rows) n_rows = 1;
+    n_rows += MEXPRJIT_EDGE_ROWS;
+
+    parse_init ();
+    srand (1);
+
+    rows = (double *)malloc (n_rows * MEXPRJIT_N_COLS * sizeof (double));
+    for (k = 0; k < n_rows * MEXPRJIT_N_COLS; k++) {
+
+        if (rand () % 16 == 0) {
+            rows[k] = NAN;
+        }
+        else if (k < MEXPRJIT_EDGE_ROWS * MEXPRJIT_N_COLS && rand () % 4 == 0) {
+            rows[k] = rand () % 2;
+        }
+        else {
+            rows[k] = (double)rand () / RAND_MAX * 20 - 10;
+        }
+    }
+    ref = (double *)malloc (n_rows * sizeof (double));
+    out = (double *)malloc (n_rows * sizeof (double));
+
+    printf ("%llu rows, ns per row\n", (unsigned long long)(n_rows - MEXPRJIT_EDGE_ROWS));
+    printf ("%-40s  %10s  %8s  %8s  %8s  %7s  %7s\n", "expression", "mismatches",
+                "interp", "jit row", "jit batch", "x row", "x batch");
+
+    if (argc > 2) {
+        for (i = 2; i < argc; i++) {
+            ok = mexprjit_expr (argv[i], rows, n_rows, ref, out) && ok;
+        }
+    }
+    else {
+        for (i = 0; mexprjit_exprs[i]; i++) {
+            ok = mexprjit_expr (mexprjit_exprs[i], rows, n_rows, ref, out) && ok;
+        }
+    }
+
+    if (!ok) printf ("Error : JIT results differ from mexpt_evaluate\n");
+
+    free (rows);
+    free (ref);
+    free (out);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,211 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include "UserParserL.h"
+#include "ParserMexpr.h"
+#include "MexprEnums.h"
+#include "MexprBatch.h"
+#include "MexprParallel.h"
+
+/* Measures scaling of parallel batch evaluation, see MexprParallel.h
+
+    Usage : mexprpar [rows] [max workers]
+
+    Evaluates expressions of increasing cost over rows rows (16M if not given)
+    of 4 random columns a, b, c, d, with 1, 2, 4 ... max workers (online cores
+    if not given), and prints throughput, speedup over 1 worker and parallel
+    efficiency of mexpt_par_eval( ) and mexpt_par_select( ), best of
+    MEXPRPAR_REPEAT runs. Results are checked against mexpt_batch_eval( ).
+*/
+
+#define MEXPRPAR_N_COLS     4
+#define MEXPRPAR_REPEAT     3
+
+static const char *mexprpar_col_names[MEXPRPAR_N_COLS] = {"a", "b", "c", "d"};
+
+static const char *mexprpar_exprs[] = {
+    "a * b + c > 25",
+    "sqrt(a * a + b * b) < c + d",
+    "sin(a) * cos(b) + pow(c, 0.5) > d / 2",
+    NULL
+};
+
+static double
+mexprpar_now (void) {
+
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static mexpt_tree_t *
+mexprpar_build (const char *expr) {
+
+    mexpt_tree_t *tree;
+
+    /* Parser rewinds by rescanning lex_buffer */
+    strcpy ((char *)lex_buffer, expr);
+    lex_set_scan_buffer ((const char *)lex_buffer);
+
+    tree = Parser_Mexpr_Condition_build_expression_tree ();
+    if (!tree) {
+        tree = Parser_Mexpr_build_math_expression_tree ();
+    }
+    Parser_stack_reset ();
+
+    if (!tree) {
+        printf ("Error : Exp Tree could not built for %s\n", expr);
+        return NULL;
+    }
+    if (!mexpr_validate_expression_tree (tree)) {
+        printf ("Error : %s is not a valid expression\n", expr);
+        mexpt_tree_destroy (tree, false);
+        return NULL;
+    }
+    mexpt_optimize (tree->root);
+    return tree;
+}
+
+static bool
+mexprpar_same (const double *out1, const double *out2, uint64_t n_rows) {
+
+    uint64_t i;
+
+    for (i = 0; i < n_rows; i++) {
+        if (out1[i] != out2[i] && (out1[i] == out1[i] || out2[i] == out2[i])) return false;
+    }
+    return true;
+}
+
+static void
+mexprpar_expr (const char *expr,
+                          const double **cols,
+                          uint64_t n_rows,
+                          int max_workers,
+                          double *ref,
+                          double *out,
+                          uint64_t *sel) {
+
+    int r, n_workers;
+    double start, t_eval, t_select, t1_eval = 0, t1_select = 0;
+    uint64_t n_selected = 0;
+    mexpt_tree_t *tree;
+    mexpt_batch_plan_t *plan;
+    mexpt_pool_t *pool;
+    mexpt_par_plan_t *par;
+    mexpt_pool_stats_t stats;
+
+    tree = mexprpar_build (expr);
+    if (!tree) return;
+
+    plan = mexpt_batch_compile (tree, mexprpar_col_names, MEXPRPAR_N_COLS,
+                                                MEXPT_BATCH_FUSE_DEFAULT);
+    if (!plan) {
+        printf ("Error : %s is not supported by MexprBatch\n", expr);
+        mexpt_tree_destroy (tree, false);
+        return;
+    }
+
+    start = mexprpar_now ();
+    mexpt_batch_eval (plan, cols, n_rows, ref);
+    printf ("\n%s\n  mexpt_batch_eval : %.1f Mrows/s\n", expr,
+                n_rows / (mexprpar_now () - start) / 1e6);
+    printf ("  %7s  %12s  %7s  %5s  %12s  %7s  %5s  %7s\n", "workers",
+                "eval Mrows/s", "speedup", "eff", "sel Mrows/s", "speedup", "eff", "steals");
+
+    for (n_workers = 1; ; n_workers = n_workers * 2 > max_workers && n_workers < max_workers ?
+                                                    max_workers : n_workers * 2) {
+
+        pool = mexpt_pool_create (n_workers);
+        par = mexpt_par_compile (pool, tree, mexprpar_col_names, MEXPRPAR_N_COLS,
+                                                MEXPT_BATCH_FUSE_DEFAULT, 0);
+        t_eval = t_select = INFINITY;
+
+        for (r = 0; r < MEXPRPAR_REPEAT; r++) {
+
+            start = mexprpar_now ();
+            mexpt_par_eval (par, cols, n_rows, out);
+            t_eval = fmin (t_eval, mexprpar_now () - start);
+
+            start = mexprpar_now ();
+            n_selected = mexpt_par_select (par, cols, n_rows, sel);
+            t_select = fmin (t_select, mexprpar_now () - start);
+        }
+        mexpt_pool_get_stats (pool, &stats);
+
+        if (!mexprpar_same (ref, out, n_rows)) {
+            printf ("Error : results of %d workers differ from mexpt_batch_eval\n", n_workers);
+        }
+
+        if (n_workers == 1) {
+            t1_eval = t_eval;
+            t1_select = t_select;
+        }
+
+        printf ("  %7d  %12.1f  %7.2f  %5.2f  %12.1f  %7.2f  %5.2f  %7llu\n", n_workers,
+                    n_rows / t_eval / 1e6, t1_eval / t_eval, t1_eval / t_eval / n_workers,
+                    n_rows / t_select / 1e6, t1_select / t_select,
+                    t1_select / t_select / n_workers, (unsigned long long)stats.n_steals);
+
+        mexpt_par_free (par);
+        mexpt_pool_destroy (pool);
+        if (n_workers >= max_workers) break;
+    }
+
+    printf ("  %llu rows selected\n", (unsigned long long)n_selected);
+    mexpt_batch_free (plan);
+    mexpt_tree_destroy (tree, false);
+}
+
+int
+main (int argc, char **argv) {
+
+    int i, c;
+    uint64_t row;
+    uint64_t n_rows = 16 * 1024 * 1024;
+    int max_workers = (int)sysconf (_SC_NPROCESSORS_ONLN);
+    double *cols[MEXPRPAR_N_COLS];
+    double *ref, *out;
+    uint64_t *sel;
+
+    if (argc > 3) {
+        printf ("Usage : %s [rows] [max workers]\n", argv[0]);
+        return 1;
+    }
+    if (argc > 1) n_rows = strtoull (argv[1], NULL, 10);
+    if (argc > 2) max_workers = atoi (argv[2]);
+    if (!n_rows) n_rows = 1;
+    if (max_workers <= 0) max_workers = 1;
+
+    parse_init ();
+    srand (1);
+
+    for (c = 0; c < MEXPRPAR_N_COLS; c++) {
+        cols[c] = (double *)malloc (n_rows * sizeof (double));
+        for (row = 0; row < n_rows; row++) {
+            cols[c][row] = (double)rand () / RAND_MAX * 10;
+        }
+    }
+    ref = (double *)malloc (n_rows * sizeof (double));
+    out = (double *)malloc (n_rows * sizeof (double));
+    sel = (uint64_t *)malloc (n_rows * sizeof (uint64_t));
+
+    printf ("%llu rows, up to %d workers\n", (unsigned long long)n_rows, max_workers);
+
+    for (i = 0; mexprpar_exprs[i]; i++) {
+        mexprpar_expr (mexprpar_exprs[i], (const double **)cols, n_rows, max_workers,
+                                ref, out, sel);
+    }
+
+    for (c = 0; c < MEXPRPAR_N_COLS; c++) {
+        free (cols[c]);
+    }
+    free (ref);
+    free (out);
+    free (sel);
+    return 0;
+}
@@ -0,0 +1,403 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "MexprEnums.h"
+#include "MExpr.h"
+#include "MexprBatch.h"
+#include "MexprParallel.h"
+
+/* ====================x================x=================== */
+/* Work Stealing Pool */
+
+#define MEXPT_POOL_STRIPE(front, back)  ((uint64_t)(front) | ((uint64_t)(back) << 32))
+#define MEXPT_POOL_FRONT(stripe)        ((uint32_t)(stripe))
+#define MEXPT_POOL_BACK(stripe)         ((uint32_t)((stripe) >> 32))
+
+static bool
+mexpt_pool_pop (mexpt_pool_worker_t *worker, uint64_t *morsel) {
+
+    uint64_t stripe = __atomic_load_n (&worker->stripe, __ATOMIC_ACQUIRE);
+    uint32_t front, back;
+
+    for (;;) {
+
+        front = MEXPT_POOL_FRONT (stripe);
+        back = MEXPT_POOL_BACK (stripe);
+        if (front >= back) return false;
+
+        /* On failure stripe is reloaded */
+        if (__atomic_compare_exchange_n (&worker->stripe, &stripe,
+                        MEXPT_POOL_STRIPE (front + 1, back), false,
+                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            *morsel = front;
+            return true;
+        }
+    }
+}
+
+/* Takes the back half of the stripe of another worker : runs its first
+    morsel, the rest becomes the stripe of the thief. Morsels are never dealt
+    twice in a job, so a stripe never takes a value back (no ABA) */
+static bool
+mexpt_pool_steal (mexpt_pool_worker_t *thief, uint64_t *morsel) {
+
+    int i;
+    uint64_t stripe;
+    uint32_t front, back, n;
+    mexpt_pool_t *pool = thief->pool;
+    mexpt_pool_worker_t *victim;
+
+    for (i = 1; i < pool->n_workers; i++) {
+
+        victim = &pool->workers[(thief->index + i) % pool->n_workers];
+        stripe = __atomic_load_n (&victim->stripe, __ATOMIC_ACQUIRE);
+
+        for (;;) {
+
+            front = MEXPT_POOL_FRONT (stripe);
+            back = MEXPT_POOL_BACK (stripe);
+            if (front >= back) break;
+
+            n = (back - front + 1) / 2;
+
+            if (__atomic_compare_exchange_n (&victim->stripe, &stripe,
+                            MEXPT_POOL_STRIPE (front, back - n), false,
+                            __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+
+                __atomic_store_n (&thief->stripe,
+                            MEXPT_POOL_STRIPE (back - n + 1, back), __ATOMIC_RELEASE);
+                thief->n_steals++;
+                *morsel = back - n;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static void
+mexpt_pool_work (mexpt_pool_worker_t *worker) {
+
+    uint64_t morsel, begin, end;
+    mexpt_pool_t *pool = worker->pool;
+
+    while (mexpt_pool_pop (worker, &morsel) || mexpt_pool_steal (worker, &morsel)) {
+
+        begin = morsel * pool->morsel_rows;
+        end = begin + pool->morsel_rows < pool->n_rows ? begin + pool->morsel_rows : pool->n_rows;
+
+        pool->fn (pool->arg, worker->index, begin, end);
+        worker->n_morsels++;
+    }
+}
+
+static void *
+mexpt_pool_thread (void *arg) {
+
+    mexpt_pool_worker_t *worker = (mexpt_pool_worker_t *)arg;
+    mexpt_pool_t *pool = worker->pool;
+    uint64_t generation = 0;
+
+    for (;;) {
+
+        pthread_mutex_lock (&pool->lock);
+        while (!pool->shutdown && pool->generation == generation) {
+            pthread_cond_wait (&pool->start_cv, &pool->lock);
+        }
+        if (pool->shutdown) {
+            pthread_mutex_unlock (&pool->lock);
+            return NULL;
+        }
+        generation = pool->generation;
+        pthread_mutex_unlock (&pool->lock);
+
+        mexpt_pool_work (worker);
+
+        pthread_mutex_lock (&pool->lock);
+        if (--pool->n_running == 0) pthread_cond_signal (&pool->done_cv);
+        pthread_mutex_unlock (&pool->lock);
+    }
+}
+
+mexpt_pool_t *
+mexpt_pool_create (int n_workers) {
+
+    int i;
+    mexpt_pool_t *pool;
+
+    if (n_workers <= 0) n_workers = (int)sysconf (_SC_NPROCESSORS_ONLN);
+    if (n_workers <= 0) n_workers = 1;
+
+    pool = (mexpt_pool_t *)calloc (1, sizeof (mexpt_pool_t));
+    pool->n_workers = n_workers;
+    pool->workers = (mexpt_pool_worker_t *)aligned_alloc (64,
+                                n_workers * sizeof (mexpt_pool_worker_t));
+    memset (pool->workers, 0, n_workers * sizeof (mexpt_pool_worker_t));
+
+    pthread_mutex_init (&pool->lock, NULL);
+    pthread_cond_init (&pool->start_cv, NULL);
+    pthread_cond_init (&pool->done_cv, NULL);
+
+    for (i = 0; i < n_workers; i++) {
+
+        pool->workers[i].pool = pool;
+        pool->workers[i].index = i;
+
+        /* Worker 0 is the thread calling mexpt_pool_run( ) */
+        if (i && pthread_create (&pool->workers[i].thread, NULL,
+                                            mexpt_pool_thread, &pool->workers[i])) {
+            printf ("Error : Could not start worker %d, pool runs %d workers\n", i, i);
+            pool->n_workers = i;
+            break;
+        }
+    }
+    return pool;
+}
+
+void
+mexpt_pool_run (mexpt_pool_t *pool,
+                            uint64_t n_rows,
+                            uint64_t morsel_rows,
+                            mexpt_pool_job_fn_t fn,
+                            void *arg) {
+
+    int i;
+    uint64_t n_morsels;
+
+    if (!n_rows) return;
+    if (!morsel_rows) morsel_rows = MEXPT_POOL_DEFAULT_MORSEL;
+
+    /* Morsel indexes are 32 bits */
+    while ((n_rows + morsel_rows - 1) / morsel_rows > UINT32_MAX) morsel_rows *= 2;
+    n_morsels = (n_rows + morsel_rows - 1) / morsel_rows;
+
+    pool->fn = fn;
+    pool->arg = arg;
+    pool->n_rows = n_rows;
+    pool->morsel_rows = morsel_rows;
+
+    for (i = 0; i < pool->n_workers; i++) {
+        pool->workers[i].n_morsels = 0;
+        pool->workers[i].n_steals = 0;
+        pool->workers[i].stripe = MEXPT_POOL_STRIPE (n_morsels * i / pool->n_workers,
+                                                n_morsels * (i + 1) / pool->n_workers);
+    }
+
+    /* Threads see the job under the lock */
+    pthread_mutex_lock (&pool->lock);
+    pool->n_running = pool->n_workers - 1;
+    pool->generation++;
+    pthread_cond_broadcast (&pool->start_cv);
+    pthread_mutex_unlock (&pool->lock);
+
+    mexpt_pool_work (&pool->workers[0]);
+
+    /* Every morsel is run once every worker is out of the job : a morsel not
+        run is in a stripe, or was stolen by a worker still running */
+    pthread_mutex_lock (&pool->lock);
+    while (pool->n_running) {
+        pthread_cond_wait (&pool->done_cv, &pool->lock);
+    }
+    pthread_mutex_unlock (&pool->lock);
+}
+
+void
+mexpt_pool_get_stats (mexpt_pool_t *pool, mexpt_pool_stats_t *stats) {
+
+    int i;
+    mexpt_pool_worker_t *worker;
+
+    memset (stats, 0, sizeof (*stats));
+    stats->min_morsels = UINT64_MAX;
+
+    for (i = 0; i < pool->n_workers; i++) {
+
+        worker = &pool->workers[i];
+        stats->n_morsels += worker->n_morsels;
+        stats->n_steals += worker->n_steals;
+        if (worker->n_morsels > stats->max_morsels) stats->max_morsels = worker->n_morsels;
+        if (worker->n_morsels < stats->min_morsels) stats->min_morsels = worker->n_morsels;
+    }
+}
+
+void
+mexpt_pool_destroy (mexpt_pool_t *pool) {
+
+    int i;
+
+    pthread_mutex_lock (&pool->lock);
+    pool->shutdown = true;
+    pthread_cond_broadcast (&pool->start_cv);
+    pthread_mutex_unlock (&pool->lock);
+
+    for (i = 1; i < pool->n_workers; i++) {
+        pthread_join (pool->workers[i].thread, NULL);
+    }
+
+    pthread_mutex_destroy (&pool->lock);
+    pthread_cond_destroy (&pool->start_cv);
+    pthread_cond_destroy (&pool->done_cv);
+    free (pool->workers);
+    free (pool);
+}
+
+/* ====================x================x=================== */
+/* Parallel Batch Evaluation */
+
+mexpt_par_plan_t *
+mexpt_par_compile (mexpt_pool_t *pool,
+                                mexpt_tree_t *tree,
+                                const char **col_names,
+                                int n_cols,
+                                uint32_t flags,
+                                uint64_t morsel_rows) {
+
+    int i;
+    mexpt_par_plan_t *par;
+    mexpt_par_ctx_t *ctx;
+
+    if (!morsel_rows) morsel_rows = MEXPT_POOL_DEFAULT_MORSEL;
+    morsel_rows = (morsel_rows + MEXPT_BATCH_CHUNK - 1) / MEXPT_BATCH_CHUNK * MEXPT_BATCH_CHUNK;
+
+    par = (mexpt_par_plan_t *)calloc (1, sizeof (mexpt_par_plan_t));
+    par->pool = pool;
+    par->n_cols = n_cols;
+    par->morsel_rows = morsel_rows;
+    par->ctxs = (mexpt_par_ctx_t *)aligned_alloc (64, pool->n_workers * sizeof (mexpt_par_ctx_t));
+    memset (par->ctxs, 0, pool->n_workers * sizeof (mexpt_par_ctx_t));
+
+    for (i = 0; i < pool->n_workers; i++) {
+
+        ctx = &par->ctxs[i];
+        ctx->plan = mexpt_batch_compile (tree, col_names, n_cols, flags);
+
+        if (!ctx->plan) {
+            mexpt_par_free (par);
+            return NULL;
+        }
+        ctx->cols = (const double **)calloc (n_cols ? n_cols : 1, sizeof (double *));
+        ctx->out = (double *)malloc (morsel_rows * sizeof (double));
+    }
+    return par;
+}
+
+static void
+mexpt_par_eval_morsel (void *arg, int worker, uint64_t begin, uint64_t end) {
+
+    int c;
+    mexpt_par_plan_t *par = (mexpt_par_plan_t *)arg;
+    mexpt_par_ctx_t *ctx = &par->ctxs[worker];
+
+    for (c = 0; c < par->n_cols; c++) {
+        ctx->cols[c] = par->cols[c] + begin;
+    }
+    mexpt_batch_eval (ctx->plan, ctx->cols, end - begin, par->out + begin);
+}
+
+void
+mexpt_par_eval (mexpt_par_plan_t *par,
+                            const double **cols,
+                            uint64_t n_rows,
+                            double *out) {
+
+    par->cols = cols;
+    par->out = out;
+    mexpt_pool_run (par->pool, n_rows, par->morsel_rows, mexpt_par_eval_morsel, par);
+}
+
+static void
+mexpt_par_select_morsel (void *arg, int worker, uint64_t begin, uint64_t end) {
+
+    int c;
+    uint64_t i, n = end - begin;
+    uint64_t n_selected = 0;
+    mexpt_par_plan_t *par = (mexpt_par_plan_t *)arg;
+    mexpt_par_ctx_t *ctx = &par->ctxs[worker];
+    uint64_t *__restrict sel = par->sel_tmp + begin;
+    const double *__restrict out = ctx->out;
+
+    for (c = 0; c < par->n_cols; c++) {
+        ctx->cols[c] = par->cols[c] + begin;
+    }
+    mexpt_batch_eval (ctx->plan, ctx->cols, n, ctx->out);
+
+    /* Branch free : the index is written anyway, kept if selected */
+    for (i = 0; i < n; i++) {
+        sel[n_selected] = begin + i;
+        n_selected += (out[i] != 0.0 && out[i] == out[i]);
+    }
+    par->offsets[begin / par->morsel_rows] = n_selected;
+}
+
+static void
+mexpt_par_gather_morsel (void *arg, int worker, uint64_t begin, uint64_t end) {
+
+    mexpt_par_plan_t *par = (mexpt_par_plan_t *)arg;
+    uint64_t morsel = begin / par->morsel_rows;
+
+    (void)worker;
+    (void)end;
+
+    memcpy (par->sel + par->offsets[morsel], par->sel_tmp + begin,
+                (par->offsets[morsel + 1] - par->offsets[morsel]) * sizeof (uint64_t));
+}
+
+uint64_t
+mexpt_par_select (mexpt_par_plan_t *par,
+                              const double **cols,
+                              uint64_t n_rows,
+                              uint64_t *sel) {
+
+    uint64_t m, count, total = 0;
+    uint64_t n_morsels = (n_rows + par->morsel_rows - 1) / par->morsel_rows;
+
+    if (!n_rows) return 0;
+
+    /* Both jobs must cut the morsels of par */
+    if (n_morsels > UINT32_MAX) {
+        printf ("Error : %llu rows are too many for morsels of %llu rows\n",
+                    (unsigned long long)n_rows, (unsigned long long)par->morsel_rows);
+        return 0;
+    }
+
+    if (n_rows > par->max_rows) {
+        free (par->sel_tmp);
+        free (par->offsets);
+        par->sel_tmp = (uint64_t *)malloc (n_rows * sizeof (uint64_t));
+        par->offsets = (uint64_t *)malloc ((n_morsels + 1) * sizeof (uint64_t));
+        par->max_rows = n_rows;
+    }
+
+    par->cols = cols;
+    par->sel = sel;
+
+    mexpt_pool_run (par->pool, n_rows, par->morsel_rows, mexpt_par_select_morsel, par);
+
+    /* Counts to offsets, exclusive prefix sum */
+    for (m = 0; m < n_morsels; m++) {
+        count = par->offsets[m];
+        par->offsets[m] = total;
+        total += count;
+    }
+    par->offsets[n_morsels] = total;
+
+    mexpt_pool_run (par->pool, n_rows, par->morsel_rows, mexpt_par_gather_morsel, par);
+    return total;
+}
+
+void
+mexpt_par_free (mexpt_par_plan_t *par) {
+
+    int i;
+
+    for (i = 0; i < par->pool->n_workers; i++) {
+        if (par->ctxs[i].plan) mexpt_batch_free (par->ctxs[i].plan);
+        free (par->ctxs[i].cols);
+        free (par->ctxs[i].out);
+    }
+    free (par->ctxs);
+    free (par->sel_tmp);
+    free (par->offsets);
+    free (par);
+}
@@ -0,0 +1,161 @@
+#ifndef __MEXPR_PARALLEL__
+#define __MEXPR_PARALLEL__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "MExpr.h"
+#include "MexprBatch.h"
+
+/* Parallel Batch Evaluation
+
+    A pool of n_workers workers (the calling thread and n_workers - 1 threads)
+    runs jobs over a range of rows. mexpt_pool_run( ) cuts the range into
+    morsels of morsel_rows rows, deals them to the workers in contiguous
+    stripes, and returns once every morsel was run :
+
+    Every worker pops morsels from the front of its stripe. A worker whose
+    stripe is empty steals the back half of the stripe of another worker, so
+    that workers finishing early (cheaper rows, a core busy with something
+    else) take over the rest. A stripe is one word : front and back morsel
+    indexes, updated with compare and swap, hence no lock on the way of
+    morsels. Rows of a morsel are contiguous, workers stream through
+    neighbouring morsels until they steal.
+
+    mexpt_par_compile( ) compiles a tree into one MexprBatch plan per worker :
+    plans own their scratch vectors, every worker evaluates with its own plan
+    and its own morsel sized buffers, nothing is shared but the columns.
+
+    mexpt_par_eval( ) gives the result column : every morsel writes its rows
+    of out, results are the ones of mexpt_batch_eval( ).
+    mexpt_par_select( ) gives the selection vector, indexes of the rows on
+    which the predicate is true (non zero, not NaN) in ascending order : every
+    morsel selects into its rows of a scratch vector, a prefix sum of the
+    counts gives where each morsel's selection goes, then morsels copy their
+    selection in place, in parallel too.
+
+    One job at a time per pool, and per compiled plan. mexprpar
+    (MexprParTool.c) measures scaling with the number of workers.
+*/
+
+#define MEXPT_POOL_DEFAULT_MORSEL   (64 * MEXPT_BATCH_CHUNK)
+
+typedef struct mexpt_pool_ mexpt_pool_t;
+
+/* Rows [begin, end) of the job, run by worker */
+typedef void (*mexpt_pool_job_fn_t) (void *arg, int worker, uint64_t begin, uint64_t end);
+
+/* Stripe of morsels of a worker, front in the low 32 bits, back in the high
+    32 bits, one past the last morsel */
+typedef struct mexpt_pool_worker_ {
+
+    uint64_t stripe;                /* atomic */
+    uint64_t n_morsels;             /* run by the worker, last job */
+    uint64_t n_steals;              /* successful steals, last job */
+    pthread_t thread;
+    mexpt_pool_t *pool;
+    int index;
+} __attribute__ ((aligned (64))) mexpt_pool_worker_t;
+
+struct mexpt_pool_ {
+
+    int n_workers;
+    mexpt_pool_worker_t *workers;
+
+    /* Job being run */
+    mexpt_pool_job_fn_t fn;
+    void *arg;
+    uint64_t n_rows;
+    uint64_t morsel_rows;
+
+    pthread_mutex_t lock;
+    pthread_cond_t start_cv;
+    pthread_cond_t done_cv;
+    uint64_t generation;            /* of the job, under lock */
+    int n_running;                  /* threads not done with the job, under lock */
+    bool shutdown;
+};
+
+typedef struct mexpt_pool_stats_ {
+
+    uint64_t n_morsels;
+    uint64_t n_steals;
+    uint64_t max_morsels;           /* of a single worker */
+    uint64_t min_morsels;
+} mexpt_pool_stats_t;
+
+/* Evaluation context of a worker */
+typedef struct mexpt_par_ctx_ {
+
+    mexpt_batch_plan_t *plan;
+    const double **cols;            /* columns from the first row of the morsel */
+    double *out;                    /* morsel_rows results */
+} __attribute__ ((aligned (64))) mexpt_par_ctx_t;
+
+typedef struct mexpt_par_plan_ {
+
+    mexpt_pool_t *pool;
+    int n_cols;
+    uint64_t morsel_rows;
+    mexpt_par_ctx_t *ctxs;          /* per worker */
+
+    /* Job arguments */
+    const double **cols;
+    double *out;
+    uint64_t *sel;
+
+    /* mexpt_par_select( ) : selection of every morsel at its first row, then
+        rows selected per morsel, turned into offsets in sel */
+    uint64_t *sel_tmp;
+    uint64_t *offsets;
+    uint64_t max_rows;
+} mexpt_par_plan_t;
+
+/* n_workers <= 0 is the number of online cores */
+mexpt_pool_t *
+mexpt_pool_create (int n_workers);
+
+/* morsel_rows 0 is MEXPT_POOL_DEFAULT_MORSEL */
+void
+mexpt_pool_run (mexpt_pool_t *pool,
+                            uint64_t n_rows,
+                            uint64_t morsel_rows,
+                            mexpt_pool_job_fn_t fn,
+                            void *arg);
+
+/* Of the last job */
+void
+mexpt_pool_get_stats (mexpt_pool_t *pool, mexpt_pool_stats_t *stats);
+
+void
+mexpt_pool_destroy (mexpt_pool_t *pool);
+
+/* NULL if MexprBatch does not support the tree. morsel_rows 0 is
+    MEXPT_POOL_DEFAULT_MORSEL, rounded up to MEXPT_BATCH_CHUNK */
+mexpt_par_plan_t *
+mexpt_par_compile (mexpt_pool_t *pool,
+                                mexpt_tree_t *tree,
+                                const char **col_names,
+                                int n_cols,
+                                uint32_t flags,
+                                uint64_t morsel_rows);
+
+/* cols[i] points to n_rows doubles of column i, out receives n_rows results */
+void
+mexpt_par_eval (mexpt_par_plan_t *par,
+                            const double **cols,
+                            uint64_t n_rows,
+                            double *out);
+
+/* sel receives the selected rows, up to n_rows. Returns their number */
+uint64_t
+mexpt_par_select (mexpt_par_plan_t *par,
+                              const double **cols,
+                              uint64_t n_rows,
+                              uint64_t *sel);
+
+void
+mexpt_par_free (mexpt_par_plan_t *par);
+
+#endif
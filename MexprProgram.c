@@ -0,0 +1,314 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "MexprEnums.h"
+#include "MExpr.h"
+#include "MexprArena.h"
+#include "MexprProgram.h"
+
+/* ====================x================x=================== */
+/* Compiler */
+
+typedef struct mexpt_program_ctx_ {
+
+    mexpt_program_instr_t *instrs;
+    int n_instrs;
+    int depth;
+    int max_stack;
+
+    int n_opds;
+    mexpt_node_t **opd_nodes;       /* first node of every slot */
+} mexpt_program_ctx_t;
+
+static int
+mexpt_program_slot (mexpt_program_ctx_t *ctx, mexpt_node_t *node) {
+
+    int i;
+
+    for (i = 0; i < ctx->n_opds; i++) {
+        if (strcmp ((char *)ctx->opd_nodes[i]->u.opd_node.opd_value.variable_name,
+                        (char *)node->u.opd_node.opd_value.variable_name) == 0) {
+            return i;
+        }
+    }
+    ctx->opd_nodes = (mexpt_node_t **)realloc (ctx->opd_nodes,
+                                (ctx->n_opds + 1) * sizeof (mexpt_node_t *));
+    ctx->opd_nodes[ctx->n_opds] = node;
+    return ctx->n_opds++;
+}
+
+/* Post-order, leaves as mexpt_evaluate( ) reads them. Unary nodes pop one
+    operand and push one, binary nodes pop two */
+static void
+mexpt_program_emit (mexpt_program_ctx_t *ctx, mexpt_node_t *node) {
+
+    mexpt_program_instr_t *instr;
+
+    if (!node) return;
+
+    mexpt_program_emit (ctx, node->left);
+    mexpt_program_emit (ctx, node->right);
+
+    instr = &ctx->instrs[ctx->n_instrs++];
+    instr->token_code = node->token_code;
+
+    if (node->left) {
+
+        instr->op = node->right ? MEXPT_PROGRAM_BINARY : MEXPT_PROGRAM_UNARY;
+        instr->u.opr_fn = node->opr_fn;
+        if (node->right) ctx->depth--;
+        return;
+    }
+
+    ctx->depth++;
+    if (ctx->depth > ctx->max_stack) ctx->max_stack = ctx->depth;
+
+    switch (node->token_code) {
+
+        case MATH_IDENTIFIER:
+        case MATH_IDENTIFIER_IDENTIFIER:
+            instr->op = MEXPT_PROGRAM_OPD;
+            instr->u.opd = mexpt_program_slot (ctx, node);
+            return;
+        case MATH_INTEGER_VALUE:
+            instr->op = MEXPT_PROGRAM_CONST;
+            instr->u.val.dtype = MEXPR_DTYPE_INT;
+            instr->u.val.u.int_val = node->u.opd_node.opd_value.int_val;
+            return;
+        case MATH_DOUBLE_VALUE:
+            instr->op = MEXPT_PROGRAM_CONST;
+            instr->u.val.dtype = MEXPR_DTYPE_DOUBLE;
+            instr->u.val.u.d_val = node->u.opd_node.opd_value.math_val;
+            return;
+        case MATH_STRING_VALUE:
+            instr->op = MEXPT_PROGRAM_CONST;
+            instr->u.val = mexpr_var_interned (node->u.opd_node.istr);
+            return;
+        default:
+            break;
+    }
+
+    /* Optimized Ineq or Logical node */
+    instr->op = MEXPT_PROGRAM_CONST;
+    instr->u.val.dtype = MEXPR_DTYPE_BOOL;
+
+    if (Math_is_ineq_operator (node->token_code)) {
+        assert (node->u.ineq_node.is_optimized);
+        instr->u.val.u.b_val = node->u.ineq_node.result;
+        return;
+    }
+
+    assert (Math_is_logical_operator (node->token_code));
+    assert (node->u.log_op_node.is_optimized);
+    instr->u.val.u.b_val = node->u.log_op_node.result;
+}
+
+mexpt_program_t *
+mexpt_program_compile (mexpt_tree_t *tree) {
+
+    int i;
+    size_t instrs_size, bindings_size;
+    mexpt_node_t *node;
+    mexpt_program_t *prog;
+    mexpt_program_ctx_t ctx;
+    mexpt_exec_binding_t *bindings;
+    char (*opd_names)[MEXPR_TREE_OPERAND_LEN_MAX];
+    int n_nodes = mexpt_count_nodes (tree->root);
+
+    if (!n_nodes) return NULL;
+
+    memset (&ctx, 0, sizeof (ctx));
+    ctx.instrs = (mexpt_program_instr_t *)calloc (n_nodes, sizeof (mexpt_program_instr_t));
+    mexpt_program_emit (&ctx, tree->root);
+    assert (ctx.depth == 1 && ctx.n_instrs == n_nodes);
+
+    /* One block : program, instructions, bindings and names of the slots */
+    instrs_size = n_nodes * sizeof (mexpt_program_instr_t);
+    bindings_size = ctx.n_opds * sizeof (mexpt_exec_binding_t);
+    prog = (mexpt_program_t *)calloc (1, sizeof (mexpt_program_t) + instrs_size +
+                                    bindings_size + ctx.n_opds * MEXPR_TREE_OPERAND_LEN_MAX);
+
+    prog->n_instrs = n_nodes;
+    prog->max_stack = ctx.max_stack;
+    prog->n_opds = ctx.n_opds;
+    memcpy (prog->instrs, ctx.instrs, instrs_size);
+
+    bindings = (mexpt_exec_binding_t *)((char *)prog->instrs + instrs_size);
+    opd_names = (char (*)[MEXPR_TREE_OPERAND_LEN_MAX])((char *)bindings + bindings_size);
+
+    for (i = 0; i < ctx.n_opds; i++) {
+
+        node = ctx.opd_nodes[i];
+        strncpy (opd_names[i], (char *)node->u.opd_node.opd_value.variable_name,
+                    MEXPR_TREE_OPERAND_LEN_MAX - 1);
+
+        if (node->u.opd_node.is_resolved) {
+            bindings[i].data_src = node->u.opd_node.data_src;
+            bindings[i].compute_fn_ptr = node->u.opd_node.compute_fn_ptr;
+        }
+    }
+    prog->bindings = bindings;
+    prog->opd_names = (const char (*)[MEXPR_TREE_OPERAND_LEN_MAX])opd_names;
+
+    free (ctx.instrs);
+    free (ctx.opd_nodes);
+    return prog;
+}
+
+int
+mexpt_program_operand_index (const mexpt_program_t *prog, const char *name) {
+
+    int i;
+
+    for (i = 0; i < prog->n_opds; i++) {
+        if (strcmp (prog->opd_names[i], name) == 0) return i;
+    }
+    return -1;
+}
+
+void
+mexpt_program_free (mexpt_program_t *prog) {
+
+    free (prog);
+}
+
+/* ====================x================x=================== */
+/* Execution Contexts */
+
+mexpt_exec_ctx_t *
+mexpt_exec_ctx_create (const mexpt_program_t *prog) {
+
+    mexpt_exec_ctx_t *ctx = (mexpt_exec_ctx_t *)calloc (1, sizeof (mexpt_exec_ctx_t));
+
+    ctx->prog = prog;
+    ctx->bindings = (mexpt_exec_binding_t *)malloc (
+                                (prog->n_opds ? prog->n_opds : 1) * sizeof (mexpt_exec_binding_t));
+    memcpy (ctx->bindings, prog->bindings, prog->n_opds * sizeof (mexpt_exec_binding_t));
+    ctx->stack = (mexpr_var_t *)malloc (prog->max_stack * sizeof (mexpr_var_t));
+    mexpr_arena_init (&ctx->arena);
+    return ctx;
+}
+
+bool
+mexpt_exec_ctx_bind (mexpt_exec_ctx_t *ctx,
+                                  const char *name,
+                                  void *data_src,
+                                  mexpr_var_t (*compute_fn_ptr) (void *)) {
+
+    int opd = mexpt_program_operand_index (ctx->prog, name);
+
+    if (opd < 0) return false;
+    mexpt_exec_ctx_bind_index (ctx, opd, data_src, compute_fn_ptr);
+    return true;
+}
+
+void
+mexpt_exec_ctx_bind_index (mexpt_exec_ctx_t *ctx,
+                                            int opd,
+                                            void *data_src,
+                                            mexpr_var_t (*compute_fn_ptr) (void *)) {
+
+    assert (opd >= 0 && opd < ctx->prog->n_opds);
+    ctx->bindings[opd].data_src = data_src;
+    ctx->bindings[opd].compute_fn_ptr = compute_fn_ptr;
+}
+
+/* ====================x================x=================== */
+/* Interpreter */
+
+/* stack has room for prog->max_stack values */
+static mexpr_var_t
+mexpt_exec_run (const mexpt_program_t *prog,
+                            const mexpt_exec_binding_t *bindings,
+                            mexpr_var_t *stack) {
+
+    int sp = 0;
+    mexpr_var_t l, r;
+    const mexpt_exec_binding_t *binding;
+    const mexpt_program_instr_t *instr = prog->instrs;
+    const mexpt_program_instr_t *end = instr + prog->n_instrs;
+
+    for (; instr < end; instr++) {
+
+        switch (instr->op) {
+
+            case MEXPT_PROGRAM_CONST:
+                stack[sp++] = instr->u.val;
+                break;
+            case MEXPT_PROGRAM_OPD:
+                binding = &bindings[instr->u.opd];
+                if (!binding->compute_fn_ptr) {
+                    stack[sp++].dtype = MEXPR_DTYPE_INVALID;
+                    break;
+                }
+                stack[sp++] = binding->compute_fn_ptr (binding->data_src);
+                break;
+            case MEXPT_PROGRAM_UNARY:
+                l = stack[sp - 1];
+                if (l.dtype == MEXPR_DTYPE_INVALID) break;
+                stack[sp - 1] = instr->u.opr_fn ? instr->u.opr_fn (l, l) :
+                                        mexpt_compute (instr->token_code, l, l);
+                break;
+            case MEXPT_PROGRAM_BINARY:
+                r = stack[--sp];
+                l = stack[sp - 1];
+                if (l.dtype == MEXPR_DTYPE_INVALID || r.dtype == MEXPR_DTYPE_INVALID) {
+                    stack[sp - 1].dtype = MEXPR_DTYPE_INVALID;
+                    break;
+                }
+                stack[sp - 1] = instr->u.opr_fn ? instr->u.opr_fn (l, r) :
+                                        mexpt_compute (instr->token_code, l, r);
+                break;
+        }
+    }
+
+    assert (sp == 1);
+    return stack[0];
+}
+
+mexpr_var_t
+mexpt_exec_evaluate (mexpt_exec_ctx_t *ctx) {
+
+    mexpr_var_t res;
+    mexpr_arena_t *prev;
+
+    /* Strings of the previous evaluation are given up */
+    mexpr_arena_reset (&ctx->arena);
+    prev = mexpr_arena_enter (&ctx->arena);
+
+    res = mexpt_exec_run (ctx->prog, ctx->bindings, ctx->stack);
+    ctx->n_evals++;
+
+    mexpr_arena_leave (prev);
+    return res;
+}
+
+mexpr_var_t
+mexpt_program_evaluate (const mexpt_program_t *prog) {
+
+    mexpr_var_t res;
+    mexpr_arena_t *prev;
+    mexpr_var_t small_stack[MEXPT_PROGRAM_SMALL_STACK];
+    mexpr_var_t *stack = small_stack;
+
+    if (prog->max_stack > MEXPT_PROGRAM_SMALL_STACK) {
+        stack = (mexpr_var_t *)malloc (prog->max_stack * sizeof (mexpr_var_t));
+    }
+
+    prev = mexpr_arena_enter (NULL);
+    res = mexpt_exec_run (prog, prog->bindings, stack);
+    mexpr_arena_leave (prev);
+
+    if (stack != small_stack) free (stack);
+    return res;
+}
+
+void
+mexpt_exec_ctx_destroy (mexpt_exec_ctx_t *ctx) {
+
+    mexpr_arena_free (&ctx->arena);
+    free (ctx->bindings);
+    free (ctx->stack);
+    free (ctx);
+}
@@ -0,0 +1,145 @@
+#ifndef __MEXPR_PROGRAM__
+#define __MEXPR_PROGRAM__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "MExpr.h"
+#include "MexprArena.h"
+
+/* Immutable Programs and Execution Contexts
+
+    A tree is not safe to evaluate from several threads : its nodes hold the
+    operand bindings (data_src, compute_fn_ptr), the state of mexpt_optimize( )
+    and the inline caches of kernels, which mexpt_evaluate( ) updates. So
+    threads clone the tree. Instead, Appln compiles the validated (and possibly
+    optimized) tree once :
+
+        mexpt_program_t     post-order instructions with constants, preselected
+                            kernels and operand slots, in one block. Never
+                            written after mexpt_program_compile( ), shared by
+                            any number of threads.
+
+        mexpt_exec_ctx_t    per thread : bindings of the operand slots, operand
+                            stack and the arena of string results. Created from
+                            the program, a few hundred bytes.
+
+    Operand slots are the distinct operand names of the tree, in order of first
+    appearance (post-order). Contexts start with the bindings installed in the
+    tree when it was compiled, slots of unresolved operands are unbound, and
+    evaluate to MEXPR_DTYPE_INVALID like unresolved operands of a tree. Bind a
+    slot to a callback returning the dtype declared with
+    mexpt_tree_set_operand_dtype( ) if any, the kernels of the program were
+    preselected for it.
+
+    Guarantees : mexpt_exec_evaluate( ) writes only its context and the memory
+    of its callbacks, and reads the program and interned strings, which nobody
+    writes while contexts evaluate. MexprDb kernels compute on their operands
+    and allocate string results from the arena of the context. Hence threads
+    evaluating one program, each with its own context, never write memory they
+    share. A context is used by one thread at a time.
+
+    Results are the ones of mexpt_evaluate( ) on the tree. String results are
+    valid until the next evaluation with the same context.
+
+    Handles shared by threads which keep no context per thread, like the ones
+    of MexprTier, call mexpt_program_evaluate( ) instead : it evaluates with
+    the bindings of the tree, on an operand stack of the calling thread, and
+    allocates string results from the thread's arena like mexpt_evaluate( ).
+
+    The tree is not needed once compiled. The program refers to interned
+    strings, it must be freed before mexpr_intern_cleanup( ).
+*/
+
+/* Programs up to this operand stack depth are evaluated by
+    mexpt_program_evaluate( ) without allocating */
+#define MEXPT_PROGRAM_SMALL_STACK   64
+
+typedef enum mexpt_program_op_ {
+
+    MEXPT_PROGRAM_CONST,
+    MEXPT_PROGRAM_OPD,
+    MEXPT_PROGRAM_UNARY,
+    MEXPT_PROGRAM_BINARY
+} mexpt_program_op_t;
+
+typedef struct mexpt_program_instr_ {
+
+    mexpt_program_op_t op;
+    int token_code;
+
+    union {
+        mexpr_var_t val;                        /* MEXPT_PROGRAM_CONST */
+        int opd;                                /* MEXPT_PROGRAM_OPD : slot */
+        operator_fn_ptr_t opr_fn;               /* UNARY, BINARY, NULL if not
+                                                    preselected */
+    } u;
+} mexpt_program_instr_t;
+
+/* Binding of an operand slot, compute_fn_ptr NULL if unbound */
+typedef struct mexpt_exec_binding_ {
+
+    void *data_src;
+    mexpr_var_t (*compute_fn_ptr) (void *);
+} mexpt_exec_binding_t;
+
+typedef struct mexpt_program_ {
+
+    int n_instrs;
+    int max_stack;
+    int n_opds;
+    const mexpt_exec_binding_t *bindings;       /* of the tree, per slot */
+    const char (*opd_names)[MEXPR_TREE_OPERAND_LEN_MAX];
+    mexpt_program_instr_t instrs[];
+} mexpt_program_t;
+
+typedef struct mexpt_exec_ctx_ {
+
+    const mexpt_program_t *prog;
+    mexpt_exec_binding_t *bindings;
+    mexpr_var_t *stack;
+    mexpr_arena_t arena;
+    uint64_t n_evals;               /* with this context */
+} mexpt_exec_ctx_t;
+
+/* NULL if the tree is empty */
+mexpt_program_t *
+mexpt_program_compile (mexpt_tree_t *tree);
+
+/* Slot of the operand, -1 if the program has none of this name */
+int
+mexpt_program_operand_index (const mexpt_program_t *prog, const char *name);
+
+/* No context of the program may be left */
+void
+mexpt_program_free (mexpt_program_t *prog);
+
+mexpt_exec_ctx_t *
+mexpt_exec_ctx_create (const mexpt_program_t *prog);
+
+/* Binds the slot of the operand, returns false if the program has none of this
+    name */
+bool
+mexpt_exec_ctx_bind (mexpt_exec_ctx_t *ctx,
+                                  const char *name,
+                                  void *data_src,
+                                  mexpr_var_t (*compute_fn_ptr) (void *));
+
+void
+mexpt_exec_ctx_bind_index (mexpt_exec_ctx_t *ctx,
+                                            int opd,
+                                            void *data_src,
+                                            mexpr_var_t (*compute_fn_ptr) (void *));
+
+mexpr_var_t
+mexpt_exec_evaluate (mexpt_exec_ctx_t *ctx);
+
+/* With the bindings of the tree, see above. String results are valid until
+    the next evaluation on the calling thread, see MexprArena.h */
+mexpr_var_t
+mexpt_program_evaluate (const mexpt_program_t *prog);
+
+void
+mexpt_exec_ctx_destroy (mexpt_exec_ctx_t *ctx);
+
+#endif
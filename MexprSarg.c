@@ -0,0 +1,598 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "MexprEnums.h"
+#include "MExpr.h"
+#include "MexprSarg.h"
+
+/* No token of its own : key <= col */
+#define MEXPT_SARG_GREATER_THAN_EQ  (-1)
+
+/* Ranges implied by a subtree : a row on which the subtree is true has the
+    key of every column in cols in its range set. exact : the converse holds
+    too, is_false : subtree is true on no row */
+typedef struct mexpt_sarg_set_ {
+
+    bool is_false;
+    bool exact;
+    int n_cols;
+    mexpt_sarg_col_t *cols;
+} mexpt_sarg_set_t;
+
+static int
+mexpt_sarg_key_cmp (mexpr_var_t key1, mexpr_var_t key2) {
+
+    int cmp;
+    uint32_t len;
+
+    if (key1.dtype == MEXPR_DTYPE_STRING) {
+        len = key1.str_len < key2.str_len ? key1.str_len : key2.str_len;
+        cmp = memcmp (key1.u.str_val, key2.u.str_val, len);
+        if (cmp) return cmp < 0 ? -1 : 1;
+        return (key1.str_len > key2.str_len) - (key1.str_len < key2.str_len);
+    }
+
+    if (key1.dtype == MEXPR_DTYPE_INT && key2.dtype == MEXPR_DTYPE_INT) {
+        return (key1.u.int_val > key2.u.int_val) - (key1.u.int_val < key2.u.int_val);
+    }
+    if (key1.dtype == MEXPR_DTYPE_INT) {
+        return mexpr_cmp_int_double (key1.u.int_val, key2.u.d_val);
+    }
+    if (key2.dtype == MEXPR_DTYPE_INT) {
+        return mexpr_cmp_double_int (key1.u.d_val, key2.u.int_val);
+    }
+    return (key1.u.d_val > key2.u.d_val) - (key1.u.d_val < key2.u.d_val);
+}
+
+/* Lower bounds : unbounded first, [k before (k */
+static int
+mexpt_sarg_lo_cmp (const mexpt_key_bound_t *b1, const mexpt_key_bound_t *b2) {
+
+    int cmp;
+
+    if (b1->unbounded || b2->unbounded) return b2->unbounded - b1->unbounded;
+    cmp = mexpt_sarg_key_cmp (b1->key, b2->key);
+    if (cmp) return cmp;
+    return b2->inclusive - b1->inclusive;
+}
+
+/* Upper bounds : k) before k], unbounded last */
+static int
+mexpt_sarg_hi_cmp (const mexpt_key_bound_t *b1, const mexpt_key_bound_t *b2) {
+
+    int cmp;
+
+    if (b1->unbounded || b2->unbounded) return b1->unbounded - b2->unbounded;
+    cmp = mexpt_sarg_key_cmp (b1->key, b2->key);
+    if (cmp) return cmp;
+    return b1->inclusive - b2->inclusive;
+}
+
+static bool
+mexpt_sarg_range_empty (const mexpt_key_range_t *range) {
+
+    int cmp;
+
+    if (range->lo.unbounded || range->hi.unbounded) return false;
+    cmp = mexpt_sarg_key_cmp (range->lo.key, range->hi.key);
+    return cmp > 0 || (cmp == 0 && !(range->lo.inclusive && range->hi.inclusive));
+}
+
+static int
+mexpt_sarg_range_cmp (const void *p1, const void *p2) {
+
+    const mexpt_key_range_t *range1 = (const mexpt_key_range_t *)p1;
+    const mexpt_key_range_t *range2 = (const mexpt_key_range_t *)p2;
+
+    if (range1->is_string != range2->is_string) return range1->is_string ? 1 : -1;
+    return mexpt_sarg_lo_cmp (&range1->lo, &range2->lo);
+}
+
+/* Sorts, then merges overlapping and adjacent ranges */
+static void
+mexpt_sarg_normalize (mexpt_sarg_col_t *col) {
+
+    int i, n = 0;
+    int cmp;
+    mexpt_key_range_t *cur, *next;
+
+    if (col->n_ranges <= 1) return;
+    qsort (col->ranges, col->n_ranges, sizeof (mexpt_key_range_t), mexpt_sarg_range_cmp);
+
+    for (i = 1; i < col->n_ranges; i++) {
+
+        cur = &col->ranges[n];
+        next = &col->ranges[i];
+
+        if (cur->is_string == next->is_string) {
+
+            if (cur->hi.unbounded || next->lo.unbounded) cmp = -1;
+            else cmp = mexpt_sarg_key_cmp (next->lo.key, cur->hi.key);
+
+            if (cmp < 0 || (cmp == 0 && (next->lo.inclusive || cur->hi.inclusive))) {
+                if (mexpt_sarg_hi_cmp (&next->hi, &cur->hi) > 0) cur->hi = next->hi;
+                continue;
+            }
+        }
+        col->ranges[++n] = *next;
+    }
+    col->n_ranges = n + 1;
+}
+
+static mexpt_sarg_col_t *
+mexpt_sarg_set_col (mexpt_sarg_set_t *set, const unsigned char *name) {
+
+    int i;
+
+    for (i = 0; i < set->n_cols; i++) {
+        if (strcmp ((char *)set->cols[i].name, (char *)name) == 0) return &set->cols[i];
+    }
+    return NULL;
+}
+
+static void
+mexpt_sarg_set_free (mexpt_sarg_set_t *set) {
+
+    int i;
+
+    for (i = 0; i < set->n_cols; i++) {
+        free (set->cols[i].ranges);
+    }
+    free (set->cols);
+    set->cols = NULL;
+    set->n_cols = 0;
+}
+
+/* Literal, or parameter bound to a value */
+static bool
+mexpt_sarg_key (mexpt_node_t *node, mexpr_var_t *key) {
+
+    if (node->left || node->right) return false;
+
+    switch (node->token_code) {
+
+        case MATH_INTEGER_VALUE:
+            key->dtype = MEXPR_DTYPE_INT;
+            key->u.int_val = node->u.opd_node.opd_value.int_val;
+            return true;
+        case MATH_DOUBLE_VALUE:
+            key->dtype = MEXPR_DTYPE_DOUBLE;
+            key->u.d_val = node->u.opd_node.opd_value.math_val;
+            return key->u.d_val == key->u.d_val;
+        case MATH_STRING_VALUE:
+            *key = mexpr_var_interned (node->u.opd_node.istr);
+            return true;
+        case MATH_IDENTIFIER:
+            if (!mexpt_node_is_param (node) || !node->u.opd_node.is_resolved ||
+                    !node->u.opd_node.compute_fn_ptr) {
+                return false;
+            }
+            *key = node->u.opd_node.compute_fn_ptr (node->u.opd_node.data_src);
+            if (key->dtype == MEXPR_DTYPE_DOUBLE) return key->u.d_val == key->u.d_val;
+            return key->dtype == MEXPR_DTYPE_INT || key->dtype == MEXPR_DTYPE_STRING;
+        default:
+            return false;
+    }
+}
+
+/* table.column op key, or key op table.column */
+static bool
+mexpt_sarg_compare (mexpt_node_t *node, mexpt_sarg_set_t *set) {
+
+    int opr = node->token_code;
+    mexpr_var_t key;
+    mexpt_node_t *col_node;
+    mexpt_key_range_t range;
+
+    if (!node->left || !node->right) return false;
+
+    if (node->left->token_code == MATH_IDENTIFIER_IDENTIFIER &&
+            mexpt_sarg_key (node->right, &key)) {
+        col_node = node->left;
+    }
+    else if (node->right->token_code == MATH_IDENTIFIER_IDENTIFIER &&
+            mexpt_sarg_key (node->left, &key)) {
+        col_node = node->right;
+        /* key < col is col > key */
+        if (opr == MATH_LESS_THAN) opr = MATH_GREATER_THAN;
+        else if (opr == MATH_GREATER_THAN) opr = MATH_LESS_THAN;
+        else if (opr == MATH_LESS_THAN_EQ) opr = MEXPT_SARG_GREATER_THAN_EQ;
+    }
+    else {
+        return false;
+    }
+
+    memset (&range, 0, sizeof (range));
+    range.is_string = (key.dtype == MEXPR_DTYPE_STRING);
+    range.lo.key = key;
+    range.hi.key = key;
+
+    switch (opr) {
+
+        case MATH_EQ:
+            range.lo.inclusive = range.hi.inclusive = true;
+            break;
+        case MATH_LESS_THAN:
+            range.lo.unbounded = true;
+            break;
+        case MATH_LESS_THAN_EQ:
+            range.lo.unbounded = true;
+            range.hi.inclusive = true;
+            break;
+        case MATH_GREATER_THAN:
+            range.hi.unbounded = true;
+            break;
+        case MEXPT_SARG_GREATER_THAN_EQ:
+            range.lo.inclusive = true;
+            range.hi.unbounded = true;
+            break;
+        default:
+            /* != is true on NaN keys */
+            return false;
+    }
+
+    /* Strings compare by equality only */
+    if (range.is_string && opr != MATH_EQ) return false;
+
+    set->n_cols = 1;
+    set->cols = (mexpt_sarg_col_t *)calloc (1, sizeof (mexpt_sarg_col_t));
+    strcpy ((char *)set->cols[0].name, (char *)col_node->u.opd_node.opd_value.variable_name);
+    set->cols[0].n_ranges = 1;
+    set->cols[0].ranges = (mexpt_key_range_t *)malloc (sizeof (mexpt_key_range_t));
+    set->cols[0].ranges[0] = range;
+    set->exact = true;
+    return true;
+}
+
+/* Key in both range sets */
+static void
+mexpt_sarg_intersect (mexpt_sarg_col_t *col1, const mexpt_sarg_col_t *col2) {
+
+    int i, j, n = 0;
+    mexpt_key_range_t range;
+    mexpt_key_range_t *ranges = (mexpt_key_range_t *)malloc (
+            (col1->n_ranges * col2->n_ranges + 1) * sizeof (mexpt_key_range_t));
+
+    for (i = 0; i < col1->n_ranges; i++) {
+        for (j = 0; j < col2->n_ranges; j++) {
+
+            if (col1->ranges[i].is_string != col2->ranges[j].is_string) continue;
+
+            range = col1->ranges[i];
+            if (mexpt_sarg_lo_cmp (&col2->ranges[j].lo, &range.lo) > 0) {
+                range.lo = col2->ranges[j].lo;
+            }
+            if (mexpt_sarg_hi_cmp (&col2->ranges[j].hi, &range.hi) < 0) {
+                range.hi = col2->ranges[j].hi;
+            }
+            if (!mexpt_sarg_range_empty (&range)) ranges[n++] = range;
+        }
+    }
+
+    free (col1->ranges);
+    col1->ranges = ranges;
+    col1->n_ranges = n;
+    mexpt_sarg_normalize (col1);
+}
+
+/* Key in either range set */
+static void
+mexpt_sarg_union (mexpt_sarg_col_t *col1, const mexpt_sarg_col_t *col2) {
+
+    col1->ranges = (mexpt_key_range_t *)realloc (col1->ranges,
+            (col1->n_ranges + col2->n_ranges) * sizeof (mexpt_key_range_t));
+    memcpy (col1->ranges + col1->n_ranges, col2->ranges,
+            col2->n_ranges * sizeof (mexpt_key_range_t));
+    col1->n_ranges += col2->n_ranges;
+    mexpt_sarg_normalize (col1);
+}
+
+/* set1 = set1 and set2, set2 is consumed */
+static void
+mexpt_sarg_and (mexpt_sarg_set_t *set1, mexpt_sarg_set_t *set2) {
+
+    int i;
+    mexpt_sarg_col_t *col;
+
+    set1->exact = set1->exact && set2->exact;
+    set1->is_false = set1->is_false || set2->is_false;
+
+    for (i = 0; i < set2->n_cols && !set1->is_false; i++) {
+
+        col = mexpt_sarg_set_col (set1, set2->cols[i].name);
+
+        if (col) {
+            mexpt_sarg_intersect (col, &set2->cols[i]);
+            if (!col->n_ranges) set1->is_false = true;
+            continue;
+        }
+        set1->cols = (mexpt_sarg_col_t *)realloc (set1->cols,
+                (set1->n_cols + 1) * sizeof (mexpt_sarg_col_t));
+        set1->cols[set1->n_cols++] = set2->cols[i];
+        set2->cols[i].ranges = NULL;
+    }
+
+    /* Condition can not be true : no range set is needed */
+    if (set1->is_false) {
+        mexpt_sarg_set_free (set1);
+        set1->exact = true;
+    }
+    mexpt_sarg_set_free (set2);
+}
+
+/* set1 = set1 or set2, set2 is consumed */
+static void
+mexpt_sarg_or (mexpt_sarg_set_t *set1, mexpt_sarg_set_t *set2) {
+
+    int i, j, n = 0;
+    mexpt_sarg_col_t *col;
+    mexpt_sarg_set_t tmp;
+
+    if (set2->is_false) {
+        mexpt_sarg_set_free (set2);
+        return;
+    }
+    if (set1->is_false) {
+        tmp = *set1;
+        *set1 = *set2;
+        *set2 = tmp;
+        mexpt_sarg_set_free (set2);
+        return;
+    }
+
+    /* Exact only for the ranges of a single column, of a single dtype class :
+        with numeric and string keys, one of the comparisons fails on the row */
+    set1->exact = set1->exact && set2->exact &&
+                        set1->n_cols == 1 && set2->n_cols == 1 &&
+                        strcmp ((char *)set1->cols[0].name, (char *)set2->cols[0].name) == 0;
+
+    /* Columns constrained on one side only are unconstrained */
+    for (i = 0; i < set1->n_cols; i++) {
+
+        col = mexpt_sarg_set_col (set2, set1->cols[i].name);
+
+        if (!col) {
+            free (set1->cols[i].ranges);
+            continue;
+        }
+        mexpt_sarg_union (&set1->cols[i], col);
+        set1->cols[n++] = set1->cols[i];
+    }
+    set1->n_cols = n;
+
+    for (i = 0; set1->exact && i < set1->cols[0].n_ranges; i++) {
+        for (j = 0; j < i; j++) {
+            if (set1->cols[0].ranges[i].is_string != set1->cols[0].ranges[j].is_string) {
+                set1->exact = false;
+            }
+        }
+    }
+    mexpt_sarg_set_free (set2);
+}
+
+static void
+mexpt_sarg_derive (mexpt_node_t *node, mexpt_sarg_set_t *set) {
+
+    mexpt_sarg_set_t rset;
+
+    memset (set, 0, sizeof (*set));
+    if (!node) return;
+
+    /* Due to optimization leaf may contain : Ineq Op Or Logical Op also */
+    if (!node->left && !node->right) {
+
+        if ((Math_is_ineq_operator (node->token_code) && node->u.ineq_node.is_optimized) ||
+            (Math_is_logical_operator (node->token_code) && node->u.log_op_node.is_optimized)) {
+
+            set->exact = true;
+            set->is_false = Math_is_ineq_operator (node->token_code) ?
+                                    !node->u.ineq_node.result : !node->u.log_op_node.result;
+        }
+        return;
+    }
+
+    switch (node->token_code) {
+
+        case MATH_LESS_THAN:
+        case MATH_LESS_THAN_EQ:
+        case MATH_GREATER_THAN:
+        case MATH_EQ:
+        case MATH_NOT_EQ:
+            mexpt_sarg_compare (node, set);
+            return;
+        case MATH_AND:
+        case MATH_OR:
+            mexpt_sarg_derive (node->left, set);
+            mexpt_sarg_derive (node->right, &rset);
+            if (node->token_code == MATH_AND) mexpt_sarg_and (set, &rset);
+            else mexpt_sarg_or (set, &rset);
+            return;
+        default:
+            return;
+    }
+}
+
+static void
+mexpt_sarg_conjuncts (mexpt_node_t *node, mexpt_node_t ***conjuncts,
+                                    int *n_conjuncts, int *max_conjuncts) {
+
+    if (node->token_code == MATH_AND && node->left && node->right) {
+        mexpt_sarg_conjuncts (node->left, conjuncts, n_conjuncts, max_conjuncts);
+        mexpt_sarg_conjuncts (node->right, conjuncts, n_conjuncts, max_conjuncts);
+        return;
+    }
+    if (*n_conjuncts == *max_conjuncts) {
+        *max_conjuncts = *max_conjuncts ? *max_conjuncts * 2 : 8;
+        *conjuncts = (mexpt_node_t **)realloc (*conjuncts,
+                                    *max_conjuncts * sizeof (mexpt_node_t *));
+    }
+    (*conjuncts)[(*n_conjuncts)++] = node;
+}
+
+mexpt_sarg_t *
+mexpt_sarg_extract (mexpt_tree_t *tree) {
+
+    int i, j;
+    int n_conjuncts = 0, max_conjuncts = 0, n_residual = 0;
+    mexpt_node_t **conjuncts = NULL;
+    const mexpt_key_range_t *range;
+    mexpt_sarg_set_t set, cset;
+    mexpt_sarg_t *sarg = (mexpt_sarg_t *)calloc (1, sizeof (mexpt_sarg_t));
+
+    if (!tree->root) return sarg;
+
+    memset (&set, 0, sizeof (set));
+    set.exact = true;
+    mexpt_sarg_conjuncts (tree->root, &conjuncts, &n_conjuncts, &max_conjuncts);
+
+    /* Inexact conjuncts still narrow the ranges, and are kept in place */
+    for (i = 0; i < n_conjuncts; i++) {
+
+        mexpt_sarg_derive (conjuncts[i], &cset);
+        if (!cset.exact) conjuncts[n_residual++] = conjuncts[i];
+        cset.exact = true;
+        mexpt_sarg_and (&set, &cset);
+    }
+
+    sarg->is_false = set.is_false;
+    sarg->n_cols = set.n_cols;
+    sarg->cols = set.cols;
+
+    for (i = 0; i < sarg->n_cols; i++) {
+
+        sarg->cols[i].is_point_set = true;
+        for (j = 0; j < sarg->cols[i].n_ranges; j++) {
+            range = &sarg->cols[i].ranges[j];
+            if (range->lo.unbounded || range->hi.unbounded ||
+                    mexpt_sarg_key_cmp (range->lo.key, range->hi.key)) {
+                sarg->cols[i].is_point_set = false;
+            }
+        }
+    }
+
+    if (n_residual && !sarg->is_false) {
+        sarg->residual = mexpt_clone_conjunction (conjuncts, n_residual);
+    }
+    free (conjuncts);
+    return sarg;
+}
+
+const mexpt_sarg_col_t *
+mexpt_sarg_lookup (const mexpt_sarg_t *sarg, const char *name) {
+
+    int i;
+
+    for (i = 0; i < sarg->n_cols; i++) {
+        if (strcmp ((char *)sarg->cols[i].name, name) == 0) return &sarg->cols[i];
+    }
+    return NULL;
+}
+
+bool
+mexpt_sarg_col_contains (const mexpt_sarg_col_t *col, mexpr_var_t key) {
+
+    int i;
+    int cmp;
+    bool is_string;
+    const mexpt_key_range_t *range;
+
+    switch (key.dtype) {
+        case MEXPR_DTYPE_INT:
+            is_string = false;
+            break;
+        case MEXPR_DTYPE_DOUBLE:
+            if (key.u.d_val != key.u.d_val) return false;
+            is_string = false;
+            break;
+        case MEXPR_DTYPE_STRING:
+            is_string = true;
+            break;
+        default:
+            return false;
+    }
+
+    for (i = 0; i < col->n_ranges; i++) {
+
+        range = &col->ranges[i];
+        if (range->is_string != is_string) continue;
+
+        if (!range->lo.unbounded) {
+            cmp = mexpt_sarg_key_cmp (key, range->lo.key);
+            if (cmp < 0 || (cmp == 0 && !range->lo.inclusive)) continue;
+        }
+        if (!range->hi.unbounded) {
+            cmp = mexpt_sarg_key_cmp (key, range->hi.key);
+            if (cmp > 0 || (cmp == 0 && !range->hi.inclusive)) continue;
+        }
+        return true;
+    }
+    return false;
+}
+
+static void
+mexpt_sarg_print_key (mexpr_var_t key) {
+
+    switch (key.dtype) {
+        case MEXPR_DTYPE_INT:
+            printf ("%lld", (long long)key.u.int_val);
+            break;
+        case MEXPR_DTYPE_DOUBLE:
+            printf ("%g", key.u.d_val);
+            break;
+        case MEXPR_DTYPE_STRING:
+            printf ("'%.*s'", (int)key.str_len, key.u.str_val);
+            break;
+        default:
+            break;
+    }
+}
+
+void
+mexpt_sarg_print (const mexpt_sarg_t *sarg) {
+
+    int i, j;
+    const mexpt_key_range_t *range;
+
+    if (sarg->is_false) {
+        printf ("Sarg : false\n");
+        return;
+    }
+
+    for (i = 0; i < sarg->n_cols; i++) {
+
+        printf ("Sarg : %s%s in", sarg->cols[i].name,
+                    sarg->cols[i].is_point_set ? " (points)" : "");
+
+        for (j = 0; j < sarg->cols[i].n_ranges; j++) {
+
+            range = &sarg->cols[i].ranges[j];
+            printf (j ? " U " : " ");
+            if (range->lo.unbounded) printf ("(-inf");
+            else {
+                printf (range->lo.inclusive ? "[" : "(");
+                mexpt_sarg_print_key (range->lo.key);
+            }
+            printf (", ");
+            if (range->hi.unbounded) printf ("inf)");
+            else {
+                mexpt_sarg_print_key (range->hi.key);
+                printf (range->hi.inclusive ? "]" : ")");
+            }
+        }
+        printf ("\n");
+    }
+    printf ("Sarg : %s residual\n", sarg->residual ? "with" : "no");
+}
+
+void
+mexpt_sarg_free (mexpt_sarg_t *sarg) {
+
+    int i;
+
+    for (i = 0; i < sarg->n_cols; i++) {
+        free (sarg->cols[i].ranges);
+    }
+    free (sarg->cols);
+    if (sarg->residual) mexpt_tree_destroy (sarg->residual, false);
+    free (sarg);
+}
@@ -0,0 +1,91 @@
+#ifndef __MEXPR_SARG__
+#define __MEXPR_SARG__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "MExpr.h"
+
+/* Search Arguments (Sargs) of Condition Trees
+
+    mexpt_sarg_extract( ) finds in a condition the predicates an index on a
+    table.column operand (MATH_IDENTIFIER_IDENTIFIER) can serve : comparisons
+    < <= > = of the column with a literal or a bound parameter ($0, see
+    mexpt_bind_parameters( )), combined by and / or. They are returned per
+    column as a normalized key range set : ranges sorted, disjoint and not
+    adjacent, a row may match only if the key of the column lies in one of
+    them. Sets of all columns are and-ed :
+
+        a.x > 5 and a.x <= 10 or a.x = 20   ->  a.x in (5, 10] U [20, 20]
+        a.s = 'k1' or a.s = 'k2'            ->  a.s in ['k1'] U ['k2'], a point set
+        a.x = 1 and b.y < 3                 ->  a.x in [1, 1], b.y in (-inf, 3)
+
+    A column whose ranges are all points (is_point_set) can be served by
+    hash lookups, others by B-tree range scans.
+
+    Conjuncts of the root the ranges do not capture exactly (a.x + a.y > 3,
+    a.s != 'k', a.x = 1 or b.y = 2, ...) make the residual, a tree of their
+    own : a row matches the condition if and only if its keys lie in the
+    range sets of every column and the residual (if any) evaluates to true.
+    Columns constrained by a residual conjunct keep the ranges implied by it,
+    e.g. (a.x = 1 and b.y = 2) or a.x = 3 gives a.x in [1] U [3].
+
+    Semantics are the ones of MexprDb : numeric keys (int and double) compare
+    exactly with each other, string keys only by equality, NaN keys lie in no
+    range, a key of another dtype class than the range (string key, numeric
+    range) lies in no range. Keys view literals of the tree or values of bound
+    parameters, which must outlive the sarg.
+*/
+
+typedef struct mexpt_key_bound_ {
+
+    bool unbounded;         /* -inf for lo, +inf for hi */
+    bool inclusive;
+    mexpr_var_t key;        /* MEXPR_DTYPE_INT, MEXPR_DTYPE_DOUBLE or MEXPR_DTYPE_STRING */
+} mexpt_key_bound_t;
+
+typedef struct mexpt_key_range_ {
+
+    bool is_string;         /* string keys, ranges are points [k, k] */
+    mexpt_key_bound_t lo;
+    mexpt_key_bound_t hi;
+} mexpt_key_range_t;
+
+typedef struct mexpt_sarg_col_ {
+
+    unsigned char name[MEXPR_TREE_OPERAND_LEN_MAX];
+    int n_ranges;
+    mexpt_key_range_t *ranges;  /* numeric ranges first */
+    bool is_point_set;
+} mexpt_sarg_col_t;
+
+typedef struct mexpt_sarg_ {
+
+    /* No row matches : a column has an empty range set (a.x > 5 and a.x < 2) */
+    bool is_false;
+
+    int n_cols;
+    mexpt_sarg_col_t *cols;
+
+    /* Conjuncts still to evaluate, NULL if ranges are exact. Owned by the sarg */
+    mexpt_tree_t *residual;
+} mexpt_sarg_t;
+
+/* Tree is left untouched, it need not be validated nor resolved */
+mexpt_sarg_t *
+mexpt_sarg_extract (mexpt_tree_t *tree);
+
+/* Range set of the column named name, NULL if unconstrained */
+const mexpt_sarg_col_t *
+mexpt_sarg_lookup (const mexpt_sarg_t *sarg, const char *name);
+
+bool
+mexpt_sarg_col_contains (const mexpt_sarg_col_t *col, mexpr_var_t key);
+
+void
+mexpt_sarg_print (const mexpt_sarg_t *sarg);
+
+void
+mexpt_sarg_free (mexpt_sarg_t *sarg);
+
+#endif
@@ -0,0 +1,328 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include "UserParserL.h"
+#include "ParserMexpr.h"
+#include "MexprEnums.h"
+#include "MexprSelectivity.h"
+
+/* Compares selectivity estimates with actual selectivity, see MexprSelectivity.h
+
+    Usage : mexprsel [condition file] [rows]
+
+    Conditions are evaluated on a synthetic table of rows rows (100000 if not
+    given) with columns :
+
+        t.u     int, uniform in [0, 1000)
+        t.z     int, skewed in [0, 100) : half the rows are below 13
+        t.n     double, normal of mean 50 and deviation 10, 5 % null
+        t.c     int, t.u + uniform in [-20, 20] : correlated with t.u
+
+    Condition file, one declaration per line, '#' starts a comment line :
+
+        hint <operand> <operand> <correlation>
+        <condition>
+
+    Without a condition file, a built-in set of conditions is used.
+*/
+
+#define MEXPRSEL_N_COLS     4
+#define MEXPRSEL_N_BUCKETS  32
+#define MEXPRSEL_MAX_HINTS  16
+
+typedef struct mexprsel_col_ {
+
+    const char *name;
+    bool is_int;
+    double *values;
+    mexpt_col_stats_t stats;
+} mexprsel_col_t;
+
+static mexprsel_col_t mexprsel_cols[MEXPRSEL_N_COLS] = {
+    {"t.u", true}, {"t.z", true}, {"t.n", false}, {"t.c", true}
+};
+
+static uint64_t mexprsel_row;
+
+static const char *mexprsel_default_conditions[] = {
+    "t.u < 250",
+    "t.u <= 500",
+    "t.u = 7",
+    "t.z = 0",
+    "t.z < 5",
+    "t.z > 50",
+    "t.n > 60",
+    "t.n < 30",
+    "t.u > 100 and t.u < 300",
+    "t.u < 100 or t.u > 900",
+    "t.z = 1 or t.z = 2",
+    "t.u < 500 and t.c < 500",
+    "t.u < 500 and t.n > 50",
+    "t.u = t.c",
+    "t.z < 3 and t.n > 45 or t.u < 10",
+    NULL
+};
+
+static char *
+mexprsel_trim (char *str) {
+
+    char *end;
+
+    while (isspace ((unsigned char)*str)) str++;
+    end = str + strlen (str);
+    while (end > str && isspace ((unsigned char)end[-1])) end--;
+    *end = '\0';
+    return str;
+}
+
+static double
+mexprsel_uniform (void) {
+
+    return (rand () + 0.5) / ((double)RAND_MAX + 1);
+}
+
+static void
+mexprsel_generate (uint64_t n_rows) {
+
+    int i;
+    uint64_t row;
+    double r;
+
+    srand (1);
+
+    for (i = 0; i < MEXPRSEL_N_COLS; i++) {
+        mexprsel_cols[i].values = (double *)malloc (n_rows * sizeof (double));
+    }
+
+    for (row = 0; row < n_rows; row++) {
+
+        mexprsel_cols[0].values[row] = floor (mexprsel_uniform () * 1000);
+
+        r = mexprsel_uniform ();
+        mexprsel_cols[1].values[row] = floor (100 * r * r * r);
+
+        mexprsel_cols[2].values[row] = mexprsel_uniform () < 0.05 ? NAN :
+                    50 + 10 * sqrt (-2 * log (mexprsel_uniform ())) *
+                        cos (2 * M_PI * mexprsel_uniform ());
+
+        mexprsel_cols[3].values[row] = mexprsel_cols[0].values[row] +
+                    floor (mexprsel_uniform () * 41) - 20;
+    }
+
+    for (i = 0; i < MEXPRSEL_N_COLS; i++) {
+        mexpt_col_stats_build (mexprsel_cols[i].values, n_rows, MEXPRSEL_N_BUCKETS,
+                                          &mexprsel_cols[i].stats);
+    }
+}
+
+/* Null rows fail */
+static mexpr_var_t
+mexprsel_col_compute (void *data_src) {
+
+    mexpr_var_t res;
+    mexprsel_col_t *col = (mexprsel_col_t *)data_src;
+    double val = col->values[mexprsel_row];
+
+    if (val != val) {
+        res.dtype = MEXPR_DTYPE_INVALID;
+    }
+    else if (col->is_int) {
+        res.dtype = MEXPR_DTYPE_INT;
+        res.u.int_val = (int64_t)val;
+    }
+    else {
+        res.dtype = MEXPR_DTYPE_DOUBLE;
+        res.u.d_val = val;
+    }
+    return res;
+}
+
+static bool
+mexprsel_bind (mexpt_tree_t *tree) {
+
+    int i;
+    mexprsel_col_t *col;
+    mexpt_node_t *opd_node = NULL;
+
+    mexpt_iterate_operands_begin (tree, opd_node) {
+
+        col = NULL;
+        for (i = 0; i < MEXPRSEL_N_COLS; i++) {
+            if (strcmp ((char *)opd_node->u.opd_node.opd_value.variable_name,
+                            mexprsel_cols[i].name) == 0) {
+                col = &mexprsel_cols[i];
+            }
+        }
+        if (!col) {
+            printf ("Error : Unknown column %s\n",
+                        (char *)opd_node->u.opd_node.opd_value.variable_name);
+            return false;
+        }
+
+        opd_node->u.opd_node.is_numeric = true;
+        mexpt_tree_install_operand_properties (opd_node, (void *)col, mexprsel_col_compute);
+        mexpt_tree_set_operand_dtype (opd_node,
+                    col->is_int ? MEXPR_DTYPE_INT : MEXPR_DTYPE_DOUBLE);
+        mexpt_tree_set_operand_stats (opd_node, &col->stats);
+
+    } mexpt_iterate_operands_end (tree, opd_node);
+
+    return mexpr_validate_expression_tree (tree);
+}
+
+/* Returns the q-error of the estimate, 0 if the condition was not evaluated */
+static double
+mexprsel_condition (const char *cond,
+                                uint64_t n_rows,
+                                const mexpt_sel_opts_t *opts) {
+
+    uint64_t n_true = 0;
+    double actual, estimate, floor_sel, q_error;
+    mexpr_var_t res;
+    mexpt_tree_t *tree;
+    mexpt_sel_est_t est;
+
+    if (strlen (cond) >= MAX_STRING_SIZE) {
+        printf ("Error : Condition %s is too long\n", cond);
+        return 0;
+    }
+
+    /* Parser rewinds by rescanning lex_buffer */
+    strcpy ((char *)lex_buffer, cond);
+    lex_set_scan_buffer ((const char *)lex_buffer);
+
+    tree = Parser_Mexpr_Condition_build_expression_tree ();
+    Parser_stack_reset ();
+
+    if (!tree) {
+        printf ("Error : Exp Tree could not built for %s\n", cond);
+        return 0;
+    }
+
+    if (!mexprsel_bind (tree)) {
+        printf ("Error : %s is not a valid condition\n", cond);
+        mexpt_tree_destroy (tree, false);
+        return 0;
+    }
+
+    est = mexpt_sel_estimate (tree, opts);
+
+    for (mexprsel_row = 0; mexprsel_row < n_rows; mexprsel_row++) {
+
+        res = mexpt_evaluate (tree->root);
+        if (res.dtype == MEXPR_DTYPE_BOOL && res.u.b_val) n_true++;
+    }
+    mexpt_tree_destroy (tree, false);
+
+    /* Selectivities below one row count as one row */
+    floor_sel = 1.0 / n_rows;
+    actual = (double)n_true / n_rows;
+    estimate = est.selectivity;
+    q_error = (estimate > floor_sel ? estimate : floor_sel) /
+                    (actual > floor_sel ? actual : floor_sel);
+    if (q_error < 1) q_error = 1 / q_error;
+
+    printf ("%-40s  %9.5f  %9.5f  %7.2f  %5.1f  %5.1f\n",
+                cond, estimate, actual, q_error, est.cost, est.cost_short_circuit);
+    return q_error;
+}
+
+int
+main (int argc, char **argv) {
+
+    int i;
+    FILE *fp = NULL;
+    int line_no = 0;
+    int n_conds = 0;
+    uint64_t n_rows = 100000;
+    double q_error, q_error_max = 1, q_error_log_sum = 0;
+    char line[MAX_STRING_SIZE];
+    char *str;
+    mexpt_sel_opts_t opts;
+    mexpt_sel_hint_t hints[MEXPRSEL_MAX_HINTS];
+    static char hint_opds[MEXPRSEL_MAX_HINTS][2][MEXPR_TREE_OPERAND_LEN_MAX];
+
+    if (argc > 3) {
+        printf ("Usage : %s [condition file] [rows]\n", argv[0]);
+        return 1;
+    }
+
+    if (argc > 1) {
+        fp = fopen (argv[1], "r");
+        if (!fp) {
+            printf ("Error : Could not open %s\n", argv[1]);
+            return 1;
+        }
+    }
+    if (argc > 2) n_rows = strtoull (argv[2], NULL, 10);
+    if (!n_rows) n_rows = 1;
+
+    parse_init ();
+    mexprsel_generate (n_rows);
+
+    memset (&opts, 0, sizeof (opts));
+    opts.hints = hints;
+
+    if (!fp) {
+        hints[0].opd1 = "t.u";
+        hints[0].opd2 = "t.c";
+        hints[0].correlation = 0.9;
+        opts.n_hints = 1;
+    }
+
+    printf ("%-40s  %9s  %9s  %7s  %5s  %5s\n",
+                "condition", "estimate", "actual", "q-error", "cost", "sc");
+
+    for (i = 0; ; i++) {
+
+        if (fp) {
+            if (!fgets (line, sizeof (line), fp)) break;
+            line_no++;
+            str = mexprsel_trim (line);
+            if (str[0] == '\0' || str[0] == '#') continue;
+
+            if (strncmp (str, "hint", 4) == 0 && isspace ((unsigned char)str[4])) {
+
+                if (opts.n_hints == MEXPRSEL_MAX_HINTS ||
+                        sscanf (str + 4, "%191s %191s %lf", hint_opds[opts.n_hints][0],
+                                hint_opds[opts.n_hints][1],
+                                &hints[opts.n_hints].correlation) != 3) {
+                    printf ("Error : %s:%d : Bad hint\n", argv[1], line_no);
+                    continue;
+                }
+                hints[opts.n_hints].opd1 = hint_opds[opts.n_hints][0];
+                hints[opts.n_hints].opd2 = hint_opds[opts.n_hints][1];
+                opts.n_hints++;
+                continue;
+            }
+        }
+        else {
+            if (!mexprsel_default_conditions[i]) break;
+            strcpy (line, mexprsel_default_conditions[i]);
+            str = line;
+        }
+
+        q_error = mexprsel_condition (str, n_rows, &opts);
+        if (q_error == 0) continue;
+
+        n_conds++;
+        q_error_log_sum += log (q_error);
+        if (q_error > q_error_max) q_error_max = q_error;
+    }
+
+    if (fp) fclose (fp);
+
+    if (n_conds) {
+        printf ("%d conditions on %llu rows : q-error geometric mean %.3f, max %.3f\n",
+                    n_conds, (unsigned long long)n_rows,
+                    exp (q_error_log_sum / n_conds), q_error_max);
+    }
+
+    for (i = 0; i < MEXPRSEL_N_COLS; i++) {
+        mexpt_col_stats_free (&mexprsel_cols[i].stats);
+        free (mexprsel_cols[i].values);
+    }
+    return 0;
+}
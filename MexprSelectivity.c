@@ -0,0 +1,458 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "MexprEnums.h"
+#include "MExpr.h"
+#include "MexprSarg.h"
+#include "MexprSelectivity.h"
+
+/* col >= key, key <= col flipped */
+#define MEXPT_SEL_GREATER_THAN_EQ  (-1)
+
+static double
+mexpt_sel_clamp (double sel) {
+
+    if (sel < 0) return 0;
+    if (sel > 1) return 1;
+    return sel;
+}
+
+static double
+mexpt_sel_non_null (const mexpt_col_stats_t *stats) {
+
+    return stats ? mexpt_sel_clamp (1 - stats->null_frac) : 1;
+}
+
+/* Fraction of the non null values below val */
+static double
+mexpt_sel_cdf (const mexpt_col_stats_t *stats, double val) {
+
+    int lo, hi, mid;
+    const double *bounds = stats->bounds;
+    int n_buckets = stats->n_buckets;
+
+    if (val <= bounds[0]) return 0;
+    if (val > bounds[n_buckets]) return 1;
+    if (val == bounds[n_buckets]) return 1 - 1.0 / n_buckets;
+
+    /* Last bucket starting at or below val */
+    lo = 0;
+    hi = n_buckets - 1;
+    while (lo < hi) {
+        mid = (lo + hi + 1) / 2;
+        if (bounds[mid] <= val) lo = mid;
+        else hi = mid - 1;
+    }
+    return (lo + (val - bounds[lo]) / (bounds[lo + 1] - bounds[lo])) / n_buckets;
+}
+
+/* Fraction of the non null values equal to val : buckets made of val only,
+    plus a share of its neighbours, at least 1 / n_distinct */
+static double
+mexpt_sel_eq (const mexpt_col_stats_t *stats, double val) {
+
+    int i;
+    int n_full = 0;
+    double sel = stats->n_distinct > 0 ? 1 / stats->n_distinct : MEXPT_SEL_DEFAULT_EQ;
+
+    if (!stats->n_buckets) return sel;
+    if (val < stats->bounds[0] || val > stats->bounds[stats->n_buckets]) return 0;
+
+    for (i = 0; i < stats->n_buckets; i++) {
+        if (stats->bounds[i] == val && stats->bounds[i + 1] == val) n_full++;
+    }
+    if (n_full) sel = (n_full + 1.0) / stats->n_buckets;
+    return mexpt_sel_clamp (sel);
+}
+
+static double
+mexpt_sel_lt (const mexpt_col_stats_t *stats, double val) {
+
+    return mexpt_sel_cdf (stats, val);
+}
+
+static double
+mexpt_sel_le (const mexpt_col_stats_t *stats, double val) {
+
+    return mexpt_sel_clamp (mexpt_sel_cdf (stats, val) + mexpt_sel_eq (stats, val));
+}
+
+static const mexpt_col_stats_t *
+mexpt_sel_col_stats (mexpt_node_t *node) {
+
+    if (node->left || node->right || !mexpt_node_is_operand (node)) return NULL;
+    return node->u.opd_node.stats;
+}
+
+/* Literal, or parameter bound to a value */
+static bool
+mexpt_sel_key (mexpt_node_t *node, mexpr_var_t *key) {
+
+    if (node->left || node->right) return false;
+
+    switch (node->token_code) {
+
+        case MATH_INTEGER_VALUE:
+            key->dtype = MEXPR_DTYPE_INT;
+            key->u.int_val = node->u.opd_node.opd_value.int_val;
+            return true;
+        case MATH_DOUBLE_VALUE:
+            key->dtype = MEXPR_DTYPE_DOUBLE;
+            key->u.d_val = node->u.opd_node.opd_value.math_val;
+            return true;
+        case MATH_STRING_VALUE:
+            key->dtype = MEXPR_DTYPE_STRING;
+            return true;
+        case MATH_IDENTIFIER:
+            if (!mexpt_node_is_param (node) || !node->u.opd_node.is_resolved ||
+                    !node->u.opd_node.compute_fn_ptr) {
+                return false;
+            }
+            *key = node->u.opd_node.compute_fn_ptr (node->u.opd_node.data_src);
+            return key->dtype == MEXPR_DTYPE_INT || key->dtype == MEXPR_DTYPE_DOUBLE ||
+                        key->dtype == MEXPR_DTYPE_STRING;
+        default:
+            return false;
+    }
+}
+
+static double
+mexpt_sel_key_double (mexpr_var_t key) {
+
+    return key.dtype == MEXPR_DTYPE_INT ? (double)key.u.int_val : key.u.d_val;
+}
+
+/* col opr key */
+static double
+mexpt_sel_compare_key (int opr, const mexpt_col_stats_t *stats, mexpr_var_t key) {
+
+    double val, eq;
+    double nn = mexpt_sel_non_null (stats);
+
+    /* Strings compare by equality only */
+    if (key.dtype == MEXPR_DTYPE_STRING || !stats->n_buckets) {
+
+        eq = stats->n_distinct > 0 ? 1 / stats->n_distinct : MEXPT_SEL_DEFAULT_EQ;
+
+        switch (opr) {
+            case MATH_EQ:       return nn * eq;
+            case MATH_NOT_EQ:   return nn * (1 - eq);
+            default:            return nn * MEXPT_SEL_DEFAULT_RANGE;
+        }
+    }
+
+    val = mexpt_sel_key_double (key);
+    if (val != val) return opr == MATH_NOT_EQ ? nn : 0;
+
+    switch (opr) {
+        case MATH_LESS_THAN:        return nn * mexpt_sel_lt (stats, val);
+        case MATH_LESS_THAN_EQ:     return nn * mexpt_sel_le (stats, val);
+        case MATH_GREATER_THAN:     return nn * (1 - mexpt_sel_le (stats, val));
+        case MATH_EQ:               return nn * mexpt_sel_eq (stats, val);
+        case MATH_NOT_EQ:           return nn * (1 - mexpt_sel_eq (stats, val));
+        case MEXPT_SEL_GREATER_THAN_EQ:
+                                    return nn * (1 - mexpt_sel_lt (stats, val));
+        default:                    return nn * MEXPT_SEL_DEFAULT_RANGE;
+    }
+}
+
+static double
+mexpt_sel_compare (mexpt_node_t *node) {
+
+    int opr = node->token_code;
+    double nd;
+    mexpr_var_t key;
+    const mexpt_col_stats_t *lstats = mexpt_sel_col_stats (node->left);
+    const mexpt_col_stats_t *rstats = mexpt_sel_col_stats (node->right);
+
+    if (lstats && mexpt_sel_key (node->right, &key)) {
+        return mexpt_sel_compare_key (opr, lstats, key);
+    }
+
+    if (rstats && mexpt_sel_key (node->left, &key)) {
+        /* key < col is col > key, key <= col is col >= key */
+        if (opr == MATH_LESS_THAN) opr = MATH_GREATER_THAN;
+        else if (opr == MATH_GREATER_THAN) opr = MATH_LESS_THAN;
+        else if (opr == MATH_LESS_THAN_EQ) opr = MEXPT_SEL_GREATER_THAN_EQ;
+        return mexpt_sel_compare_key (opr, rstats, key);
+    }
+
+    if (lstats && rstats) {
+
+        nd = lstats->n_distinct > rstats->n_distinct ? lstats->n_distinct : rstats->n_distinct;
+
+        switch (opr) {
+            case MATH_EQ:
+                return mexpt_sel_non_null (lstats) * mexpt_sel_non_null (rstats) *
+                            (nd > 0 ? 1 / nd : MEXPT_SEL_DEFAULT_EQ);
+            case MATH_NOT_EQ:
+                return mexpt_sel_non_null (lstats) * mexpt_sel_non_null (rstats) *
+                            (1 - (nd > 0 ? 1 / nd : MEXPT_SEL_DEFAULT_EQ));
+            default:
+                return mexpt_sel_non_null (lstats) * mexpt_sel_non_null (rstats) *
+                            MEXPT_SEL_DEFAULT_RANGE;
+        }
+    }
+
+    switch (opr) {
+        case MATH_EQ:       return MEXPT_SEL_DEFAULT_EQ;
+        case MATH_NOT_EQ:   return 1 - MEXPT_SEL_DEFAULT_EQ;
+        default:            return MEXPT_SEL_DEFAULT_RANGE;
+    }
+}
+
+/* Fraction of non null values in the range, through the histogram */
+static double
+mexpt_sel_range (const mexpt_col_stats_t *stats, const mexpt_key_range_t *range) {
+
+    double lo = 0, hi = 1;
+
+    if (range->is_string) {
+        return stats->n_distinct > 0 ? 1 / stats->n_distinct : MEXPT_SEL_DEFAULT_EQ;
+    }
+
+    if (!range->lo.unbounded && !range->hi.unbounded &&
+            mexpt_sel_key_double (range->lo.key) == mexpt_sel_key_double (range->hi.key)) {
+        return mexpt_sel_eq (stats, mexpt_sel_key_double (range->lo.key));
+    }
+
+    if (!range->lo.unbounded) {
+        lo = range->lo.inclusive ?
+                    mexpt_sel_lt (stats, mexpt_sel_key_double (range->lo.key)) :
+                    mexpt_sel_le (stats, mexpt_sel_key_double (range->lo.key));
+    }
+    if (!range->hi.unbounded) {
+        hi = range->hi.inclusive ?
+                    mexpt_sel_le (stats, mexpt_sel_key_double (range->hi.key)) :
+                    mexpt_sel_lt (stats, mexpt_sel_key_double (range->hi.key));
+    }
+    return hi > lo ? hi - lo : 0;
+}
+
+/* And / or over a single table.column : range set of the column. Returns
+    false if the subtree is not one */
+static bool
+mexpt_sel_single_col (mexpt_node_t *node, double *sel) {
+
+    int i;
+    mexpt_tree_t *tree;
+    mexpt_sarg_t *sarg;
+    mexpt_node_t *opd_node = NULL;
+    const mexpt_col_stats_t *stats = NULL;
+    bool rc = false;
+
+    tree = mexpt_clone_conjunction (&node, 1);
+
+    mexpt_iterate_operands_begin (tree, opd_node) {
+
+        if (opd_node->token_code == MATH_IDENTIFIER_IDENTIFIER && !stats) {
+            stats = opd_node->u.opd_node.stats;
+        }
+    } mexpt_iterate_operands_end (tree, opd_node);
+
+    if (!stats || !stats->n_buckets) {
+        mexpt_tree_destroy (tree, false);
+        return false;
+    }
+
+    sarg = mexpt_sarg_extract (tree);
+
+    if (sarg->is_false) {
+        *sel = 0;
+        rc = true;
+    }
+    else if (!sarg->residual && sarg->n_cols == 1) {
+        *sel = 0;
+        for (i = 0; i < sarg->cols[0].n_ranges; i++) {
+            *sel += mexpt_sel_range (stats, &sarg->cols[0].ranges[i]);
+        }
+        *sel = mexpt_sel_non_null (stats) * mexpt_sel_clamp (*sel);
+        rc = true;
+    }
+
+    mexpt_sarg_free (sarg);
+    mexpt_tree_destroy (tree, false);
+    return rc;
+}
+
+static bool
+mexpt_sel_refers (mexpt_node_t *node, const char *name) {
+
+    if (!node) return false;
+    if (mexpt_node_is_operand (node)) {
+        return strcmp ((char *)node->u.opd_node.opd_value.variable_name, name) == 0;
+    }
+    return mexpt_sel_refers (node->left, name) || mexpt_sel_refers (node->right, name);
+}
+
+static double
+mexpt_sel_correlation (mexpt_node_t *node, const mexpt_sel_opts_t *opts) {
+
+    int i;
+    double corr;
+    const mexpt_sel_hint_t *hint;
+
+    if (!opts) return 0;
+    corr = opts->correlation;
+
+    for (i = 0; i < opts->n_hints; i++) {
+
+        hint = &opts->hints[i];
+        if ((mexpt_sel_refers (node->left, hint->opd1) && mexpt_sel_refers (node->right, hint->opd2)) ||
+            (mexpt_sel_refers (node->left, hint->opd2) && mexpt_sel_refers (node->right, hint->opd1))) {
+            corr = hint->correlation;
+        }
+    }
+    return mexpt_sel_clamp (corr);
+}
+
+static bool
+mexpt_sel_is_single_col (mexpt_node_t *node, const char **name) {
+
+    if (!node) return true;
+
+    if (!node->left && !node->right) {
+        if (node->token_code != MATH_IDENTIFIER_IDENTIFIER) return true;
+        if (!*name) *name = (const char *)node->u.opd_node.opd_value.variable_name;
+        return strcmp (*name, (const char *)node->u.opd_node.opd_value.variable_name) == 0;
+    }
+    return mexpt_sel_is_single_col (node->left, name) &&
+                mexpt_sel_is_single_col (node->right, name);
+}
+
+mexpt_sel_est_t
+mexpt_sel_estimate_node (mexpt_node_t *node, const mexpt_sel_opts_t *opts) {
+
+    double corr, sel;
+    const char *col_name = NULL;
+    mexpt_sel_est_t est, lest, rest;
+
+    memset (&est, 0, sizeof (est));
+    if (!node) return est;
+
+    /* Leaves */
+    if (!node->left && !node->right) {
+
+        if (Math_is_ineq_operator (node->token_code) && node->u.ineq_node.is_optimized) {
+            est.selectivity = node->u.ineq_node.result;
+            return est;
+        }
+        if (Math_is_logical_operator (node->token_code) && node->u.log_op_node.is_optimized) {
+            est.selectivity = node->u.log_op_node.result;
+            return est;
+        }
+
+        est.cost = 1;
+        if (mexpt_node_is_operand (node) && node->u.opd_node.stats &&
+                node->u.opd_node.stats->cost > 0) {
+            est.cost = node->u.opd_node.stats->cost;
+        }
+        est.cost_short_circuit = est.cost;
+        /* Bool operand */
+        if (node->rt_dtype == MEXPR_DTYPE_BOOL) est.selectivity = 0.5;
+        return est;
+    }
+
+    lest = mexpt_sel_estimate_node (node->left, opts);
+    rest = mexpt_sel_estimate_node (node->right, opts);
+    est.cost = lest.cost + rest.cost + 1;
+    est.cost_short_circuit = lest.cost_short_circuit + rest.cost_short_circuit + 1;
+
+    switch (node->token_code) {
+
+        case MATH_LESS_THAN:
+        case MATH_LESS_THAN_EQ:
+        case MATH_GREATER_THAN:
+        case MATH_EQ:
+        case MATH_NOT_EQ:
+            est.selectivity = mexpt_sel_compare (node);
+            return est;
+
+        case MATH_AND:
+        case MATH_OR:
+            corr = mexpt_sel_correlation (node, opts);
+
+            if (node->token_code == MATH_AND) {
+                sel = lest.selectivity < rest.selectivity ? lest.selectivity : rest.selectivity;
+                est.selectivity = (1 - corr) * lest.selectivity * rest.selectivity + corr * sel;
+                est.cost_short_circuit = lest.cost_short_circuit + 1 +
+                                                    lest.selectivity * rest.cost_short_circuit;
+            }
+            else {
+                sel = lest.selectivity > rest.selectivity ? lest.selectivity : rest.selectivity;
+                est.selectivity = (1 - corr) * (lest.selectivity + rest.selectivity -
+                                            lest.selectivity * rest.selectivity) + corr * sel;
+                est.cost_short_circuit = lest.cost_short_circuit + 1 +
+                                                    (1 - lest.selectivity) * rest.cost_short_circuit;
+            }
+
+            if (mexpt_sel_is_single_col (node, &col_name) && col_name &&
+                    mexpt_sel_single_col (node, &sel)) {
+                est.selectivity = sel;
+            }
+            est.selectivity = mexpt_sel_clamp (est.selectivity);
+            return est;
+
+        default:
+            /* Not a condition */
+            return est;
+    }
+}
+
+mexpt_sel_est_t
+mexpt_sel_estimate (mexpt_tree_t *tree, const mexpt_sel_opts_t *opts) {
+
+    return mexpt_sel_estimate_node (tree->root, opts);
+}
+
+static int
+mexpt_sel_double_cmp (const void *p1, const void *p2) {
+
+    double d1 = *(const double *)p1;
+    double d2 = *(const double *)p2;
+
+    return (d1 > d2) - (d1 < d2);
+}
+
+void
+mexpt_col_stats_build (const double *values,
+                                    uint64_t n_values,
+                                    int n_buckets,
+                                    mexpt_col_stats_t *stats) {
+
+    int i;
+    uint64_t j, n = 0;
+    double *sorted = (double *)malloc ((n_values + 1) * sizeof (double));
+    double *bounds;
+
+    memset (stats, 0, sizeof (*stats));
+
+    for (j = 0; j < n_values; j++) {
+        if (values[j] == values[j]) sorted[n++] = values[j];
+    }
+    qsort (sorted, n, sizeof (double), mexpt_sel_double_cmp);
+
+    stats->null_frac = n_values ? (double)(n_values - n) / n_values : 0;
+    for (j = 0; j < n; j++) {
+        if (!j || sorted[j] != sorted[j - 1]) stats->n_distinct++;
+    }
+
+    if (n && n_buckets > 0) {
+
+        bounds = (double *)malloc ((n_buckets + 1) * sizeof (double));
+        for (i = 0; i <= n_buckets; i++) {
+            bounds[i] = sorted[(uint64_t)((double)i * (n - 1) / n_buckets)];
+        }
+        stats->n_buckets = n_buckets;
+        stats->bounds = bounds;
+    }
+    free (sorted);
+}
+
+void
+mexpt_col_stats_free (mexpt_col_stats_t *stats) {
+
+    free ((double *)stats->bounds);
+    stats->bounds = NULL;
+    stats->n_buckets = 0;
+}
@@ -0,0 +1,97 @@
+#ifndef __MEXPR_SELECTIVITY__
+#define __MEXPR_SELECTIVITY__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "MExpr.h"
+
+/* Selectivity Estimation of Condition Trees
+
+    mexpt_sel_estimate( ) estimates the fraction of rows a condition is true
+    on, and the per row cost of evaluating it, from statistics of the columns
+    attached to the operands with mexpt_tree_set_operand_stats( ) :
+
+    col < <= > = != literal (or bound parameter)
+        from the equi-depth histogram of col, interpolating inside a bucket.
+        col = v is 1 / n_distinct, more for values filling whole buckets.
+    col1 = col2
+        1 / max (n_distinct1, n_distinct2).
+    and / or over comparisons of a single table.column with literals
+        from the range set of the column (see MexprSarg.h), so that
+        a.x > 5 and a.x < 10 is the histogram fraction of (5, 10).
+    Other and / or
+        combined under independence, or under the correlation hinted for
+        their operands : 0 independent, 1 the most one side implies the
+        other (and is min (s1, s2), or is max (s1, s2)), values in between
+        blend the two.
+    Anything else
+        System R defaults : 1 / 10 for =, 1 / 3 for ranges.
+
+    Rows counted by null_frac (missing, NaN or failing values) satisfy no
+    comparison. cost counts node evaluations, an operand costs its stats
+    cost (1 without stats). cost is the one of mexpt_evaluate( ), which
+    evaluates every node, cost_short_circuit the one of an evaluator skipping
+    the right child of and / or once the left child decides.
+
+    mexprsel (MexprSelTool.c) compares estimates with actual selectivity on
+    synthetic data.
+*/
+
+#define MEXPT_SEL_DEFAULT_EQ      0.1
+#define MEXPT_SEL_DEFAULT_RANGE   (1.0 / 3)
+
+struct mexpt_col_stats_ {
+
+    double null_frac;
+    double n_distinct;          /* among non null rows, 0 if unknown */
+
+    /* Equi-depth histogram : n_buckets + 1 non decreasing bounds, every bucket
+        holds 1 / n_buckets of the non null rows. 0 buckets if none */
+    int n_buckets;
+    const double *bounds;
+
+    double cost;                /* of reading the column, 0 is 1 */
+};
+
+typedef struct mexpt_sel_hint_ {
+
+    const char *opd1;
+    const char *opd2;
+    double correlation;
+} mexpt_sel_hint_t;
+
+typedef struct mexpt_sel_opts_ {
+
+    double correlation;         /* of operands without hint */
+    int n_hints;
+    const mexpt_sel_hint_t *hints;
+} mexpt_sel_opts_t;
+
+typedef struct mexpt_sel_est_ {
+
+    double selectivity;
+    double cost;
+    double cost_short_circuit;
+} mexpt_sel_est_t;
+
+/* opts NULL : independence */
+mexpt_sel_est_t
+mexpt_sel_estimate (mexpt_tree_t *tree, const mexpt_sel_opts_t *opts);
+
+/* Of the subtree rooted at node */
+mexpt_sel_est_t
+mexpt_sel_estimate_node (mexpt_node_t *node, const mexpt_sel_opts_t *opts);
+
+/* Statistics of n_values values, NaN are null. bounds are allocated, free
+    them with mexpt_col_stats_free( ) */
+void
+mexpt_col_stats_build (const double *values,
+                                    uint64_t n_values,
+                                    int n_buckets,
+                                    mexpt_col_stats_t *stats);
+
+void
+mexpt_col_stats_free (mexpt_col_stats_t *stats);
+
+#endif
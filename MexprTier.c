@@ -0,0 +1,148 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+#include "MexprEnums.h"
+#include "MExpr.h"
+#include "MexprTier.h"
+
+/* ====================x================x=================== */
+/* Tiered Handle */
+
+static uint64_t
+mexpt_tier_now_ns (void) {
+
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+mexpt_tiered_t *
+mexpt_tiered_create (mexpt_tree_t *tree, uint64_t threshold) {
+
+    mexpt_tiered_t *handle = (mexpt_tiered_t *)calloc (1, sizeof (mexpt_tiered_t));
+
+    handle->tree = tree;
+    handle->threshold = threshold;
+    return handle;
+}
+
+bool
+mexpt_tiered_promote (mexpt_tiered_t *handle) {
+
+    uint64_t start;
+    mexpt_program_t *prog;
+    bool expected = false;
+
+    if (__atomic_load_n (&handle->prog, __ATOMIC_ACQUIRE)) return true;
+    if (__atomic_load_n (&handle->not_promotable, __ATOMIC_RELAXED)) return false;
+
+    /* One compiler at a time, the others go on interpreting */
+    if (!__atomic_compare_exchange_n (&handle->promoting, &expected, true, false,
+                                                    __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return false;
+    }
+
+    if (__atomic_load_n (&handle->prog, __ATOMIC_ACQUIRE)) {
+        __atomic_store_n (&handle->promoting, false, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    start = mexpt_tier_now_ns ();
+    prog = mexpt_program_compile (handle->tree);
+
+    if (!prog) {
+        __atomic_store_n (&handle->not_promotable, true, __ATOMIC_RELAXED);
+        __atomic_store_n (&handle->promoting, false, __ATOMIC_RELEASE);
+        return false;
+    }
+
+    __atomic_store_n (&handle->compile_ns, mexpt_tier_now_ns () - start, __ATOMIC_RELAXED);
+    __atomic_store_n (&handle->promoted_at,
+                                __atomic_load_n (&handle->n_evals, __ATOMIC_RELAXED),
+                                __ATOMIC_RELAXED);
+    __atomic_add_fetch (&handle->n_promotions, 1, __ATOMIC_RELAXED);
+
+    /* Publish, evaluators loading prog with acquire see its instructions */
+    __atomic_store_n (&handle->prog, prog, __ATOMIC_RELEASE);
+    __atomic_store_n (&handle->promoting, false, __ATOMIC_RELEASE);
+    return true;
+}
+
+mexpr_var_t
+mexpt_tiered_evaluate (mexpt_tiered_t *handle) {
+
+    uint64_t n_evals;
+    mexpt_program_t *prog;
+
+    n_evals = __atomic_add_fetch (&handle->n_evals, 1, __ATOMIC_RELAXED);
+    prog = __atomic_load_n (&handle->prog, __ATOMIC_ACQUIRE);
+
+    if (prog) return mexpt_program_evaluate (prog);
+
+    if (n_evals > handle->threshold && mexpt_tiered_promote (handle)) {
+        return mexpt_program_evaluate (__atomic_load_n (&handle->prog, __ATOMIC_ACQUIRE));
+    }
+
+    /* Other evaluators share the tree, its inline caches are left alone */
+    __atomic_add_fetch (&handle->n_interp_evals, 1, __ATOMIC_RELAXED);
+    return mexpt_evaluate_shared (handle->tree->root);
+}
+
+void
+mexpt_tiered_invalidate (mexpt_tiered_t *handle) {
+
+    mexpt_program_t *prog = handle->prog;
+
+    handle->prog = NULL;
+    handle->not_promotable = false;
+    handle->n_invalidations++;
+    mexpt_program_free (prog);
+
+    /* Count towards the threshold again */
+    handle->n_evals = 0;
+    handle->n_interp_evals = 0;
+}
+
+void
+mexpt_tiered_get_stats (mexpt_tiered_t *handle, mexpt_tier_stats_t *stats) {
+
+    mexpt_program_t *prog = __atomic_load_n (&handle->prog, __ATOMIC_ACQUIRE);
+
+    stats->tier = prog ? MEXPT_TIER_BYTECODE : MEXPT_TIER_INTERP;
+    stats->n_evals = __atomic_load_n (&handle->n_evals, __ATOMIC_RELAXED);
+    stats->n_interp_evals = __atomic_load_n (&handle->n_interp_evals, __ATOMIC_RELAXED);
+    stats->promoted_at = __atomic_load_n (&handle->promoted_at, __ATOMIC_RELAXED);
+    stats->compile_ns = __atomic_load_n (&handle->compile_ns, __ATOMIC_RELAXED);
+    stats->n_promotions = __atomic_load_n (&handle->n_promotions, __ATOMIC_RELAXED);
+    stats->n_invalidations = __atomic_load_n (&handle->n_invalidations, __ATOMIC_RELAXED);
+    stats->n_instrs = prog ? prog->n_instrs : 0;
+    stats->not_promotable = __atomic_load_n (&handle->not_promotable, __ATOMIC_RELAXED);
+}
+
+void
+mexpt_tiered_print_stats (mexpt_tiered_t *handle) {
+
+    mexpt_tier_stats_t stats;
+
+    mexpt_tiered_get_stats (handle, &stats);
+
+    printf ("Tier : %s%s\n", stats.tier == MEXPT_TIER_BYTECODE ? "bytecode" : "interpreter",
+                stats.not_promotable ? " (not promotable)" : "");
+    printf ("Evaluations : %llu (interpreted %llu)\n",
+                (unsigned long long)stats.n_evals, (unsigned long long)stats.n_interp_evals);
+    printf ("Promotions : %u, last at evaluation %llu, compiled in %llu ns, %d instructions\n",
+                stats.n_promotions, (unsigned long long)stats.promoted_at,
+                (unsigned long long)stats.compile_ns, stats.n_instrs);
+    printf ("Invalidations : %u\n", stats.n_invalidations);
+}
+
+void
+mexpt_tiered_destroy (mexpt_tiered_t *handle, bool free_data_src) {
+
+    mexpt_program_free (handle->prog);
+    mexpt_tree_destroy (handle->tree, free_data_src);
+    free (handle);
+}
@@ -0,0 +1,97 @@
+#ifndef __MEXPR_TIER__
+#define __MEXPR_TIER__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "MExpr.h"
+#include "MexprProgram.h"
+
+/* Tiered Execution of Expression Trees
+
+    Appln evaluating a long tail of ad hoc expressions next to a few hot ones
+    wraps each resolved and validated tree into a handle, and calls
+    mexpt_tiered_evaluate( ) instead of mexpt_evaluate( ) :
+
+    Tier 0 (MEXPT_TIER_INTERP)   : mexpt_evaluate_shared( ) on the tree, which
+                                   leaves the inline caches of its nodes alone.
+    Tier 1 (MEXPT_TIER_BYTECODE) : once the handle was evaluated threshold times,
+                                   the tree is compiled into a mexpt_program_t,
+                                   post-order instructions with the kernels
+                                   preselected on the nodes, run by
+                                   mexpt_program_evaluate( ), see MexprProgram.h.
+
+    Exactly one evaluator compiles the program, the others keep interpreting
+    meanwhile. The program is published with an atomic store, so concurrent
+    evaluators pick it up on their next call. Neither tier writes the tree or
+    the program, hence any number of threads may evaluate one handle at the
+    same time. Results are the ones of mexpt_evaluate( ) on the same tree.
+
+    The handle owns the tree. If Appln changes the tree afterwards (installs
+    operands, concatenates trees ...), it must call mexpt_tiered_invalidate( ),
+    which demotes the handle to tier 0. Like any change of the tree, this must
+    not run concurrently with evaluators.
+*/
+
+#define MEXPT_TIER_DEFAULT_THRESHOLD    1000
+
+typedef enum mexpt_tier_ {
+
+    MEXPT_TIER_INTERP,
+    MEXPT_TIER_BYTECODE
+} mexpt_tier_t;
+
+typedef struct mexpt_tier_stats_ {
+
+    mexpt_tier_t tier;
+    uint64_t n_evals;               /* evaluations since created or invalidated */
+    uint64_t n_interp_evals;        /* evaluations in tier 0 */
+    uint64_t promoted_at;           /* n_evals when last promoted, 0 if never */
+    uint64_t compile_ns;            /* time spent in the last promotion */
+    uint32_t n_promotions;
+    uint32_t n_invalidations;
+    int n_instrs;                   /* size of the current program, 0 in tier 0 */
+    bool not_promotable;            /* empty tree, nothing to compile */
+} mexpt_tier_stats_t;
+
+typedef struct mexpt_tiered_ {
+
+    mexpt_tree_t *tree;
+    uint64_t threshold;
+
+    /* Shared by concurrent evaluators, accessed with atomic builtins only */
+    mexpt_program_t *prog;          /* NULL in tier 0 */
+    uint64_t n_evals;
+    uint64_t n_interp_evals;
+    uint64_t promoted_at;
+    uint64_t compile_ns;
+    uint32_t n_promotions;
+    uint32_t n_invalidations;
+    bool promoting;
+    bool not_promotable;
+} mexpt_tiered_t;
+
+mexpt_tiered_t *
+mexpt_tiered_create (mexpt_tree_t *tree, uint64_t threshold);
+
+mexpr_var_t
+mexpt_tiered_evaluate (mexpt_tiered_t *handle);
+
+/* Promotes right away, e.g. for expressions known to be hot */
+bool
+mexpt_tiered_promote (mexpt_tiered_t *handle);
+
+void
+mexpt_tiered_invalidate (mexpt_tiered_t *handle);
+
+void
+mexpt_tiered_get_stats (mexpt_tiered_t *handle, mexpt_tier_stats_t *stats);
+
+void
+mexpt_tiered_print_stats (mexpt_tiered_t *handle);
+
+/* Destroys the handle and its tree, no evaluator may be running */
+void
+mexpt_tiered_destroy (mexpt_tiered_t *handle, bool free_data_src);
+
+#endif
@@ -0,0 +1,344 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "UserParserL.h"
+#include "ParserMexpr.h"
+#include "MexprEnums.h"
+#include "MexprArena.h"
+#include "MexprTier.h"
+
+/* Checks tiered evaluation against mexpt_evaluate( ) and times its tiers,
+    see MexprTier.h
+
+    Usage : mexprtier [rows] [threshold] [expression ...]
+
+    Every expression (a built-in set if none is given) is evaluated on rows
+    rows (1M if not given) of double columns a, b, c, int column n and string
+    column s. Doubles are uniform in [-10, 10) with NaN mixed in, n is in
+    [-100, 100) and s one of MEXPRTIER_N_STRS strings.
+
+    Check : a handle of threshold threshold (MEXPT_TIER_DEFAULT_THRESHOLD if
+    not given) evaluates every row with mexpt_tiered_evaluate( ), so rows up
+    to the threshold run in tier 0 and the others in tier 1. Results must be
+    the ones of mexpt_evaluate( ) on the same tree : same dtype, same value,
+    doubles bitwise. The handle must have been promoted once, right after the
+    threshold.
+
+    Time : ns per row of mexpt_evaluate( ), of mexpt_tiered_evaluate( ) in
+    tier 0 (handle never promoted) and in tier 1 (handle promoted by
+    mexpt_tiered_promote( )), best of MEXPRTIER_REPEAT runs. Then ns per
+    mexpt_tiered_promote( ) of the demoted handle, best of
+    MEXPRTIER_N_PROMOTES, and the number of evaluations the promotion takes to
+    pay off. Returns 1 if any result differs.
+*/
+
+#define MEXPRTIER_N_COLS        5
+#define MEXPRTIER_N_STRS        3
+#define MEXPRTIER_REPEAT        3
+#define MEXPRTIER_N_PROMOTES    100
+
+static const char *mexprtier_col_names[MEXPRTIER_N_COLS] = {"a", "b", "c", "n", "s"};
+
+static const char *mexprtier_strs[MEXPRTIER_N_STRS] = {"abc", "abd", "b"};
+
+static const char *mexprtier_exprs[] = {
+    "a * b + c > 5",
+    "a > b and b <= c or a = c",
+    "sqr(a - b) + 1 / (c - 11)",
+    "n * 3 + 7 > n / 2 and n - 1 != 4",
+    "mmax(a, n) - mmin(b, c)",
+    "sin(a) * cos(b) + pow(c, 2) > n",
+    "s = 'abc' or s + 'd' = 'bd'",
+    "s + 'x'",
+    NULL
+};
+
+/* Row of column values */
+typedef struct mexprtier_row_ {
+
+    double d[3];
+    int64_t n;
+    int s;
+} mexprtier_row_t;
+
+/* Row read by operand callbacks */
+static const mexprtier_row_t *mexprtier_row;
+
+static double
+mexprtier_now (void) {
+
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static mexpr_var_t
+mexprtier_col_compute (void *data_src) {
+
+    mexpr_var_t res;
+    int col = *(int *)data_src;
+
+    switch (col) {
+
+        case 3:
+            res.dtype = MEXPR_DTYPE_INT;
+            res.u.int_val = mexprtier_row->n;
+            return res;
+        case 4:
+            return mexpr_var_string ((unsigned char *)mexprtier_strs[mexprtier_row->s],
+                                                strlen (mexprtier_strs[mexprtier_row->s]));
+        default:
+            res.dtype = MEXPR_DTYPE_DOUBLE;
+            res.u.d_val = mexprtier_row->d[col];
+            return res;
+    }
+}
+
+static bool
+mexprtier_same (mexpr_var_t x, mexpr_var_t y) {
+
+    if (x.dtype != y.dtype) return false;
+
+    switch (x.dtype) {
+
+        case MEXPR_DTYPE_INT:
+            return x.u.int_val == y.u.int_val;
+        case MEXPR_DTYPE_DOUBLE:
+            if (x.u.d_val != x.u.d_val || y.u.d_val != y.u.d_val) {
+                return x.u.d_val != x.u.d_val && y.u.d_val != y.u.d_val;
+            }
+            return memcmp (&x.u.d_val, &y.u.d_val, sizeof (double)) == 0;
+        case MEXPR_DTYPE_STRING:
+            return x.str_len == y.str_len &&
+                        memcmp (x.u.str_val, y.u.str_val, x.str_len) == 0;
+        case MEXPR_DTYPE_BOOL:
+            return x.u.b_val == y.u.b_val;
+        default:
+            return true;
+    }
+}
+
+/* Operands own their data_src : mexpt_optimize( ) frees the ones of the
+    subtrees it folds */
+static mexpt_tree_t *
+mexprtier_build (const char *expr) {
+
+    int i;
+    mexpt_tree_t *tree;
+    mexpt_node_t *opd_node = NULL;
+
+    if (strlen (expr) >= MAX_STRING_SIZE) {
+        printf ("Error : Expression %s is too long\n", expr);
+        return NULL;
+    }
+
+    /* Parser rewinds by rescanning lex_buffer */
+    strcpy ((char *)lex_buffer, expr);
+    lex_set_scan_buffer ((const char *)lex_buffer);
+
+    tree = Parser_Mexpr_Condition_build_expression_tree ();
+    if (!tree) {
+        tree = Parser_Mexpr_build_math_expression_tree ();
+    }
+    Parser_stack_reset ();
+
+    if (!tree) {
+        printf ("Error : Exp Tree could not built for %s\n", expr);
+        return NULL;
+    }
+
+    mexpt_iterate_operands_begin (tree, opd_node) {
+
+        for (i = 0; i < MEXPRTIER_N_COLS; i++) {
+            if (strcmp ((char *)opd_node->u.opd_node.opd_value.variable_name,
+                            mexprtier_col_names[i]) == 0) break;
+        }
+        if (i == MEXPRTIER_N_COLS) {
+            printf ("Error : Unknown column %s\n",
+                        (char *)opd_node->u.opd_node.opd_value.variable_name);
+            mexpt_tree_destroy (tree, true);
+            return NULL;
+        }
+
+        opd_node->u.opd_node.is_numeric = i != 4;
+        mexpt_tree_install_operand_properties (opd_node, malloc (sizeof (int)),
+                                                                     mexprtier_col_compute);
+        *(int *)opd_node->u.opd_node.data_src = i;
+        if (i == 3) mexpt_tree_set_operand_dtype (opd_node, MEXPR_DTYPE_INT);
+        if (i == 4) mexpt_tree_set_operand_dtype (opd_node, MEXPR_DTYPE_STRING);
+
+    } mexpt_iterate_operands_end (tree, opd_node);
+
+    if (!mexpr_validate_expression_tree (tree)) {
+        printf ("Error : %s is not a valid expression\n", expr);
+        mexpt_tree_destroy (tree, true);
+        return NULL;
+    }
+    mexpt_optimize (tree->root);
+    return tree;
+}
+
+/* Rows of tiered evaluation of handle which differ from mexpt_evaluate( ) of
+    its tree. String results of the reference live in arena, the ones of the
+    handle in the thread's arena */
+static uint64_t
+mexprtier_check (mexpt_tiered_t *handle,
+                           const mexprtier_row_t *rows,
+                           uint64_t n_rows,
+                           mexpr_arena_t *arena) {
+
+    uint64_t row, n_mismatches = 0;
+    mexpr_var_t ref, res;
+
+    for (row = 0; row < n_rows; row++) {
+
+        mexprtier_row = &rows[row];
+        mexpr_arena_reset (arena);
+        ref = mexpt_evaluate_in (handle->tree->root, arena);
+        res = mexpt_tiered_evaluate (handle);
+        if (!mexprtier_same (ref, res)) n_mismatches++;
+    }
+    return n_mismatches;
+}
+
+/* Best ns per row */
+static double
+mexprtier_time (mexpt_tiered_t *handle,
+                          const mexprtier_row_t *rows,
+                          uint64_t n_rows,
+                          bool tiered) {
+
+    int r;
+    uint64_t row;
+    double start, t_best = INFINITY;
+
+    for (r = 0; r < MEXPRTIER_REPEAT; r++) {
+
+        start = mexprtier_now ();
+        for (row = 0; row < n_rows; row++) {
+            mexprtier_row = &rows[row];
+            if (tiered) mexpt_tiered_evaluate (handle);
+            else mexpt_evaluate (handle->tree->root);
+        }
+        t_best = fmin (t_best, mexprtier_now () - start);
+    }
+    return t_best / n_rows * 1e9;
+}
+
+/* Returns false if results differ */
+static bool
+mexprtier_expr (const char *expr,
+                          const mexprtier_row_t *rows,
+                          uint64_t n_rows,
+                          uint64_t threshold) {
+
+    int i;
+    uint64_t n_mismatches, n_interp;
+    double start, t_interp, t_tier0, t_tier1, t_promote;
+    mexpt_tree_t *tree;
+    mexpt_tiered_t *checked, *timed;
+    mexpt_tier_stats_t stats;
+    mexpr_arena_t arena;
+
+    tree = mexprtier_build (expr);
+    if (!tree) return true;
+    checked = mexpt_tiered_create (tree, threshold);
+
+    tree = mexprtier_build (expr);
+    if (!tree) {
+        mexpt_tiered_destroy (checked, true);
+        return true;
+    }
+    timed = mexpt_tiered_create (tree, UINT64_MAX);
+
+    /* Check */
+    mexpr_arena_init (&arena);
+    n_mismatches = mexprtier_check (checked, rows, n_rows, &arena);
+    mexpr_arena_free (&arena);
+
+    mexpt_tiered_get_stats (checked, &stats);
+    n_interp = n_rows < threshold ? n_rows : threshold;
+    if (stats.n_interp_evals != n_interp ||
+            (n_rows > threshold &&
+                (stats.n_promotions != 1 || stats.promoted_at != threshold + 1))) {
+        printf ("Error : %s interpreted %llu rows, promoted %u times at %llu\n", expr,
+                    (unsigned long long)stats.n_interp_evals, stats.n_promotions,
+                    (unsigned long long)stats.promoted_at);
+        n_mismatches++;
+    }
+
+    /* Time */
+    t_interp = mexprtier_time (timed, rows, n_rows, false);
+    t_tier0 = mexprtier_time (timed, rows, n_rows, true);
+
+    t_promote = INFINITY;
+    for (i = 0; i < MEXPRTIER_N_PROMOTES; i++) {
+        mexpt_tiered_invalidate (timed);
+        start = mexprtier_now ();
+        mexpt_tiered_promote (timed);
+        t_promote = fmin (t_promote, mexprtier_now () - start);
+    }
+    t_tier1 = mexprtier_time (timed, rows, n_rows, true);
+    mexpt_tiered_get_stats (timed, &stats);
+
+    printf ("%-36s  %10llu  %7.1f  %7.1f  %7.1f  %6.2f  %8.0f  %3d  ", expr,
+                (unsigned long long)n_mismatches, t_interp, t_tier0, t_tier1,
+                t_tier0 / t_tier1, t_promote * 1e9, stats.n_instrs);
+    if (t_tier1 < t_tier0) printf ("%10.0f\n", t_promote * 1e9 / (t_tier0 - t_tier1));
+    else printf ("%10s\n", "never");
+
+    mexpt_tiered_destroy (checked, true);
+    mexpt_tiered_destroy (timed, true);
+    return n_mismatches == 0;
+}
+
+int
+main (int argc, char **argv) {
+
+    int i;
+    bool ok = true;
+    uint64_t k, n_rows = 1024 * 1024;
+    uint64_t threshold = MEXPT_TIER_DEFAULT_THRESHOLD;
+    mexprtier_row_t *rows;
+
+    if (argc > 1) n_rows = strtoull (argv[1], NULL, 10);
+    if (argc > 2) threshold = strtoull (argv[2], NULL, 10);
+    if (!n_rows) n_rows = 1;
+
+    parse_init ();
+    srand (1);
+
+    rows = (mexprtier_row_t *)malloc (n_rows * sizeof (mexprtier_row_t));
+    for (k = 0; k < n_rows; k++) {
+
+        for (i = 0; i < 3; i++) {
+            rows[k].d[i] = rand () % 16 == 0 ? NAN : (double)rand () / RAND_MAX * 20 - 10;
+        }
+        rows[k].n = rand () % 200 - 100;
+        rows[k].s = rand () % MEXPRTIER_N_STRS;
+    }
+
+    printf ("%llu rows, threshold %llu, ns per row, ns per promotion\n",
+                (unsigned long long)n_rows, (unsigned long long)threshold);
+    printf ("%-36s  %10s  %7s  %7s  %7s  %6s  %8s  %3s  %10s\n", "expression", "mismatches",
+                "interp", "tier 0", "tier 1", "x", "promote", "ins", "break even");
+
+    if (argc > 3) {
+        for (i = 3; i < argc; i++) {
+            ok = mexprtier_expr (argv[i], rows, n_rows, threshold) && ok;
+        }
+    }
+    else {
+        for (i = 0; mexprtier_exprs[i]; i++) {
+            ok = mexprtier_expr (mexprtier_exprs[i], rows, n_rows, threshold) && ok;
+        }
+    }
+
+    if (!ok) printf ("Error : Tiered results differ from mexpt_evaluate\n");
+
+    free (rows);
+    return ok ? 0 : 1;
+}
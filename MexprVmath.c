@@ -0,0 +1,318 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "MexprVmath.h"
+
+/* Two lanes, GCC vector extensions : one SSE2 or NEON register. Wider
+    vectors are split into scalar compares on targets without AVX */
+typedef double mexpr_v2df_t __attribute__ ((vector_size (16)));
+typedef int64_t mexpr_v2di_t __attribute__ ((vector_size (16)));
+
+#define VLEN    2
+
+/* Adding 1.5 * 2^52 rounds to integer, and leaves the integer in the low
+    mantissa bits */
+#define VMATH_SHIFTER       6755399441055744.0
+
+#define VMATH_TWO_OVER_PI   6.36619772367581382433e-01
+#define VMATH_PIO2_1        1.57079632673412561417e+00    /* first 33 bits of pi/2 */
+#define VMATH_PIO2_2        6.07710050630396597660e-11    /* next 33 bits */
+#define VMATH_PIO2_2T       2.02226624879595063154e-21    /* pi/2 - (PIO2_1 + PIO2_2) */
+#define VMATH_PIO2_3        2.02226624871116645580e-21    /* next 33 bits */
+#define VMATH_PIO2_3T       8.47842766036889956997e-32    /* pi/2 - (PIO2_1 + .. + PIO2_3) */
+
+/* fdlibm __kernel_sin, __kernel_cos */
+#define VMATH_S1   -1.66666666666666324348e-01
+#define VMATH_S2    8.33333333332248946124e-03
+#define VMATH_S3   -1.98412698298579493134e-04
+#define VMATH_S4    2.75573137070700676789e-06
+#define VMATH_S5   -2.50507602534068634195e-08
+#define VMATH_S6    1.58969099521155010221e-10
+
+#define VMATH_C1    4.16666666666666019037e-02
+#define VMATH_C2   -1.38888888888741095749e-03
+#define VMATH_C3    2.48015872894767294178e-05
+#define VMATH_C4   -2.75573143513906633035e-07
+#define VMATH_C5    2.08757232129817482790e-09
+#define VMATH_C6   -1.13596475577881948265e-11
+
+/* Below this, sin (x) rounds to x and cos (x) to 1 */
+#define VMATH_TRIG_TINY     3.7252902984e-09            /* 2^-28 */
+
+static inline mexpr_v2df_t
+mexpr_vmath_load (const double *x, int n) {
+
+    mexpr_v2df_t v = {0, 0};
+
+    if (n == VLEN) memcpy (&v, x, sizeof (v));
+    else memcpy (&v, x, n * sizeof (double));
+    return v;
+}
+
+static inline void
+mexpr_vmath_store (double *y, mexpr_v2df_t v, int n) {
+
+    if (n == VLEN) memcpy (y, &v, sizeof (v));
+    else memcpy (y, &v, n * sizeof (double));
+}
+
+static inline mexpr_v2df_t
+mexpr_vmath_select (mexpr_v2di_t mask, mexpr_v2df_t a, mexpr_v2df_t b) {
+
+    return (mexpr_v2df_t)(((mexpr_v2di_t)a & mask) | ((mexpr_v2di_t)b & ~mask));
+}
+
+static inline mexpr_v2df_t
+mexpr_vmath_abs (mexpr_v2df_t x) {
+
+    return (mexpr_v2df_t)((mexpr_v2di_t)x & INT64_MAX);
+}
+
+/* ====================x================x=================== */
+/* sin, cos */
+
+static inline void
+mexpr_vmath_sincos4 (mexpr_v2df_t x, mexpr_v2df_t *s, mexpr_v2df_t *c) {
+
+    mexpr_v2df_t k, r, t, w, y0, y1, z, v, ps, pc, hz, ax;
+    mexpr_v2di_t q, swap, tiny;
+
+    /* x = k * pi/2 + y0 + y1, |y0| <= pi/4 : fdlibm __ieee754_rem_pio2 medium
+        case, all three steps. k * PIO2_1, k * PIO2_2, k * PIO2_3 are exact
+        for |k| < 2^20 */
+    k = x * VMATH_TWO_OVER_PI + VMATH_SHIFTER;
+    q = (mexpr_v2di_t)k;
+    k = k - VMATH_SHIFTER;
+
+    r = x - k * VMATH_PIO2_1;
+
+    t = r;
+    w = k * VMATH_PIO2_2;
+    r = t - w;
+    w = k * VMATH_PIO2_2T - ((t - r) - w);
+
+    t = r;
+    w = k * VMATH_PIO2_3;
+    r = t - w;
+    w = k * VMATH_PIO2_3T - ((t - r) - w);
+
+    y0 = r - w;
+    y1 = (r - y0) - w;
+
+    /* fdlibm __kernel_sin (y0, y1, 1), __kernel_cos (y0, y1) */
+    z = y0 * y0;
+    v = z * y0;
+    ps = y0 - ((z * (0.5 * y1 - v * (VMATH_S2 + z * (VMATH_S3 + z * (VMATH_S4 +
+                z * (VMATH_S5 + z * VMATH_S6))))) - y1) - v * VMATH_S1);
+
+    hz = 0.5 * z;
+    w = 1.0 - hz;
+    pc = w + (((1.0 - w) - hz) + (z * z * (VMATH_C1 + z * (VMATH_C2 + z * (VMATH_C3 +
+                z * (VMATH_C4 + z * (VMATH_C5 + z * VMATH_C6))))) - y0 * y1));
+
+    /* Quadrant k mod 4 : sin is ps, pc, -ps, -pc, cos is pc, -ps, -pc, ps */
+    swap = (q & 1) != 0;
+    *s = mexpr_vmath_select (swap, pc, ps);
+    *c = mexpr_vmath_select (swap, ps, pc);
+    *s = (mexpr_v2df_t)((mexpr_v2di_t)*s ^ ((q & 2) << 62));
+    *c = (mexpr_v2df_t)((mexpr_v2di_t)*c ^ (((q + 1) & 2) << 62));
+
+    /* Keeps the sign of -0.0 */
+    ax = mexpr_vmath_abs (x);
+    tiny = ax < VMATH_TRIG_TINY;
+    *s = mexpr_vmath_select (tiny, x, *s);
+    *c = mexpr_vmath_select (tiny, (mexpr_v2df_t){1.0, 1.0}, *c);
+}
+
+/* Lanes out of the reduction range, infinite or NaN go to libm */
+static inline bool
+mexpr_vmath_trig_in_range (mexpr_v2df_t x) {
+
+    mexpr_v2di_t in = mexpr_vmath_abs (x) <= MEXPR_VMATH_TRIG_MAX;
+
+    return (in[0] & in[1]) != 0;
+}
+
+void
+mexpr_vmath_sin (const double *x, double *y, int n) {
+
+    int i, j, m;
+    mexpr_v2df_t vx, vs, vc;
+
+    for (i = 0; i < n; i += VLEN) {
+
+        m = n - i < VLEN ? n - i : VLEN;
+        vx = mexpr_vmath_load (x + i, m);
+        mexpr_vmath_sincos4 (vx, &vs, &vc);
+
+        if (!mexpr_vmath_trig_in_range (vx)) {
+            for (j = 0; j < m; j++) {
+                if (!(fabs (vx[j]) <= MEXPR_VMATH_TRIG_MAX)) vs[j] = sin (vx[j]);
+            }
+        }
+        mexpr_vmath_store (y + i, vs, m);
+    }
+}
+
+void
+mexpr_vmath_cos (const double *x, double *y, int n) {
+
+    int i, j, m;
+    mexpr_v2df_t vx, vs, vc;
+
+    for (i = 0; i < n; i += VLEN) {
+
+        m = n - i < VLEN ? n - i : VLEN;
+        vx = mexpr_vmath_load (x + i, m);
+        mexpr_vmath_sincos4 (vx, &vs, &vc);
+
+        if (!mexpr_vmath_trig_in_range (vx)) {
+            for (j = 0; j < m; j++) {
+                if (!(fabs (vx[j]) <= MEXPR_VMATH_TRIG_MAX)) vc[j] = cos (vx[j]);
+            }
+        }
+        mexpr_vmath_store (y + i, vc, m);
+    }
+}
+
+void
+mexpr_vmath_sincos (const double *x, double *s, double *c, int n) {
+
+    int i, j, m;
+    mexpr_v2df_t vx, vs, vc;
+
+    for (i = 0; i < n; i += VLEN) {
+
+        m = n - i < VLEN ? n - i : VLEN;
+        vx = mexpr_vmath_load (x + i, m);
+        mexpr_vmath_sincos4 (vx, &vs, &vc);
+
+        if (!mexpr_vmath_trig_in_range (vx)) {
+            for (j = 0; j < m; j++) {
+                if (fabs (vx[j]) <= MEXPR_VMATH_TRIG_MAX) continue;
+                vs[j] = sin (vx[j]);
+                vc[j] = cos (vx[j]);
+            }
+        }
+        mexpr_vmath_store (s + i, vs, m);
+        mexpr_vmath_store (c + i, vc, m);
+    }
+}
+
+/* ====================x================x=================== */
+/* sqrt */
+
+void
+mexpr_vmath_sqrt (const double *x, double *y, int n) {
+
+    int i = 0;
+
+#if defined(__SSE2__)
+    for (; i + 2 <= n; i += 2) {
+        _mm_storeu_pd (y + i, _mm_sqrt_pd (_mm_loadu_pd (x + i)));
+    }
+#endif
+    for (; i < n; i++) {
+        y[i] = sqrt (x[i]);
+    }
+}
+
+/* ====================x================x=================== */
+/* pow */
+
+/* x ^ e for |e| <= MEXPR_VMATH_POW_INT_MAX by repeated squaring.
+    Lanes whose result is zero, subnormal, infinite or NaN may have been rounded
+    more than once, libm knows better */
+static inline mexpr_v2di_t
+mexpr_vmath_pow_normal (mexpr_v2df_t r) {
+
+    mexpr_v2df_t ar = mexpr_vmath_abs (r);
+
+    return (ar >= DBL_MIN) & (ar <= DBL_MAX);
+}
+
+static inline bool
+mexpr_vmath_all (mexpr_v2di_t mask, int m) {
+
+    int j;
+
+    for (j = 0; j < m; j++) {
+        if (!mask[j]) return false;
+    }
+    return true;
+}
+
+void
+mexpr_vmath_pow (const double *x, const double *e, double *y, int n) {
+
+    int i, j, m;
+    mexpr_v2df_t vx, ve, ae, x2, acc, one = {1.0, 1.0};
+    mexpr_v2di_t fast;
+
+    for (i = 0; i < n; i += VLEN) {
+
+        m = n - i < VLEN ? n - i : VLEN;
+        vx = mexpr_vmath_load (x + i, m);
+        ve = mexpr_vmath_load (e + i, m);
+
+        /* Same products as mexpr_vmath_powi( ), lane by lane */
+        ae = mexpr_vmath_abs (ve);
+        x2 = vx * vx;
+        acc = mexpr_vmath_select (ae == 1.0, vx, one);
+        acc = mexpr_vmath_select (ae == 2.0, x2, acc);
+        acc = mexpr_vmath_select (ae == 3.0, x2 * vx, acc);
+        acc = mexpr_vmath_select (ae == 4.0, x2 * x2, acc);
+        acc = mexpr_vmath_select (ve < 0, one / acc, acc);
+
+        fast = (ae == 0.0) | (ae == 1.0) | (ae == 2.0) | (ae == 3.0) | (ae == 4.0);
+        fast &= mexpr_vmath_pow_normal (acc);
+
+        if (!mexpr_vmath_all (fast, m)) {
+            for (j = 0; j < m; j++) {
+                if (!fast[j]) acc[j] = pow (vx[j], ve[j]);
+            }
+        }
+        mexpr_vmath_store (y + i, acc, m);
+    }
+}
+
+void
+mexpr_vmath_powi (const double *x, int e, double *y, int n) {
+
+    int i, j, m;
+    mexpr_v2df_t vx, acc;
+    mexpr_v2di_t fast;
+
+    if (e < -MEXPR_VMATH_POW_INT_MAX || e > MEXPR_VMATH_POW_INT_MAX) {
+        for (i = 0; i < n; i++) y[i] = pow (x[i], (double)e);
+        return;
+    }
+
+    for (i = 0; i < n; i += VLEN) {
+
+        m = n - i < VLEN ? n - i : VLEN;
+        vx = mexpr_vmath_load (x + i, m);
+
+        switch (e < 0 ? -e : e) {
+            case 0: acc = (mexpr_v2df_t){1.0, 1.0}; break;
+            case 1: acc = vx; break;
+            case 2: acc = vx * vx; break;
+            case 3: acc = vx * vx * vx; break;
+            case 4: acc = vx * vx; acc = acc * acc; break;
+        }
+        if (e < 0) acc = 1.0 / acc;
+        fast = mexpr_vmath_pow_normal (acc);
+
+        if (!mexpr_vmath_all (fast, m)) {
+            for (j = 0; j < m; j++) {
+                if (!fast[j]) acc[j] = pow (vx[j], (double)e);
+            }
+        }
+        mexpr_vmath_store (y + i, acc, m);
+    }
+}
@@ -0,0 +1,393 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "MexprEnums.h"
+#include "MExpr.h"
+#include "MexprVmath.h"
+
+/* Measures accuracy and throughput of MexprVmath kernels, see MexprVmath.h
+
+    Usage : mexprvmath [values]
+
+    For every kernel and argument range, values random arguments (1M if not
+    given) are computed by the kernel and by libm, and both are compared with
+    the long double result : prints max and mean error in ULP of the exact
+    result, next to the bound MexprVmath.h documents. pow with non integer
+    exponents must be equal to libm, mismatches are counted instead.
+
+    Then prints throughput of the kernels, of the scalar MexprDb operators
+    (mexpt_compute( ), one value at a time as mexpt_evaluate( ) does) and of a
+    plain libm loop, best of MEXPRVMATH_REPEAT runs.
+
+    Returns 1 if an error is above its bound.
+*/
+
+#define MEXPRVMATH_REPEAT   3
+
+typedef enum {
+
+    MEXPRVMATH_SIN,
+    MEXPRVMATH_COS,
+    MEXPRVMATH_SINCOS,
+    MEXPRVMATH_SQRT,
+    MEXPRVMATH_POW,
+    MEXPRVMATH_POWI
+} mexprvmath_fn_t;
+
+typedef struct mexprvmath_case_ {
+
+    mexprvmath_fn_t fn;
+    int e;                  /* exponent of MEXPRVMATH_POWI */
+    double lo, hi;          /* arguments are uniform in [lo, hi] */
+    double bound;           /* max ULP, < 0 : equal to libm */
+    bool timed;
+} mexprvmath_case_t;
+
+static const mexprvmath_case_t mexprvmath_cases[] = {
+
+    {MEXPRVMATH_SIN,     0, -1, 1, 1.06, false},
+    {MEXPRVMATH_SIN,     0, -MEXPR_VMATH_TRIG_MAX, MEXPR_VMATH_TRIG_MAX, 1.51, true},
+    {MEXPRVMATH_COS,     0, -1, 1, 1.06, false},
+    {MEXPRVMATH_COS,     0, -MEXPR_VMATH_TRIG_MAX, MEXPR_VMATH_TRIG_MAX, 1.51, true},
+    {MEXPRVMATH_SINCOS,  0, -1, 1, 1.06, false},
+    {MEXPRVMATH_SINCOS,  0, -MEXPR_VMATH_TRIG_MAX, MEXPR_VMATH_TRIG_MAX, 1.51, true},
+    {MEXPRVMATH_SQRT,    0, 0, 1e6, 0.5, true},
+    {MEXPRVMATH_POWI,   -4, -100, 100, 3.5, false},
+    {MEXPRVMATH_POWI,   -3, -100, 100, 2.5, false},
+    {MEXPRVMATH_POWI,   -2, -100, 100, 1.5, false},
+    {MEXPRVMATH_POWI,   -1, -100, 100, 0.5, false},
+    {MEXPRVMATH_POWI,    0, -100, 100, 0, false},
+    {MEXPRVMATH_POWI,    1, -100, 100, 0, false},
+    {MEXPRVMATH_POWI,    2, -100, 100, 0.5, true},
+    {MEXPRVMATH_POWI,    3, -100, 100, 1.3, true},
+    {MEXPRVMATH_POWI,    4, -100, 100, 1.9, false},
+    {MEXPRVMATH_POW,     0, 0, 100, -1, true},
+};
+
+#define MEXPRVMATH_N_CASES  ((int)(sizeof (mexprvmath_cases) / sizeof (mexprvmath_cases[0])))
+
+static double
+mexprvmath_now (void) {
+
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void
+mexprvmath_name (const mexprvmath_case_t *cs, char *name, size_t size) {
+
+    static const char *names[] = {"sin", "cos", "sincos", "sqrt", "pow", "pow"};
+
+    if (cs->fn == MEXPRVMATH_POWI) {
+        snprintf (name, size, "pow e=%d", cs->e);
+        return;
+    }
+    snprintf (name, size, "%s", names[cs->fn]);
+}
+
+/* Error of y in ULP of the exact result ref */
+static double
+mexprvmath_ulp_error (double y, long double ref) {
+
+    int exp;
+
+    if (y != y || ref != ref) return (y != y && ref != ref) ? 0 : INFINITY;
+    if ((long double)y == ref) return 0;
+
+    /* ULP of the binade of ref, ref not rounded to double first */
+    frexpl (ref, &exp);
+    if (exp - 53 < -1074) exp = -1074 + 53;
+    return (double)(fabsl ((long double)y - ref) / ldexpl (1.0L, exp - 53));
+}
+
+static long double
+mexprvmath_ref (const mexprvmath_case_t *cs, double x, double e, bool cos_out) {
+
+    switch (cs->fn) {
+
+        case MEXPRVMATH_SIN:
+            return sinl (x);
+        case MEXPRVMATH_COS:
+            return cosl (x);
+        case MEXPRVMATH_SINCOS:
+            return cos_out ? cosl (x) : sinl (x);
+        case MEXPRVMATH_SQRT:
+            return sqrtl (x);
+        case MEXPRVMATH_POW:
+            return powl (x, e);
+        case MEXPRVMATH_POWI:
+            return powl (x, cs->e);
+    }
+    return 0;
+}
+
+static double
+mexprvmath_libm (const mexprvmath_case_t *cs, double x, double e, bool cos_out) {
+
+    switch (cs->fn) {
+
+        case MEXPRVMATH_SIN:
+            return sin (x);
+        case MEXPRVMATH_COS:
+            return cos (x);
+        case MEXPRVMATH_SINCOS:
+            return cos_out ? cos (x) : sin (x);
+        case MEXPRVMATH_SQRT:
+            return sqrt (x);
+        case MEXPRVMATH_POW:
+            return pow (x, e);
+        case MEXPRVMATH_POWI:
+            return pow (x, cs->e);
+    }
+    return 0;
+}
+
+static void
+mexprvmath_kernel (const mexprvmath_case_t *cs,
+                                const double *x,
+                                const double *e,
+                                double *y,
+                                double *y2,
+                                int n) {
+
+    switch (cs->fn) {
+
+        case MEXPRVMATH_SIN:
+            mexpr_vmath_sin (x, y, n);
+            break;
+        case MEXPRVMATH_COS:
+            mexpr_vmath_cos (x, y, n);
+            break;
+        case MEXPRVMATH_SINCOS:
+            mexpr_vmath_sincos (x, y, y2, n);
+            break;
+        case MEXPRVMATH_SQRT:
+            mexpr_vmath_sqrt (x, y, n);
+            break;
+        case MEXPRVMATH_POW:
+            mexpr_vmath_pow (x, e, y, n);
+            break;
+        case MEXPRVMATH_POWI:
+            mexpr_vmath_powi (x, cs->e, y, n);
+            break;
+    }
+}
+
+/* Scalar MexprDb operators, as mexpt_evaluate( ) calls them */
+static void
+mexprvmath_db (const mexprvmath_case_t *cs,
+                        const double *x,
+                        const double *e,
+                        double *y,
+                        double *y2,
+                        int n) {
+
+    int i;
+    mexpr_var_t l, r;
+
+    l.dtype = MEXPR_DTYPE_DOUBLE;
+    r.dtype = MEXPR_DTYPE_INT;
+    r.u.int_val = cs->e;
+
+    for (i = 0; i < n; i++) {
+
+        l.u.d_val = x[i];
+
+        switch (cs->fn) {
+
+            case MEXPRVMATH_SIN:
+                y[i] = mexpt_compute (MATH_SIN, l, l).u.d_val;
+                break;
+            case MEXPRVMATH_COS:
+                y[i] = mexpt_compute (MATH_COS, l, l).u.d_val;
+                break;
+            case MEXPRVMATH_SINCOS:
+                y[i] = mexpt_compute (MATH_SIN, l, l).u.d_val;
+                y2[i] = mexpt_compute (MATH_COS, l, l).u.d_val;
+                break;
+            case MEXPRVMATH_SQRT:
+                y[i] = mexpt_compute (MATH_SQRT, l, l).u.d_val;
+                break;
+            case MEXPRVMATH_POW:
+                r.dtype = MEXPR_DTYPE_DOUBLE;
+                r.u.d_val = e[i];
+                y[i] = mexpt_compute (MATH_POW, l, r).u.d_val;
+                break;
+            case MEXPRVMATH_POWI:
+                y[i] = mexpt_compute (MATH_POW, l, r).u.d_val;
+                break;
+        }
+    }
+}
+
+static void
+mexprvmath_libm_loop (const mexprvmath_case_t *cs,
+                                    const double *x,
+                                    const double *e,
+                                    double *y,
+                                    double *y2,
+                                    int n) {
+
+    int i;
+
+    for (i = 0; i < n; i++) {
+        y[i] = mexprvmath_libm (cs, x[i], e[i], false);
+        if (cs->fn == MEXPRVMATH_SINCOS) y2[i] = cos (x[i]);
+    }
+}
+
+static void
+mexprvmath_generate (const mexprvmath_case_t *cs, double *x, double *e, int n) {
+
+    int i;
+
+    for (i = 0; i < n; i++) {
+        x[i] = cs->lo + (cs->hi - cs->lo) * ((double)rand () / RAND_MAX);
+        e[i] = -4 + 8 * ((double)rand () / RAND_MAX);
+    }
+}
+
+/* Returns false if an error is above the bound */
+static bool
+mexprvmath_accuracy (const mexprvmath_case_t *cs,
+                                  double *x,
+                                  double *e,
+                                  double *y,
+                                  double *y2,
+                                  int n) {
+
+    int i, k;
+    uint64_t n_diff = 0;
+    double err, err_max = 0, err_sum = 0, libm, libm_max = 0;
+    double *out;
+    char name[32], range[48];
+
+    mexprvmath_generate (cs, x, e, n);
+    mexprvmath_kernel (cs, x, e, y, y2, n);
+
+    for (k = 0; k < (cs->fn == MEXPRVMATH_SINCOS ? 2 : 1); k++) {
+
+        out = k ? y2 : y;
+
+        for (i = 0; i < n; i++) {
+
+            if (cs->bound < 0) {
+                libm = mexprvmath_libm (cs, x[i], e[i], k);
+                if (memcmp (&out[i], &libm, sizeof (double)) != 0) n_diff++;
+                continue;
+            }
+
+            err = mexprvmath_ulp_error (out[i], mexprvmath_ref (cs, x[i], e[i], k));
+            err_sum += err;
+            if (err > err_max) err_max = err;
+
+            err = mexprvmath_ulp_error (mexprvmath_libm (cs, x[i], e[i], k),
+                                                      mexprvmath_ref (cs, x[i], e[i], k));
+            if (err > libm_max) libm_max = err;
+        }
+    }
+
+    mexprvmath_name (cs, name, sizeof (name));
+    snprintf (range, sizeof (range), "[%g, %g]", cs->lo, cs->hi);
+
+    if (cs->bound < 0) {
+        printf ("%-10s  %-20s  %llu values differ from libm\n", name, range,
+                    (unsigned long long)n_diff);
+        return n_diff == 0;
+    }
+
+    printf ("%-10s  %-20s  %8.3f  %8.4f  %6.2f  %8.3f\n", name, range, err_max,
+                err_sum / n / (cs->fn == MEXPRVMATH_SINCOS ? 2 : 1), cs->bound, libm_max);
+
+    if (err_max > cs->bound) {
+        printf ("Error : %s on %s is %.3f ULP off, above its bound of %.2f ULP\n",
+                    name, range, err_max, cs->bound);
+        return false;
+    }
+    return true;
+}
+
+static void
+mexprvmath_throughput (const mexprvmath_case_t *cs,
+                                     double *x,
+                                     double *e,
+                                     double *y,
+                                     double *y2,
+                                     int n) {
+
+    int r;
+    double start, t_db, t_libm, t_vmath;
+    char name[32];
+
+    mexprvmath_generate (cs, x, e, n);
+    t_db = t_libm = t_vmath = INFINITY;
+
+    for (r = 0; r < MEXPRVMATH_REPEAT; r++) {
+
+        start = mexprvmath_now ();
+        mexprvmath_db (cs, x, e, y, y2, n);
+        t_db = fmin (t_db, mexprvmath_now () - start);
+
+        start = mexprvmath_now ();
+        mexprvmath_libm_loop (cs, x, e, y, y2, n);
+        t_libm = fmin (t_libm, mexprvmath_now () - start);
+
+        start = mexprvmath_now ();
+        mexprvmath_kernel (cs, x, e, y, y2, n);
+        t_vmath = fmin (t_vmath, mexprvmath_now () - start);
+    }
+
+    mexprvmath_name (cs, name, sizeof (name));
+    printf ("%-10s  %12.1f  %12.1f  %12.1f  %8.2f  %8.2f\n", name,
+                n / t_db / 1e6, n / t_libm / 1e6, n / t_vmath / 1e6,
+                t_db / t_vmath, t_libm / t_vmath);
+}
+
+int
+main (int argc, char **argv) {
+
+    int i, n = 1024 * 1024;
+    bool ok = true;
+    double *x, *e, *y, *y2;
+
+    if (argc > 2) {
+        printf ("Usage : %s [values]\n", argv[0]);
+        return 1;
+    }
+    if (argc > 1) n = atoi (argv[1]);
+    if (n <= 0) n = 1;
+
+    srand (1);
+    x = (double *)malloc (n * sizeof (double));
+    e = (double *)malloc (n * sizeof (double));
+    y = (double *)malloc (n * sizeof (double));
+    y2 = (double *)malloc (n * sizeof (double));
+
+    printf ("Accuracy, %d values, ULP\n", n);
+    printf ("%-10s  %-20s  %8s  %8s  %6s  %8s\n", "kernel", "arguments",
+                "max", "mean", "bound", "libm max");
+
+    for (i = 0; i < MEXPRVMATH_N_CASES; i++) {
+        ok = mexprvmath_accuracy (&mexprvmath_cases[i], x, e, y, y2, n) && ok;
+    }
+
+    printf ("\nThroughput, %d values, Mvalues/s\n", n);
+    printf ("%-10s  %12s  %12s  %12s  %8s  %8s\n", "kernel", "MexprDb",
+                "libm", "MexprVmath", "x MexprDb", "x libm");
+
+    for (i = 0; i < MEXPRVMATH_N_CASES; i++) {
+        if (mexprvmath_cases[i].timed) {
+            mexprvmath_throughput (&mexprvmath_cases[i], x, e, y, y2, n);
+        }
+    }
+
+    free (x);
+    free (e);
+    free (y);
+    free (y2);
+    return ok ? 0 : 1;
+}
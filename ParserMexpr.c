@@ -66,3 +66,29 @@ Parser_Mexpr_Condition_build_expression_tree (void ) {
     free(postfix);
     return tree;
 }
+
+/* Parses the condition and lifts its literals into params, see
+    mexpr_parameterize_postfix( ). Appln looks up its cache by params->fingerprint and
+    calls mexpr_param_vec_build_tree( ) on a miss, before Parser_stack_reset( ) */
+bool
+Parser_Mexpr_Condition_parameterize (mexpr_param_vec_t *params) {
+
+    int stack_chkp = undo_stack.top + 1;
+
+    parse_rc_t err = PARSER_CALL(S);
+
+    do {
+
+        if (err == PARSE_SUCCESS) break;
+        err = PARSER_CALL(Q);
+        if (err == PARSE_ERR) return false;
+
+    } while (0);
+
+    int size_out = 0;
+    lex_data_t **postfix = mexpr_convert_infix_to_postfix (
+                                            &undo_stack.data[stack_chkp], undo_stack.top + 1 - stack_chkp, &size_out);
+
+    mexpr_parameterize_postfix (postfix, size_out, params);
+    return true;
+}
@@ -11,4 +11,7 @@ Parser_Mexpr_build_math_expression_tree (void  ) ;
 mexpt_tree_t *
 Parser_Mexpr_Condition_build_expression_tree (void );
 
+bool
+Parser_Mexpr_Condition_parameterize (mexpr_param_vec_t *params);
+
 #endif 
\ No newline at end of file
@@ -1,8 +1,41 @@
 flex Parser.l
 g++ -g -c -fpermissive lex.yy.c -o lex.yy.o
 g++ -g -c -fpermissive MExpr.c -o MExpr.o
+g++ -g -c -fpermissive MexprArena.c -o MexprArena.o
+g++ -g -c -fpermissive MexprIntern.c -o MexprIntern.o
 g++ -g -c -fpermissive ExpressionParser.c -o ExpressionParser.o
 g++ -g -c -fpermissive ParserMexpr.c -o ParserMexpr.o
+g++ -g -c -fpermissive MexprImage.c -o MexprImage.o
+g++ -g -c -fpermissive MexprJit.c -o MexprJit.o
+g++ -g -c -fpermissive MexprCodegen.c -o MexprCodegen.o
+g++ -g -c -fpermissive MexprTier.c -o MexprTier.o
+g++ -g -c -fpermissive MexprVmath.c -o MexprVmath.o
+g++ -g -c -fpermissive MexprBatch.c -o MexprBatch.o
+g++ -g -c -fpermissive MexprDict.c -o MexprDict.o
+g++ -g -c -fpermissive MexprInterval.c -o MexprInterval.o
+g++ -g -c -fpermissive MexprSarg.c -o MexprSarg.o
+g++ -g -c -fpermissive MexprConjunct.c -o MexprConjunct.o
+g++ -g -c -fpermissive MexprSelectivity.c -o MexprSelectivity.o
+g++ -g -c -fpermissive MexprAdaptive.c -o MexprAdaptive.o
+g++ -g -c -fpermissive MexprParallel.c -o MexprParallel.o
+g++ -g -c -fpermissive MexprProgram.c -o MexprProgram.o
+g++ -g -c -fpermissive MexprCodegenTool.c -o MexprCodegenTool.o
+g++ -g -c -fpermissive MexprSelTool.c -o MexprSelTool.o
+g++ -g -c -fpermissive MexprParTool.c -o MexprParTool.o
+g++ -g -c -fpermissive MexprJitTool.c -o MexprJitTool.o
+g++ -g -c -fpermissive MexprVmathTool.c -o MexprVmathTool.o
+g++ -g -c -fpermissive MexprInternTool.c -o MexprInternTool.o
+g++ -g -c -fpermissive MexprCloneTool.c -o MexprCloneTool.o
+g++ -g -c -fpermissive MexprTierTool.c -o MexprTierTool.o
+g++ -std=c++17 -fsyntax-only MexprConstexprTest.cpp
 g++ -g -c -fpermissive test.c -o test.o
-g++ -g test.o lex.yy.o ParserMexpr.o MExpr.o ExpressionParser.o -o exe -lfl -lm
+g++ -g test.o lex.yy.o ParserMexpr.o MExpr.o MexprArena.o MexprIntern.o ExpressionParser.o MexprImage.o MexprJit.o MexprCodegen.o MexprTier.o MexprBatch.o MexprVmath.o MexprDict.o MexprInterval.o MexprSarg.o MexprConjunct.o MexprSelectivity.o MexprAdaptive.o MexprParallel.o MexprProgram.o -o exe -lfl -lm -ldl -lpthread
+g++ -g MexprCodegenTool.o lex.yy.o ParserMexpr.o MExpr.o MexprArena.o MexprIntern.o ExpressionParser.o MexprCodegen.o -o mexprcc -lfl -lm -ldl
+g++ -g MexprSelTool.o lex.yy.o ParserMexpr.o MExpr.o MexprArena.o MexprIntern.o ExpressionParser.o MexprSarg.o MexprSelectivity.o -o mexprsel -lfl -lm -ldl
+g++ -g MexprParTool.o lex.yy.o ParserMexpr.o MExpr.o MexprArena.o MexprIntern.o ExpressionParser.o MexprBatch.o MexprVmath.o MexprParallel.o -o mexprpar -lfl -lm -ldl -lpthread
+g++ -g MexprJitTool.o lex.yy.o ParserMexpr.o MExpr.o MexprArena.o MexprIntern.o ExpressionParser.o MexprJit.o -o mexprjit -lfl -lm -ldl
+g++ -g MexprVmathTool.o lex.yy.o ParserMexpr.o MExpr.o MexprArena.o MexprIntern.o ExpressionParser.o MexprVmath.o -o mexprvmath -lfl -lm -ldl
+g++ -g MexprInternTool.o lex.yy.o ParserMexpr.o MExpr.o MexprArena.o MexprIntern.o ExpressionParser.o -o mexprintern -lfl -lm -ldl
+g++ -g MexprCloneTool.o lex.yy.o ParserMexpr.o MExpr.o MexprArena.o MexprIntern.o ExpressionParser.o -o mexprclone -lfl -lm -ldl
+g++ -g MexprTierTool.o lex.yy.o ParserMexpr.o MExpr.o MexprArena.o MexprIntern.o ExpressionParser.o MexprProgram.o MexprTier.o -o mexprtier -lfl -lm -ldl
 
@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <string.h>
+#include <unistd.h>
 #include "UserParserL.h"
 #include "ParserMexpr.h"
 
@@ -31,8 +32,7 @@ compute_opd_value_fn (void *data_src) {
     }
 
     else if ((char)data_src == 'd') {
-        res.dtype = MEXPR_DTYPE_STRING;
-        res.u.str_val = "Sagar";
+        res = mexpr_var_string ((unsigned char *)"Sagar", 5);
     }
 
     return res;
@@ -83,9 +83,7 @@ main (int argc, char **argv) {
             
             printf ("Error : Exp Tree Validation Failed\n");
 
-            mexpt_destroy (tree->root, false);
-            assert (!tree->opd_list_head.lst_right);
-            free(tree);
+            mexpt_tree_destroy (tree, false);
             Parser_stack_reset();
             continue;
         }
@@ -129,16 +127,14 @@ main (int argc, char **argv) {
         if (!mexpr_validate_expression_tree (tree)) {
             
             printf ("Error : Exp Tree Validation Failed\n");
-            mexpt_destroy (tree->root, false);
-            assert (!tree->opd_list_head.lst_right);
-            free(tree);
+            mexpt_tree_destroy (tree, false);
             Parser_stack_reset();
             continue;
         }
         printf ("Exp Tree Successfully Validated after resolution\n");
 
 #if 1
-        uint8_t cnt = mexpt_remove_unresolved_operands (tree, false);
+        int cnt = mexpt_remove_unresolved_operands (tree, false);
         printf ("No of unresolved operands removed = %d\n", cnt);
 
         if (cnt) {
@@ -152,9 +148,7 @@ main (int argc, char **argv) {
         if (res.retc == failure_type_t) {
 
             printf ("Error : Exp Tree Evaluation Failed\n");
-                    mexpt_destroy (tree->root, false);
-                    assert (!tree->opd_list_head.lst_right);
-                    free(tree);
+                    mexpt_tree_destroy (tree, false);
                     Parser_stack_reset();
                     continue;
         }
@@ -175,9 +169,7 @@ main (int argc, char **argv) {
             else printf  (" = FALSE\n");
         }
 
-        mexpt_destroy (tree->root, false);
-        assert (!tree->opd_list_head.lst_right);
-        free(tree);
+        mexpt_tree_destroy (tree, false);
         Parser_stack_reset();
     }
 
@@ -186,7 +178,74 @@ main (int argc, char **argv) {
 
 #endif 
 
+/* Literals whose fold fails in the kernel : mexpt_optimize( ) must leave them
+    for the evaluation, and print nothing */
+static const char *test_fold_fails_exprs[] = {
+    "sqr(4000000000)",
+    "3037000500 * 3037000500",
+    "4 / 0",
+    NULL
+};
+
+static bool
+test_fold_fails (const char *expr) {
+
+    int out, saved;
+    long n_printed;
+    FILE *tmp;
+    mexpt_tree_t *tree;
+    mexpr_var_t res;
+    bool ok;
+
+    strcpy (lex_buffer, expr);
+    lex_set_scan_buffer (lex_buffer);
+
+    tree = Parser_Mexpr_build_math_expression_tree ();
+    Parser_stack_reset();
+
+    if (!tree || !mexpr_validate_expression_tree (tree)) {
+        printf ("%-30s FAILED : not a valid expression\n", expr);
+        if (tree) mexpt_tree_destroy (tree, false);
+        return false;
+    }
+
+    /* Catch what mexpt_optimize( ) prints */
+    tmp = tmpfile ();
+    fflush (stdout);
+    saved = dup (1);
+    out = fileno (tmp);
+    dup2 (out, 1);
+    mexpt_optimize (tree->root);
+    fflush (stdout);
+    dup2 (saved, 1);
+    close (saved);
+    n_printed = ftell (tmp);
+    fclose (tmp);
+
+    res = mexpt_evaluate (tree->root);
+
+    ok = n_printed == 0 && tree->root->left && res.dtype == MEXPR_DTYPE_INVALID;
+    printf ("%-30s %s : %ld bytes printed by optimize, %s, result dtype %d\n",
+                expr, ok ? "passed" : "FAILED", n_printed,
+                tree->root->left ? "not folded" : "folded", res.dtype);
+
+    mexpt_tree_destroy (tree, false);
+    return ok;
+}
 
+static int
+test_run (void) {
+
+    int i;
+    bool ok = true;
+
+    for (i = 0; test_fold_fails_exprs[i]; i++) {
+        ok = test_fold_fails (test_fold_fails_exprs[i]) && ok;
+    }
+    return ok ? 0 : 1;
+}
+
+/* exe -t runs the checks above, else exe is a calculator */
 int 
 main (int argc, char **argv) {
 
@@ -195,6 +254,8 @@ main (int argc, char **argv) {
     mexpt_tree_t *tree ;
     mexpr_var_t res;
 
+    if (argc > 1 && strcmp (argv[1], "-t") == 0) return test_run ();
+
     while (1) {
         
         printf ("Calc : ");
@@ -231,9 +292,7 @@ main (int argc, char **argv) {
             
             printf ("Error : Exp Tree Validation Failed\n");
 
-            mexpt_destroy (tree->root, false);
-            assert (!tree->opd_list_head.lst_right);
-            free(tree);
+            mexpt_tree_destroy (tree, false);
             Parser_stack_reset();
             continue;
         }
@@ -277,16 +336,14 @@ main (int argc, char **argv) {
         if (!mexpr_validate_expression_tree (tree)) {
             
             printf ("Error : Exp Tree Validation Failed\n");
-            mexpt_destroy (tree->root, false);
-            assert (!tree->opd_list_head.lst_right);
-            free(tree);
+            mexpt_tree_destroy (tree, false);
             Parser_stack_reset();
             continue;
         }
         printf ("Exp Tree Successfully Validated after resolution\n");
 
 #if 1
-        uint8_t cnt = mexpt_remove_unresolved_operands (tree, false);
+        int cnt = mexpt_remove_unresolved_operands (tree, false);
         printf ("No of unresolved operands removed = %d\n", cnt);
 
         if (cnt) {
@@ -300,9 +357,7 @@ main (int argc, char **argv) {
         if (res.dtype== MEXPR_DTYPE_INVALID) {
 
             printf ("Error : Exp Tree Evaluation Failed\n");
-                    mexpt_destroy (tree->root, false);
-                    assert (!tree->opd_list_head.lst_right);
-                    free(tree);
+                    mexpt_tree_destroy (tree, false);
                     Parser_stack_reset();
                     continue;
         }
@@ -310,7 +365,7 @@ main (int argc, char **argv) {
         switch (res.dtype) {
 
             case MEXPR_DTYPE_INT:
-                printf ("= %d\n", ( int ) res.u.int_val);
+                printf ("= %lld\n", (long long) res.u.int_val);
                 break;
             case MEXPR_DTYPE_DOUBLE:
                 printf ("= %lf\n",  res.u.d_val);
@@ -326,9 +381,7 @@ main (int argc, char **argv) {
                 break;
             }
 
-        mexpt_destroy (tree->root, false);
-        assert (!tree->opd_list_head.lst_right);
-        free(tree);
+        mexpt_tree_destroy (tree, false);
         Parser_stack_reset();
     }
 